@@ -1,10 +1,27 @@
 #include "certs.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h" // IWYU pragma: keep
+#include "freertos/semphr.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/version.h"
+#include "mbedtls/x509_crt.h"
 #include <stdio.h>
 #include <stdlib.h>
+#if MBEDTLS_VERSION_MAJOR < 4
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#endif
+
+#define TAG "cikon:certs"
 
 static uint8_t *s_ca = NULL, *s_cert = NULL, *s_key = NULL;
 static size_t s_ca_len = 0, s_cert_len = 0, s_key_len = 0;
 
+static mbedtls_x509_crt s_chain;
+static mbedtls_pk_context s_pk;
+static int s_parsed_refs = 0;
+static SemaphoreHandle_t s_parsed_mutex = NULL;
+
 static uint8_t *load_file(const char *path, size_t *out_len) {
     FILE *f = fopen(path, "rb");
     if (!f)
@@ -68,3 +85,65 @@ size_t get_client_key_size(void) {
     ensure_loaded();
     return s_key_len;
 }
+
+static int parse_key(mbedtls_pk_context *pk) {
+#if MBEDTLS_VERSION_MAJOR >= 4
+    return mbedtls_pk_parse_key(pk, s_key, s_key_len, NULL, 0);
+#else
+    // mbedtls 3.x wants an RNG for key blinding during the pair check
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&drbg);
+    int ret = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, NULL, 0);
+    if (ret == 0)
+        ret = mbedtls_pk_parse_key(pk, s_key, s_key_len, NULL, 0, mbedtls_ctr_drbg_random, &drbg);
+    mbedtls_ctr_drbg_free(&drbg);
+    mbedtls_entropy_free(&entropy);
+    return ret;
+#endif
+}
+
+bool certs_acquire_parsed(mbedtls_x509_crt **chain, mbedtls_pk_context **key) {
+    if (!certs_available())
+        return false;
+
+    if (!s_parsed_mutex) {
+        static StaticSemaphore_t mutex_buf;
+        s_parsed_mutex = xSemaphoreCreateMutexStatic(&mutex_buf);
+    }
+
+    xSemaphoreTake(s_parsed_mutex, portMAX_DELAY);
+    if (s_parsed_refs == 0) {
+        mbedtls_x509_crt_init(&s_chain);
+        mbedtls_pk_init(&s_pk);
+        int ret = mbedtls_x509_crt_parse(&s_chain, s_cert, s_cert_len);
+        if (ret == 0)
+            ret = parse_key(&s_pk);
+        if (ret != 0) {
+            ESP_LOGE(TAG, "Failed to parse client certificate/key: -0x%04x", -ret);
+            mbedtls_x509_crt_free(&s_chain);
+            mbedtls_pk_free(&s_pk);
+            xSemaphoreGive(s_parsed_mutex);
+            return false;
+        }
+    }
+    s_parsed_refs++;
+    xSemaphoreGive(s_parsed_mutex);
+
+    *chain = &s_chain;
+    *key = &s_pk;
+    return true;
+}
+
+void certs_release_parsed(void) {
+    if (!s_parsed_mutex)
+        return;
+
+    xSemaphoreTake(s_parsed_mutex, portMAX_DELAY);
+    if (s_parsed_refs > 0 && --s_parsed_refs == 0) {
+        mbedtls_x509_crt_free(&s_chain);
+        mbedtls_pk_free(&s_pk);
+    }
+    xSemaphoreGive(s_parsed_mutex);
+}
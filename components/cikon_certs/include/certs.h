@@ -19,6 +19,17 @@ size_t get_client_key_size(void);
 
 bool certs_available(void);
 
+// NOLINTBEGIN(readability-identifier-naming)
+typedef struct mbedtls_x509_crt mbedtls_x509_crt;
+typedef struct mbedtls_pk_context mbedtls_pk_context;
+// NOLINTEND(readability-identifier-naming)
+
+/* Client certificate chain and key, parsed once into mbedtls contexts and shared by every TLS
+ * endpoint that can take them instead of PEM (HTTPS cert selection hook). Refcounted: each
+ * successful acquire needs one release; the contexts are freed with the last one. */
+bool certs_acquire_parsed(mbedtls_x509_crt **chain, mbedtls_pk_context **key);
+void certs_release_parsed(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -20,8 +20,9 @@
 
 #define SUPERVISOR_EVENT_CMND_COMPLETED BIT0
 #define SUPERVISOR_EVENT_PLATFORM_INITIALIZED BIT1
+#define SUPERVISOR_EVENT_ADAPTER_STATE_CHANGED BIT2 // Adapter enabled/disabled at runtime
 
-// BIT2-4: Available
+// BIT3-4: Available
 
 #define INET_EVENT_STA_READY BIT5  // WiFi STA got IP
 #define INET_EVENT_STA_LOST BIT6   // WiFi STA disconnected
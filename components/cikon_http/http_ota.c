@@ -0,0 +1,220 @@
+#include "http_ota.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h" // IWYU pragma: keep
+#include "freertos/task.h"
+#include "ota_delta.h"
+#include "ota_inflate.h"
+#include "ota_writer.h"
+#include "platform_services.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Clients are not authenticated: only images signed with the project key may be installed
+#if !CONFIG_SECURE_SIGNED_ON_UPDATE
+#error "HTTP OTA needs app signature verification on update (SECURE_SIGNED_ON_UPDATE)"
+#endif
+
+#define TAG "cikon:http:ota"
+#define OTA_URI "/ota"
+#define OTA_SHA256_HDR "X-OTA-SHA256"
+#define OTA_SHA256_LEN 32
+#define OTA_DELTA_TYPE "application/x-ota-delta"
+#define OTA_RECV_RETRIES 3 // Receive timeouts in a row before the upload is given up
+#define OTA_DEFLATE_BUF_SIZE 2048 // Compressed input; inflated output goes to pipeline buffers
+#define OTA_RESTART_DELAY_MS 500 // Lets the response reach the client
+
+static bool parse_sha256(const char *hex, uint8_t out[OTA_SHA256_LEN]) {
+    if (strlen(hex) != OTA_SHA256_LEN * 2)
+        return false;
+
+    for (int i = 0; i < OTA_SHA256_LEN; i++) {
+        char byte[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+        if (!isxdigit((unsigned char)byte[0]) || !isxdigit((unsigned char)byte[1]))
+            return false;
+        out[i] = (uint8_t)strtoul(byte, NULL, 16);
+    }
+    return true;
+}
+
+static esp_err_t ota_reply(httpd_req_t *req, const char *status, const char *msg) {
+    ESP_LOGW(TAG, "%s %s %s", req->uri, status, msg);
+    httpd_resp_set_status(req, status);
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_sendstr(req, msg);
+    return ESP_FAIL;
+}
+
+// Verifies and activates the written image, answers and restarts on success
+static esp_err_t ota_complete(httpd_req_t *req, const uint8_t sha[OTA_SHA256_LEN]) {
+    esp_err_t err = ota_writer_finish(sha, OTA_SHA256_LEN);
+    if (err == ESP_ERR_INVALID_CRC)
+        return ota_reply(req, "400 Bad Request", "SHA-256 mismatch");
+    if (err == ESP_ERR_OTA_VALIDATE_FAILED)
+        return ota_reply(req, "400 Bad Request", "Invalid image");
+    if (err != ESP_OK)
+        return ota_reply(req, "500 Internal Server Error", esp_err_to_name(err));
+
+    httpd_resp_set_hdr(req, "Connection", "close");
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_sendstr(req, "OK, restarting");
+    ESP_LOGI(TAG, "Update written, restarting");
+    vTaskDelay(pdMS_TO_TICKS(OTA_RESTART_DELAY_MS));
+    esp_safe_restart();
+    return ESP_OK;
+}
+
+#if CONFIG_OTA_COMPRESSED
+// ESP_FAIL if the client went away, another error if the stream is corrupt or a write failed.
+// A delta patch is applied against the running partition between the inflater and the pipeline.
+static esp_err_t receive_deflate(httpd_req_t *req, bool delta) {
+#if CONFIG_OTA_DELTA
+    ota_delta_t *d = delta ? ota_delta_new(ota_writer_sink, NULL) : NULL;
+    if (delta && !d)
+        return ESP_ERR_NO_MEM; // Never flash the inflated patch as if it were the image
+    ota_inflate_t *z =
+        d ? ota_inflate_new(ota_delta_sink, d) : ota_inflate_new(ota_writer_sink, NULL);
+#else
+    ota_inflate_t *z = ota_inflate_new(ota_writer_sink, NULL);
+#endif
+    char *buf = malloc(OTA_DEFLATE_BUF_SIZE);
+    if (!z || !buf) {
+        ota_inflate_free(z);
+#if CONFIG_OTA_DELTA
+        ota_delta_free(d);
+#endif
+        free(buf);
+        return ESP_ERR_NO_MEM;
+    }
+
+    size_t rem = req->content_len;
+    int timeouts = 0;
+    esp_err_t err = ESP_OK;
+    while (err == ESP_OK && rem > 0) {
+        int got = httpd_req_recv(req, buf, rem < OTA_DEFLATE_BUF_SIZE ? rem : OTA_DEFLATE_BUF_SIZE);
+        if (got == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts <= OTA_RECV_RETRIES)
+            continue;
+        if (got <= 0) {
+            err = ESP_FAIL;
+            break;
+        }
+        timeouts = 0;
+        err = ota_inflate_feed(z, (const uint8_t *)buf, got);
+        rem -= got;
+    }
+    if (err == ESP_OK)
+        err = ota_inflate_finish(z);
+    ota_inflate_free(z);
+#if CONFIG_OTA_DELTA
+    if (d && err == ESP_OK)
+        err = ota_delta_finish(d);
+    ota_delta_free(d);
+#endif
+    free(buf);
+    return err;
+}
+#endif
+
+/* No staging copy: the body goes from the socket buffer straight into esp_ota_write(), hashed on
+ * the way. The client sends the image's SHA-256 (hex) in X-OTA-SHA256, e.g.
+ *   curl -H "X-OTA-SHA256: $(sha256sum fw.bin | cut -c1-64)" --data-binary @fw.bin http://dev/ota
+ * or with "Content-Encoding: deflate" and a zlib stream from ota_pack.py (digest of the inflated
+ * image). "Content-Type: application/x-ota-delta" sends a patch from ota_delta.py instead, built
+ * against the firmware currently running (digest of the rebuilt image).
+ * Image and signature verification and the rollback path are the same as for TCP OTA. */
+esp_err_t http_ota_receive(httpd_req_t *req) {
+    if (req->content_len == 0)
+        return ota_reply(req, "411 Length Required", "Content-Length required");
+
+    char sha_hex[OTA_SHA256_LEN * 2 + 1] = "";
+    uint8_t sha[OTA_SHA256_LEN];
+    httpd_req_get_hdr_value_str(req, OTA_SHA256_HDR, sha_hex, sizeof(sha_hex));
+    if (!parse_sha256(sha_hex, sha))
+        return ota_reply(req, "400 Bad Request", OTA_SHA256_HDR " (hex) required");
+
+    char encoding[16] = "";
+    bool deflate = false;
+    httpd_req_get_hdr_value_str(req, "Content-Encoding", encoding, sizeof(encoding));
+#if CONFIG_OTA_COMPRESSED
+    deflate = strcmp(encoding, "deflate") == 0; // HTTP "deflate" is the zlib format
+#endif
+    if (encoding[0] && !deflate)
+        return ota_reply(req, "415 Unsupported Media Type", "Unsupported Content-Encoding");
+
+    char type[32] = "";
+    bool delta = false;
+    httpd_req_get_hdr_value_str(req, "Content-Type", type, sizeof(type));
+#if CONFIG_OTA_DELTA
+    delta = strcmp(type, OTA_DELTA_TYPE) == 0; // Always zlib-compressed, with or without the header
+    deflate |= delta;
+#endif
+
+    // Compressed: Content-Length is not the image size, so no upfront size check or progress
+    esp_err_t err = ota_writer_begin(deflate ? 0 : req->content_len, OTA_HASH_SHA256);
+    if (err == ESP_ERR_INVALID_STATE)
+        return ota_reply(req, "409 Conflict", "OTA already in progress");
+    if (err == ESP_ERR_INVALID_SIZE)
+        return ota_reply(req, "413 Payload Too Large", "Image larger than OTA partition");
+    if (err != ESP_OK)
+        return ota_reply(req, "500 Internal Server Error", esp_err_to_name(err));
+
+#if CONFIG_OTA_COMPRESSED
+    if (deflate) {
+        err = receive_deflate(req, delta);
+        if (err != ESP_OK) {
+            ota_writer_abort();
+            if (err == ESP_FAIL)
+                return ESP_FAIL;
+            if (err == ESP_ERR_INVALID_VERSION)
+                return ota_reply(req, "409 Conflict", "Patch made for a different firmware");
+            if (err == ESP_ERR_INVALID_RESPONSE || err == ESP_ERR_INVALID_SIZE)
+                return ota_reply(req, "400 Bad Request", "Corrupt compressed image");
+            return ota_reply(req, "500 Internal Server Error", esp_err_to_name(err));
+        }
+        return ota_complete(req, sha);
+    }
+#endif
+
+    // Receive straight into pipeline buffers while the writer task flashes the previous one
+    size_t rem = req->content_len;
+    int timeouts = 0;
+    while (rem > 0) {
+        size_t size;
+        uint8_t *buf = ota_writer_acquire(&size);
+        if (!buf)
+            break; // Flash write failed
+
+        size_t len = 0;
+        while (len < size && rem > 0) {
+            size_t want = size - len < rem ? size - len : rem;
+            int got = httpd_req_recv(req, (char *)buf + len, want);
+            if (got == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts <= OTA_RECV_RETRIES)
+                continue;
+            if (got <= 0) {
+                // Client gone: the running image stays the boot partition
+                ota_writer_commit(buf, 0);
+                ota_writer_abort();
+                return ESP_FAIL;
+            }
+            timeouts = 0;
+            len += got;
+            rem -= got;
+        }
+        if (ota_writer_commit(buf, len) != ESP_OK)
+            break;
+    }
+    if (rem > 0) {
+        ota_writer_abort();
+        return ota_reply(req, "500 Internal Server Error", "Flash write failed");
+    }
+
+    return ota_complete(req, sha);
+}
+
+void http_ota_init(httpd_handle_t server) {
+    httpd_uri_t ep = {.uri = OTA_URI, .method = HTTP_POST, .handler = http_ota_receive};
+    if (httpd_register_uri_handler(server, &ep) != ESP_OK)
+        ESP_LOGE(TAG, "Failed to register %s", OTA_URI);
+    else
+        ESP_LOGI(TAG, "Firmware upload ready at POST %s", OTA_URI);
+}
@@ -0,0 +1,87 @@
+#include "http_range.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool parse_size(const char *s, char **end, size_t *out) {
+    if (*s < '0' || *s > '9')
+        return false;
+    *out = strtoul(s, end, 10);
+    return true;
+}
+
+http_range_result_t http_range_parse(const char *hdr, size_t size, http_range_t *out) {
+    if (!hdr || strncmp(hdr, "bytes=", 6) != 0 || strchr(hdr, ','))
+        return HTTP_RANGE_NONE;
+
+    const char *spec = hdr + 6;
+    char *end;
+    size_t first, last;
+
+    if (*spec == '-') {
+        // Suffix: the last N bytes
+        if (!parse_size(spec + 1, &end, &last) || *end)
+            return HTTP_RANGE_NONE;
+        if (last == 0 || size == 0)
+            return HTTP_RANGE_UNSATISFIABLE;
+        first = last < size ? size - last : 0;
+        last = size - 1;
+    } else {
+        if (!parse_size(spec, &end, &first) || *end != '-')
+            return HTTP_RANGE_NONE;
+        if (end[1] == '\0') {
+            last = size - 1;
+        } else if (!parse_size(end + 1, &end, &last) || *end || last < first) {
+            return HTTP_RANGE_NONE;
+        }
+        if (first >= size)
+            return HTTP_RANGE_UNSATISFIABLE;
+        if (last >= size)
+            last = size - 1;
+    }
+
+    out->start = first;
+    out->len = last - first + 1;
+    return HTTP_RANGE_OK;
+}
+
+bool http_content_range_parse(const char *hdr, http_range_t *out, size_t *total) {
+    if (!hdr || strncmp(hdr, "bytes ", 6) != 0)
+        return false;
+
+    const char *spec = hdr + 6;
+    char *end;
+    size_t first, last;
+
+    if (*spec == '*') {
+        out->start = 0;
+        out->len = 0;
+        return spec[1] == '/' && parse_size(spec + 2, &end, total) && !*end;
+    }
+
+    if (!parse_size(spec, &end, &first) || *end != '-' || !parse_size(end + 1, &end, &last) ||
+        *end != '/' || !parse_size(end + 1, &end, total) || *end)
+        return false;
+    if (last < first || last >= *total)
+        return false;
+
+    out->start = first;
+    out->len = last - first + 1;
+    return true;
+}
+
+void http_range_set_headers(httpd_req_t *req, http_range_result_t result, const http_range_t *r,
+                            size_t size, char *hdr_buf) {
+    httpd_resp_set_hdr(req, "Accept-Ranges", "bytes");
+
+    if (result == HTTP_RANGE_OK) {
+        snprintf(hdr_buf, HTTP_RANGE_HDR_LEN, "bytes %zu-%zu/%zu", r->start,
+                 r->start + r->len - 1, size);
+        httpd_resp_set_status(req, "206 Partial Content");
+        httpd_resp_set_hdr(req, "Content-Range", hdr_buf);
+    } else if (result == HTTP_RANGE_UNSATISFIABLE) {
+        snprintf(hdr_buf, HTTP_RANGE_HDR_LEN, "bytes */%zu", size);
+        httpd_resp_set_status(req, "416 Range Not Satisfiable");
+        httpd_resp_set_hdr(req, "Content-Range", hdr_buf);
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "esp_http_server.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Single-range "Range: bytes=..." support shared by static files and WebDAV */
+
+#define HTTP_RANGE_HDR_LEN 48 // "bytes */<size>" / "bytes <a>-<b>/<size>"
+
+typedef enum {
+    HTTP_RANGE_NONE,          // No (or ignored, e.g. multi-range) header: send everything
+    HTTP_RANGE_OK,            // Send [start, start + len)
+    HTTP_RANGE_UNSATISFIABLE, // Answer 416
+} http_range_result_t;
+
+typedef struct {
+    size_t start;
+    size_t len;
+} http_range_t;
+
+http_range_result_t http_range_parse(const char *hdr, size_t size, http_range_t *out);
+
+// Parses a request "Content-Range: bytes <a>-<b>/<total>" (a resumable upload chunk) or
+// "bytes */<total>" (offset query, out->len = 0). False if malformed or inconsistent.
+bool http_content_range_parse(const char *hdr, http_range_t *out, size_t *total);
+
+/* Sets the 206 / 416 status and Content-Range for a parse result (nothing for NONE) plus
+ * Accept-Ranges. hdr_buf (HTTP_RANGE_HDR_LEN) must stay valid until the response is sent. */
+void http_range_set_headers(httpd_req_t *req, http_range_result_t result, const http_range_t *r,
+                            size_t size, char *hdr_buf);
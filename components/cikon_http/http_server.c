@@ -4,19 +4,106 @@
 #include "esp_http_server.h"
 #include "esp_https_server.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h" // IWYU pragma: keep
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "http_range.h"
+#if CONFIG_ESP_TLS_SERVER_CERT_SELECT_HOOK
+#include "mbedtls/ssl.h"
+#endif
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
 #if CONFIG_HTTP_ENABLE_WEBDAV
 #include "webdav.h"
 #endif
+#if CONFIG_HTTP_WEB_BUNDLE
+#include "web_bundle.h"
+#endif
+#if CONFIG_HTTP_OTA
+#include "http_ota.h"
+#endif
 
 #define TAG "cikon:http"
 #define WWW_ROOT CONFIG_VFS_LITTLEFS_MOUNT_POINT "/www"
 
+#define CACHE_CONTROL_IMMUTABLE "public, max-age=31536000, immutable"
+#define CACHE_CONTROL_REVALIDATE "no-cache"
+#define HASHED_NAME_MIN_HEX 8
+
+#define ASSET_MANIFEST WWW_ROOT "/.manifest"
+#define ASSET_ENC_BR (1 << 0)
+#define ASSET_ENC_GZ (1 << 1)
+#define ASSET_ENC_ID (1 << 2)
+
+#define STR_(x) #x
+#define STR(x) STR_(x)
+#define KEEPALIVE_HDR "timeout=" STR(CONFIG_HTTP_SESSION_TIMEOUT)
+
+/* Per-request state of a static file response. Heap allocated so it can be handed to a worker
+ * together with the async copy of the request; header values set on the response point into it,
+ * so it must outlive the send. */
+typedef struct {
+    httpd_req_t *req;
+    FILE *f;
+    const char *encoding; // Content-Encoding of the file served, NULL for identity
+    const char *ct;
+    const char *cache_control;
+    char etag[24];
+    char if_none_match[64];
+    char range[48];
+    char content_range[HTTP_RANGE_HDR_LEN];
+    char path[sizeof(WWW_ROOT) + CONFIG_HTTPD_MAX_URI_LEN + 3]; /* + ".gz" / ".br" */
+} static_req_t;
+
+/* One line of the manifest written by web_assets.py at build time: which encoded variants of an
+ * asset exist in the image, and its content hash. */
+typedef struct {
+    char *uri;
+    uint8_t encodings; // ASSET_ENC_*
+    char hash[9];
+} asset_t;
+
 static httpd_handle_t s_server = NULL;
 static bool s_secure = false;
-static char s_path[sizeof(WWW_ROOT) + CONFIG_HTTPD_MAX_URI_LEN];
-static char gz_path[sizeof(s_path) + 4]; /* + ".gz\0" */
+#if CONFIG_ESP_TLS_SERVER_CERT_SELECT_HOOK
+static mbedtls_x509_crt *s_tls_chain = NULL; // Shared, see certs_acquire_parsed()
+static mbedtls_pk_context *s_tls_key = NULL;
+#endif
+static http_version_fn_t s_json_version = NULL;
+static asset_t *s_assets = NULL; // Sorted by uri
+static size_t s_asset_count = 0;
+
+#if CONFIG_HTTP_EVENTS
+static http_json_get_fn_t s_events_snapshot = NULL;
+static http_json_post_fn_t s_events_cmnd = NULL;
+static SemaphoreHandle_t s_events_mutex = NULL;
+static cJSON *s_events_last = NULL; // Last pushed telemetry, base for deltas
+static bool s_events_full = true;   // Next push carries the full state (new subscriber)
+#endif
+
+#if CONFIG_HTTP_LONGPOLL_MAX > 0
+typedef struct {
+    httpd_req_t *req; // Async copy, NULL = free slot
+    uint32_t since;
+    TickType_t deadline;
+} longpoll_t;
+
+static longpoll_t s_longpolls[CONFIG_HTTP_LONGPOLL_MAX];
+static http_json_get_fn_t s_longpoll_fn = NULL;
+static SemaphoreHandle_t s_longpoll_mutex = NULL;
+static TaskHandle_t s_longpoll_task = NULL;
+#endif
+
+#if CONFIG_HTTP_STATIC_WORKERS > 0
+static QueueHandle_t s_static_queue = NULL;
+static SemaphoreHandle_t s_static_idle = NULL; // Counts workers waiting for a job
+#endif
 
 static void http_log(const char *method, int status, const char *path, size_t bytes) {
     if (status >= 500)
@@ -28,67 +115,450 @@ static void http_log(const char *method, int status, const char *path, size_t by
 }
 
 static void set_keepalive_timeout(httpd_req_t *req) {
-    static char hdr[32];
-    snprintf(hdr, sizeof(hdr), "timeout=%d", CONFIG_HTTP_SESSION_TIMEOUT);
-    httpd_resp_set_hdr(req, "Keep-Alive", hdr);
+    httpd_resp_set_hdr(req, "Keep-Alive", KEEPALIVE_HDR);
+}
+
+/* Content hash in the file name (e.g. app.3f9a1c2b.js): the contents behind such a name never
+ * change, so browsers may cache it without revalidating. */
+static bool is_hashed_asset(const char *path) {
+    const char *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+
+    for (const char *dot = strchr(name, '.'); dot; dot = strchr(dot + 1, '.')) {
+        const char *end = strchr(dot + 1, '.');
+        if (!end)
+            return false;
+
+        size_t hex = 0;
+        while (dot + 1 + hex < end && isxdigit((unsigned char)dot[1 + hex])) {
+            hex++;
+        }
+        if (hex >= HASHED_NAME_MIN_HEX && dot + 1 + hex == end)
+            return true;
+    }
+    return false;
+}
+
+static const char *content_type(const char *path) {
+    if (strstr(path, ".css"))
+        return "text/css";
+    if (strstr(path, ".js"))
+        return "application/javascript";
+    return "text/html";
+}
+
+#define ACCEPT_ENCODING_LEN 96
+
+// "0", "0.5", "1.000" -> 0..1000; anything else counts as 1
+static int parse_qvalue(const char *s) {
+    if (*s != '0' && *s != '1')
+        return 1000;
+    int q = (*s++ - '0') * 1000;
+    if (*s == '.') {
+        s++;
+        for (int scale = 100; scale > 0 && isdigit((unsigned char)*s); scale /= 10, s++) {
+            q += (*s - '0') * scale;
+        }
+    }
+    return q > 1000 ? 1000 : q;
+}
+
+/* Weight (0-1000) an Accept-Encoding header gives a content coding: its own entry, else "*",
+ * else 0; identity is acceptable unless refused (RFC 9110 12.5.3). A request without the header
+ * gets identity only: curl and small clients send none and cannot decode gzip. */
+static int accept_quality(const char *accept, const char *coding) {
+    size_t coding_len = strlen(coding);
+    int star = -1;
+    for (const char *p = accept; *p;) {
+        p += strspn(p, " \t,");
+        size_t len = strcspn(p, " \t;,");
+        size_t end = strcspn(p, ",");
+        int q = 1000;
+        for (const char *param = p + len; param < p + end; param++) {
+            if ((*param == 'q' || *param == 'Q') && param[1] == '=') {
+                q = parse_qvalue(param + 2);
+                break;
+            }
+        }
+        bool x_gzip = len == 6 && !strcmp(coding, "gzip") && !strncasecmp(p, "x-gzip", 6);
+        if ((len == coding_len && !strncasecmp(p, coding, len)) || x_gzip)
+            return q;
+        if (len == 1 && *p == '*')
+            star = q;
+        p += end;
+    }
+    if (star >= 0)
+        return star;
+    return strcmp(coding, "identity") == 0 ? 1000 : 0;
+}
+
+// Only compressed copies of the asset exist and the client takes none of them
+static void send_not_acceptable(httpd_req_t *req, const char *uri) {
+    httpd_resp_set_status(req, "406 Not Acceptable");
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_sendstr(req, "Stored compressed only, send Accept-Encoding: gzip");
+    http_log("GET", 406, uri, 0);
+}
+
+#if CONFIG_HTTP_WEB_BUNDLE
+/* Serves a bundled asset straight from memory-mapped flash with a single send, no copy.
+ * Returns false if not bundled so the caller falls back to LittleFS. Bundled names win, so a
+ * gzipped entry the client cannot take gets 406 rather than another file. */
+static bool bundle_send(httpd_req_t *req, const char *uri) {
+    web_bundle_file_t file;
+    if (!web_bundle_find(uri, &file))
+        return false;
+
+    if (file.gzipped) {
+        char enc_hdr[ACCEPT_ENCODING_LEN] = "";
+        httpd_req_get_hdr_value_str(req, "Accept-Encoding", enc_hdr, sizeof(enc_hdr));
+        if (accept_quality(enc_hdr, "gzip") == 0) {
+            send_not_acceptable(req, uri);
+            return true;
+        }
+        httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    }
+
+    set_keepalive_timeout(req);
+    httpd_resp_set_hdr(req, "Cache-Control",
+                       is_hashed_asset(uri) ? CACHE_CONTROL_IMMUTABLE : CACHE_CONTROL_REVALIDATE);
+
+#if CONFIG_HTTP_STATIC_ETAG
+    char etag[12];
+    char if_none_match[64] = "";
+    snprintf(etag, sizeof(etag), "\"%08" PRIx32 "\"", file.crc);
+    httpd_resp_set_hdr(req, "ETag", etag);
+
+    httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match));
+    if (strstr(if_none_match, etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_send(req, NULL, 0);
+        http_log("GET", 304, uri, 0);
+        return true;
+    }
+#endif
+
+    httpd_resp_set_type(req, content_type(uri));
+    if (file.gzipped)
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+
+    // Ranges address the stored (possibly gzipped) bytes, i.e. the representation sent
+    char range_hdr[48] = "";
+    char content_range[HTTP_RANGE_HDR_LEN];
+    http_range_t range = {0, file.len};
+    httpd_req_get_hdr_value_str(req, "Range", range_hdr, sizeof(range_hdr));
+    http_range_result_t rr = http_range_parse(range_hdr, file.len, &range);
+    http_range_set_headers(req, rr, &range, file.len, content_range);
+    if (rr == HTTP_RANGE_UNSATISFIABLE) {
+        httpd_resp_send(req, NULL, 0);
+        http_log("GET", 416, uri, 0);
+        return true;
+    }
+
+    httpd_resp_send(req, (const char *)file.data + range.start, range.len);
+    http_log("GET", rr == HTTP_RANGE_OK ? 206 : 200, uri, range.len);
+    return true;
+}
+#endif
+
+static int asset_cmp(const void *a, const void *b) {
+    return strcmp(((const asset_t *)a)->uri, ((const asset_t *)b)->uri);
+}
+
+static void assets_unload(void) {
+    for (size_t i = 0; i < s_asset_count; i++) {
+        free(s_assets[i].uri);
+    }
+    free(s_assets);
+    s_assets = NULL;
+    s_asset_count = 0;
+}
+
+// Reads the build-time manifest; without one every request goes through the fopen fallback
+static void assets_load(void) {
+    assets_unload();
+
+    FILE *f = fopen(ASSET_MANIFEST, "r");
+    if (!f)
+        return;
+
+    char line[CONFIG_HTTPD_MAX_URI_LEN + 32];
+    size_t capacity = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char *uri = strtok(line, " \n");
+        char *encodings = strtok(NULL, " \n");
+        char *hash = strtok(NULL, " \n");
+        if (!uri || !encodings || !hash || uri[0] != '/')
+            continue;
+
+        if (s_asset_count == capacity) {
+            size_t grown = capacity ? capacity * 2 : 8;
+            asset_t *assets = realloc(s_assets, grown * sizeof(*assets));
+            if (!assets)
+                break;
+            s_assets = assets;
+            capacity = grown;
+        }
+
+        asset_t *a = &s_assets[s_asset_count];
+        a->uri = strdup(uri);
+        if (!a->uri)
+            break;
+        a->encodings = (strstr(encodings, "br") ? ASSET_ENC_BR : 0) |
+                       (strstr(encodings, "gz") ? ASSET_ENC_GZ : 0) |
+                       (strstr(encodings, "id") ? ASSET_ENC_ID : 0);
+        strlcpy(a->hash, hash, sizeof(a->hash));
+        s_asset_count++;
+    }
+    fclose(f);
+
+    qsort(s_assets, s_asset_count, sizeof(*s_assets), asset_cmp);
+    ESP_LOGI(TAG, "Asset manifest: %zu files", s_asset_count);
+}
+
+static const asset_t *asset_find(const char *uri) {
+    if (!s_asset_count)
+        return NULL;
+    asset_t key = {.uri = (char *)uri};
+    return bsearch(&key, s_assets, s_asset_count, sizeof(*s_assets), asset_cmp);
 }
 
+/* Picks the variant to serve from the manifest alone (no stat / fopen probing): the stored
+ * encoding the client weights highest, brotli before gzip before identity on a tie. Returns false
+ * if it accepts none of them; the build ships no plain copy of compressible files. */
+static bool asset_select(const asset_t *asset, const char *accept, static_req_t *ctx) {
+    int br = (asset->encodings & ASSET_ENC_BR) ? accept_quality(accept, "br") : 0;
+    int gz = (asset->encodings & ASSET_ENC_GZ) ? accept_quality(accept, "gzip") : 0;
+    int id = (asset->encodings & ASSET_ENC_ID) ? accept_quality(accept, "identity") : 0;
+    const char *suffix = "";
+    if (br > 0 && br >= gz && br >= id) {
+        ctx->encoding = "br";
+        suffix = ".br";
+    } else if (gz > 0 && gz >= id) {
+        ctx->encoding = "gzip";
+        suffix = ".gz";
+    } else if (id == 0) {
+        return false;
+    }
+    snprintf(ctx->path, sizeof(ctx->path), WWW_ROOT "%s%s", asset->uri, suffix);
+
+#if CONFIG_HTTP_STATIC_ETAG
+    snprintf(ctx->etag, sizeof(ctx->etag), "\"%s-%s\"", asset->hash,
+             ctx->encoding ? suffix + 1 : "id");
+#endif
+    return true;
+}
+
+// Sends headers and body (or 304) for an opened file; closes the file
+static void static_send(static_req_t *ctx) {
+    httpd_req_t *req = ctx->req;
+
+    set_keepalive_timeout(req);
+    httpd_resp_set_hdr(req, "Cache-Control", ctx->cache_control);
+    if (ctx->encoding)
+        httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+
+#if CONFIG_HTTP_STATIC_ETAG
+    // Manifest assets come with a tag already; otherwise size + mtime of the file actually
+    // served, so plain and .gz variants get distinct tags
+    struct stat st;
+    if (ctx->etag[0]) {
+        httpd_resp_set_hdr(req, "ETag", ctx->etag);
+    } else if (fstat(fileno(ctx->f), &st) == 0) {
+        snprintf(ctx->etag, sizeof(ctx->etag), "\"%lx-%lx\"", (unsigned long)st.st_size,
+                 (unsigned long)st.st_mtime);
+        httpd_resp_set_hdr(req, "ETag", ctx->etag);
+    }
+
+    if (ctx->etag[0] && strstr(ctx->if_none_match, ctx->etag)) {
+        fclose(ctx->f);
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_send(req, NULL, 0);
+        http_log("GET", 304, ctx->path, 0);
+        return;
+    }
+#endif
+
+    httpd_resp_set_type(req, ctx->ct);
+    if (ctx->encoding)
+        httpd_resp_set_hdr(req, "Content-Encoding", ctx->encoding);
+
+    struct stat fst;
+    size_t size = fstat(fileno(ctx->f), &fst) == 0 ? (size_t)fst.st_size : 0;
+    http_range_t range = {0, size};
+    http_range_result_t rr = http_range_parse(ctx->range, size, &range);
+    http_range_set_headers(req, rr, &range, size, ctx->content_range);
+    if (rr == HTTP_RANGE_UNSATISFIABLE) {
+        fclose(ctx->f);
+        httpd_resp_send(req, NULL, 0);
+        http_log("GET", 416, ctx->path, 0);
+        return;
+    }
+    if (rr == HTTP_RANGE_OK && fseek(ctx->f, (long)range.start, SEEK_SET) != 0) {
+        fclose(ctx->f);
+        http_log("GET", 500, ctx->path, 0);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+        return;
+    }
+
+    char buf[1024];
+    size_t n;
+    size_t total = 0;
+    size_t left = rr == HTTP_RANGE_OK ? range.len : SIZE_MAX;
+    while (left > 0 && (n = fread(buf, 1, left < sizeof(buf) ? left : sizeof(buf), ctx->f)) > 0) {
+        if (httpd_resp_send_chunk(req, buf, n) != ESP_OK)
+            break;
+        total += n;
+        left -= n;
+    }
+    fclose(ctx->f);
+    httpd_resp_send_chunk(req, NULL, 0);
+    http_log("GET", rr == HTTP_RANGE_OK ? 206 : 200, ctx->path, total);
+}
+
+#if CONFIG_HTTP_STATIC_WORKERS > 0
+static void static_worker_task(void *args) {
+    static_req_t *ctx;
+
+    for (;;) {
+        xSemaphoreGive(s_static_idle);
+        if (xQueueReceive(s_static_queue, &ctx, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        static_send(ctx);
+        httpd_req_async_handler_complete(ctx->req);
+        free(ctx);
+    }
+}
+
+static void static_workers_start(void) {
+    if (s_static_queue)
+        return;
+
+    s_static_queue = xQueueCreate(CONFIG_HTTP_STATIC_WORKERS, sizeof(static_req_t *));
+    s_static_idle = xSemaphoreCreateCounting(CONFIG_HTTP_STATIC_WORKERS, 0);
+    if (!s_static_queue || !s_static_idle) {
+        ESP_LOGE(TAG, "Failed to create static worker queue");
+        return;
+    }
+
+    for (int i = 0; i < CONFIG_HTTP_STATIC_WORKERS; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "http_static%d", i);
+        if (xTaskCreate(static_worker_task, name, CONFIG_HTTP_STATIC_WORKER_STACK_SIZE, NULL,
+                        tskIDLE_PRIORITY + 5, NULL) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create %s", name);
+        }
+    }
+}
+
+// Hands the response to an idle worker; false if none is idle (caller sends inline)
+static bool static_dispatch(static_req_t *ctx) {
+    if (!s_static_idle || xSemaphoreTake(s_static_idle, 0) != pdTRUE)
+        return false;
+
+    httpd_req_t *async_req;
+    if (httpd_req_async_handler_begin(ctx->req, &async_req) != ESP_OK) {
+        xSemaphoreGive(s_static_idle);
+        return false;
+    }
+
+    ctx->req = async_req;
+    if (xQueueSend(s_static_queue, &ctx, 0) != pdTRUE) {
+        // Cannot happen while the idle count is consistent; keep serving inline
+        ESP_LOGW(TAG, "Static worker queue full");
+        static_send(ctx);
+        httpd_req_async_handler_complete(async_req);
+        free(ctx);
+    }
+    return true;
+}
+#endif
+
 /* Registered as the 404 error handler instead of a wildcard URI handler.
  * Wildcard would have to be registered last to not shadow other routes — which
  * is impossible to guarantee when JSON endpoints are added dynamically after
  * http_init().  The 404 path fires only after all registered handlers fail to
  * match, so dynamic endpoints always take priority regardless of order.
- * Also doubles as an SPA fallback: "/" → index.html. */
+ * Also doubles as an SPA fallback: "/" → index.html.
+ * All per-request state lives in a heap context, so concurrent requests (and worker tasks)
+ * never share buffers. */
 static esp_err_t static_file_handler(httpd_req_t *req, httpd_err_code_t err) {
     const char *uri = req->uri;
     if (strcmp(uri, "/") == 0)
         uri = "/index.html";
 
-    snprintf(s_path, sizeof(s_path), WWW_ROOT "%s", uri);
+#if CONFIG_HTTP_WEB_BUNDLE
+    if (bundle_send(req, uri))
+        return ESP_OK;
+#endif
 
-    const char *ct = "text/html";
-    if (strstr(s_path, ".css"))
-        ct = "text/css";
-    else if (strstr(s_path, ".js"))
-        ct = "application/javascript";
+    static_req_t *ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) {
+        http_log("GET", 500, uri, 0);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+        return ESP_FAIL;
+    }
+    ctx->req = req;
 
-    FILE *f = fopen(s_path, "r");
-    bool gzipped = false;
-    if (!f) {
-        char enc_hdr[32] = "";
-        httpd_req_get_hdr_value_str(req, "Accept-Encoding", enc_hdr, sizeof(enc_hdr));
-        if (strstr(enc_hdr, "gzip")) {
-            snprintf(gz_path, sizeof(gz_path), "%s.gz", s_path);
-            f = fopen(gz_path, "r");
-            gzipped = (f != NULL);
+    ctx->ct = content_type(uri);
+    ctx->cache_control = is_hashed_asset(uri) ? CACHE_CONTROL_IMMUTABLE : CACHE_CONTROL_REVALIDATE;
+
+    char enc_hdr[ACCEPT_ENCODING_LEN] = "";
+    httpd_req_get_hdr_value_str(req, "Accept-Encoding", enc_hdr, sizeof(enc_hdr));
+
+    const asset_t *asset = asset_find(uri);
+    if (asset) {
+        if (!asset_select(asset, enc_hdr, ctx)) {
+            free(ctx);
+            send_not_acceptable(req, uri);
+            return ESP_OK;
+        }
+        ctx->f = fopen(ctx->path, "r");
+    } else {
+        // Not built into the image (e.g. uploaded over WebDAV): plain file, then .gz
+        int len = snprintf(ctx->path, sizeof(ctx->path) - 3, WWW_ROOT "%s", uri);
+        ctx->f = fopen(ctx->path, "r");
+        if (!ctx->f && accept_quality(enc_hdr, "gzip") > 0 && len > 0 &&
+            (size_t)len < sizeof(ctx->path) - 3) {
+            memcpy(ctx->path + len, ".gz", 4);
+            ctx->f = fopen(ctx->path, "r");
+            ctx->encoding = ctx->f ? "gzip" : NULL;
         }
     }
-    if (!f) {
-        http_log("GET", 404, s_path, 0);
+    if (!ctx->f) {
+        http_log("GET", 404, ctx->path, 0);
+        free(ctx);
         httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
         return ESP_FAIL;
     }
 
-    set_keepalive_timeout(req);
-    httpd_resp_set_type(req, ct);
-    if (gzipped)
-        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    // Read now: the async copy of the request must not depend on the parser's scratch buffer
+#if CONFIG_HTTP_STATIC_ETAG
+    httpd_req_get_hdr_value_str(req, "If-None-Match", ctx->if_none_match,
+                                sizeof(ctx->if_none_match));
+#endif
+    httpd_req_get_hdr_value_str(req, "Range", ctx->range, sizeof(ctx->range));
 
-    char buf[1024];
-    size_t n;
-    size_t total = 0;
-    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
-        httpd_resp_send_chunk(req, buf, n);
-        total += n;
-    }
-    fclose(f);
-    httpd_resp_send_chunk(req, NULL, 0);
-    http_log("GET", 200, s_path, total);
+#if CONFIG_HTTP_STATIC_WORKERS > 0
+    if (static_dispatch(ctx))
+        return ESP_OK;
+#endif
+
+    static_send(ctx);
+    free(ctx);
     return ESP_OK;
 }
 
-static esp_err_t json_get_handler(httpd_req_t *req) {
-    http_json_get_fn_t fn = req->user_ctx;
+// Versioned endpoints also report the version the body was built at
+static esp_err_t json_get_send(httpd_req_t *req, http_json_get_fn_t fn, bool versioned) {
+    char version[12];
+    if (versioned) {
+        snprintf(version, sizeof(version), "%" PRIu32, s_json_version());
+        httpd_resp_set_hdr(req, "X-Tele-Version", version);
+    }
+
     cJSON *root = cJSON_CreateObject();
     if (fn)
         fn(root);
@@ -106,16 +576,153 @@ static esp_err_t json_get_handler(httpd_req_t *req) {
     return ret;
 }
 
+static esp_err_t json_get_handler(httpd_req_t *req) {
+    return json_get_send(req, req->user_ctx, false);
+}
+
+#if CONFIG_HTTP_LONGPOLL_MAX > 0
+// Parked requests are answered (and their slot freed) only with s_longpoll_mutex held
+static void longpoll_answer(longpoll_t *lp) {
+    json_get_send(lp->req, s_longpoll_fn, true);
+    http_log("GET", 200, lp->req->uri, 0);
+    httpd_req_async_handler_complete(lp->req);
+    lp->req = NULL;
+}
+
+/* Answers parked requests once the version moved past their "since" or their wait expired, then
+ * sleeps until the nearest deadline or http_notify_version(). */
+static void longpoll_task(void *args) {
+    for (;;) {
+        TickType_t sleep = portMAX_DELAY;
+
+        xSemaphoreTake(s_longpoll_mutex, portMAX_DELAY);
+        TickType_t now = xTaskGetTickCount();
+        uint32_t version = s_json_version();
+        for (int i = 0; i < CONFIG_HTTP_LONGPOLL_MAX; i++) {
+            longpoll_t *lp = &s_longpolls[i];
+            if (!lp->req)
+                continue;
+
+            TickType_t left = lp->deadline - now;
+            if ((int32_t)(version - lp->since) > 0 || (int32_t)left <= 0)
+                longpoll_answer(lp);
+            else if (left < sleep)
+                sleep = left;
+        }
+        xSemaphoreGive(s_longpoll_mutex);
+
+        ulTaskNotifyTake(pdTRUE, sleep);
+    }
+}
+
+static bool longpoll_park(httpd_req_t *req, uint32_t since, uint32_t wait_ms) {
+    if (!s_longpoll_task) {
+        static StaticSemaphore_t mutex_buf;
+        s_longpoll_mutex = xSemaphoreCreateMutexStatic(&mutex_buf);
+        if (xTaskCreate(longpoll_task, "http_longpoll", CONFIG_HTTP_LONGPOLL_STACK_SIZE, NULL,
+                        tskIDLE_PRIORITY + 5, &s_longpoll_task) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create long-poll task");
+            s_longpoll_task = NULL;
+            return false;
+        }
+    }
+
+    bool parked = false;
+    xSemaphoreTake(s_longpoll_mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_HTTP_LONGPOLL_MAX; i++) {
+        longpoll_t *lp = &s_longpolls[i];
+        if (lp->req)
+            continue;
+
+        if (httpd_req_async_handler_begin(req, &lp->req) == ESP_OK) {
+            lp->since = since;
+            lp->deadline = xTaskGetTickCount() + pdMS_TO_TICKS(wait_ms);
+            parked = true;
+        } else {
+            lp->req = NULL;
+        }
+        break;
+    }
+    xSemaphoreGive(s_longpoll_mutex);
+
+    if (parked)
+        xTaskNotifyGive(s_longpoll_task);
+    return parked;
+}
+
+// Answers everything still parked; async requests must not outlive the server
+static void longpoll_flush(void) {
+    if (!s_longpoll_task)
+        return;
+
+    xSemaphoreTake(s_longpoll_mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_HTTP_LONGPOLL_MAX; i++) {
+        if (s_longpolls[i].req)
+            longpoll_answer(&s_longpolls[i]);
+    }
+    xSemaphoreGive(s_longpoll_mutex);
+}
+#endif
+
+/* GET <uri>?since=N&wait=ms parks the request until the version moves past N or the wait
+ * (capped at HTTP_LONGPOLL_MAX_WAIT_MS) expires. Without "since", or if the version already
+ * moved on, it answers immediately. 503 when all parking slots are taken. */
+static esp_err_t json_versioned_handler(httpd_req_t *req) {
+    char query[48] = "";
+    char value[12];
+    uint32_t since = 0;
+    uint32_t wait_ms = CONFIG_HTTP_LONGPOLL_MAX_WAIT_MS;
+    bool has_since = false;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+            since = strtoul(value, NULL, 10);
+            has_since = true;
+        }
+        if (httpd_query_key_value(query, "wait", value, sizeof(value)) == ESP_OK)
+            wait_ms = strtoul(value, NULL, 10);
+    }
+    if (wait_ms > CONFIG_HTTP_LONGPOLL_MAX_WAIT_MS)
+        wait_ms = CONFIG_HTTP_LONGPOLL_MAX_WAIT_MS;
+
+    if (!has_since || wait_ms == 0 || (int32_t)(s_json_version() - since) > 0)
+        return json_get_send(req, req->user_ctx, true);
+
+#if CONFIG_HTTP_LONGPOLL_MAX > 0
+    if (longpoll_park(req, since, wait_ms))
+        return ESP_OK;
+#endif
+
+    http_log("GET", 503, req->uri, 0);
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_hdr(req, "Retry-After", "1");
+    return httpd_resp_send(req, NULL, 0);
+}
+
+/* Bodies above HTTP_POST_MAX_BODY are refused from Content-Length alone, before anything is
+ * allocated or read; returning ESP_FAIL closes the socket instead of draining the body.
+ * Replies with the JSON result object filled by the endpoint function. */
 static esp_err_t json_post_handler(httpd_req_t *req) {
     http_json_post_fn_t fn = req->user_ctx;
-    int len = req->content_len;
+    size_t len = req->content_len;
+    if (len == 0) {
+        http_log("POST", 400, req->uri, 0);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
+        return ESP_FAIL;
+    }
+    if (len > CONFIG_HTTP_POST_MAX_BODY) {
+        http_log("POST", 413, req->uri, len);
+        httpd_resp_send_err(req, HTTPD_413_CONTENT_TOO_LARGE, NULL);
+        return ESP_FAIL;
+    }
+
     char *buf = malloc(len + 1);
     if (!buf) {
         http_log("POST", 500, req->uri, 0);
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
         return ESP_FAIL;
     }
-    int received = 0;
+    size_t received = 0;
     while (received < len) {
         int r = httpd_req_recv(req, buf + received, len - received);
         if (r <= 0) {
@@ -127,19 +734,169 @@ static esp_err_t json_post_handler(httpd_req_t *req) {
         received += r;
     }
     buf[received] = '\0';
-    if (fn)
-        fn(buf);
+
+    cJSON *result = cJSON_CreateObject();
+    bool ok = fn ? fn(buf, result) : true;
     free(buf);
+    if (!ok) {
+        cJSON_Delete(result);
+        http_log("POST", 400, req->uri, len);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
+        return ESP_FAIL;
+    }
+
+    char *body = cJSON_PrintUnformatted(result);
+    cJSON_Delete(result);
+    if (!body) {
+        http_log("POST", 500, req->uri, 0);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+        return ESP_FAIL;
+    }
     http_log("POST", 200, req->uri, len);
     set_keepalive_timeout(req);
-    return httpd_resp_sendstr(req, "OK");
+    httpd_resp_set_type(req, "application/json");
+    esp_err_t ret = httpd_resp_sendstr(req, body);
+    free(body);
+    return ret;
+}
+
+#if CONFIG_HTTP_EVENTS
+/* Wraps telemetry as {"full":bool,"tele":{...}}; printed once per push and shared by all
+ * subscribers. Does not take ownership of tele. */
+static char *events_message(cJSON *tele, bool full) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "full", full);
+    cJSON_AddItemReferenceToObject(root, "tele", tele);
+    char *msg = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return msg;
+}
+
+static int events_subscribers(httpd_handle_t server, int *fds) {
+    size_t n = CONFIG_LWIP_MAX_SOCKETS;
+    if (httpd_get_client_list(server, &n, fds) != ESP_OK)
+        return 0;
+
+    int count = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (httpd_ws_get_fd_info(server, fds[i]) == HTTPD_WS_CLIENT_WEBSOCKET)
+            fds[count++] = fds[i];
+    }
+    return count;
 }
 
+// Runs on the server task (httpd_queue_work), so sends never race with request handlers
+static void events_broadcast(void *arg) {
+    char *msg = arg;
+    int fds[CONFIG_LWIP_MAX_SOCKETS];
+    int count = events_subscribers(s_server, fds);
+
+    httpd_ws_frame_t frame = {
+        .final = true, .type = HTTPD_WS_TYPE_TEXT, .payload = (uint8_t *)msg, .len = strlen(msg)};
+    for (int i = 0; i < count; i++) {
+        httpd_ws_send_frame_async(s_server, fds[i], &frame);
+    }
+    free(msg);
+}
+
+/* GET completes the handshake: the new subscriber gets the full state right away and the next
+ * broadcast is a full one, so no client can miss a change. Text frames are commands, same JSON
+ * as POST /cmnd. */
+static esp_err_t events_handler(httpd_req_t *req) {
+    if (req->method == HTTP_GET) {
+        cJSON *tele = cJSON_CreateObject();
+        s_events_snapshot(tele);
+        char *msg = events_message(tele, true);
+        cJSON_Delete(tele);
+
+        xSemaphoreTake(s_events_mutex, portMAX_DELAY);
+        s_events_full = true;
+        xSemaphoreGive(s_events_mutex);
+
+        if (!msg)
+            return ESP_FAIL;
+        httpd_ws_frame_t frame = {.final = true,
+                                  .type = HTTPD_WS_TYPE_TEXT,
+                                  .payload = (uint8_t *)msg,
+                                  .len = strlen(msg)};
+        esp_err_t ret = httpd_ws_send_frame(req, &frame);
+        http_log("WS", 101, req->uri, frame.len);
+        free(msg);
+        return ret;
+    }
+
+    httpd_ws_frame_t frame = {0};
+    esp_err_t ret = httpd_ws_recv_frame(req, &frame, 0);
+    if (ret != ESP_OK || frame.type != HTTPD_WS_TYPE_TEXT || frame.len == 0)
+        return ret;
+
+    // Returning an error closes the socket; the client reconnects
+    if (frame.len > CONFIG_HTTP_POST_MAX_BODY) {
+        http_log("WS", 413, req->uri, frame.len);
+        return ESP_FAIL;
+    }
+
+    char *buf = malloc(frame.len + 1);
+    if (!buf) {
+        http_log("WS", 500, req->uri, 0);
+        return ESP_ERR_NO_MEM;
+    }
+    frame.payload = (uint8_t *)buf;
+    ret = httpd_ws_recv_frame(req, &frame, frame.len);
+    if (ret != ESP_OK || !s_events_cmnd) {
+        free(buf);
+        return ret;
+    }
+    buf[frame.len] = '\0';
+
+    // Reply to the sender only: {"cmnd":{"<command>":"<result>",...}} or {"cmnd":null}
+    cJSON *root = cJSON_CreateObject();
+    cJSON *results = cJSON_CreateObject();
+    bool ok = s_events_cmnd(buf, results);
+    cJSON_AddItemToObject(root, "cmnd", ok ? results : cJSON_CreateNull());
+    if (!ok)
+        cJSON_Delete(results);
+    http_log("WS", ok ? 200 : 400, req->uri, frame.len);
+    free(buf);
+
+    char *reply = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (!reply)
+        return ESP_OK;
+    httpd_ws_frame_t out = {.final = true,
+                            .type = HTTPD_WS_TYPE_TEXT,
+                            .payload = (uint8_t *)reply,
+                            .len = strlen(reply)};
+    ret = httpd_ws_send_frame(req, &out);
+    free(reply);
+    return ret;
+}
+#endif
+
 static void register_common_handlers(void) {
     httpd_register_err_handler(s_server, HTTPD_404_NOT_FOUND, static_file_handler);
 #if CONFIG_HTTP_ENABLE_WEBDAV
     http_webdav_init(s_server);
 #endif
+#if CONFIG_HTTP_OTA
+    http_ota_init(s_server);
+#endif
+}
+
+#if CONFIG_ESP_TLS_SERVER_CERT_SELECT_HOOK
+static int https_cert_select(mbedtls_ssl_context *ssl) {
+    return mbedtls_ssl_set_hs_own_cert(ssl, s_tls_chain, s_tls_key);
+}
+#endif
+
+static void tls_release(void) {
+#if CONFIG_ESP_TLS_SERVER_CERT_SELECT_HOOK
+    if (s_tls_chain) {
+        certs_release_parsed();
+        s_tls_chain = NULL;
+        s_tls_key = NULL;
+    }
+#endif
 }
 
 void http_init(const http_config_t *cfg) {
@@ -149,16 +906,35 @@ void http_init(const http_config_t *cfg) {
     }
     s_secure = cfg->secure;
 
+#if CONFIG_HTTP_WEB_BUNDLE
+    // Not fatal: assets are then served from LittleFS only
+    web_bundle_init();
+#endif
+    assets_load();
+
     if (cfg->secure) {
         if (!certs_available()) {
             ESP_LOGE(TAG, "Certificates not available");
             return;
         }
         httpd_ssl_config_t ssl_cfg = HTTPD_SSL_CONFIG_DEFAULT();
-        ssl_cfg.servercert = (const uint8_t *)get_client_pem_start();
-        ssl_cfg.servercert_len = get_client_pem_size();
-        ssl_cfg.prvtkey_pem = (const uint8_t *)get_client_key_start();
-        ssl_cfg.prvtkey_len = get_client_key_size();
+#if CONFIG_ESP_TLS_SERVER_CERT_SELECT_HOOK
+        // Chain and key parsed once and shared by all handshakes instead of per connection
+        if (certs_acquire_parsed(&s_tls_chain, &s_tls_key)) {
+            ssl_cfg.cert_select_cb = https_cert_select;
+        } else
+#endif
+        {
+            ssl_cfg.servercert = (const uint8_t *)get_client_pem_start();
+            ssl_cfg.servercert_len = get_client_pem_size();
+            ssl_cfg.prvtkey_pem = (const uint8_t *)get_client_key_start();
+            ssl_cfg.prvtkey_len = get_client_key_size();
+        }
+#if CONFIG_HTTPS_SESSION_TICKETS
+        // Returning clients resume with a ticket instead of a full handshake; esp-tls rotates
+        // the ticket key every ESP_TLS_SERVER_SESSION_TICKET_TIMEOUT
+        ssl_cfg.session_tickets = true;
+#endif
         ssl_cfg.httpd.stack_size = CONFIG_HTTPS_STACK_SIZE;
         ssl_cfg.httpd.recv_wait_timeout = CONFIG_HTTP_SESSION_TIMEOUT;
         ssl_cfg.httpd.send_wait_timeout = CONFIG_HTTP_SESSION_TIMEOUT;
@@ -170,6 +946,7 @@ void http_init(const http_config_t *cfg) {
         if (httpd_ssl_start(&s_server, &ssl_cfg) != ESP_OK) {
             ESP_LOGE(TAG, "Failed to start HTTPS");
             s_server = NULL;
+            tls_release();
             return;
         }
     } else {
@@ -190,6 +967,10 @@ void http_init(const http_config_t *cfg) {
         }
     }
 
+#if CONFIG_HTTP_STATIC_WORKERS > 0
+    static_workers_start();
+#endif
+
     esp_log_level_set("httpd_parse", ESP_LOG_ERROR);
     esp_log_level_set("httpd_txrx", ESP_LOG_ERROR);
     esp_log_level_set("httpd_uri", ESP_LOG_ERROR);
@@ -202,11 +983,23 @@ void http_shutdown(void) {
         ESP_LOGW(TAG, "Already stopped");
         return;
     }
+#if CONFIG_HTTP_LONGPOLL_MAX > 0
+    longpoll_flush();
+#endif
     if (s_secure)
         httpd_ssl_stop(s_server);
     else
         httpd_stop(s_server);
     s_server = NULL;
+    tls_release();
+    assets_unload();
+#if CONFIG_HTTP_EVENTS
+    s_events_snapshot = NULL;
+    s_events_cmnd = NULL;
+#endif
+#if CONFIG_HTTP_WEB_BUNDLE
+    web_bundle_deinit();
+#endif
     ESP_LOGI(TAG, "Stopped");
 }
 
@@ -219,6 +1012,28 @@ void http_register_json_get(const char *uri, http_json_get_fn_t fn) {
     httpd_register_uri_handler(s_server, &ep);
 }
 
+void http_register_json_get_versioned(const char *uri, http_json_get_fn_t fn,
+                                      http_version_fn_t version) {
+    if (!s_server) {
+        ESP_LOGE(TAG, "http_init() must be called first");
+        return;
+    }
+    s_json_version = version;
+#if CONFIG_HTTP_LONGPOLL_MAX > 0
+    s_longpoll_fn = fn;
+#endif
+    httpd_uri_t ep = {
+        .uri = uri, .method = HTTP_GET, .handler = json_versioned_handler, .user_ctx = fn};
+    httpd_register_uri_handler(s_server, &ep);
+}
+
+void http_notify_version(void) {
+#if CONFIG_HTTP_LONGPOLL_MAX > 0
+    if (s_longpoll_task)
+        xTaskNotifyGive(s_longpoll_task);
+#endif
+}
+
 void http_register_json_post(const char *uri, http_json_post_fn_t fn) {
     if (!s_server) {
         ESP_LOGE(TAG, "http_init() must be called first");
@@ -228,3 +1043,68 @@ void http_register_json_post(const char *uri, http_json_post_fn_t fn) {
         .uri = uri, .method = HTTP_POST, .handler = json_post_handler, .user_ctx = fn};
     httpd_register_uri_handler(s_server, &ep);
 }
+
+void http_register_events(const char *uri, http_json_get_fn_t snapshot, http_json_post_fn_t cmnd) {
+#if CONFIG_HTTP_EVENTS
+    if (!s_server) {
+        ESP_LOGE(TAG, "http_init() must be called first");
+        return;
+    }
+    if (!s_events_mutex) {
+        static StaticSemaphore_t mutex_buf;
+        s_events_mutex = xSemaphoreCreateMutexStatic(&mutex_buf);
+    }
+    s_events_snapshot = snapshot;
+    s_events_cmnd = cmnd;
+    httpd_uri_t ep = {
+        .uri = uri, .method = HTTP_GET, .handler = events_handler, .is_websocket = true};
+    httpd_register_uri_handler(s_server, &ep);
+#else
+    ESP_LOGW(TAG, "HTTP_EVENTS disabled, %s not registered", uri);
+#endif
+}
+
+void http_events_notify(void) {
+#if CONFIG_HTTP_EVENTS
+    if (!s_server || !s_events_snapshot)
+        return;
+
+    int fds[CONFIG_LWIP_MAX_SOCKETS];
+    if (events_subscribers(s_server, fds) == 0)
+        return;
+
+    cJSON *cur = cJSON_CreateObject();
+    s_events_snapshot(cur);
+
+    xSemaphoreTake(s_events_mutex, portMAX_DELAY);
+    bool full = s_events_full || !s_events_last;
+    char *msg = NULL;
+    if (full) {
+        msg = events_message(cur, true);
+    } else {
+        /* Only top-level keys whose value changed, and null for keys gone from the snapshot;
+         * clients merge them into their state and drop the null ones */
+        cJSON *delta = cJSON_CreateObject();
+        cJSON *item;
+        cJSON_ArrayForEach(item, cur) {
+            cJSON *prev = cJSON_GetObjectItemCaseSensitive(s_events_last, item->string);
+            if (!prev || !cJSON_Compare(prev, item, true))
+                cJSON_AddItemToObject(delta, item->string, cJSON_Duplicate(item, true));
+        }
+        cJSON_ArrayForEach(item, s_events_last) {
+            if (!cJSON_GetObjectItemCaseSensitive(cur, item->string))
+                cJSON_AddNullToObject(delta, item->string);
+        }
+        if (delta->child)
+            msg = events_message(delta, false);
+        cJSON_Delete(delta);
+    }
+    cJSON_Delete(s_events_last);
+    s_events_last = cur;
+    s_events_full = false;
+    xSemaphoreGive(s_events_mutex);
+
+    if (msg && httpd_queue_work(s_server, events_broadcast, msg) != ESP_OK)
+        free(msg);
+#endif
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void http_ota_init(httpd_handle_t server);
+
+/* Streams the request body into the OTA partition (see ota_writer.h) and restarts on success.
+ * Also used for WebDAV PUT to /dav/.ota/. */
+esp_err_t http_ota_receive(httpd_req_t *req);
+
+#ifdef __cplusplus
+}
+#endif
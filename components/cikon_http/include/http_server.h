@@ -16,13 +16,30 @@ typedef struct {
 } http_config_t;
 
 typedef void (*http_json_get_fn_t)(cJSON *json);
-typedef void (*http_json_post_fn_t)(const char *json_str);
+typedef uint32_t (*http_version_fn_t)(void);
+/* Handles a POSTed JSON body; may add entries to result, which is sent back as the response.
+ * Returns false if the body was rejected (400). */
+typedef bool (*http_json_post_fn_t)(const char *json_str, cJSON *result);
 
 void http_init(const http_config_t *cfg);
 void http_shutdown(void);
 void http_register_json_get(const char *uri, http_json_get_fn_t fn);
 void http_register_json_post(const char *uri, http_json_post_fn_t fn);
 
+/* JSON GET with long-poll: "?since=N&wait=ms" holds the request (async, up to
+ * CONFIG_HTTP_LONGPOLL_MAX at a time) until version() moves past N. The current version is sent
+ * in the X-Tele-Version header. Call http_notify_version() after bumping the version. */
+void http_register_json_get_versioned(const char *uri, http_json_get_fn_t fn,
+                                      http_version_fn_t version);
+void http_notify_version(void);
+
+/* WebSocket push channel (CONFIG_HTTP_EVENTS): subscribers get the full snapshot on connect
+ * and changed top-level keys on each http_events_notify(), with null for keys the snapshot no
+ * longer has; text frames are passed to cmnd and its result is sent back to the sender as
+ * {"cmnd":{...}}. */
+void http_register_events(const char *uri, http_json_get_fn_t snapshot, http_json_post_fn_t cmnd);
+void http_events_notify(void);
+
 #ifdef __cplusplus
 }
 #endif
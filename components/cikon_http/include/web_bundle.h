@@ -0,0 +1,25 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const void *data; // Points into memory-mapped flash, valid until web_bundle_deinit()
+    size_t len;
+    uint32_t crc; // crc32 of the stored bytes
+    bool gzipped;
+} web_bundle_file_t;
+
+esp_err_t web_bundle_init(void);
+void web_bundle_deinit(void);
+bool web_bundle_find(const char *uri, web_bundle_file_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -3,6 +3,8 @@
   "use strict";
 
   var POLL_MS = 5000;
+  var WS_RETRY_MS = 5000;        // reconnect after a push channel that was up drops
+  var WS_UNSUPPORTED_MS = 60000; // retry rarely when /events never opened (firmware without it)
   var PENDING_TTL_MS = POLL_MS * 2; // must outlast one full poll cycle with margin
 
   // ---- state ----
@@ -15,7 +17,8 @@
     sortDir: "desc",
     resetPhase: "idle"
   };
-  var confirmTimer = null, resetTimer = null, pollTimer = null;
+  var confirmTimer = null, resetTimer = null, pollTimer = null, polling = false;
+  var ws = null, wsRetry = null, wsTele = {};
   var prevTicks = null, prevTotal = null;  // for live (delta) CPU
   state.cpu = null;                         // { taskName: pct } or null
 
@@ -84,28 +87,77 @@
   }
 
   // ---- telemetry ----
+  function applyTele(t) {
+    computeCpu(t);
+    Object.keys(pendingSwitch).forEach(function (name) {
+      var p = pendingSwitch[name];
+      if (t[name] === p.value) { delete pendingSwitch[name]; }
+      else if (Date.now() - p.ts < PENDING_TTL_MS) { t[name] = p.value; }
+      else { delete pendingSwitch[name]; }
+    });
+    state.tele = t; state.online = true; state.live = true; render();
+  }
+
   function loadTele() {
     var ctrl = new AbortController();
     var to = setTimeout(function () { ctrl.abort(); }, 3500);
     return fetch("/tele", { cache: "no-store", signal: ctrl.signal })
       .then(function (r) { if (!r.ok) throw new Error("bad"); return r.json(); })
-      .then(function (t) {
-        computeCpu(t);
-        Object.keys(pendingSwitch).forEach(function (name) {
-          var p = pendingSwitch[name];
-          if (t[name] === p.value) { delete pendingSwitch[name]; }
-          else if (Date.now() - p.ts < PENDING_TTL_MS) { t[name] = p.value; }
-          else { delete pendingSwitch[name]; }
-        });
-        state.tele = t; state.online = true; state.live = true; render();
-      })
+      .then(applyTele)
       .catch(function () { if (state.live) { state.online = false; render(); } })
       .finally(function () { clearTimeout(to); });
   }
 
   function pollLoop() {
+    if (!polling) return;
     loadTele().finally(function () {
-      pollTimer = setTimeout(pollLoop, state.online ? POLL_MS : 2000);
+      if (polling) pollTimer = setTimeout(pollLoop, state.online ? POLL_MS : 2000);
+    });
+  }
+  function startPolling() {
+    if (polling) return;
+    polling = true; pollLoop();
+  }
+  function stopPolling() {
+    polling = false; clearTimeout(pollTimer);
+  }
+
+  // ---- push channel: /events sends the full state on connect, then changed keys only.
+  // wsTele keeps the device's view; optimistic pending values are applied on a copy.
+  function wsConnect() {
+    if (!window.WebSocket) { startPolling(); return; }
+    var sock, opened = false;
+    try { sock = new WebSocket((location.protocol === "https:" ? "wss://" : "ws://") + location.host + "/events"); }
+    catch (e) { startPolling(); return; }
+    sock.onopen = function () { opened = true; ws = sock; stopPolling(); };
+    sock.onmessage = function (ev) {
+      var m;
+      try { m = JSON.parse(ev.data); } catch (e) { return; }
+      if (!m || !m.tele) return;
+      if (m.full) wsTele = m.tele;
+      else Object.keys(m.tele).forEach(function (k) {
+        if (m.tele[k] === null) delete wsTele[k]; // key gone from the device's telemetry
+        else wsTele[k] = m.tele[k];
+      });
+      applyTele(Object.assign({}, wsTele));
+    };
+    sock.onclose = function () {
+      if (ws === sock) ws = null;
+      startPolling();
+      clearTimeout(wsRetry);
+      wsRetry = setTimeout(wsConnect, opened ? WS_RETRY_MS : WS_UNSUPPORTED_MS);
+    };
+  }
+
+  // Commands go over the push channel when it is up, POST /cmnd otherwise
+  function sendCmnd(body) {
+    if (ws && ws.readyState === 1) {
+      try { ws.send(JSON.stringify(body)); return Promise.resolve(); } catch (e) {}
+    }
+    return fetch("/cmnd", {
+      method: "POST",
+      headers: { "Content-Type": "application/json" },
+      body: JSON.stringify(body)
     });
   }
 
@@ -121,11 +173,7 @@
     t[name] = next; render();
     pendingSwitch[name] = { value: next, ts: Date.now() };
     var body = {}; body[name] = next ? "on" : "off";
-    fetch("/cmnd", {
-      method: "POST",
-      headers: { "Content-Type": "application/json" },
-      body: JSON.stringify(body)
-    }).catch(function () {});
+    sendCmnd(body).catch(function () {});
   }
   function buildSwitchCards(keys) {
     var wrap = $("switch-cards");
@@ -192,7 +240,7 @@
   }
   function lightPost(name, payload) {
     var body = {}; body[name] = payload;
-    fetch("/cmnd", { method: "POST", headers: { "Content-Type": "application/json" }, body: JSON.stringify(body) }).catch(function () {});
+    sendCmnd(body).catch(function () {});
   }
   function lightToggle(name, nextOn) {
     lightMergePending(name, undefined, undefined, { on: nextOn });
@@ -302,11 +350,7 @@
   }
   function runReset() {
     state.resetPhase = "sending"; render();
-    fetch("/cmnd", {
-      method: "POST",
-      headers: { "Content-Type": "application/json" },
-      body: JSON.stringify({ restart: null })
-    })
+    sendCmnd({ restart: null })
       .catch(function () {})
       .then(function () {
         state.resetPhase = "done"; state.online = false; render();
@@ -361,7 +405,7 @@
     var badge = $("status");
     badge.classList.toggle("online", state.online);
     badge.title = state.online
-      ? "Receiving telemetry from /tele"
+      ? "Receiving telemetry from " + (ws ? "/events" : "/tele")
       : "No response from /tele";
     $("status-text").textContent = state.online ? "Live" : "Offline";
 
@@ -633,7 +677,8 @@
     }
 
     render();
-    pollLoop();
+    startPolling(); // first paint right away; stops once /events is up
+    wsConnect();
   }
 
   if (document.readyState === "loading") document.addEventListener("DOMContentLoaded", init);
@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""Build the web assets staged into the LittleFS image (<mount>/www).
+
+For every file in pages/:
+  - minify text assets (conservative: indentation, blank lines, full-line comments),
+  - give js/css a content-hashed name (app.js -> app.3f9a1c2b.js) and rewrite
+    references to them in html/css,
+  - store gzip-9 (.gz) and brotli (.br, when a brotli module or CLI is available)
+    variants; the identity copy is kept only for files that do not compress
+    (clients accepting neither encoding get 406 for those),
+  - write the manifest read by http_server.c.
+
+Manifest (<out>/.manifest), one asset per line, sorted by URI:
+    <uri> <encodings> <hash>
+e.g. "/app.3f9a1c2b.js br,gz 3f9a1c2b". encodings lists the stored variants
+("br", "gz", "id" = uncompressed file). hash is the first 8 hex digits of the
+SHA-256 of the minified content and is also used for the ETag.
+Keep in sync with http_server.c.
+"""
+
+import argparse
+import gzip
+import hashlib
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+MANIFEST = ".manifest"
+HASHED_EXT = (".js", ".css")
+TEXT_EXT = (".html", ".css", ".js", ".json", ".svg", ".txt")
+
+try:
+    import brotli  # type: ignore
+except ImportError:
+    brotli = None
+
+
+def brotli_compress(data):
+    if brotli:
+        return brotli.compress(data, quality=11)
+    exe = shutil.which("brotli")
+    if exe:
+        return subprocess.run([exe, "-c", "-q", "11"], input=data, stdout=subprocess.PIPE,
+                              check=True).stdout
+    return None
+
+
+def minify(name, text):
+    if name.endswith(".css"):
+        text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+        lines = (l.strip() for l in text.splitlines())
+        return "\n".join(l for l in lines if l)
+    if name.endswith(".js"):
+        lines = (l.strip() for l in text.splitlines())
+        return "\n".join(l for l in lines if l and not l.startswith("//"))
+    if name.endswith((".html", ".svg")):
+        text = re.sub(r"<!--.*?-->", "", text, flags=re.S)
+        lines = (l.strip() for l in text.splitlines())
+        return "\n".join(l for l in lines if l)
+    return text
+
+
+def short_hash(data):
+    return hashlib.sha256(data).hexdigest()[:8]
+
+
+def clean(out):
+    """Remove what the previous run generated, leaving unrelated files alone."""
+    path = os.path.join(out, MANIFEST)
+    if not os.path.exists(path):
+        return
+    with open(path) as f:
+        for line in f:
+            uri, encodings, _ = line.split()
+            base = os.path.join(out, uri.lstrip("/"))
+            for enc in encodings.split(","):
+                target = base + {"br": ".br", "gz": ".gz", "id": ""}[enc]
+                if os.path.exists(target):
+                    os.remove(target)
+    os.remove(path)
+
+
+def build(src, out):
+    os.makedirs(out, exist_ok=True)
+    clean(out)
+
+    assets = {}
+    for name in sorted(os.listdir(src)):
+        path = os.path.join(src, name)
+        if name.startswith(".") or not os.path.isfile(path):
+            continue
+        with open(path, "rb") as f:
+            data = f.read()
+        if name.endswith(TEXT_EXT):
+            data = minify(name, data.decode()).encode()
+        assets[name] = data
+
+    # Hash js/css first, then point html/css at the hashed names
+    renames = {}
+    for name, data in assets.items():
+        if name.endswith(HASHED_EXT):
+            stem, ext = os.path.splitext(name)
+            renames[name] = f"{stem}.{short_hash(data)}{ext}"
+    for name, data in assets.items():
+        if name.endswith((".html", ".css")) and renames:
+            text = data.decode()
+            for old, new in renames.items():
+                text = re.sub(r"(?<=[\"'/(])" + re.escape(old) + r"(?=[\"'?#)])", new, text)
+            assets[name] = text.encode()
+
+    raw = sum(os.path.getsize(os.path.join(src, n)) for n in assets)
+    minified = stored = gz_total = br_total = 0
+    manifest = []
+    for name, data in assets.items():
+        final = renames.get(name, name)
+        base = os.path.join(out, final)
+        encodings = []
+
+        br = brotli_compress(data) if name.endswith(TEXT_EXT) else None
+        if br is not None and len(br) < len(data):
+            with open(base + ".br", "wb") as f:
+                f.write(br)
+            encodings.append("br")
+            stored += len(br)
+            br_total += len(br)
+
+        gz = gzip.compress(data, compresslevel=9, mtime=0)
+        if len(gz) < len(data):
+            with open(base + ".gz", "wb") as f:
+                f.write(gz)
+            encodings.append("gz")
+            stored += len(gz)
+            gz_total += len(gz)
+        else:
+            with open(base, "wb") as f:
+                f.write(data)
+            encodings.append("id")
+            stored += len(data)
+
+        minified += len(data)
+        manifest.append(f"/{final} {','.join(encodings)} {short_hash(data)}\n")
+
+    with open(os.path.join(out, MANIFEST), "w") as f:
+        f.writelines(sorted(manifest))
+
+    print(f"web assets: {len(assets)} files, {raw} B raw -> {minified} B minified -> "
+          f"gzip {gz_total} B" + (f", brotli {br_total} B" if br_total else ", brotli n/a") +
+          f"; {stored} B staged")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("src")
+    parser.add_argument("out")
+    args = parser.parse_args()
+    if not os.path.isdir(args.src):
+        sys.exit(f"web_assets: no such directory: {args.src}")
+    build(args.src, args.out)
+
+
+if __name__ == "__main__":
+    main()
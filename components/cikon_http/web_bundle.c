@@ -0,0 +1,111 @@
+#include "web_bundle.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG "cikon:http:bundle"
+
+/* Image layout produced by web_bundle.py (little endian, mapped as-is) */
+#define BUNDLE_MAGIC "CWB1"
+#define BUNDLE_NAME_MAX 48
+#define BUNDLE_FLAG_GZIP 0x1
+
+typedef struct {
+    char magic[4];
+    uint32_t count;
+    uint32_t size;
+    uint32_t reserved;
+} bundle_header_t;
+
+typedef struct {
+    char name[BUNDLE_NAME_MAX]; // NUL padded, sorted in strcmp order
+    uint32_t offset;
+    uint32_t length;
+    uint32_t crc;
+    uint32_t flags;
+} bundle_entry_t;
+
+_Static_assert(sizeof(bundle_header_t) == 16, "bundle header layout");
+_Static_assert(sizeof(bundle_entry_t) == 64, "bundle entry layout");
+
+static esp_partition_mmap_handle_t s_mmap_handle;
+static const uint8_t *s_image = NULL;
+static const bundle_entry_t *s_entries = NULL;
+static uint32_t s_count = 0;
+
+esp_err_t web_bundle_init(void) {
+    if (s_image)
+        return ESP_OK;
+
+    const esp_partition_t *part = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, CONFIG_HTTP_WEB_BUNDLE_PARTITION);
+    if (!part) {
+        ESP_LOGW(TAG, "Partition '%s' not found", CONFIG_HTTP_WEB_BUNDLE_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const void *ptr;
+    esp_err_t err =
+        esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &ptr, &s_mmap_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "mmap failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    const bundle_header_t *hdr = ptr;
+    if (memcmp(hdr->magic, BUNDLE_MAGIC, sizeof(hdr->magic)) != 0 || hdr->size > part->size ||
+        sizeof(*hdr) + (size_t)hdr->count * sizeof(bundle_entry_t) > hdr->size) {
+        ESP_LOGW(TAG, "No valid bundle in '%s' (not flashed?)", part->label);
+        esp_partition_munmap(s_mmap_handle);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Reject entries pointing outside the image once, so lookups need no bounds checks
+    const bundle_entry_t *entries = (const bundle_entry_t *)(hdr + 1);
+    for (uint32_t i = 0; i < hdr->count; i++) {
+        if (entries[i].offset > hdr->size || entries[i].length > hdr->size - entries[i].offset ||
+            entries[i].name[BUNDLE_NAME_MAX - 1] != '\0') {
+            ESP_LOGE(TAG, "Corrupt bundle entry %" PRIu32, i);
+            esp_partition_munmap(s_mmap_handle);
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+
+    s_image = ptr;
+    s_entries = entries;
+    s_count = hdr->count;
+    ESP_LOGI(TAG, "Mapped %" PRIu32 " files, %" PRIu32 " B from '%s'", s_count, hdr->size,
+             part->label);
+    return ESP_OK;
+}
+
+void web_bundle_deinit(void) {
+    if (!s_image)
+        return;
+
+    esp_partition_munmap(s_mmap_handle);
+    s_image = NULL;
+    s_entries = NULL;
+    s_count = 0;
+}
+
+static int entry_cmp(const void *key, const void *elem) {
+    return strcmp(key, ((const bundle_entry_t *)elem)->name);
+}
+
+bool web_bundle_find(const char *uri, web_bundle_file_t *out) {
+    if (!s_image)
+        return false;
+
+    const bundle_entry_t *e = bsearch(uri, s_entries, s_count, sizeof(*s_entries), entry_cmp);
+    if (!e)
+        return false;
+
+    out->data = s_image + e->offset;
+    out->len = e->length;
+    out->crc = e->crc;
+    out->gzipped = e->flags & BUNDLE_FLAG_GZIP;
+    return true;
+}
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""Pack / unpack the read-only web bundle served by cikon_http (CONFIG_HTTP_WEB_BUNDLE).
+
+Image layout (little endian), mapped as-is with esp_partition_mmap():
+
+    header  : magic "CWB1", u32 entry count, u32 image size, u32 reserved
+    entries : count x { char name[48]; u32 offset; u32 length; u32 crc32; u32 flags }
+              sorted by name (strcmp order) for binary search on the device
+    data    : file contents, each starting on a 4-byte boundary
+
+Names are URI paths ("/index.html"). Text assets are stored gzipped (flag bit 0) when that
+makes them smaller; crc32 covers the stored bytes and doubles as the HTTP ETag.
+Keep in sync with web_bundle.c.
+"""
+
+import argparse
+import gzip
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = b"CWB1"
+HEADER = struct.Struct("<4sIII")
+ENTRY = struct.Struct("<48sIIII")
+NAME_MAX = 47
+FLAG_GZIP = 0x1
+COMPRESS_EXT = (".html", ".css", ".js", ".json", ".svg", ".txt")
+
+
+def align4(n):
+    return (n + 3) & ~3
+
+
+def collect(src):
+    files = []
+    for root, _, names in os.walk(src):
+        for name in names:
+            if name.startswith("."):
+                continue
+            path = os.path.join(root, name)
+            uri = "/" + os.path.relpath(path, src).replace(os.sep, "/")
+            with open(path, "rb") as f:
+                files.append((uri, f.read()))
+    return files
+
+
+def pack(src, out, max_size):
+    entries = []
+    for uri, data in collect(src):
+        flags = 0
+        if uri.endswith(COMPRESS_EXT):
+            packed = gzip.compress(data, compresslevel=9, mtime=0)
+            if len(packed) < len(data):
+                data, flags = packed, FLAG_GZIP
+        if len(uri.encode()) > NAME_MAX:
+            sys.exit(f"web_bundle: name too long (max {NAME_MAX}): {uri}")
+        entries.append((uri.encode(), data, flags))
+
+    entries.sort(key=lambda e: e[0])
+    offset = align4(HEADER.size + ENTRY.size * len(entries))
+    index = bytearray()
+    blob = bytearray()
+    for name, data, flags in entries:
+        index += ENTRY.pack(name, offset + len(blob), len(data), zlib.crc32(data), flags)
+        blob += data + b"\0" * (align4(len(data)) - len(data))
+
+    size = offset + len(blob)
+    if max_size and size > max_size:
+        sys.exit(f"web_bundle: image is {size} B, partition holds {max_size} B")
+
+    image = HEADER.pack(MAGIC, len(entries), size, 0) + index
+    image += b"\0" * (offset - len(image)) + blob
+    with open(out, "wb") as f:
+        f.write(image)
+    print(f"web_bundle: {len(entries)} files, {size} B -> {out}")
+
+
+def unpack(image_path, dest):
+    with open(image_path, "rb") as f:
+        image = f.read()
+
+    magic, count, size, _ = HEADER.unpack_from(image)
+    if magic != MAGIC or size > len(image):
+        sys.exit("web_bundle: not a web bundle image")
+
+    for i in range(count):
+        name, offset, length, crc, flags = ENTRY.unpack_from(image, HEADER.size + i * ENTRY.size)
+        uri = name.rstrip(b"\0").decode()
+        data = image[offset:offset + length]
+        if zlib.crc32(data) != crc:
+            sys.exit(f"web_bundle: crc mismatch: {uri}")
+        if flags & FLAG_GZIP:
+            data = gzip.decompress(data)
+        path = os.path.join(dest, *uri.lstrip("/").split("/"))
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, "wb") as f:
+            f.write(data)
+        print(f"{uri} {length} B{' (gzip)' if flags & FLAG_GZIP else ''}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="cmd", required=True)
+    p = sub.add_parser("pack", help="pack a directory into an image")
+    p.add_argument("src")
+    p.add_argument("out")
+    p.add_argument("--max-size", type=lambda s: int(s, 0), default=0)
+    u = sub.add_parser("unpack", help="extract an image (verifies crc)")
+    u.add_argument("image")
+    u.add_argument("dest")
+    args = parser.parse_args()
+
+    if args.cmd == "pack":
+        pack(args.src, args.out, args.max_size)
+    else:
+        unpack(args.image, args.dest)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,6 +1,10 @@
 #include "webdav.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
+#include "http_range.h"
+#if CONFIG_HTTP_OTA
+#include "http_ota.h"
+#endif
 #include <dirent.h>
 #include <errno.h>
 #include <stdio.h>
@@ -20,6 +24,11 @@
 /* Child path adds one directory entry name (LittleFS NAME_MAX = 255) */
 #define FS_CHILD_PATH_MAX (FS_PATH_MAX + 256)
 
+#define DAV_OTA_PREFIX DAV_PREFIX "/.ota/" // PUT here flashes firmware instead of storing a file
+#define PUT_TMP_SUFFIX ".~upload" // Not a suffix users pick, unlike ".tmp"
+#define PUT_TMP_SUFFIX_LEN (sizeof(PUT_TMP_SUFFIX) - 1)
+#define PUT_RECV_RETRIES 3 // Receive timeouts in a row before the upload is given up
+
 /* Returns true for macOS metadata files that should be invisible on ESP */
 static bool is_macos_junk(const char *path) {
     const char *name = strrchr(path, '/');
@@ -27,6 +36,48 @@ static bool is_macos_junk(const char *path) {
     return strncmp(name, "._", 2) == 0 || strcmp(name, ".DS_Store") == 0;
 }
 
+/* Returns true for <path>.~upload upload state: reserved, never listed or served */
+static bool is_upload_tmp(const char *path) {
+    size_t len = strlen(path);
+    return len > PUT_TMP_SUFFIX_LEN && strcmp(path + len - PUT_TMP_SUFFIX_LEN, PUT_TMP_SUFFIX) == 0;
+}
+
+/* Deletes a partial upload untouched for HTTP_WEBDAV_RESUME_TTL. Without file mtimes (0) or
+ * while the clock is behind the file (not synced yet) its age is unknown and it is kept. */
+static bool upload_tmp_expire(const char *tmp, const struct stat *st) {
+    time_t now = time(NULL);
+    if (st->st_mtime <= 0 || now <= st->st_mtime ||
+        now - st->st_mtime <= CONFIG_HTTP_WEBDAV_RESUME_TTL)
+        return false;
+    if (unlink(tmp) != 0)
+        return false;
+    ESP_LOGI(TAG, "Removed stale partial upload %s", tmp);
+    return true;
+}
+
+/* Expires the partial uploads in the directory of path */
+static void upload_tmp_sweep(const char *path) {
+    const char *slash = strrchr(path, '/');
+    char *child = slash ? malloc(FS_CHILD_PATH_MAX) : NULL;
+    if (!child)
+        return;
+    int prefix = snprintf(child, FS_CHILD_PATH_MAX, "%.*s", (int)(slash - path), path);
+    DIR *dir = opendir(child);
+    child[prefix++] = '/';
+    struct dirent *de;
+    while (dir && (de = readdir(dir)) != NULL) {
+        if (!is_upload_tmp(de->d_name))
+            continue;
+        strlcpy(child + prefix, de->d_name, FS_CHILD_PATH_MAX - prefix);
+        struct stat st;
+        if (stat(child, &st) == 0 && S_ISREG(st.st_mode))
+            upload_tmp_expire(child, &st);
+    }
+    if (dir)
+        closedir(dir);
+    free(child);
+}
+
 static void dav_log(const char *method, int status, const char *path, size_t bytes) {
     if (status >= 500)
         ESP_LOGE(TAG, "%s %s %d", method, path, status);
@@ -45,48 +96,80 @@ static bool dav_resolve_path(const char *uri, char *dest, size_t dest_size) {
     return true;
 }
 
-static void propfind_open(httpd_req_t *req) {
-    httpd_resp_sendstr_chunk(req, "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
-                                  "<D:multistatus xmlns:D=\"DAV:\">");
+/* Coalesces the PROPFIND XML into CONFIG_HTTP_WEBDAV_XML_BUF_SIZE chunks, so a listing goes out
+ * in a few full TCP segments instead of one chunk per fragment. The first send error sticks and
+ * suppresses further output. */
+typedef struct {
+    httpd_req_t *req;
+    esp_err_t err;
+    size_t len;
+    char buf[CONFIG_HTTP_WEBDAV_XML_BUF_SIZE];
+} xml_writer_t;
+
+static void xw_flush(xml_writer_t *w) {
+    if (w->len && w->err == ESP_OK)
+        w->err = httpd_resp_send_chunk(w->req, w->buf, w->len);
+    w->len = 0;
+}
+
+static void xw_write(xml_writer_t *w, const char *s, size_t n) {
+    while (n > 0) {
+        size_t room = sizeof(w->buf) - w->len;
+        size_t take = n < room ? n : room;
+        memcpy(w->buf + w->len, s, take);
+        w->len += take;
+        s += take;
+        n -= take;
+        if (w->len == sizeof(w->buf))
+            xw_flush(w);
+    }
+}
+
+static void xw_puts(xml_writer_t *w, const char *s) {
+    xw_write(w, s, strlen(s));
+}
+
+static void propfind_open(xml_writer_t *w) {
+    xw_puts(w, "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+               "<D:multistatus xmlns:D=\"DAV:\">");
 }
 
-static void propfind_entry(httpd_req_t *req, const char *href, bool is_col, size_t size,
+static void propfind_entry(xml_writer_t *w, const char *href, bool is_col, size_t size,
                            time_t mtime) {
-    char buf[128];
-    httpd_resp_sendstr_chunk(req, "<D:response><D:href>");
-    httpd_resp_sendstr_chunk(req, href);
-    httpd_resp_sendstr_chunk(req, "</D:href><D:propstat><D:prop>");
+    char buf[96];
+    xw_puts(w, "<D:response><D:href>");
+    xw_puts(w, href);
+    xw_puts(w, "</D:href><D:propstat><D:prop>");
 
     const char *name = strrchr(href, '/');
-    /* name+1 is empty when href has trailing slash (e.g. "/dav/") — sending
-     * an empty chunk would terminate chunked transfer prematurely. Fall back
-     * to the full href in that case. */
+    /* name+1 is empty when href has trailing slash (e.g. "/dav/"); show the full href then */
     const char *display = (name && name[1]) ? name + 1 : href;
-    httpd_resp_sendstr_chunk(req, "<D:displayname>");
-    httpd_resp_sendstr_chunk(req, display);
-    httpd_resp_sendstr_chunk(req, "</D:displayname>");
+    xw_puts(w, "<D:displayname>");
+    xw_puts(w, display);
+    xw_puts(w, "</D:displayname>");
 
     if (is_col) {
-        httpd_resp_sendstr_chunk(req, "<D:resourcetype><D:collection/></D:resourcetype>");
+        xw_puts(w, "<D:resourcetype><D:collection/></D:resourcetype>");
     } else {
-        httpd_resp_sendstr_chunk(req, "<D:resourcetype/>");
-        snprintf(buf, sizeof(buf), "<D:getcontentlength>%zu</D:getcontentlength>", size);
-        httpd_resp_sendstr_chunk(req, buf);
+        int n = snprintf(buf, sizeof(buf), "<D:resourcetype/><D:getcontentlength>%zu"
+                                           "</D:getcontentlength>", size);
+        xw_write(w, buf, n);
     }
 
     struct tm tm_info;
     gmtime_r(&mtime, &tm_info);
-    strftime(buf, sizeof(buf), "<D:getlastmodified>%a, %d %b %Y %H:%M:%S GMT</D:getlastmodified>",
-             &tm_info);
-    httpd_resp_sendstr_chunk(req, buf);
+    xw_write(w, buf,
+             strftime(buf, sizeof(buf),
+                      "<D:getlastmodified>%a, %d %b %Y %H:%M:%S GMT</D:getlastmodified>",
+                      &tm_info));
 
-    httpd_resp_sendstr_chunk(
-        req, "</D:prop><D:status>HTTP/1.1 200 OK</D:status></D:propstat></D:response>");
+    xw_puts(w, "</D:prop><D:status>HTTP/1.1 200 OK</D:status></D:propstat></D:response>");
 }
 
-static void propfind_close(httpd_req_t *req) {
-    httpd_resp_sendstr_chunk(req, "</D:multistatus>");
-    httpd_resp_send_chunk(req, NULL, 0);
+static void propfind_close(xml_writer_t *w) {
+    xw_puts(w, "</D:multistatus>");
+    xw_flush(w);
+    httpd_resp_send_chunk(w->req, NULL, 0);
 }
 
 /* Drain any request body (PROPFIND may send allprop XML we don't parse) */
@@ -124,7 +207,7 @@ static esp_err_t dav_propfind_handler(httpd_req_t *req) {
 
     drain_body(req);
 
-    if (is_macos_junk(path)) {
+    if (is_macos_junk(path) || is_upload_tmp(path)) {
         httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
         return ESP_FAIL;
     }
@@ -136,59 +219,69 @@ static esp_err_t dav_propfind_handler(httpd_req_t *req) {
         return ESP_FAIL;
     }
 
+    xml_writer_t *w = malloc(sizeof(*w));
+    if (!w) {
+        dav_log("PROPFIND", 500, path, 0);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+        return ESP_FAIL;
+    }
+    w->req = req;
+    w->err = ESP_OK;
+    w->len = 0;
+
     httpd_resp_set_status(req, "207 Multi-Status");
     httpd_resp_set_type(req, "application/xml; charset=utf-8");
-    propfind_open(req);
+    propfind_open(w);
 
     bool is_dir = S_ISDIR(st.st_mode);
-    propfind_entry(req, req->uri, is_dir, is_dir ? 0 : (size_t)st.st_size, st.st_mtime);
-
-    if (depth >= 1 && is_dir) {
-        DIR *dir = opendir(path);
-        if (dir) {
-            char *child_path = malloc(FS_CHILD_PATH_MAX);
-            char *child_href = malloc(FS_CHILD_PATH_MAX);
-            if (!child_path || !child_href) {
-                free(child_path);
-                free(child_href);
-                closedir(dir);
-                propfind_close(req);
-                return ESP_OK;
+    propfind_entry(w, req->uri, is_dir, is_dir ? 0 : (size_t)st.st_size, st.st_mtime);
+
+    DIR *dir = (depth >= 1 && is_dir) ? opendir(path) : NULL;
+    char *child_path = dir ? malloc(FS_CHILD_PATH_MAX) : NULL;
+    char *child_href = dir ? malloc(FS_CHILD_PATH_MAX) : NULL;
+    if (child_path && child_href) {
+        // Directory prefixes are written once; each child only appends its name
+        const char *base = req->uri;
+        size_t base_len = strlen(base);
+        bool base_slash = base_len > 0 && base[base_len - 1] == '/';
+        int path_prefix = snprintf(child_path, FS_CHILD_PATH_MAX, "%s/", path);
+        int href_prefix =
+            snprintf(child_href, FS_CHILD_PATH_MAX, base_slash ? "%s" : "%s/", base);
+        struct dirent *de;
+
+        while (w->err == ESP_OK && (de = readdir(dir)) != NULL) {
+            if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+                continue;
+            strlcpy(child_path + path_prefix, de->d_name, FS_CHILD_PATH_MAX - path_prefix);
+            strlcpy(child_href + href_prefix, de->d_name, FS_CHILD_PATH_MAX - href_prefix);
+
+            // Partial uploads are not content; listing a directory also expires its stale ones
+            struct stat cs;
+            bool have_stat = stat(child_path, &cs) == 0;
+            if (is_upload_tmp(de->d_name)) {
+                if (have_stat && S_ISREG(cs.st_mode))
+                    upload_tmp_expire(child_path, &cs);
+                continue;
             }
 
-            const char *base = req->uri;
-            size_t base_len = strlen(base);
-            bool base_slash = base_len > 0 && base[base_len - 1] == '/';
-            struct dirent *de;
-
-            while ((de = readdir(dir)) != NULL) {
-                if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
-                    continue;
-                snprintf(child_path, FS_CHILD_PATH_MAX, "%s/%s", path, de->d_name);
-                if (base_slash)
-                    snprintf(child_href, FS_CHILD_PATH_MAX, "%s%s", base, de->d_name);
-                else
-                    snprintf(child_href, FS_CHILD_PATH_MAX, "%s/%s", base, de->d_name);
-
-                struct stat cs;
-                bool c_is_dir = (de->d_type == DT_DIR);
-                size_t c_size = 0;
-                time_t c_mtime = 0;
-                if (stat(child_path, &cs) == 0) {
-                    c_is_dir = S_ISDIR(cs.st_mode);
-                    c_size = cs.st_size;
-                    c_mtime = cs.st_mtime;
-                }
-                propfind_entry(req, child_href, c_is_dir, c_size, c_mtime);
+            bool c_is_dir = (de->d_type == DT_DIR);
+            size_t c_size = 0;
+            time_t c_mtime = 0;
+            if (have_stat) {
+                c_is_dir = S_ISDIR(cs.st_mode);
+                c_size = cs.st_size;
+                c_mtime = cs.st_mtime;
             }
-
-            free(child_path);
-            free(child_href);
-            closedir(dir);
+            propfind_entry(w, child_href, c_is_dir, c_size, c_mtime);
         }
     }
+    free(child_path);
+    free(child_href);
+    if (dir)
+        closedir(dir);
 
-    propfind_close(req);
+    propfind_close(w);
+    free(w);
     return ESP_OK;
 }
 
@@ -200,7 +293,7 @@ static esp_err_t dav_get_handler(httpd_req_t *req) {
         return ESP_FAIL;
     }
 
-    if (is_macos_junk(path)) {
+    if (is_macos_junk(path) || is_upload_tmp(path)) {
         httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
         return ESP_FAIL;
     }
@@ -219,18 +312,45 @@ static esp_err_t dav_get_handler(httpd_req_t *req) {
         return ESP_FAIL;
     }
 
+    char range_hdr[48] = "";
+    char content_range[HTTP_RANGE_HDR_LEN];
+    http_range_t range = {0, (size_t)st.st_size};
+    httpd_req_get_hdr_value_str(req, "Range", range_hdr, sizeof(range_hdr));
+    http_range_result_t rr = http_range_parse(range_hdr, range.len, &range);
+    http_range_set_headers(req, rr, &range, (size_t)st.st_size, content_range);
+    if (rr == HTTP_RANGE_UNSATISFIABLE) {
+        fclose(f);
+        dav_log("GET", 416, path, 0);
+        return httpd_resp_send(req, NULL, 0);
+    }
+    if (rr == HTTP_RANGE_OK && fseek(f, (long)range.start, SEEK_SET) != 0) {
+        fclose(f);
+        dav_log("GET", 500, path, 0);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+        return ESP_FAIL;
+    }
+
     httpd_resp_set_type(req, "application/octet-stream");
     char buf[512];
     size_t n;
-    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
-        httpd_resp_send_chunk(req, buf, n);
+    size_t left = range.len;
+    while (left > 0 && (n = fread(buf, 1, left < sizeof(buf) ? left : sizeof(buf), f)) > 0) {
+        if (httpd_resp_send_chunk(req, buf, n) != ESP_OK)
+            break;
+        left -= n;
+    }
     fclose(f);
     httpd_resp_send_chunk(req, NULL, 0);
-    dav_log("GET", 200, path, (size_t)st.st_size);
+    dav_log("GET", rr == HTTP_RANGE_OK ? 206 : 200, path, range.len - left);
     return ESP_OK;
 }
 
 static esp_err_t dav_put_handler(httpd_req_t *req) {
+#if CONFIG_HTTP_OTA
+    if (strncmp(req->uri, DAV_OTA_PREFIX, sizeof(DAV_OTA_PREFIX) - 1) == 0)
+        return http_ota_receive(req);
+#endif
+
     char path[FS_PATH_MAX];
     if (!dav_resolve_path(req->uri, path, sizeof(path))) {
         dav_log("PUT", 400, req->uri, 0);
@@ -244,29 +364,134 @@ static esp_err_t dav_put_handler(httpd_req_t *req) {
         return httpd_resp_send(req, NULL, 0);
     }
 
-    FILE *f = fopen(path, "wb");
+    if (is_upload_tmp(path)) {
+        drain_body(req);
+        dav_log("PUT", 403, path, 0);
+        httpd_resp_set_status(req, "403 Forbidden");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    struct stat st;
+    bool existed = stat(path, &st) == 0;
+    if (existed && S_ISDIR(st.st_mode)) {
+        drain_body(req);
+        dav_log("PUT", 405, path, 0);
+        httpd_resp_set_status(req, "405 Method Not Allowed");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    /* Upload into <path>.~upload and rename() over the target only once the body is complete and
+     * synced, so an aborted upload or power loss never leaves a truncated file behind */
+    char tmp[FS_PATH_MAX + sizeof(PUT_TMP_SUFFIX)];
+    snprintf(tmp, sizeof(tmp), "%s" PUT_TMP_SUFFIX, path);
+
+    // Resumable upload: each chunk carries "Content-Range: bytes a-b/total" and is appended to
+    // the temp file, which survives aborts; "bytes */total" (no body) asks how much arrived.
+    // Chunks must start at the current temp file size (or 0 to restart); every answer carries
+    // X-Upload-Offset, and the file is moved into place once the last byte arrived.
+    char cr_hdr[64] = "";
+    http_range_t chunk = {0, req->content_len};
+    size_t total = req->content_len;
+    bool resumable = httpd_req_get_hdr_value_str(req, "Content-Range", cr_hdr, sizeof(cr_hdr)) ==
+                     ESP_OK;
+    char offset_hdr[12];
+    if (resumable) {
+        if (!http_content_range_parse(cr_hdr, &chunk, &total) || chunk.len != req->content_len) {
+            drain_body(req);
+            dav_log("PUT", 400, path, 0);
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad Content-Range");
+            return ESP_FAIL;
+        }
+
+        // An expired temp file is dropped: the client is told to restart from offset 0
+        struct stat tmp_st;
+        bool have_tmp = stat(tmp, &tmp_st) == 0 && !upload_tmp_expire(tmp, &tmp_st);
+        size_t offset = have_tmp ? (size_t)tmp_st.st_size : 0;
+        snprintf(offset_hdr, sizeof(offset_hdr), "%zu", offset);
+        httpd_resp_set_hdr(req, "X-Upload-Offset", offset_hdr);
+        if (chunk.len == 0 || (chunk.start != 0 && chunk.start != offset)) {
+            drain_body(req);
+            dav_log("PUT", chunk.len ? 409 : 202, path, 0);
+            httpd_resp_set_status(req, chunk.len ? "409 Conflict" : "202 Accepted");
+            return httpd_resp_send(req, NULL, 0);
+        }
+    }
+
+    // A plain upload truncates its own temp file and expires abandoned ones next to it
+    if (!resumable)
+        upload_tmp_sweep(path);
+
+    char *buf = malloc(CONFIG_HTTP_WEBDAV_PUT_BUF_SIZE);
+    FILE *f = buf ? fopen(tmp, chunk.start ? "ab" : "wb") : NULL;
     if (!f) {
+        free(buf);
         dav_log("PUT", 500, path, 0);
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Cannot create file");
         return ESP_FAIL;
     }
 
-    char buf[512];
-    int rem = req->content_len;
+    size_t rem = req->content_len;
+    int timeouts = 0;
     while (rem > 0) {
-        int got = httpd_req_recv(req, buf, rem < (int)sizeof(buf) ? rem : (int)sizeof(buf));
+        size_t want = rem < CONFIG_HTTP_WEBDAV_PUT_BUF_SIZE ? rem : CONFIG_HTTP_WEBDAV_PUT_BUF_SIZE;
+        int got = httpd_req_recv(req, buf, want);
+        if (got == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts <= PUT_RECV_RETRIES)
+            continue;
         if (got <= 0) {
+            // Client gone: the previous file (if any) stays untouched; a resumable upload keeps
+            // what arrived so far
             dav_log("PUT", 500, path, 0);
             fclose(f);
-            unlink(path);
+            if (!resumable)
+                unlink(tmp);
+            free(buf);
+            return ESP_FAIL;
+        }
+        timeouts = 0;
+        if (fwrite(buf, 1, got, f) != (size_t)got) {
+            // A resumable upload drops the partial chunk and can be continued once there is room
+            dav_log("PUT", 507, path, 0);
+            fclose(f);
+            size_t kept = resumable && truncate(tmp, (off_t)chunk.start) == 0 ? chunk.start : 0;
+            if (!kept)
+                unlink(tmp);
+            if (resumable)
+                snprintf(offset_hdr, sizeof(offset_hdr), "%zu", kept); // X-Upload-Offset, set above
+            free(buf);
+            httpd_resp_set_status(req, "507 Insufficient Storage");
+            httpd_resp_send(req, NULL, 0);
             return ESP_FAIL;
         }
-        fwrite(buf, 1, got, f);
         rem -= got;
     }
-    fclose(f);
-    dav_log("PUT", 201, path, req->content_len);
-    httpd_resp_set_status(req, "201 Created");
+    free(buf);
+
+    bool synced = fflush(f) == 0 && fsync(fileno(f)) == 0;
+    if (fclose(f) != 0 || !synced) {
+        dav_log("PUT", 500, path, 0);
+        unlink(tmp);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Cannot store file");
+        return ESP_FAIL;
+    }
+
+    size_t received = chunk.start + chunk.len;
+    if (resumable)
+        snprintf(offset_hdr, sizeof(offset_hdr), "%zu", received);
+    if (received < total) {
+        dav_log("PUT", 202, path, chunk.len);
+        httpd_resp_set_status(req, "202 Accepted");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    if (rename(tmp, path) != 0) {
+        dav_log("PUT", 500, path, 0);
+        unlink(tmp);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Cannot store file");
+        return ESP_FAIL;
+    }
+
+    dav_log("PUT", existed ? 204 : 201, path, received);
+    httpd_resp_set_status(req, existed ? "204 No Content" : "201 Created");
     return httpd_resp_send(req, NULL, 0);
 }
 
@@ -360,6 +585,12 @@ static esp_err_t dav_move_handler(httpd_req_t *req) {
         return ESP_FAIL;
     }
 
+    if (is_upload_tmp(dst)) {
+        dav_log("MOVE", 403, src, 0);
+        httpd_resp_set_status(req, "403 Forbidden");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
     char overwrite[4] = "T";
     httpd_req_get_hdr_value_str(req, "Overwrite", overwrite, sizeof(overwrite));
     if (overwrite[0] == 'F') {
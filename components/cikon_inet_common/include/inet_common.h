@@ -55,6 +55,9 @@ static inline void inet_common_mqtt_shutdown(void) {
 
 void inet_common_sntp_handler(const char *args_json_str);
 void inet_common_ota_handler(const char *args_json_str);
+#if CONFIG_OTA_PULL
+void inet_common_ota_pull_handler(const char *args_json_str);
+#endif
 void inet_common_monitor_handler(const char *args_json_str);
 void inet_common_http_init(bool secure);
 void inet_common_http_handler(const char *args_json_str);
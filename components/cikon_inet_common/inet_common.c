@@ -28,7 +28,11 @@
 #include "http_server.h"
 #include "inet_common.h"
 #include "tcp_monitor.h"
+#include "ota_writer.h"
 #include "tcp_ota.h"
+#if CONFIG_OTA_PULL
+#include "ota_pull.h"
+#endif
 
 #define TAG "cikon:inet_common"
 
@@ -60,7 +64,7 @@ void inet_common_mqtt_init(void) {
         .mqtt_mtls_en = config_get()->mqtt_mtls_en,
         .mqtt_max_retry = config_get()->mqtt_max_retry,
         .mqtt_disc_pref = config_get()->mqtt_disc_pref,
-        .command_cb = cmnd_process_json,
+        .command_cb = cmnd_process_json_results,
         .telemetry_cb = tele_append_all,
     };
 
@@ -217,9 +221,10 @@ void inet_common_register_all_ha_entities(void) {
             continue;
         }
 
-        // Register all entities from this adapter
-        for (int e = 0; meta->entities[e].type != HA_ENTITY_NONE; e++) {
-            ha_register_entity(&meta->entities[e]);
+        // Static metadata is registered by reference, keyed by the metadata so the entities can be
+        // dropped again when the adapter is disabled
+        if (supervisor_adapter_is_enabled(adapters[i])) {
+            ha_register_entities(meta->entities, meta);
         }
     }
 
@@ -233,6 +238,23 @@ void inet_common_register_all_ha_entities(void) {
 #endif
 }
 
+// Follows adapters enabled/disabled at runtime with the "adapter" command
+static void sync_adapter_ha_entities(void) {
+    const supervisor_platform_adapter_t **adapters = supervisor_get_adapters();
+    for (int i = 0; adapters[i] != NULL; i++) {
+        const ha_metadata_t *meta = (const ha_metadata_t *)adapters[i]->metadata;
+        if (meta == NULL || meta->magic != HA_METADATA_MAGIC) {
+            continue;
+        }
+
+        if (supervisor_adapter_is_enabled(adapters[i])) {
+            ha_register_entities(meta->entities, meta);
+        } else {
+            ha_unregister_entities(meta);
+        }
+    }
+}
+
 void inet_common_ha_discovery_handler(const char *args_json_str) {
     logic_state_t force_empty_payload = json_str_as_logic_state(args_json_str);
     if (force_empty_payload == STATE_TOGGLE) {
@@ -342,7 +364,14 @@ bool is_tcp_port_reachable(const char *host, uint16_t port) {
 void inet_common_on_interval(supervisor_interval_stage_t stage) {
     if (stage == SUPERVISOR_INTERVAL_5S) {
         inet_common_poll_internet_reachability();
+#if CONFIG_HTTP_EVENTS
+        http_events_notify();
+#endif
     }
+#if CONFIG_OTA_PULL
+    if (stage == SUPERVISOR_INTERVAL_10M)
+        ota_pull_on_interval();
+#endif
 }
 
 static void tele_common_mdns(const char *tele_id, cJSON *json_root) {
@@ -351,9 +380,43 @@ static void tele_common_mdns(const char *tele_id, cJSON *json_root) {
     cJSON_AddStringToObject(json_root, tele_id, buf);
 }
 
+// Running update progress, or the duration and throughput of the last one (survives its restart)
+static void tele_common_ota(const char *tele_id, cJSON *json_root) {
+    ota_stats_t stats;
+    if (ota_writer_busy()) {
+        cJSON *ota = cJSON_AddObjectToObject(json_root, tele_id);
+        cJSON_AddStringToObject(ota, "state", "running");
+        cJSON_AddNumberToObject(ota, "bytes", ota_writer_written());
+    } else if (ota_writer_last_stats(&stats)) {
+        cJSON *ota = cJSON_AddObjectToObject(json_root, tele_id);
+        cJSON_AddStringToObject(ota, "state", stats.result == ESP_OK ? "done" : "failed");
+        cJSON_AddNumberToObject(ota, "bytes", stats.bytes);
+        cJSON_AddNumberToObject(ota, "ms", stats.ms);
+        cJSON_AddNumberToObject(ota, "kbps", stats.kbps);
+    }
+}
+
+// Log the TCP monitor client missed because the ring buffer was full
+static void tele_common_monitor(const char *tele_id, cJSON *json_root) {
+    cJSON *monitor = cJSON_AddObjectToObject(json_root, tele_id);
+    cJSON_AddBoolToObject(monitor, "client", tcp_monitor_client_connected());
+    cJSON_AddNumberToObject(monitor, "dropped", tcp_monitor_dropped_bytes());
+}
+
+#if CONFIG_OTA_PULL
+static void tele_common_ota_pull(const char *tele_id, cJSON *json_root) {
+    cJSON_AddStringToObject(json_root, tele_id, ota_pull_state());
+}
+#endif
+
 void inet_common_on_event(EventBits_t bits) {
     if (bits & SUPERVISOR_EVENT_PLATFORM_INITIALIZED) {
         tele_register("mdns", tele_common_mdns);
+        tele_register("ota", tele_common_ota);
+        tele_register("monitor", tele_common_monitor);
+#if CONFIG_OTA_PULL
+        tele_register("ota_pull", tele_common_ota_pull);
+#endif
     }
 
 #ifdef CONFIG_MQTT_ENABLE_HA_DISCOVERY
@@ -368,10 +431,21 @@ void inet_common_on_event(EventBits_t bits) {
                                                  .icon = "mdi:dns",
                                                  .entity_category = "diagnostic"});
     }
+
+    if (bits & SUPERVISOR_EVENT_ADAPTER_STATE_CHANGED) {
+        sync_adapter_ha_entities();
+    }
 #endif
 
+    if (bits & (SUPERVISOR_EVENT_CMND_COMPLETED | SUPERVISOR_EVENT_ADAPTER_STATE_CHANGED)) {
+        http_notify_version();
+    }
+
     if (bits & SUPERVISOR_EVENT_CMND_COMPLETED) {
         mqtt_trigger_telemetry();
+#if CONFIG_HTTP_EVENTS
+        http_events_notify();
+#endif
     }
 }
 
@@ -421,6 +495,26 @@ void inet_common_ota_handler(const char *args_json_str) {
     }
 }
 
+#if CONFIG_OTA_PULL
+// No args: configured manifest; "<url>"; or {"url": "<url>", "force": true}
+void inet_common_ota_pull_handler(const char *args_json_str) {
+    char url[OTA_PULL_URL_MAX] = "";
+    bool force = false;
+
+    cJSON *json = json_str_as_object(args_json_str);
+    if (json) {
+        const char *u = cJSON_GetStringValue(cJSON_GetObjectItem(json, "url"));
+        if (u)
+            snprintf(url, sizeof(url), "%s", u);
+        force = cJSON_IsTrue(cJSON_GetObjectItem(json, "force"));
+        cJSON_Delete(json);
+    } else {
+        json_str_as_string_buf(args_json_str, url, sizeof(url));
+    }
+    ota_pull_start(url, force);
+}
+#endif
+
 void inet_common_monitor_handler(const char *args_json_str) {
     logic_state_t state = json_str_as_logic_state(args_json_str);
     if (state == STATE_ON) {
@@ -440,8 +534,11 @@ void inet_common_http_init(bool secure) {
         .max_open_sockets = secure ? CONFIG_HTTPS_MAX_OPEN_SOCKETS : CONFIG_HTTP_MAX_OPEN_SOCKETS,
         .secure = secure,
     });
-    http_register_json_get("/tele", tele_append_all);
-    http_register_json_post("/cmnd", cmnd_process_json);
+    http_register_json_get_versioned("/tele", tele_append_all, tele_get_version);
+    http_register_json_post("/cmnd", cmnd_process_json_results);
+#if CONFIG_HTTP_EVENTS
+    http_register_events("/events", tele_append_all, cmnd_process_json_results);
+#endif
     if (s_mdns_ready) {
         mdns_service_add(NULL, secure ? "_https" : "_http", "_tcp", port, NULL, 0);
     }
@@ -1,8 +1,16 @@
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h" // IWYU pragma: keep
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#if CONFIG_MQTT_HA_INCREMENTAL_DISCOVERY
+#include "nvs.h"
+#endif
 
 #include "cJSON.h"
 
@@ -11,13 +19,95 @@
 #include "mqtt.h"
 
 #define TAG "cikon:ha"
-#define MAX_ENTITIES 64
+#define ENTITY_BLOCK CONFIG_MQTT_HA_ENTITY_BLOCK
 
-static bool has_sent_full_dev = false;
+#if CONFIG_MQTT_HA_INCREMENTAL_DISCOVERY
+// One blob per published entity: key = hash of discovery topic, value = payload hash + topic
+#define HA_DISC_NAMESPACE "ha_disc"
+#define HA_DISC_RECORD_MAX 160
+#define HA_DISC_STALE_BATCH 32
+// Discovery publishes awaiting their PUBACK; the cache is only updated once acknowledged
+#define HA_DISC_INFLIGHT_MAX 16
+#endif
 
-// Dynamic entity registry
-static ha_entity_config_t entities[MAX_ENTITIES];
+// Discovery run options; requests arriving during a run are merged into the next one
+#define DISC_RUN_EMPTY BIT0 // Publish empty payloads to remove the entities
+#define DISC_RUN_FULL BIT1  // Republish every config, ignoring the NVS cache
+
+#define DISC_DRAIN_TIMEOUT pdMS_TO_TICKS(CONFIG_MQTT_HA_DISCOVERY_DRAIN_TIMEOUT_MS)
+
+// Per-entity strings derived from config, precomputed into one heap arena
+typedef struct {
+    const char *sanitized_name;
+    const char *unique_id;
+    const char *topic;       // <disc_pref>/<type>/<unique_id>/config
+    const char *state_topic; // <node>/<client_id>/<sanitized>/state
+} ha_entity_topics_t;
+
+typedef struct {
+    const ha_entity_config_t *def; // Caller's static config, or a copy in config_blocks
+    const void *owner;             // Set by ha_register_entities(), NULL for copied configs
+    ha_entity_topics_t topics;
+#if CONFIG_MQTT_HA_ENTITY_STATE_TOPICS
+    uint32_t state_hash; // FNV-1a of the last published state payload (0 = not published yet)
+#endif
+} ha_entity_t;
+
+// Copies of configs passed to ha_register_entity(), typically compound literals. Blocks are never
+// moved or freed, so registry entries can point into them.
+typedef struct config_block {
+    struct config_block *next;
+    size_t used;
+    ha_entity_config_t configs[ENTITY_BLOCK];
+} config_block_t;
+
+// Entity registry, grown by ENTITY_BLOCK entries at a time
+static ha_entity_t *entities = NULL;
 static size_t entity_count = 0;
+static size_t entity_capacity = 0;
+static config_block_t *config_blocks = NULL;
+static uint32_t registry_generation = 0;
+
+static char *topic_arena = NULL;
+static uint32_t topics_generation = 0;
+static uint32_t topics_registry_generation = 0;
+
+// Guards the registry and topic arena against discovery and the telemetry task
+static SemaphoreHandle_t registry_mutex = NULL;
+static StaticSemaphore_t registry_mutex_storage;
+
+// Discovery runs in its own low priority task, paced by the client outbox
+static TaskHandle_t discovery_task_handle = NULL;
+static SemaphoreHandle_t discovery_mutex = NULL;
+static StaticSemaphore_t discovery_mutex_storage;
+static bool discovery_pending = false;
+static uint32_t discovery_pending_flags = 0;
+// Flags of the current or last run; a paused run is resumed with them on the next connect
+static uint32_t discovery_run_flags = 0;
+static bool discovery_resume = false;
+// Configs are retained on the broker; set once a full run announced them, cleared by "ha off"
+static bool discovery_announced = false;
+
+typedef struct {
+    size_t published;
+    size_t bytes; // topic + payload of published configs
+    size_t unchanged;
+    size_t removed;
+    size_t peak_outbox;
+} discovery_stats_t;
+
+static discovery_stats_t discovery_stats;
+
+#if CONFIG_MQTT_HA_ENTITY_STATE_TOPICS || CONFIG_MQTT_HA_INCREMENTAL_DISCOVERY
+// FNV-1a, never returns 0 so callers can use 0 as "nothing published"
+static uint32_t fnv1a_hash(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h = (h ^ (uint8_t)*s++) * 16777619u;
+    }
+    return h ? h : 1;
+}
+#endif
 
 static const char *get_type_str(ha_entity_type_t type) {
     switch (type) {
@@ -37,14 +127,9 @@ static const char *get_type_str(ha_entity_type_t type) {
 static cJSON *create_ha_device(void) {
     cJSON *device = cJSON_CreateObject();
 
+    // Full block in every payload: each retained config is self-contained and hashes the same
+    // regardless of which entity happened to be published first
     cJSON_AddStringToObject(device, "ids", mqtt_get_config()->client_id);
-
-    if (has_sent_full_dev) {
-        return device;
-    }
-
-    has_sent_full_dev = true;
-
     cJSON_AddStringToObject(device, "name", mqtt_get_config()->device_name);
     cJSON_AddStringToObject(device, "mf", mqtt_get_config()->device_manufacturer);
     cJSON_AddStringToObject(device, "mdl", mqtt_get_config()->device_model);
@@ -78,7 +163,8 @@ static void build_button(cJSON *payload, const char *sanitized_name) {
     cJSON_AddStringToObject(payload, "command_template", buf);
 }
 
-static void build_light(cJSON *payload, const char *sanitized_name, const char *parent_key) {
+static void build_light(cJSON *payload, const char *sanitized_name, const char *parent_key,
+                        const char *value_path) {
 
     char buf[256];
 
@@ -97,12 +183,11 @@ static void build_light(cJSON *payload, const char *sanitized_name, const char *
     cJSON_AddStringToObject(payload, "cmd_off_tpl", buf);
 
     // State template - returns "on" or "off"
-    snprintf(buf, sizeof(buf), "{%% if value_json.%s.%s > 0 %%}on{%% else %%}off{%% endif %%}",
-             parent_key, sanitized_name);
+    snprintf(buf, sizeof(buf), "{%% if %s > 0 %%}on{%% else %%}off{%% endif %%}", value_path);
     cJSON_AddStringToObject(payload, "stat_tpl", buf);
 
     // Brightness template - returns brightness value
-    snprintf(buf, sizeof(buf), "{{ value_json.%s.%s }}", parent_key, sanitized_name);
+    snprintf(buf, sizeof(buf), "{{ %s }}", value_path);
     cJSON_AddStringToObject(payload, "bri_tpl", buf);
 
     // Template schema uses stat_tpl/bri_tpl instead of val_tpl
@@ -113,60 +198,267 @@ static void build_light(cJSON *payload, const char *sanitized_name, const char *
     cJSON_AddStringToObject(payload, "payload_off", buf);
 }
 
-void ha_register_entity(const ha_entity_config_t *config) {
-    if (entity_count >= MAX_ENTITIES) {
-        ESP_LOGE(TAG, "Maximum entity limit (%d) reached", MAX_ENTITIES);
-        return;
+// Writes "sanitized\0unique_id\0topic\0state_topic\0" to dst; with dst == NULL only returns the
+// size
+static size_t format_entity_topics(const ha_entity_config_t *def, char *dst,
+                                   ha_entity_topics_t *out) {
+    char *sanitized_name = sanitize(def->name);
+    if (!sanitized_name)
+        return 0;
+
+    char unique_id[64];
+    char topic[128];
+    char state_topic[128];
+    snprintf(unique_id, sizeof(unique_id), "%.6s_%s", mqtt_get_config()->client_id, sanitized_name);
+    snprintf(topic, sizeof(topic), "%s/%s/%s/config", mqtt_get_config()->mqtt_disc_pref,
+             get_type_str(def->type), unique_id);
+    snprintf(state_topic, sizeof(state_topic), "%s/%s/state", mqtt_get_topics()->base,
+             sanitized_name);
+
+    size_t name_len = strlen(sanitized_name) + 1;
+    size_t id_len = strlen(unique_id) + 1;
+    size_t topic_len = strlen(topic) + 1;
+    size_t state_len = strlen(state_topic) + 1;
+
+    if (dst) {
+        memcpy(dst, sanitized_name, name_len);
+        memcpy(dst + name_len, unique_id, id_len);
+        memcpy(dst + name_len + id_len, topic, topic_len);
+        memcpy(dst + name_len + id_len + topic_len, state_topic, state_len);
+        out->sanitized_name = dst;
+        out->unique_id = dst + name_len;
+        out->topic = dst + name_len + id_len;
+        out->state_topic = dst + name_len + id_len + topic_len;
     }
 
+    free(sanitized_name);
+    return name_len + id_len + topic_len + state_len;
+}
+
+// Rebuilds the topic arena when the registry or the MQTT topic table changed. Caller holds
+// registry_mutex.
+static bool ensure_entity_topics(void) {
+    uint32_t generation = mqtt_get_topics()->generation;
+    if (topic_arena && topics_generation == generation &&
+        topics_registry_generation == registry_generation)
+        return true;
+
+    size_t total = 0;
+    for (size_t i = 0; i < entity_count; i++) {
+        total += format_entity_topics(entities[i].def, NULL, NULL);
+    }
+
+    char *arena = malloc(total ? total : 1);
+    if (!arena) {
+        ESP_LOGE(TAG, "Failed to allocate topic arena (%zu B)", total);
+        return false;
+    }
+
+    size_t offset = 0;
+    for (size_t i = 0; i < entity_count; i++) {
+        offset += format_entity_topics(entities[i].def, arena + offset, &entities[i].topics);
+    }
+
+    free(topic_arena);
+    topic_arena = arena;
+    topics_generation = generation;
+    topics_registry_generation = registry_generation;
+
+    ESP_LOGI(TAG, "Topic arena rebuilt: %zu entities, %zu B", entity_count, total);
+    return true;
+}
+
+static void registry_lock_init(void) {
+    if (registry_mutex == NULL) {
+        registry_mutex = xSemaphoreCreateMutexStatic(&registry_mutex_storage);
+        discovery_mutex = xSemaphoreCreateMutexStatic(&discovery_mutex_storage);
+    }
+}
+
+// Makes room for one more entry. Caller holds registry_mutex.
+static bool registry_reserve(void) {
+    if (entity_count < entity_capacity)
+        return true;
+
+    size_t capacity = entity_capacity + ENTITY_BLOCK;
+    ha_entity_t *grown = realloc(entities, capacity * sizeof(*grown));
+    if (!grown) {
+        ESP_LOGE(TAG, "Failed to grow entity registry to %zu entries", capacity);
+        return false;
+    }
+
+    entities = grown;
+    entity_capacity = capacity;
+    ESP_LOGD(TAG, "Entity registry grown to %zu entries (%zu B)", capacity,
+             capacity * sizeof(*grown));
+    return true;
+}
+
+// Caller holds registry_mutex and has reserved a slot
+static void registry_add(const ha_entity_config_t *def, const void *owner) {
+    entities[entity_count++] = (ha_entity_t){.def = def, .owner = owner};
+    registry_generation++;
+}
+
+static void discovery_request(uint32_t flags);
+
+// Registry changes after discovery announced the device are published right away
+static void discovery_refresh(void) {
+    if (discovery_announced) {
+        discovery_request(0);
+    }
+}
+
+void ha_register_entity(const ha_entity_config_t *config) {
     if (!config || !config->name) {
         ESP_LOGE(TAG, "Invalid entity config: name is required");
         return;
     }
 
-    entities[entity_count++] = *config;
+    registry_lock_init();
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+
+    if (!config_blocks || config_blocks->used == ENTITY_BLOCK) {
+        config_block_t *block = calloc(1, sizeof(*block));
+        if (!block) {
+            xSemaphoreGive(registry_mutex);
+            ESP_LOGE(TAG, "Failed to allocate entity config block");
+            return;
+        }
+        block->next = config_blocks;
+        config_blocks = block;
+    }
+
+    bool added = registry_reserve();
+    if (added) {
+        ha_entity_config_t *copy = &config_blocks->configs[config_blocks->used++];
+        *copy = *config;
+        registry_add(copy, NULL);
+    }
+
+    xSemaphoreGive(registry_mutex);
+
+    if (added) {
+        discovery_refresh();
+    }
 }
 
-static void publish_entity(const ha_entity_config_t *def, bool empty_payload) {
+void ha_register_entities(const ha_entity_config_t *configs, const void *owner) {
+    if (!configs || !owner)
+        return;
 
-    char *sanitized_name = sanitize(def->name);
+    registry_lock_init();
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
 
-    char buf[128];
-    char topic[128];
-    char unique_id[64];
+    for (size_t i = 0; i < entity_count; i++) {
+        if (entities[i].owner == owner) {
+            xSemaphoreGive(registry_mutex);
+            return;
+        }
+    }
 
-    // Build topic
-    snprintf(unique_id, sizeof(unique_id), "%.6s_%s", mqtt_get_config()->client_id, sanitized_name);
-    snprintf(topic, sizeof(topic), "%s/%s/%s/config", mqtt_get_config()->mqtt_disc_pref,
-             get_type_str(def->type), unique_id);
+    size_t added = 0;
+    for (size_t e = 0; configs[e].type != HA_ENTITY_NONE; e++) {
+        if (!configs[e].name) {
+            ESP_LOGE(TAG, "Invalid entity config: name is required");
+            continue;
+        }
+        if (!registry_reserve())
+            break;
+        registry_add(&configs[e], owner);
+        added++;
+    }
 
-    ESP_LOGI(TAG, "Topic: %s", topic);
+    xSemaphoreGive(registry_mutex);
 
-    if (empty_payload) {
-        ESP_LOGI(TAG, "Payload: (empty)");
-        mqtt_publish(topic, "", 0, true);
-        has_sent_full_dev = false;
-        free(sanitized_name);
+    if (added) {
+        ESP_LOGI(TAG, "Registered %zu entities (%zu total)", added, entity_count);
+        discovery_refresh();
+    }
+}
+
+void ha_unregister_entities(const void *owner) {
+    if (!owner || registry_mutex == NULL)
         return;
+
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < entity_count; i++) {
+        if (entities[i].owner != owner) {
+            entities[kept++] = entities[i];
+        }
+    }
+
+    size_t removed = entity_count - kept;
+    entity_count = kept;
+    if (removed) {
+        registry_generation++;
+    }
+
+    xSemaphoreGive(registry_mutex);
+
+    if (removed) {
+        ESP_LOGI(TAG, "Unregistered %zu entities (%zu left)", removed, kept);
+        discovery_refresh();
     }
+}
+
+/* Entities with a custom builder may template against the whole tele JSON (json_attr_t,
+ * overridden val_tpl) and buttons have no state, so both keep the shared ~/tele topic. */
+static bool entity_has_own_state(const ha_entity_config_t *def) {
+#if CONFIG_MQTT_HA_ENTITY_STATE_TOPICS
+    return !def->custom_builder && def->type != HA_BUTTON;
+#else
+    (void)def;
+    return false;
+#endif
+}
+
+/* Builds the compact discovery payload; caller frees with cJSON_free(). As a device discovery
+ * component the shared "~", cmd_t, avty_t and dev keys are left to the device payload. */
+static char *build_entity_payload(const ha_entity_config_t *def, const ha_entity_topics_t *t,
+                                  bool component) {
+
+    const char *sanitized_name = t->sanitized_name;
+
+    char buf[128];
 
     cJSON *payload = cJSON_CreateObject();
+    if (component) {
+        cJSON_AddStringToObject(payload, "p", get_type_str(def->type));
+    }
     cJSON_AddStringToObject(payload, "name", def->name);
-    cJSON_AddStringToObject(payload, "uniq_id", unique_id);
-
-    snprintf(buf, sizeof(buf), "%s/%s", mqtt_get_config()->mqtt_node, mqtt_get_config()->client_id);
-    cJSON_AddStringToObject(payload, "~", buf);
+    cJSON_AddStringToObject(payload, "uniq_id", t->unique_id);
+    if (!component) {
+        cJSON_AddStringToObject(payload, "~", mqtt_get_topics()->base);
+    }
 
-    cJSON_AddStringToObject(payload, "stat_t", "~/tele");
-    cJSON_AddStringToObject(payload, "cmd_t", "~/cmnd");
-    cJSON_AddStringToObject(payload, "avty_t", "~/aval");
+    // Path to this entity's value inside the state payload
+    char value_path[96];
+    bool own_state = entity_has_own_state(def);
 
-    // Build value_template with optional parent key for nested JSON
-    if (def->parent_key) {
-        snprintf(buf, sizeof(buf), "{{ value_json.%s.%s }}", def->parent_key, sanitized_name);
+    if (own_state) {
+        snprintf(buf, sizeof(buf), "~/%s/state", sanitized_name);
+        cJSON_AddStringToObject(payload, "stat_t", buf);
+        snprintf(value_path, sizeof(value_path), "value_json");
     } else {
-        snprintf(buf, sizeof(buf), "{{ value_json.%s }}", sanitized_name);
+        cJSON_AddStringToObject(payload, "stat_t", "~/tele");
+        // Optional parent key for nested JSON
+        if (def->parent_key) {
+            snprintf(value_path, sizeof(value_path), "value_json.%s.%s", def->parent_key,
+                     sanitized_name);
+        } else {
+            snprintf(value_path, sizeof(value_path), "value_json.%s", sanitized_name);
+        }
     }
+
+    if (!component) {
+        cJSON_AddStringToObject(payload, "cmd_t", "~/cmnd");
+        cJSON_AddStringToObject(payload, "avty_t", "~/aval");
+    }
+
+    snprintf(buf, sizeof(buf), "{{ %s }}", value_path);
     cJSON_AddStringToObject(payload, "val_tpl", buf);
 
     if (def->device_class) {
@@ -192,23 +484,759 @@ static void publish_entity(const ha_entity_config_t *def, bool empty_payload) {
     } else if (def->type == HA_BUTTON) {
         build_button(payload, sanitized_name);
     } else if (def->type == HA_LIGHT) {
-        build_light(payload, sanitized_name, def->parent_key);
+        build_light(payload, sanitized_name, def->parent_key, value_path);
     }
 
-    cJSON_AddItemToObject(payload, "dev", create_ha_device());
-
-    // Publish
-    char *payload_str = cJSON_Print(payload);
-    ESP_LOGI(TAG, "Payload: %s", payload_str);
-    mqtt_publish(topic, payload_str, 0, true);
+    if (!component) {
+        cJSON_AddItemToObject(payload, "dev", create_ha_device());
+    }
 
-    cJSON_free(payload_str);
+    char *payload_str = cJSON_PrintUnformatted(payload);
     cJSON_Delete(payload);
-    free(sanitized_name);
+    return payload_str;
+}
+
+#if CONFIG_MQTT_HA_DEVICE_DISCOVERY
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    bool failed;
+} payload_buf_t;
+
+static void payload_append(payload_buf_t *b, const char *s, size_t n) {
+    if (b->failed)
+        return;
+
+    if (b->len + n + 1 > b->cap) {
+        size_t cap = b->cap ? b->cap : 1024;
+        while (cap < b->len + n + 1) {
+            cap *= 2;
+        }
+        char *data = realloc(b->data, cap);
+        if (!data) {
+            b->failed = true;
+            return;
+        }
+        b->data = data;
+        b->cap = cap;
+    }
+
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+    b->data[b->len] = '\0';
+}
+
+static void device_discovery_topic(char *buf, size_t len) {
+    snprintf(buf, len, "%s/device/%s/config", mqtt_get_config()->mqtt_disc_pref,
+             mqtt_get_config()->client_id);
+}
+
+/* One payload for the whole device: {"dev":..,"o":..,"~":..,"cmd_t":..,"avty_t":..,"cmps":{..}}.
+ * Components are serialized one at a time and appended as text, so only a single entity's cJSON
+ * tree is alive at once. Caller holds registry_mutex and frees the result with free(). */
+static char *build_device_payload(void) {
+    cJSON *head = cJSON_CreateObject();
+    cJSON_AddItemToObject(head, "dev", create_ha_device());
+
+    cJSON *origin = cJSON_AddObjectToObject(head, "o");
+    cJSON_AddStringToObject(origin, "name", "cikon");
+    cJSON_AddStringToObject(origin, "sw", mqtt_get_config()->device_sw_version);
+
+    // Shared options, inherited by every component
+    cJSON_AddStringToObject(head, "~", mqtt_get_topics()->base);
+    cJSON_AddStringToObject(head, "cmd_t", "~/cmnd");
+    cJSON_AddStringToObject(head, "avty_t", "~/aval");
+
+    char *head_str = cJSON_PrintUnformatted(head);
+    cJSON_Delete(head);
+    if (!head_str)
+        return NULL;
+
+    payload_buf_t b = {0};
+
+    // Reopen the head object (drop its closing brace) and append the components map
+    payload_append(&b, head_str, strlen(head_str) - 1);
+    cJSON_free(head_str);
+    payload_append(&b, ",\"cmps\":{", 9);
+
+    for (size_t i = 0; i < entity_count && !b.failed; i++) {
+        const ha_entity_t *e = &entities[i];
+        char *component = build_entity_payload(e->def, &e->topics, true);
+        if (!component) {
+            b.failed = true;
+            break;
+        }
+
+        if (i) {
+            payload_append(&b, ",", 1);
+        }
+        payload_append(&b, "\"", 1);
+        payload_append(&b, e->topics.unique_id, strlen(e->topics.unique_id));
+        payload_append(&b, "\":", 2);
+        payload_append(&b, component, strlen(component));
+        cJSON_free(component);
+    }
+
+    payload_append(&b, "}}", 2);
+
+    if (b.failed) {
+        ESP_LOGE(TAG, "Failed to build device discovery payload (%zu B so far)", b.len);
+        free(b.data);
+        return NULL;
+    }
+
+    return b.data;
+}
+#endif
+
+#if CONFIG_MQTT_HA_INCREMENTAL_DISCOVERY
+static size_t disc_settle(void);
+#endif
+
+/* Waits until the client outbox is below the high-water mark so retained configs never pile up
+ * in front of telemetry. False if the broker is gone or the outbox does not drain in time. */
+static bool discovery_pace(void) {
+    TickType_t start = xTaskGetTickCount();
+
+    for (;;) {
+        if (!mqtt_is_connected())
+            return false;
+
+        size_t outbox = mqtt_get_outbox_size();
+        if (outbox > discovery_stats.peak_outbox) {
+            discovery_stats.peak_outbox = outbox;
+        }
+
+#if CONFIG_MQTT_HA_INCREMENTAL_DISCOVERY
+        // Caches what was acknowledged meanwhile and keeps a tracking slot for the next publish
+        size_t unacked = disc_settle();
+        bool slot_free = unacked < HA_DISC_INFLIGHT_MAX;
+#else
+        size_t unacked = 0;
+        bool slot_free = true;
+#endif
+
+        if (outbox < CONFIG_MQTT_HA_DISCOVERY_OUTBOX_HWM && slot_free)
+            return true;
+
+        if (xTaskGetTickCount() - start >= DISC_DRAIN_TIMEOUT) {
+            ESP_LOGW(TAG, "Outbox stuck at %zu B (%zu unacknowledged), pausing discovery", outbox,
+                     unacked);
+            return false;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_MQTT_HA_DISCOVERY_PACE_MS));
+    }
+}
+
+#if CONFIG_MQTT_HA_INCREMENTAL_DISCOVERY
+static nvs_handle_t disc_nvs;
+static bool disc_nvs_open = false;
+static bool disc_nvs_dirty = false;
+
+static void disc_key(uint32_t topic_hash, char *key, size_t len) {
+    snprintf(key, len, "%08" PRIx32, topic_hash);
+}
+
+// True if NVS says exactly this payload is already retained on this topic
+static bool disc_is_current(const char *topic, uint32_t payload_hash) {
+    if (!disc_nvs_open)
+        return false;
+
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    disc_key(fnv1a_hash(topic), key, sizeof(key));
+
+    uint8_t rec[HA_DISC_RECORD_MAX];
+    size_t len = sizeof(rec);
+    if (nvs_get_blob(disc_nvs, key, rec, &len) != ESP_OK || len < sizeof(uint32_t))
+        return false;
+
+    uint32_t stored;
+    memcpy(&stored, rec, sizeof(stored));
+    size_t topic_len = strlen(topic);
+
+    // Topic is compared too, two topics may share a key
+    return stored == payload_hash && len == sizeof(stored) + topic_len &&
+           memcmp(rec + sizeof(stored), topic, topic_len) == 0;
+}
+
+static void disc_remember(const char *topic, uint32_t payload_hash) {
+    if (!disc_nvs_open)
+        return;
+
+    size_t topic_len = strlen(topic);
+    uint8_t rec[HA_DISC_RECORD_MAX];
+    if (topic_len > sizeof(rec) - sizeof(payload_hash)) {
+        ESP_LOGW(TAG, "Topic too long for discovery cache: %s", topic);
+        return;
+    }
+
+    memcpy(rec, &payload_hash, sizeof(payload_hash));
+    memcpy(rec + sizeof(payload_hash), topic, topic_len);
+
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    disc_key(fnv1a_hash(topic), key, sizeof(key));
+
+    esp_err_t err = nvs_set_blob(disc_nvs, key, rec, sizeof(payload_hash) + topic_len);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Discovery cache write failed: %s", esp_err_to_name(err));
+        return;
+    }
+    disc_nvs_dirty = true;
+}
+
+static void disc_forget(const char *topic) {
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    disc_key(fnv1a_hash(topic), key, sizeof(key));
+    if (nvs_erase_key(disc_nvs, key) == ESP_OK) {
+        disc_nvs_dirty = true;
+    }
+}
+
+typedef struct {
+    int msg_id; // 0 = free slot
+    bool acked;
+    uint32_t payload_hash; // 0 = removal, the record is erased once acknowledged
+    char *topic;
+} disc_inflight_t;
+
+// Written by the MQTT task (PUBACK) and the discovery task
+static disc_inflight_t disc_inflight[HA_DISC_INFLIGHT_MAX];
+// PUBACKs that beat disc_track() to their slot
+static int disc_early_acks[HA_DISC_INFLIGHT_MAX];
+static size_t disc_early_next = 0;
+static portMUX_TYPE disc_inflight_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void ha_on_mqtt_published(int msg_id) {
+    if (msg_id <= 0)
+        return;
+
+    portENTER_CRITICAL(&disc_inflight_lock);
+    size_t i = 0;
+    while (i < HA_DISC_INFLIGHT_MAX && disc_inflight[i].msg_id != msg_id) {
+        i++;
+    }
+    if (i < HA_DISC_INFLIGHT_MAX) {
+        disc_inflight[i].acked = true;
+    } else {
+        disc_early_acks[disc_early_next] = msg_id;
+        disc_early_next = (disc_early_next + 1) % HA_DISC_INFLIGHT_MAX;
+    }
+    portEXIT_CRITICAL(&disc_inflight_lock);
+}
+
+// Keeps a published config until its PUBACK. Caller made sure a slot is free (discovery_pace).
+static void disc_track(int msg_id, const char *topic, uint32_t payload_hash) {
+    if (!disc_nvs_open || msg_id <= 0)
+        return;
+
+    char *copy = strdup(topic);
+    if (!copy)
+        return;
+
+    portENTER_CRITICAL(&disc_inflight_lock);
+    bool acked = false;
+    for (size_t i = 0; i < HA_DISC_INFLIGHT_MAX && !acked; i++) {
+        if (disc_early_acks[i] == msg_id) {
+            disc_early_acks[i] = 0;
+            acked = true;
+        }
+    }
+    for (size_t i = 0; i < HA_DISC_INFLIGHT_MAX; i++) {
+        if (!disc_inflight[i].msg_id) {
+            disc_inflight[i] = (disc_inflight_t){msg_id, acked, payload_hash, copy};
+            copy = NULL;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&disc_inflight_lock);
+
+    free(copy);
+}
+
+/* Caches acknowledged configs (or erases the records of acknowledged removals) and frees their
+ * slots. Returns the number of publishes still waiting for a PUBACK. */
+static size_t disc_settle(void) {
+    size_t unacked = 0;
+
+    for (size_t i = 0; i < HA_DISC_INFLIGHT_MAX; i++) {
+        disc_inflight_t done = {0};
+
+        portENTER_CRITICAL(&disc_inflight_lock);
+        if (disc_inflight[i].msg_id && disc_inflight[i].acked) {
+            done = disc_inflight[i];
+            disc_inflight[i] = (disc_inflight_t){0};
+        } else if (disc_inflight[i].msg_id) {
+            unacked++;
+        }
+        portEXIT_CRITICAL(&disc_inflight_lock);
+
+        if (!done.topic)
+            continue;
+
+        if (done.payload_hash) {
+            disc_remember(done.topic, done.payload_hash);
+        } else {
+            disc_forget(done.topic);
+        }
+        free(done.topic);
+    }
+
+    return unacked;
+}
+
+/* Waits for the PUBACKs of everything published in this run. Configs still unacknowledged when
+ * the broker goes away or the drain timeout expires are not cached; false in that case. */
+static bool disc_drain(void) {
+    TickType_t start = xTaskGetTickCount();
+
+    for (;;) {
+        size_t unacked = disc_settle();
+        if (!unacked)
+            return true;
+
+        if (!mqtt_is_connected() || xTaskGetTickCount() - start >= DISC_DRAIN_TIMEOUT) {
+            ESP_LOGW(TAG, "%zu discovery configs not acknowledged, left uncached", unacked);
+
+            portENTER_CRITICAL(&disc_inflight_lock);
+            disc_inflight_t dropped[HA_DISC_INFLIGHT_MAX];
+            memcpy(dropped, disc_inflight, sizeof(dropped));
+            memset(disc_inflight, 0, sizeof(disc_inflight));
+            memset(disc_early_acks, 0, sizeof(disc_early_acks));
+            portEXIT_CRITICAL(&disc_inflight_lock);
+
+            for (size_t i = 0; i < HA_DISC_INFLIGHT_MAX; i++) {
+                free(dropped[i].topic);
+            }
+            return false;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_MQTT_HA_DISCOVERY_PACE_MS));
+    }
+}
+
+// Clears retained configs of entities that were published earlier but are no longer registered
+static bool disc_remove_stale(void) {
+    if (!disc_nvs_open)
+        return true;
+
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+
+    uint32_t *current = malloc((entity_count + 1) * sizeof(*current));
+    if (!current) {
+        xSemaphoreGive(registry_mutex);
+        ESP_LOGE(TAG, "Failed to allocate stale entity scan");
+        return true;
+    }
+
+    size_t current_count = 0;
+#if CONFIG_MQTT_HA_DEVICE_DISCOVERY
+    char device_topic[128];
+    device_discovery_topic(device_topic, sizeof(device_topic));
+    current[current_count++] = fnv1a_hash(device_topic);
+#else
+    for (size_t i = 0; i < entity_count; i++) {
+        current[current_count++] = fnv1a_hash(entities[i].topics.topic);
+    }
+#endif
+
+    xSemaphoreGive(registry_mutex);
+
+    bool completed = true;
+    size_t stale_count;
+
+    do {
+        // Collect a batch first, entries must not be erased while the iterator is live
+        uint32_t stale[HA_DISC_STALE_BATCH];
+        stale_count = 0;
+
+        nvs_iterator_t it = NULL;
+        esp_err_t err =
+            nvs_entry_find(NVS_DEFAULT_PART_NAME, HA_DISC_NAMESPACE, NVS_TYPE_BLOB, &it);
+        while (err == ESP_OK && stale_count < HA_DISC_STALE_BATCH) {
+            nvs_entry_info_t info;
+            nvs_entry_info(it, &info);
+
+            uint32_t key = strtoul(info.key, NULL, 16);
+            bool found = false;
+            for (size_t i = 0; i < current_count && !found; i++) {
+                found = current[i] == key;
+            }
+            if (!found) {
+                stale[stale_count++] = key;
+            }
+
+            err = nvs_entry_next(&it);
+        }
+        nvs_release_iterator(it);
+
+        size_t removed = 0;
+        for (size_t i = 0; i < stale_count && completed; i++) {
+            char key[NVS_KEY_NAME_MAX_SIZE];
+            disc_key(stale[i], key, sizeof(key));
+
+            char rec[HA_DISC_RECORD_MAX + 1];
+            size_t len = HA_DISC_RECORD_MAX;
+            if (nvs_get_blob(disc_nvs, key, rec, &len) != ESP_OK || len <= sizeof(uint32_t)) {
+                // Unreadable record, nothing to clear on the broker
+                nvs_erase_key(disc_nvs, key);
+                disc_nvs_dirty = true;
+                removed++;
+                continue;
+            }
+
+            rec[len] = '\0';
+            const char *topic = rec + sizeof(uint32_t);
+            ESP_LOGI(TAG, "Removing stale entity: %s", topic);
+
+            // The record is erased on PUBACK, so a lost removal is retried next time
+            if (!discovery_pace()) {
+                completed = false;
+                break;
+            }
+            int msg_id = mqtt_enqueue(topic, "", 1, true);
+            if (msg_id < 0)
+                continue;
+
+            disc_track(msg_id, topic, 0);
+            discovery_stats.removed++;
+            removed++;
+        }
+
+        // Erased records must be gone before the next scan, or it would find them again
+        if (!disc_drain()) {
+            completed = false;
+        }
+
+        // A full batch may mean more stale records; stop if nothing could be removed
+        if (!removed)
+            break;
+    } while (completed && stale_count == HA_DISC_STALE_BATCH);
+
+    free(current);
+    return completed;
+}
+#endif
+
+/* Publishes one retained config at QoS 1, unless use_cache is set and NVS says it is already
+ * current. The cache entry is written once the broker acknowledges it. False if paused. */
+static bool publish_config(const char *topic, const char *payload, bool use_cache) {
+#if CONFIG_MQTT_HA_INCREMENTAL_DISCOVERY
+    uint32_t hash = fnv1a_hash(payload);
+    if (use_cache && disc_is_current(topic, hash)) {
+        discovery_stats.unchanged++;
+        return true;
+    }
+#else
+    (void)use_cache;
+#endif
+
+    if (!discovery_pace())
+        return false;
+
+    ESP_LOGI(TAG, "Topic: %s", topic);
+    ESP_LOGD(TAG, "Payload: %s", payload);
+
+    // esp-mqtt writes payloads larger than its buffer in buffer-sized chunks
+    int msg_id = mqtt_enqueue(topic, payload, 1, true);
+    if (msg_id >= 0) {
+        discovery_stats.published++;
+        discovery_stats.bytes += strlen(topic) + strlen(payload);
+#if CONFIG_MQTT_HA_INCREMENTAL_DISCOVERY
+        disc_track(msg_id, topic, hash);
+#endif
+    }
+
+    return true;
+}
+
+static bool remove_config(const char *topic) {
+    if (!discovery_pace())
+        return false;
+
+    ESP_LOGI(TAG, "Removing: %s", topic);
+    int msg_id = mqtt_enqueue(topic, "", 1, true);
+    if (msg_id >= 0) {
+        discovery_stats.removed++;
+#if CONFIG_MQTT_HA_INCREMENTAL_DISCOVERY
+        disc_track(msg_id, topic, 0);
+#endif
+    }
+    return true;
+}
+
+#if CONFIG_MQTT_HA_DEVICE_DISCOVERY
+static bool publish_device(bool force_empty_payload, bool use_cache) {
+    char topic[128];
+    device_discovery_topic(topic, sizeof(topic));
+
+    if (force_empty_payload)
+        return remove_config(topic);
+
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+    char *payload = ensure_entity_topics() ? build_device_payload() : NULL;
+    xSemaphoreGive(registry_mutex);
+    if (!payload)
+        return true;
+
+    bool completed = publish_config(topic, payload, use_cache);
+    free(payload);
+    return completed;
+}
+#else
+static bool publish_entities(bool force_empty_payload, bool use_cache) {
+    // The lock is held per entity only, so pacing never stalls registration or telemetry. If the
+    // registry changes meanwhile, the change triggers another run that catches up.
+    for (size_t i = 0;; i++) {
+        char topic[128];
+        char *payload = NULL;
+
+        xSemaphoreTake(registry_mutex, portMAX_DELAY);
+        if (i >= entity_count || !ensure_entity_topics()) {
+            xSemaphoreGive(registry_mutex);
+            break;
+        }
+
+        const ha_entity_t *e = &entities[i];
+        snprintf(topic, sizeof(topic), "%s", e->topics.topic);
+        if (!force_empty_payload) {
+            payload = build_entity_payload(e->def, &e->topics, false);
+            if (!payload) {
+                ESP_LOGE(TAG, "Failed to build discovery payload for '%s'", e->def->name);
+            }
+        }
+        xSemaphoreGive(registry_mutex);
+
+        if (force_empty_payload) {
+            if (!remove_config(topic))
+                return false;
+            continue;
+        }
+
+        if (!payload)
+            continue;
+
+        bool completed = publish_config(topic, payload, use_cache);
+        cJSON_free(payload);
+        if (!completed)
+            return false;
+    }
+
+    return true;
+}
+#endif
+
+static void run_discovery(uint32_t flags) {
+    bool force_empty_payload = flags & DISC_RUN_EMPTY;
+    bool use_cache = !(flags & DISC_RUN_FULL);
+
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+    bool topics_ready = ensure_entity_topics();
+    xSemaphoreGive(registry_mutex);
+    if (!topics_ready)
+        return;
+
+#if CONFIG_MQTT_HA_INCREMENTAL_DISCOVERY
+    esp_err_t err = nvs_open(HA_DISC_NAMESPACE, NVS_READWRITE, &disc_nvs);
+    disc_nvs_open = err == ESP_OK;
+    disc_nvs_dirty = false;
+    if (!disc_nvs_open) {
+        ESP_LOGW(TAG, "Discovery cache unavailable (%s), publishing all entities",
+                 esp_err_to_name(err));
+    }
+#endif
+
+    memset(&discovery_stats, 0, sizeof(discovery_stats));
+    TickType_t start = xTaskGetTickCount();
+    bool completed = true;
+
+#if CONFIG_MQTT_HA_INCREMENTAL_DISCOVERY
+    // Stale configs go first: a device payload must not race removal of the same unique_ids
+    // published per entity (or vice versa) when the discovery mode was switched
+    completed = disc_remove_stale();
+#endif
+
+#if CONFIG_MQTT_HA_DEVICE_DISCOVERY
+    completed = completed && publish_device(force_empty_payload, use_cache);
+#else
+    completed = completed && publish_entities(force_empty_payload, use_cache);
+#endif
+
+#if CONFIG_MQTT_HA_INCREMENTAL_DISCOVERY
+    if (disc_nvs_open) {
+        // Also after a pause: whatever the broker did acknowledge is cached
+        bool acknowledged = disc_drain();
+        completed = completed && acknowledged;
+
+        // Removed entities must be announced again by the next discovery run
+        if (force_empty_payload && completed) {
+            nvs_erase_all(disc_nvs);
+            disc_nvs_dirty = true;
+        }
+
+        if (disc_nvs_dirty) {
+            err = nvs_commit(disc_nvs);
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "Discovery cache commit failed: %s", esp_err_to_name(err));
+            }
+        }
+        nvs_close(disc_nvs);
+        disc_nvs_open = false;
+    }
+#endif
+
+    if (completed) {
+        discovery_announced = !force_empty_payload;
+    }
+
+    xSemaphoreTake(discovery_mutex, portMAX_DELAY);
+    discovery_resume = !completed;
+    xSemaphoreGive(discovery_mutex);
+
+    ESP_LOGI(TAG,
+             "Discovery %s: %zu published (%zu B), %zu unchanged, %zu removed in %" PRIu32
+             " ms, peak outbox %zu B",
+             completed ? "done" : "paused", discovery_stats.published, discovery_stats.bytes,
+             discovery_stats.unchanged, discovery_stats.removed,
+             (uint32_t)pdTICKS_TO_MS(xTaskGetTickCount() - start), discovery_stats.peak_outbox);
+}
+
+static void discovery_task(void *args) {
+    uint32_t flags = (uint32_t)(uintptr_t)args;
+
+    for (;;) {
+        run_discovery(flags);
+
+        // Requests that arrived while running are coalesced into one more pass
+        xSemaphoreTake(discovery_mutex, portMAX_DELAY);
+        if (!discovery_pending) {
+            discovery_task_handle = NULL;
+            xSemaphoreGive(discovery_mutex);
+            break;
+        }
+        flags = discovery_pending_flags;
+        discovery_run_flags = flags;
+        discovery_pending = false;
+        xSemaphoreGive(discovery_mutex);
+    }
+
+    vTaskDelete(NULL);
+}
+
+static void discovery_request(uint32_t flags) {
+    if (discovery_mutex == NULL) {
+        ESP_LOGW(TAG, "No entities registered, nothing to discover");
+        return;
+    }
+
+    xSemaphoreTake(discovery_mutex, portMAX_DELAY);
+
+    if (discovery_task_handle) {
+        // The latest request decides between publish and removal; a full republish sticks
+        uint32_t full = discovery_pending ? discovery_pending_flags & DISC_RUN_FULL : 0;
+        discovery_pending = true;
+        discovery_pending_flags = flags | full;
+        xSemaphoreGive(discovery_mutex);
+        ESP_LOGI(TAG, "Discovery already running, queued another pass");
+        return;
+    }
+
+    discovery_run_flags = flags;
+    if (xTaskCreate(discovery_task, "ha_discovery", CONFIG_MQTT_HA_DISCOVERY_TASK_STACK_SIZE,
+                    (void *)(uintptr_t)flags, CONFIG_MQTT_HA_DISCOVERY_TASK_PRIORITY,
+                    &discovery_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create discovery task");
+        discovery_task_handle = NULL;
+    }
+
+    xSemaphoreGive(discovery_mutex);
+}
+
+void ha_on_mqtt_connected(void) {
+    if (discovery_mutex == NULL)
+        return;
+
+    // A run still in progress lost the connection as well, it gets another pass
+    xSemaphoreTake(discovery_mutex, portMAX_DELAY);
+    bool resume = discovery_resume || discovery_task_handle;
+    uint32_t flags = discovery_run_flags;
+    discovery_resume = false;
+    xSemaphoreGive(discovery_mutex);
+
+    if (resume) {
+        ESP_LOGI(TAG, "Resuming paused discovery");
+        discovery_request(flags);
+    }
 }
 
 void publish_ha_mqtt_discovery(bool force_empty_payload) {
+    discovery_request(DISC_RUN_FULL | (force_empty_payload ? DISC_RUN_EMPTY : 0));
+}
+
+#if !CONFIG_MQTT_HA_INCREMENTAL_DISCOVERY
+void ha_on_mqtt_published(int msg_id) { (void)msg_id; }
+#endif
+
+#if CONFIG_MQTT_HA_ENTITY_STATE_TOPICS
+void ha_publish_entity_states(const cJSON *tele) {
+    if (!tele || registry_mutex == NULL)
+        return;
+
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+
+    // Arena is (re)built by discovery; until then there is nothing to point state topics at
+    if (!topic_arena || topics_generation != mqtt_get_topics()->generation ||
+        topics_registry_generation != registry_generation) {
+        xSemaphoreGive(registry_mutex);
+        return;
+    }
+
+    size_t changed = 0;
+    size_t bytes = 0;
+    char buf[128];
+
+    for (size_t i = 0; i < entity_count; i++) {
+        ha_entity_t *e = &entities[i];
+        const ha_entity_config_t *def = e->def;
+        if (!entity_has_own_state(def))
+            continue;
+
+        const cJSON *parent = def->parent_key ? cJSON_GetObjectItem(tele, def->parent_key) : tele;
+        const cJSON *value = parent ? cJSON_GetObjectItem(parent, e->topics.sanitized_name) : NULL;
+        if (!value)
+            continue;
+
+        if (!cJSON_PrintPreallocated((cJSON *)value, buf, sizeof(buf), false)) {
+            ESP_LOGW(TAG, "State of '%s' exceeds %zu B, skipped", def->name, sizeof(buf));
+            continue;
+        }
+
+        uint32_t hash = fnv1a_hash(buf);
+        if (hash == e->state_hash)
+            continue;
+
+        mqtt_publish(e->topics.state_topic, buf, CONFIG_MQTT_QOS, true);
+        e->state_hash = hash;
+        changed++;
+        bytes += strlen(e->topics.state_topic) + strlen(buf);
+    }
+
+    xSemaphoreGive(registry_mutex);
+
+    if (changed) {
+        ESP_LOGD(TAG, "State topics: %zu changed, %zu B (topic + payload)", changed, bytes);
+    }
+}
+
+void ha_reset_entity_states(void) {
+    if (registry_mutex == NULL)
+        return;
+
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
     for (size_t i = 0; i < entity_count; i++) {
-        publish_entity(&entities[i], force_empty_payload);
+        entities[i].state_hash = 0;
     }
+    xSemaphoreGive(registry_mutex);
 }
+#endif
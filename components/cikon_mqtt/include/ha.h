@@ -16,6 +16,10 @@ typedef struct cJSON cJSON;
  *
  * @param config Pointer to entity configuration struct
  *
+ * The config struct is copied, so compound literals may be passed. The registry grows as
+ * needed; entities registered this way are never unregistered. If discovery has already been
+ * published, it is republished with the new entity.
+ *
  * @note The name will be sanitized (spaces → underscores) for MQTT topic keys,
  *       but the original name is preserved for display in Home Assistant UI.
  *
@@ -29,15 +33,80 @@ typedef struct cJSON cJSON;
  */
 void ha_register_entity(const ha_entity_config_t *config);
 
+/**
+ * @brief Register a static, sentinel-terminated entity array (e.g. adapter HA metadata).
+ *
+ * Entries are referenced, not copied, so the array must stay valid until unregistered.
+ * Registering the same owner twice is a no-op. If discovery has already been published, it is
+ * republished with the new entities.
+ *
+ * @param configs Entity array terminated by an entry with type HA_ENTITY_NONE
+ * @param owner   Tag used by ha_unregister_entities(), typically the adapter's metadata pointer
+ */
+void ha_register_entities(const ha_entity_config_t *configs, const void *owner);
+
+/**
+ * @brief Remove all entities registered with the given owner (e.g. adapter disabled at runtime).
+ *
+ * If discovery has already been published, it is republished; with
+ * CONFIG_MQTT_HA_INCREMENTAL_DISCOVERY the removed entities get empty retained configs.
+ *
+ * @param owner Tag passed to ha_register_entities()
+ */
+void ha_unregister_entities(const void *owner);
+
 /**
  * @brief Publishes all registered Home Assistant entities via MQTT Discovery.
  *
  * Entities must be registered via ha_register_entity() before calling this function.
+ * Returns immediately: configs are queued at QoS 1 from a background task that waits for the
+ * MQTT outbox to drop below CONFIG_MQTT_HA_DISCOVERY_OUTBOX_HWM before each message. A request
+ * made while a run is in progress is coalesced into one more run; a paused run is resumed on the
+ * next connect.
+ *
+ * With CONFIG_MQTT_HA_DEVICE_DISCOVERY all entities are sent as components of one device
+ * discovery payload instead of one config per entity.
+ *
+ * With CONFIG_MQTT_HA_INCREMENTAL_DISCOVERY, a hash of each compact payload is kept in NVS once
+ * the broker has acknowledged it, and entities no longer registered get an empty retained
+ * payload. Registry changes then publish only new or changed entities; this call always
+ * republishes everything and refreshes the cache.
  *
  * @param force_empty_payload If true, publishes empty payloads to remove entities
  */
 void publish_ha_mqtt_discovery(bool force_empty_payload);
 
+/**
+ * @brief Connect hook, called by the MQTT client once connected.
+ *
+ * A discovery run paused by a disconnect or a stuck outbox is started again.
+ */
+void ha_on_mqtt_connected(void);
+
+/**
+ * @brief PUBACK hook, called by the MQTT client for every acknowledged message id.
+ *
+ * Discovery caches a config in NVS only after its publish is acknowledged.
+ */
+void ha_on_mqtt_published(int msg_id);
+
+#if CONFIG_MQTT_HA_ENTITY_STATE_TOPICS
+/**
+ * @brief Publishes changed entity states on their own retained <node>/<id>/<entity>/state topics.
+ *
+ * Looks up each entity's value in the telemetry JSON and publishes it only if it differs from
+ * the last published value, so Home Assistant re-evaluates a single entity per change.
+ *
+ * @param tele Telemetry JSON root (same object published on the tele topic)
+ */
+void ha_publish_entity_states(const cJSON *tele);
+
+/**
+ * @brief Forgets last published states so every entity is republished (e.g. after reconnect).
+ */
+void ha_reset_entity_states(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -9,7 +9,10 @@
 extern "C" {
 #endif
 
-typedef void (*mqtt_command_callback_t)(const char *payload);
+/* Executes the commands in payload. With MQTT 5 request/response, results is an object to fill
+ * with "<command>": "<result>" for the reply (NULL otherwise). Returns false if the payload was
+ * rejected as a whole. */
+typedef bool (*mqtt_command_callback_t)(const char *payload, cJSON *results);
 typedef void (*mqtt_telemetry_callback_t)(cJSON *json_root);
 
 typedef struct {
@@ -31,14 +34,39 @@ typedef struct {
     mqtt_telemetry_callback_t telemetry_cb;
 } mqtt_config_t;
 
+/**
+ * @brief Precomputed MQTT topics for the configured node and client id.
+ *
+ * Built into a single arena by mqtt_configure() and refreshed on connect, so publish and
+ * subscribe paths only take pointers. A change builds a new table instead of rewriting the old
+ * one, which stays valid until the change after that.
+ */
+typedef struct {
+    const char *base; // <node>/<client_id> (HA "~" prefix)
+    const char *cmnd; // <node>/<client_id>/cmnd
+    const char *tele; // <node>/<client_id>/tele
+    const char *aval; // <node>/<client_id>/aval
+    uint32_t generation; // Incremented on every rebuild, lets dependents refresh their caches
+} mqtt_topics_t;
+
 void mqtt_configure(const mqtt_config_t *cfg);
 void mqtt_init(void);
 void mqtt_shutdown(void);
 
-void mqtt_publish(const char *topic, const char *payload, int qos, bool retain);
+// Returns true if the message was sent or queued in the client outbox
+bool mqtt_publish(const char *topic, const char *payload, int qos, bool retain);
+/* Stores the message in the client outbox for the MQTT task to send, so the caller never blocks
+ * on the socket and the message counts in mqtt_get_outbox_size() until it is out (QoS 0) or
+ * acknowledged. Returns the message id (0 for QoS 0, -1 on failure) so a QoS > 0 message can be
+ * matched with its PUBACK (MQTT_EVENT_PUBLISHED). */
+int mqtt_enqueue(const char *topic, const char *payload, int qos, bool retain);
 void mqtt_publish_offline_state(void);
+bool mqtt_is_connected(void);
+// Bytes of outgoing messages still waiting in the client outbox
+size_t mqtt_get_outbox_size(void);
 void mqtt_trigger_telemetry(void);
 const mqtt_config_t *mqtt_get_config(void);
+const mqtt_topics_t *mqtt_get_topics(void);
 
 void mqtt_log_event_group_bits(void);
 
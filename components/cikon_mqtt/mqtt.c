@@ -9,18 +9,35 @@
 
 #include "certs.h"
 #include "mqtt.h"
+#if CONFIG_MQTT_ENABLE_HA_DISCOVERY
+#include "ha.h"
+#endif
 
 #define TAG "cikon:mqtt"
 #define TOPIC_BUF_SIZE 128
+#define TOPIC_ARENA_SIZE (4 * TOPIC_BUF_SIZE)
 
 #define MQTT_CONNECTED_BIT BIT0
 #define MQTT_OFFLINE_PUBLISHED_BIT BIT1
 #define MQTT_TASKS_SHUTDOWN_BIT BIT2
 #define MQTT_TELEMETRY_TRIGGER_BIT BIT3
 
+// MQTT 5 topic aliases (client -> broker). 0 means "no alias".
+#define MQTT5_ALIAS_NONE 0
+#define MQTT5_ALIAS_TELE 1
+#define MQTT5_ALIAS_AVAL 2
+#define MQTT5_ALIAS_COUNT 3
+
+#if CONFIG_MQTT_USE_PROTOCOL_5
+#define MQTT_TELEMETRY_EXPIRY_S CONFIG_MQTT5_TELEMETRY_EXPIRY_S
+#else
+#define MQTT_TELEMETRY_EXPIRY_S 0
+#endif
+
 static mqtt_config_t mqtt_config = {NULL};
 static TaskHandle_t mqtt_command_task_handle, mqtt_telemetry_task_handle;
 static SemaphoreHandle_t mqtt_reconnect_mutex = NULL;
+static SemaphoreHandle_t mqtt_publish_mutex = NULL;
 
 static esp_mqtt_client_handle_t mqtt_client;
 static EventGroupHandle_t mqtt_event_group;
@@ -28,21 +45,157 @@ static QueueHandle_t mqtt_queue;
 
 static bool mqtt_skip_current_msg = false;
 
-void mqtt_command_topic(char *buf, size_t buf_size) {
-    snprintf(buf, buf_size, "%s/%s/cmnd", mqtt_config.mqtt_node, mqtt_config.client_id);
+// Message id of the pending "offline" publish; only its PUBACK confirms it
+static int mqtt_offline_msg_id = -1;
+// Recent PUBACKs, for the one that beats mqtt_offline_msg_id being set
+#define MQTT_RECENT_ACKS 8
+static int mqtt_recent_acks[MQTT_RECENT_ACKS];
+static size_t mqtt_recent_acks_next = 0;
+static portMUX_TYPE mqtt_ack_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Alias is bound once the full topic has been sent with it in the current session
+static bool mqtt5_alias_bound[MQTT5_ALIAS_COUNT];
+// Highest alias usable on this connection, lowered when esp-mqtt refuses one
+static uint8_t mqtt5_alias_max = MQTT5_ALIAS_COUNT - 1;
+
+// All fixed topics live in one arena, rebuilt only when node/client_id change. A rebuild makes a
+// new table and swaps the pointer, so readers never see a half-written string; the previous
+// table is kept until the next rebuild for a reader still using its pointers.
+typedef struct {
+    mqtt_topics_t topics;
+    char arena[TOPIC_ARENA_SIZE];
+} mqtt_topic_table_t;
+
+static const mqtt_topics_t mqtt_topics_empty = {"", "", "", "", 0};
+static mqtt_topic_table_t *mqtt_topic_table = NULL;
+static mqtt_topic_table_t *mqtt_topic_table_retired = NULL;
+static SemaphoreHandle_t mqtt_topics_mutex = NULL;
+static StaticSemaphore_t mqtt_topics_mutex_storage;
+
+static const char *topic_arena_put(mqtt_topic_table_t *table, size_t *offset, const char *base,
+                                   const char *suffix) {
+    char *dst = table->arena + *offset;
+    size_t room = sizeof(table->arena) - *offset;
+
+    int len = suffix ? snprintf(dst, room, "%s/%s", base, suffix) : snprintf(dst, room, "%s", base);
+    if (len < 0 || (size_t)len >= room) {
+        ESP_LOGE(TAG, "Topic arena too small for '%s/%s'", base, suffix ? suffix : "");
+        return "";
+    }
+
+    *offset += len + 1;
+    return dst;
 }
-// void mqtt_status_topic(char *buf, size_t buf_size) {
-//     snprintf(buf, buf_size, "%s/%s/stat", mqtt_config.mqtt_node, mqtt_config.client_id);
-// }
-void mqtt_telemetry_topic(char *buf, size_t buf_size) {
-    snprintf(buf, buf_size, "%s/%s/tele", mqtt_config.mqtt_node, mqtt_config.client_id);
+
+// force: rebuild even if base is unchanged (other config fields, e.g. discovery prefix, changed)
+static void mqtt_topics_refresh(bool force) {
+
+    const char *node = mqtt_config.mqtt_node ? mqtt_config.mqtt_node : "";
+    const char *id = mqtt_config.client_id ? mqtt_config.client_id : "";
+
+    char base[TOPIC_BUF_SIZE];
+    snprintf(base, sizeof(base), "%s/%s", node, id);
+
+    const mqtt_topics_t *current = mqtt_get_topics();
+    if (!force && current->generation && strcmp(base, current->base) == 0)
+        return;
+
+    mqtt_topic_table_t *table = malloc(sizeof(*table));
+    if (!table) {
+        ESP_LOGE(TAG, "Failed to allocate topic table (%zu B)", sizeof(*table));
+        return;
+    }
+
+    size_t offset = 0;
+    table->topics.base = topic_arena_put(table, &offset, base, NULL);
+    table->topics.cmnd = topic_arena_put(table, &offset, base, "cmnd");
+    table->topics.tele = topic_arena_put(table, &offset, base, "tele");
+    table->topics.aval = topic_arena_put(table, &offset, base, "aval");
+    table->topics.generation = current->generation + 1;
+
+    xSemaphoreTake(mqtt_topics_mutex, portMAX_DELAY);
+    free(mqtt_topic_table_retired);
+    mqtt_topic_table_retired = mqtt_topic_table;
+    mqtt_topic_table = table;
+    xSemaphoreGive(mqtt_topics_mutex);
+
+    ESP_LOGI(TAG, "Topic table rebuilt: %s/{cmnd,tele,aval} (%zu B)", table->topics.base, offset);
 }
-void mqtt_availability_topic(char *buf, size_t buf_size) {
-    snprintf(buf, buf_size, "%s/%s/aval", mqtt_config.mqtt_node, mqtt_config.client_id);
+
+const mqtt_topics_t *mqtt_get_topics(void) {
+    if (mqtt_topics_mutex == NULL)
+        mqtt_topics_mutex = xSemaphoreCreateMutexStatic(&mqtt_topics_mutex_storage);
+
+    xSemaphoreTake(mqtt_topics_mutex, portMAX_DELAY);
+    const mqtt_topics_t *topics = mqtt_topic_table ? &mqtt_topic_table->topics : &mqtt_topics_empty;
+    xSemaphoreGive(mqtt_topics_mutex);
+    return topics;
 }
 
 const mqtt_config_t *mqtt_get_config(void) { return &mqtt_config; }
 
+/* Writes the message from the calling task, or with enqueue stores it in the outbox for the MQTT
+ * task to send, so the caller never blocks on the socket */
+static int mqtt_client_send(const char *topic, const char *payload, int qos, bool retain,
+                            bool enqueue) {
+    return enqueue ? esp_mqtt_client_enqueue(mqtt_client, topic, payload, 0, qos, retain, true)
+                   : esp_mqtt_client_publish(mqtt_client, topic, payload, 0, qos, retain);
+}
+
+/* esp-mqtt keeps MQTT 5 publish properties in the client, not per message, so setting them and
+ * publishing must happen under one lock. With MQTT 3.1.1 this is a plain publish. */
+static int mqtt_publish_ex(const char *topic, uint8_t alias, const char *payload, int qos,
+                           bool retain, uint32_t expiry_s, const char *correlation,
+                           uint16_t correlation_len, bool enqueue) {
+#if CONFIG_MQTT_USE_PROTOCOL_5
+    if (mqtt_publish_mutex == NULL)
+        return -1;
+
+    xSemaphoreTake(mqtt_publish_mutex, portMAX_DELAY);
+
+    if (alias > mqtt5_alias_max)
+        alias = MQTT5_ALIAS_NONE;
+
+    esp_mqtt5_publish_property_config_t prop = {
+        .message_expiry_interval = expiry_s,
+        .topic_alias = alias,
+        .correlation_data = correlation,
+        .correlation_data_len = correlation_len,
+    };
+
+    /* Once bound, the alias alone identifies the topic - send an empty topic name. Not for
+     * QoS > 0: esp-mqtt replays those from its outbox after a reconnect, when the broker no
+     * longer knows the alias, so they always carry the topic along with it. */
+    const char *wire_topic = (alias && mqtt5_alias_bound[alias] && qos == 0) ? "" : topic;
+
+    esp_mqtt5_client_set_publish_property(mqtt_client, &prop);
+    int msg_id = mqtt_client_send(wire_topic, payload, qos, retain, enqueue);
+
+    if (msg_id < 0 && alias && mqtt_is_connected()) {
+        /* esp-mqtt checks the alias against the Topic Alias Maximum from CONNACK and refuses the
+         * publish locally. The value itself is not exposed, so cap at the one below for the rest
+         * of this connection and resend with the full topic. */
+        mqtt5_alias_max = alias - 1;
+        ESP_LOGW(TAG, "Topic alias %u refused by broker limit, using aliases up to %u", alias,
+                 mqtt5_alias_max);
+        prop.topic_alias = MQTT5_ALIAS_NONE;
+        esp_mqtt5_client_set_publish_property(mqtt_client, &prop);
+        msg_id = mqtt_client_send(topic, payload, qos, retain, enqueue);
+    } else if (msg_id >= 0 && alias) {
+        mqtt5_alias_bound[alias] = true;
+    }
+
+    xSemaphoreGive(mqtt_publish_mutex);
+    return msg_id;
+#else
+    (void)alias;
+    (void)expiry_s;
+    (void)correlation;
+    (void)correlation_len;
+    return mqtt_client_send(topic, payload, qos, retain, enqueue);
+#endif
+}
+
 static void mqtt_shutdown_task(void *args) {
     mqtt_shutdown();
     vTaskDelete(NULL);
@@ -58,10 +211,12 @@ void mqtt_publish_telemetry(void) {
 
     char *json_str = cJSON_PrintUnformatted(json);
 
-    char topic[TOPIC_BUF_SIZE];
-    mqtt_telemetry_topic(topic, sizeof(topic));
+    mqtt_publish_ex(mqtt_get_topics()->tele, MQTT5_ALIAS_TELE, json_str, CONFIG_MQTT_QOS, false,
+                    MQTT_TELEMETRY_EXPIRY_S, NULL, 0, false);
 
-    esp_mqtt_client_publish(mqtt_client, topic, json_str, 0, CONFIG_MQTT_QOS, false);
+#if CONFIG_MQTT_HA_ENTITY_STATE_TOPICS
+    ha_publish_entity_states(json);
+#endif
 
     free(json_str);
     cJSON_Delete(json);
@@ -75,10 +230,20 @@ void mqtt_publish_offline_state(void) {
         return;
     }
 
-    char aval_buf_topic[TOPIC_BUF_SIZE];
-    mqtt_availability_topic(aval_buf_topic, sizeof(aval_buf_topic));
+    xEventGroupClearBits(mqtt_event_group, MQTT_OFFLINE_PUBLISHED_BIT);
+    int msg_id = mqtt_publish_ex(mqtt_get_topics()->aval, MQTT5_ALIAS_AVAL, "offline", 1, true, 0,
+                                 NULL, 0, false);
 
-    esp_mqtt_client_publish(mqtt_client, aval_buf_topic, "offline", 0, 1, true);
+    // The PUBACK can be handled before the id is known here
+    bool acked = false;
+    portENTER_CRITICAL(&mqtt_ack_lock);
+    mqtt_offline_msg_id = msg_id;
+    for (size_t i = 0; i < MQTT_RECENT_ACKS && msg_id > 0 && !acked; i++) {
+        acked = mqtt_recent_acks[i] == msg_id;
+    }
+    portEXIT_CRITICAL(&mqtt_ack_lock);
+    if (acked)
+        xEventGroupSetBits(mqtt_event_group, MQTT_OFFLINE_PUBLISHED_BIT);
 
     EventBits_t bits = xEventGroupWaitBits(mqtt_event_group, MQTT_OFFLINE_PUBLISHED_BIT, pdTRUE,
                                            pdFALSE, pdMS_TO_TICKS(1000));
@@ -103,12 +268,8 @@ void mqtt_telemetry_task(void *args) {
     mqtt_telemetry_task_handle = current;
 
     // Birth message
-    {
-        char topic[TOPIC_BUF_SIZE];
-
-        mqtt_availability_topic(topic, sizeof(topic));
-        esp_mqtt_client_publish(mqtt_client, topic, "online", 0, CONFIG_MQTT_QOS, true);
-    }
+    mqtt_publish_ex(mqtt_get_topics()->aval, MQTT5_ALIAS_AVAL, "online", CONFIG_MQTT_QOS, true, 0,
+                    NULL, 0, false);
 
     while (!(xEventGroupGetBits(mqtt_event_group) & MQTT_TASKS_SHUTDOWN_BIT)) {
 
@@ -151,14 +312,9 @@ void mqtt_command_task(void *args) {
     mqtt_command_task_handle = current;
 
     // Command topic subscription
-    {
-        char topic[TOPIC_BUF_SIZE];
-        mqtt_command_topic(topic, sizeof(topic));
-
-        if (esp_mqtt_client_subscribe(mqtt_client, topic, CONFIG_MQTT_QOS) < 0) {
-            ESP_LOGE(TAG, "Unable to subscribe to MQTT topic '%s'", topic);
-            vTaskDelete(NULL);
-        }
+    if (esp_mqtt_client_subscribe(mqtt_client, mqtt_get_topics()->cmnd, CONFIG_MQTT_QOS) < 0) {
+        ESP_LOGE(TAG, "Unable to subscribe to MQTT topic '%s'", mqtt_get_topics()->cmnd);
+        vTaskDelete(NULL);
     }
 
     char *msg = NULL; // ensure safe free() even if xQueueReceive fails
@@ -179,17 +335,37 @@ void mqtt_command_task(void *args) {
         if (xQueueReceive(mqtt_queue, &msg, pdMS_TO_TICKS(100)) == pdFALSE)
             goto cleanup;
 
+        // topic\0response_topic\0<correlation_len:2><correlation_data>payload\0
         char *topic = msg;
-        char *payload = msg + strlen(topic) + 1;
-
-        char commmand_topic[TOPIC_BUF_SIZE];
-        mqtt_command_topic(commmand_topic, sizeof(commmand_topic));
-
-        if (strcmp(topic, commmand_topic))
+        char *response_topic = topic + strlen(topic) + 1;
+        char *correlation = response_topic + strlen(response_topic) + 1;
+        uint16_t correlation_len;
+        memcpy(&correlation_len, correlation, sizeof(correlation_len));
+        correlation += sizeof(correlation_len);
+        char *payload = correlation + correlation_len;
+
+        if (strcmp(topic, mqtt_get_topics()->cmnd))
             goto cleanup;
 
-        if (mqtt_config.command_cb) {
-            mqtt_config.command_cb(payload);
+        // Per-command results are only collected when there is someone to reply to
+        cJSON *results = response_topic[0] ? cJSON_CreateObject() : NULL;
+        bool ok = mqtt_config.command_cb && mqtt_config.command_cb(payload, results);
+
+        /* MQTT 5 request/response: reply on the requester's topic, echoing its request id, with
+         * {"cmnd":{"<command>":"<result>",...}} or {"cmnd":null} like the WebSocket channel */
+        if (response_topic[0]) {
+            cJSON *reply = cJSON_CreateObject();
+            cJSON_AddItemToObject(reply, "cmnd", ok ? results : cJSON_CreateNull());
+            if (!ok)
+                cJSON_Delete(results);
+
+            char *reply_str = cJSON_PrintUnformatted(reply);
+            cJSON_Delete(reply);
+            if (reply_str) {
+                mqtt_publish_ex(response_topic, MQTT5_ALIAS_NONE, reply_str, CONFIG_MQTT_QOS,
+                                false, 0, correlation, correlation_len, false);
+                cJSON_free(reply_str);
+            }
         }
 
     cleanup:
@@ -203,13 +379,36 @@ void mqtt_command_task(void *args) {
     vTaskDelete(NULL);
 }
 
-void mqtt_publish(const char *topic, const char *payload, int qos, bool retain) {
+bool mqtt_publish(const char *topic, const char *payload, int qos, bool retain) {
 
-    if (xEventGroupGetBits(mqtt_event_group) & MQTT_CONNECTED_BIT) {
-        esp_mqtt_client_publish(mqtt_client, topic, payload, 0, qos, retain);
-    } else {
+    if (!(xEventGroupGetBits(mqtt_event_group) & MQTT_CONNECTED_BIT)) {
         ESP_LOGW(TAG, "No connection to the MQTT broker, skipping publish to topic: %s", topic);
+        return false;
     }
+
+    return mqtt_publish_ex(topic, MQTT5_ALIAS_NONE, payload, qos, retain, 0, NULL, 0, false) >= 0;
+}
+
+int mqtt_enqueue(const char *topic, const char *payload, int qos, bool retain) {
+
+    if (!(xEventGroupGetBits(mqtt_event_group) & MQTT_CONNECTED_BIT)) {
+        ESP_LOGW(TAG, "No connection to the MQTT broker, skipping publish to topic: %s", topic);
+        return -1;
+    }
+
+    return mqtt_publish_ex(topic, MQTT5_ALIAS_NONE, payload, qos, retain, 0, NULL, 0, true);
+}
+
+bool mqtt_is_connected(void) {
+    return mqtt_event_group && (xEventGroupGetBits(mqtt_event_group) & MQTT_CONNECTED_BIT);
+}
+
+size_t mqtt_get_outbox_size(void) {
+    if (!mqtt_client)
+        return 0;
+
+    int size = esp_mqtt_client_get_outbox_size(mqtt_client);
+    return size > 0 ? (size_t)size : 0;
 }
 
 void shutdown_mqtt_tasks(void) {
@@ -241,7 +440,19 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         }
 
         mqtt_retry_counter = 0;
+        mqtt_topics_refresh(false);
+
+        // Topic aliases are scoped to a network connection - rebind on every connect
+        memset(mqtt5_alias_bound, 0, sizeof(mqtt5_alias_bound));
+        mqtt5_alias_max = MQTT5_ALIAS_COUNT - 1;
+
+#if CONFIG_MQTT_HA_ENTITY_STATE_TOPICS
+        ha_reset_entity_states();
+#endif
         xEventGroupSetBits(mqtt_event_group, MQTT_CONNECTED_BIT);
+#if CONFIG_MQTT_ENABLE_HA_DISCOVERY
+        ha_on_mqtt_connected();
+#endif
 
         // Ensure old tasks are properly shut down before creating new ones
         if (mqtt_command_task_handle != NULL || mqtt_telemetry_task_handle != NULL) {
@@ -316,8 +527,22 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         int topic_len = event->topic_len;
         int payload_len = event->data_len;
 
-        // Calculate: topic\0payload\0
-        size_t message_len = topic_len + 1 + payload_len + 1;
+        const char *response_ptr = NULL;
+        const char *correlation_ptr = NULL;
+        int response_len = 0;
+        uint16_t correlation_len = 0;
+#if CONFIG_MQTT_USE_PROTOCOL_5
+        if (event->property && event->property->response_topic) {
+            response_ptr = event->property->response_topic;
+            response_len = event->property->response_topic_len;
+            correlation_ptr = event->property->correlation_data;
+            correlation_len = correlation_ptr ? event->property->correlation_data_len : 0;
+        }
+#endif
+
+        // Calculate: topic\0response_topic\0<correlation_len:2><correlation_data>payload\0
+        size_t message_len = topic_len + 1 + response_len + 1 + sizeof(correlation_len) +
+                             correlation_len + payload_len + 1;
         char *message_buf = malloc(message_len);
 
         if (!message_buf) {
@@ -325,11 +550,24 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
             break;
         }
 
-        // topic\0payload\0
-        memcpy(message_buf, topic_ptr, topic_len);
-        message_buf[topic_len] = '\0';
+        char *p = message_buf;
+
+        memcpy(p, topic_ptr, topic_len);
+        p += topic_len;
+        *p++ = '\0';
+
+        if (response_len)
+            memcpy(p, response_ptr, response_len);
+        p += response_len;
+        *p++ = '\0';
 
-        memcpy(message_buf + topic_len + 1, payload_ptr, payload_len);
+        memcpy(p, &correlation_len, sizeof(correlation_len));
+        p += sizeof(correlation_len);
+        if (correlation_len)
+            memcpy(p, correlation_ptr, correlation_len);
+        p += correlation_len;
+
+        memcpy(p, payload_ptr, payload_len);
         message_buf[message_len - 1] = '\0';
 
         if (mqtt_queue != NULL &&
@@ -343,9 +581,23 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 
         break;
     }
-    case MQTT_EVENT_PUBLISHED:
-        xEventGroupSetBits(mqtt_event_group, MQTT_OFFLINE_PUBLISHED_BIT);
+    case MQTT_EVENT_PUBLISHED: {
+        esp_mqtt_event_handle_t event = event_data;
+
+        portENTER_CRITICAL(&mqtt_ack_lock);
+        bool offline = event->msg_id == mqtt_offline_msg_id;
+        mqtt_recent_acks[mqtt_recent_acks_next] = event->msg_id;
+        mqtt_recent_acks_next = (mqtt_recent_acks_next + 1) % MQTT_RECENT_ACKS;
+        portEXIT_CRITICAL(&mqtt_ack_lock);
+
+        if (offline) {
+            xEventGroupSetBits(mqtt_event_group, MQTT_OFFLINE_PUBLISHED_BIT);
+        }
+#if CONFIG_MQTT_ENABLE_HA_DISCOVERY
+        ha_on_mqtt_published(event->msg_id);
+#endif
         break;
+    }
     default:
         break;
     }
@@ -385,6 +637,15 @@ void mqtt_init() {
         return;
     }
 
+    if (mqtt_publish_mutex == NULL) {
+        mqtt_publish_mutex = xSemaphoreCreateMutex();
+    }
+
+    if (mqtt_publish_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create MQTT publish mutex!");
+        return;
+    }
+
     static StaticEventGroup_t mqtt_event_group_storage;
 
     if (mqtt_event_group == NULL) {
@@ -408,8 +669,7 @@ void mqtt_init() {
         return;
     }
 
-    static char avail_topic_buf[TOPIC_BUF_SIZE];
-    mqtt_availability_topic(avail_topic_buf, sizeof(avail_topic_buf));
+    mqtt_topics_refresh(false);
 
     bool is_secure = mqtt_is_secure(mqtt_config.mqtt_broker);
 
@@ -434,10 +694,13 @@ void mqtt_init() {
         .buffer.size = CONFIG_MQTT_RX_BUFFER_SIZE,
         .session =
             {
+#if CONFIG_MQTT_USE_PROTOCOL_5
+                .protocol_ver = MQTT_PROTOCOL_V_5,
+#endif
                 .keepalive = 15,
                 .last_will =
                     {
-                        .topic = avail_topic_buf,
+                        .topic = mqtt_get_topics()->aval,
                         .msg = "offline",
                         .qos = 0,
                         .retain = true,
@@ -466,6 +729,11 @@ void mqtt_shutdown() {
         mqtt_reconnect_mutex = NULL;
     }
 
+    if (mqtt_publish_mutex != NULL) {
+        vSemaphoreDelete(mqtt_publish_mutex);
+        mqtt_publish_mutex = NULL;
+    }
+
     if (mqtt_queue != NULL) {
         vQueueDelete(mqtt_queue);
         mqtt_queue = NULL;
@@ -499,4 +767,5 @@ void mqtt_configure(const mqtt_config_t *cfg) {
         return;
     }
     mqtt_config = *cfg;
+    mqtt_topics_refresh(true);
 }
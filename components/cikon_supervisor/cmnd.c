@@ -143,11 +143,11 @@ void cmnd_init(QueueHandle_t queue) {
              use_immediate_execution ? "" : (command_queue ? "" : " (NULL queue!)"));
 }
 
-void cmnd_enqueue_job(command_job_t *job) {
+bool cmnd_enqueue_job(command_job_t *job) {
 
     if (!job) {
         ESP_LOGE(TAG, "Cannot enqueue NULL job");
-        return;
+        return false;
     }
 
     if (!command_queue || xQueueSend(command_queue, &job, pdMS_TO_TICKS(100)) != pdTRUE) {
@@ -160,44 +160,63 @@ void cmnd_enqueue_job(command_job_t *job) {
             job->args_json_str = NULL;
         }
         free(job);
+        return false;
     }
+    return true;
 }
 
-void cmnd_submit(const char *command_id, const char *args_json_str) {
+cmnd_result_t cmnd_submit(const char *command_id, const char *args_json_str) {
 
     const command_t *cmnd = cmnd_find(command_id);
 
     if (!cmnd) {
         ESP_LOGW(TAG, "Unknown command: %s", command_id);
-        return;
+        return CMND_RESULT_UNKNOWN;
     }
 
     if (use_immediate_execution) {
         cmnd->handler(args_json_str);
-        return;
+        return CMND_RESULT_ACCEPTED;
     }
 
     command_job_t *job = malloc(sizeof(command_job_t));
 
     if (!job) {
         ESP_LOGE(TAG, "Failed to allocate memory for command job");
-        return;
+        return CMND_RESULT_NO_MEM;
     }
 
     job->cmnd = cmnd;
     job->args_json_str = args_json_str ? strdup(args_json_str) : NULL;
 
-    cmnd_enqueue_job(job);
+    return cmnd_enqueue_job(job) ? CMND_RESULT_ACCEPTED : CMND_RESULT_QUEUE_FULL;
 }
 
-void cmnd_process_json(const char *payload) {
+const char *cmnd_result_str(cmnd_result_t result) {
+    switch (result) {
+    case CMND_RESULT_ACCEPTED:
+        return "accepted";
+    case CMND_RESULT_UNKNOWN:
+        return "unknown";
+    case CMND_RESULT_QUEUE_FULL:
+        return "queue_full";
+    case CMND_RESULT_NO_MEM:
+        return "no_mem";
+    }
+    return "error";
+}
+
+/* Submits every top-level key of a JSON object as a command. If results is given, the outcome of
+ * each command is added to it as "<command>": "<cmnd_result_str>". Returns false if the payload
+ * is not a JSON object (nothing submitted). */
+bool cmnd_process_json_results(const char *payload, cJSON *results) {
 
     cJSON *json_root = cJSON_Parse(payload);
 
     if (!json_root || !cJSON_IsObject(json_root)) {
         ESP_LOGW(TAG, "Invalid JSON: Rejecting message.");
         cJSON_Delete(json_root);
-        return;
+        return false;
     }
 
     for (cJSON *item = json_root->child; item != NULL; item = item->next) {
@@ -206,9 +225,19 @@ void cmnd_process_json(const char *payload) {
         }
 
         char *args_json_str = cJSON_PrintUnformatted(item);
-        cmnd_submit(item->string, args_json_str);
+        cmnd_result_t result =
+            args_json_str ? cmnd_submit(item->string, args_json_str) : CMND_RESULT_NO_MEM;
         free(args_json_str);
+
+        if (results) {
+            cJSON_AddStringToObject(results, item->string, cmnd_result_str(result));
+        }
     }
 
     cJSON_Delete(json_root);
+    return true;
+}
+
+void cmnd_process_json(const char *payload) {
+    cmnd_process_json_results(payload, NULL);
 }
@@ -2,6 +2,7 @@
 
 #include "freertos/FreeRTOS.h" // IWYU pragma: keep
 #include "freertos/queue.h"
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,13 +24,25 @@ typedef struct {
     char *args_json_str;
 } command_job_t;
 
+typedef enum {
+    CMND_RESULT_ACCEPTED,   // Executed (immediate mode) or queued for the supervisor
+    CMND_RESULT_UNKNOWN,    // No such command registered
+    CMND_RESULT_QUEUE_FULL, // Supervisor queue did not accept the job in time
+    CMND_RESULT_NO_MEM,
+} cmnd_result_t;
+
+// NOLINTNEXTLINE(readability-identifier-naming)
+typedef struct cJSON cJSON;
+
 void cmnd_init(QueueHandle_t queue);
 void cmnd_process_json(const char *json_string);
+bool cmnd_process_json_results(const char *json_string, cJSON *results);
 void cmnd_register(const char *command_id, const char *description, command_handler_t handler);
 void cmnd_unregister(const char *command_id);
 void cmnd_register_group(const command_entry_t *commands);
 void cmnd_unregister_group(const command_entry_t *commands);
-void cmnd_submit(const char *command_id, const char *args_json_str);
+cmnd_result_t cmnd_submit(const char *command_id, const char *args_json_str);
+const char *cmnd_result_str(cmnd_result_t result);
 
 const command_t *cmnd_find(const char *command_id);
 const command_t *cmnd_get_registry(size_t *out_count);
@@ -145,6 +145,14 @@ const supervisor_platform_adapter_t **supervisor_get_adapters(void);
  */
 bool supervisor_is_safe_mode_active(void);
 
+/**
+ * @brief Check whether an adapter is enabled
+ * Adapters are enabled unless shut down at runtime (e.g. via the "adapter" command).
+ * @param adapter Registered adapter
+ * @return false if the adapter was shut down or is not registered
+ */
+bool supervisor_adapter_is_enabled(const supervisor_platform_adapter_t *adapter);
+
 /**
  * @brief Initialize adapter and register its command/telemetry groups
  * @param adapter Adapter to initialize
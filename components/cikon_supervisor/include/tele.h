@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,6 +30,11 @@ const tele_t *tele_find(const char *tele_id);
 void tele_append_all(cJSON *json_root);
 void tele_append_one(cJSON *json_root, const char *tele_id);
 
+/* Monotonic (wrapping) telemetry version, bumped by the supervisor whenever a command completes
+ * or an adapter changes state. Lets clients wait for "something changed since N". */
+uint32_t tele_get_version(void);
+void tele_bump_version(void);
+
 #ifdef __cplusplus
 }
 #endif
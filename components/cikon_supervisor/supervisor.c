@@ -27,6 +27,9 @@ static EventGroupHandle_t supervisor_event_group;
 static supervisor_platform_adapter_t *registered_adapters[CONFIG_SUPERVISOR_MAX_ADAPTERS];
 static uint8_t adapter_count = 0;
 
+// Adapters shut down at runtime, indexed like registered_adapters
+static bool adapter_disabled[CONFIG_SUPERVISOR_MAX_ADAPTERS];
+
 // OTA rollback validation
 static bool firmware_validated = false;
 
@@ -56,11 +59,29 @@ QueueHandle_t supervisor_get_queue(void) { return supervisor_queue; }
 EventGroupHandle_t supervisor_get_event_group(void) { return supervisor_event_group; }
 
 void supervisor_notify_event(EventBits_t bits) {
+    // Bump before the bits are delivered, so on_event handlers already see the new version
+    if (bits & (SUPERVISOR_EVENT_CMND_COMPLETED | SUPERVISOR_EVENT_ADAPTER_STATE_CHANGED)) {
+        tele_bump_version();
+    }
+
     if (supervisor_event_group) {
         xEventGroupSetBits(supervisor_event_group, bits);
     }
 }
 
+static int adapter_index(const supervisor_platform_adapter_t *adapter) {
+    for (int i = 0; i < adapter_count; i++) {
+        if (registered_adapters[i] == adapter)
+            return i;
+    }
+    return -1;
+}
+
+bool supervisor_adapter_is_enabled(const supervisor_platform_adapter_t *adapter) {
+    int i = adapter_index(adapter);
+    return i >= 0 && !adapter_disabled[i];
+}
+
 esp_err_t supervisor_adapter_init(supervisor_platform_adapter_t *adapter) {
 
     if (!adapter->init) {
@@ -78,6 +99,11 @@ esp_err_t supervisor_adapter_init(supervisor_platform_adapter_t *adapter) {
             cmnd_register_group(adapter->cmnd_group);
         }
 
+        int i = adapter_index(adapter);
+        if (i >= 0) {
+            adapter_disabled[i] = false;
+        }
+
         ESP_LOGI(TAG, "Adapter initialized: %s", adapter->name);
     } else if (ret == ESP_ERR_INVALID_STATE) {
         ESP_LOGW(TAG, "Adapter already started: %s", adapter->name);
@@ -102,6 +128,11 @@ esp_err_t supervisor_adapter_shutdown(supervisor_platform_adapter_t *adapter) {
             tele_unregister_group(adapter->tele_group);
         }
 
+        int i = adapter_index(adapter);
+        if (i >= 0) {
+            adapter_disabled[i] = true;
+        }
+
         ESP_LOGI(TAG, "Adapter shut down: %s", adapter->name);
     } else if (ret == ESP_ERR_INVALID_STATE) {
         ESP_LOGW(TAG, "Adapter already shut down: %s", adapter->name);
@@ -457,13 +488,19 @@ static void supervisor_adapter_control_handler(const char *args_json_str) {
             continue;
 
         // Found adapter - execute state change
+        esp_err_t ret = ESP_ERR_INVALID_ARG;
         if (state == STATE_ON && registered_adapters[i]->init) {
 
-            supervisor_adapter_init(registered_adapters[i]);
+            ret = supervisor_adapter_init(registered_adapters[i]);
 
         } else if (state == STATE_OFF && registered_adapters[i]->shutdown) {
 
-            supervisor_adapter_shutdown(registered_adapters[i]);
+            ret = supervisor_adapter_shutdown(registered_adapters[i]);
+        }
+
+        // Lets other adapters follow (e.g. inet updates Home Assistant entities)
+        if (ret == ESP_OK) {
+            supervisor_notify_event(SUPERVISOR_EVENT_ADAPTER_STATE_CHANGED);
         }
 
         cJSON_Delete(json);
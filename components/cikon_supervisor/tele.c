@@ -1,3 +1,4 @@
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <string.h>
 
@@ -10,6 +11,7 @@
 static tele_t tele_registry[CONFIG_SUPERVISOR_MAX_TELE];
 static size_t tele_count = 0;
 static bool tele_initialized = false;
+static atomic_uint_fast32_t tele_version = 0;
 
 void tele_init(void) {
     if (tele_initialized) {
@@ -156,3 +158,11 @@ void tele_append_one(cJSON *json_root, const char *tele_id) {
         t->fn(t->tele_id, json_root);
     }
 }
+
+uint32_t tele_get_version(void) {
+    return (uint32_t)atomic_load(&tele_version);
+}
+
+void tele_bump_version(void) {
+    atomic_fetch_add(&tele_version, 1);
+}
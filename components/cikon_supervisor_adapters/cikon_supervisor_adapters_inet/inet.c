@@ -343,6 +343,9 @@ static const command_entry_t inet_commands[] = {
     {"http", "Control HTTP server (on/off)", inet_common_http_handler},
     {"sntp", "Control SNTP service (on/off)", inet_common_sntp_handler},
     {"ota", "Control OTA service (on/off)", inet_common_ota_handler},
+#if CONFIG_OTA_PULL
+    {"ota_pull", "Check the update manifest and install it", inet_common_ota_pull_handler},
+#endif
     {"monitor", "Control TCP monitor (on/off)", inet_common_monitor_handler},
 #ifdef CONFIG_MQTT_ENABLE_HA_DISCOVERY
     {"ha", "Trigger Home Assistant MQTT discovery", inet_common_ha_discovery_handler},
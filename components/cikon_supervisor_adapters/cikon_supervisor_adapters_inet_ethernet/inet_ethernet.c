@@ -210,6 +210,9 @@ static void tele_inet_ethernet_link(const char *tele_id, cJSON *json_root) {
 static const command_entry_t inet_ethernet_commands[] = {
     {"sntp", "Control SNTP service (on/off)", inet_common_sntp_handler},
     {"ota", "Control OTA service (on/off)", inet_common_ota_handler},
+#if CONFIG_OTA_PULL
+    {"ota_pull", "Check the update manifest and install it", inet_common_ota_pull_handler},
+#endif
     {"monitor", "Control TCP monitor (on/off)", inet_common_monitor_handler},
     {"http", "Control HTTP server (on/off)", inet_common_http_handler},
 #ifdef CONFIG_MQTT_ENABLE_HA_DISCOVERY
@@ -225,6 +225,9 @@ static esp_err_t thread_device_adapter_shutdown(void) {
 
 static const command_entry_t s_thread_device_cmnd[] = {
     {"ota", "Control OTA service (on/off)", inet_common_ota_handler},
+#if CONFIG_OTA_PULL
+    {"ota_pull", "Check the update manifest and install it", inet_common_ota_pull_handler},
+#endif
     {"monitor", "Control TCP monitor (on/off)", inet_common_monitor_handler},
 #ifdef CONFIG_MQTT_ENABLE_HA_DISCOVERY
     {"ha", "Trigger HA MQTT discovery", inet_common_ha_discovery_handler},
@@ -1,6 +1,7 @@
 #ifndef TCP_MONITOR_H
 #define TCP_MONITOR_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -12,6 +13,10 @@ void tcp_monitor_configure(uint16_t port);
 void tcp_monitor_init(void);
 void tcp_monitor_shutdown(void);
 
+// Log bytes lost to the client (ring buffer full) while one was connected, since boot
+uint32_t tcp_monitor_dropped_bytes(void);
+bool tcp_monitor_client_connected(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,12 +1,13 @@
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
-#include <sys/socket.h>
-#include <unistd.h>
 
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h" // IWYU pragma: keep
 #include "freertos/ringbuf.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
+#include "lwip/sockets.h"
 
 #include "sdkconfig.h"
 #include "task_helpers.h"
@@ -22,6 +23,40 @@ static volatile TaskHandle_t monitor_task_handle = NULL;
 static volatile bool shutdown_requested = false;
 
 static vprintf_like_t original_vprintf = NULL;
+static atomic_uint dropped_bytes = 0; // Not yet reported to the client
+static atomic_uint dropped_total = 0; // While a client was connected, for telemetry
+static atomic_bool client_connected = false;
+
+#define COLOR_MAX 7 // "\033[0;32m"
+#define COLOR_RESET "\033[0m"
+#define TRUNC_MAX 16 // " [+65535 B]\n"
+#define FORMAT_WAIT_MS 10
+
+// One entry is formatted at a time into this buffer, not on the stack of every task that logs
+static SemaphoreHandle_t format_lock = NULL;
+static char format_buffer[COLOR_MAX + CONFIG_MAX_LOG_SIZE + sizeof(COLOR_RESET)];
+
+static const char *line_color(const char *line) {
+    // Detect log level by first character for fast lookup
+    if (line[0] == '\0' || line[1] != ' ' || line[2] != '(')
+        return COLOR_RESET; // Default: white
+    switch (line[0]) {
+    case 'I':
+        return "\033[0;32m"; // Green
+    case 'W':
+        return "\033[0;33m"; // Yellow
+    case 'E':
+        return "\033[0;31m"; // Red
+    default:
+        return COLOR_RESET;
+    }
+}
+
+static void count_dropped(size_t size) {
+    atomic_fetch_add(&dropped_bytes, size);
+    if (atomic_load(&client_connected))
+        atomic_fetch_add(&dropped_total, size);
+}
 
 // Called on every ESP_LOG*() even without clients. Ring buffer overhead is minimal.
 static int tcp_monitor_vprintf(const char *fmt, va_list args) {
@@ -33,18 +68,67 @@ static int tcp_monitor_vprintf(const char *fmt, va_list args) {
         va_end(args_copy);
     }
 
-    // Format for ring buffer
-    char buffer[CONFIG_MAX_LOG_SIZE];
-    int len = vsnprintf(buffer, sizeof(buffer), fmt, args);
-    if (len > 0 && ring_buffer != NULL) {
-        if (len >= sizeof(buffer))
-            len = sizeof(buffer) - 1;
-        xRingbufferSend(ring_buffer, buffer, len, 0);
+    // Formatting is short, so waiting tasks rarely block; a stalled one costs a line, not the log
+    if (xSemaphoreTake(format_lock, pdMS_TO_TICKS(FORMAT_WAIT_MS)) != pdTRUE) {
+        int len = vsnprintf(NULL, 0, fmt, args);
+        count_dropped(len > 0 ? len : 0);
+        return len;
+    }
+
+    // Colored line as it goes out to the client, so the sender can pass ring bytes on untouched.
+    // The color is right-aligned in front of the text once the level is known.
+    char *text = format_buffer + COLOR_MAX;
+    int len = vsnprintf(text, CONFIG_MAX_LOG_SIZE, fmt, args);
+    if (len <= 0 || ring_buffer == NULL) {
+        xSemaphoreGive(format_lock);
+        return len;
+    }
+
+    int kept = len;
+    if (len >= CONFIG_MAX_LOG_SIZE) {
+        kept = CONFIG_MAX_LOG_SIZE - TRUNC_MAX;
+        int marker = snprintf(text + kept, TRUNC_MAX, " [+%d B]\n", len - kept);
+        kept += marker < TRUNC_MAX ? marker : TRUNC_MAX - 1;
     }
 
+    const char *color = line_color(text);
+    size_t color_len = strlen(color);
+    char *start = text - color_len;
+    memcpy(start, color, color_len);
+    memcpy(text + kept, COLOR_RESET, sizeof(COLOR_RESET) - 1);
+
+    // Byte buffer sends are all or nothing, so a full ring drops whole lines
+    size_t size = color_len + kept + sizeof(COLOR_RESET) - 1;
+    if (xRingbufferSend(ring_buffer, start, size, 0) != pdTRUE)
+        count_dropped(size);
+
+    xSemaphoreGive(format_lock);
     return len;
 }
 
+static bool send_all(int sock, const char *data, size_t size) {
+    while (size > 0) {
+        int sent = send(sock, data, size, 0);
+        if (sent <= 0)
+            return false;
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+// Drops since the last call go out as a line of their own, straight to the socket
+static bool report_dropped(int sock) {
+    unsigned dropped = atomic_exchange(&dropped_bytes, 0);
+    if (dropped == 0)
+        return true;
+
+    char notice[64];
+    int len = snprintf(notice, sizeof(notice),
+                       "\033[0;33m--- %u B of log dropped ---\n" COLOR_RESET, dropped);
+    return send_all(sock, notice, len);
+}
+
 static void tcp_monitor_task(void *args) {
 
     struct sockaddr_in6 server_addr = {};
@@ -94,39 +178,31 @@ static void tcp_monitor_task(void *args) {
         inet_ntop(client_addr.ss_family, sin_addr, addr_str, sizeof(addr_str));
         ESP_LOGI(TAG, "Client connected: %s", addr_str);
 
+        // Whatever was dropped while nobody listened is not news to this client
+        atomic_store(&dropped_bytes, 0);
+        atomic_store(&client_connected, true);
         while (!shutdown_requested) {
+            // As much as is queued (up to the wrap point) per send()
             size_t size;
-            char *data = (char *)xRingbufferReceive(ring_buffer, &size, pdMS_TO_TICKS(100));
-
-            if (data != NULL) {
-                // Detect log level by first character for fast lookup
-                const char *color = "\033[0m"; // Default: white
-                if (data[1] == ' ' && data[2] == '(') {
-                    switch (data[0]) {
-                    case 'I':
-                        color = "\033[0;32m";
-                        break; // Green
-                    case 'W':
-                        color = "\033[0;33m";
-                        break; // Yellow
-                    case 'E':
-                        color = "\033[0;31m";
-                        break; // Red
-                    }
-                }
-
-                // Format with color codes in single buffer
-                char output[CONFIG_MAX_LOG_SIZE + 16]; // +16 for ANSI codes (max 11 bytes)
-                int len = snprintf(output, sizeof(output), "%s%.*s\033[0m", color, (int)size, data);
-
-                vRingbufferReturnItem(ring_buffer, data);
-
-                if (send(client_sock, output, len, 0) <= 0) {
+            char *data = (char *)xRingbufferReceiveUpTo(ring_buffer, &size, pdMS_TO_TICKS(100),
+                                                        CONFIG_RING_BUFFER_SIZE);
+            if (data == NULL) {
+                if (!report_dropped(client_sock))
                     break; // Disconnected
-                }
+                continue;
             }
+
+            // A chunk can end mid-line at the wrap point, the notice has to wait for the rest
+            bool line_end = size >= sizeof(COLOR_RESET) - 1 &&
+                            !memcmp(data + size - (sizeof(COLOR_RESET) - 1), COLOR_RESET,
+                                    sizeof(COLOR_RESET) - 1);
+            bool ok = send_all(client_sock, data, size);
+            vRingbufferReturnItem(ring_buffer, data);
+            if (!ok || (line_end && !report_dropped(client_sock)))
+                break; // Disconnected
         }
 
+        atomic_store(&client_connected, false);
         ESP_LOGW(TAG, "Client disconnected: %s", addr_str);
         if (client_sock >= 0) {
             shutdown(client_sock, SHUT_RDWR);
@@ -148,6 +224,10 @@ static void tcp_monitor_task(void *args) {
 
 void tcp_monitor_configure(uint16_t port) { tcp_monitor_port = port; }
 
+uint32_t tcp_monitor_dropped_bytes(void) { return atomic_load(&dropped_total); }
+
+bool tcp_monitor_client_connected(void) { return atomic_load(&client_connected); }
+
 void tcp_monitor_init(void) {
 
     if (monitor_task_handle != NULL) {
@@ -155,7 +235,11 @@ void tcp_monitor_init(void) {
         return;
     }
 
-    ring_buffer = xRingbufferCreate(CONFIG_RING_BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT);
+    // Kept across shutdowns: a task may still be inside tcp_monitor_vprintf()
+    if (format_lock == NULL)
+        format_lock = xSemaphoreCreateMutex();
+    ring_buffer = format_lock ? xRingbufferCreate(CONFIG_RING_BUFFER_SIZE, RINGBUF_TYPE_BYTEBUF)
+                              : NULL;
     if (ring_buffer == NULL) {
         ESP_LOGE(TAG, "Failed to create ring buffer");
         return;
@@ -189,8 +273,11 @@ void tcp_monitor_shutdown(void) {
         ESP_LOGW(TAG, "TCP Monitor task did not finish in time");
     }
 
+    // Not while a line is being queued
     if (ring_buffer != NULL) {
+        xSemaphoreTake(format_lock, portMAX_DELAY);
         vRingbufferDelete(ring_buffer);
         ring_buffer = NULL;
+        xSemaphoreGive(format_lock);
     }
 }
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "esp_err.h"
+#include "ota_writer.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Streaming applier for delta patches made by ota_delta.py against the running firmware.
+ *
+ * Patch stream (little endian, zlib-compressed as a whole on the wire, so it is fed from
+ * ota_inflate):
+ *   header  : magic "CDP1", u32 source size, u32 target size, u8 source sha256[32]
+ *   records : u32 diff_len, u32 extra_len, i32 seek, diff_len bytes, extra_len bytes
+ * Each record outputs diff_len bytes of (source byte + diff byte) starting at the current source
+ * position, then extra_len literal bytes, then moves the source position by diff_len + seek.
+ * The source is read back from the running partition with esp_partition_read() and must hash to
+ * the header's sha256 (checked before anything is written); memory use is a fixed 1 KB scratch
+ * buffer regardless of image size. */
+
+typedef struct ota_delta ota_delta_t;
+
+ota_delta_t *ota_delta_new(ota_sink_t sink, void *sink_ctx);
+// Same signature as ota_sink_t, so ota_inflate can feed it directly
+esp_err_t ota_delta_sink(void *ctx, const uint8_t *data, size_t len);
+// ESP_ERR_INVALID_SIZE if the patch ended early
+esp_err_t ota_delta_finish(ota_delta_t *d);
+void ota_delta_free(ota_delta_t *d);
+
+#ifdef __cplusplus
+}
+#endif
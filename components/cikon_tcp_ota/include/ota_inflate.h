@@ -0,0 +1,27 @@
+#pragma once
+
+#include "esp_err.h"
+#include "ota_writer.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Streaming zlib (RFC 1950) decompression for compressed OTA payloads (ota_pack.py) and delta
+ * patches. Uses the ROM inflater with a 32 KB window (heap, ~43 KB in total, only during an
+ * update). Feed compressed bytes as they arrive; inflated data goes to sink, normally
+ * ota_writer_sink. */
+
+typedef struct ota_inflate ota_inflate_t;
+
+ota_inflate_t *ota_inflate_new(ota_sink_t sink, void *sink_ctx);
+esp_err_t ota_inflate_feed(ota_inflate_t *z, const uint8_t *data, size_t len);
+// ESP_ERR_INVALID_SIZE if the stream is truncated. Logs ratio and inflate throughput.
+esp_err_t ota_inflate_finish(ota_inflate_t *z);
+void ota_inflate_free(ota_inflate_t *z);
+
+#ifdef __cplusplus
+}
+#endif
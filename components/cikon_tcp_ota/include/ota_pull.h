@@ -0,0 +1,35 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Pull updates (CONFIG_OTA_PULL): fetch a JSON manifest, e.g. made by ota_manifest.py,
+ *   {"version": "1.4.0", "url": "firmware.bin", "size": 1234567, "sha256": "<hex>",
+ *    "rollout": 25, "min_version": "1.2.0"}
+ * and, when the manifest version is newer than the running one, the running one is at least
+ * min_version and this device falls inside the rollout percentage, stream the image through
+ * ota_writer (SHA-256 checked, same validation and rollback as a pushed update) and restart.
+ * URLs must be https:// unless CONFIG_OTA_PULL_ALLOW_HTTP; redirects are followed, and url may
+ * be relative to the (final) manifest URL. rollout (default 100) is compared against a bucket
+ * 0..99 from SHA-256("<device id>:<version>"), so raising it only adds devices. */
+
+#define OTA_PULL_URL_MAX 256
+
+// Runs one check in a background task. url NULL or "" uses CONFIG_OTA_PULL_URL; force skips the
+// version and rollout checks. ESP_ERR_INVALID_ARG without a usable URL, ESP_ERR_INVALID_STATE
+// while a check or another update is running.
+esp_err_t ota_pull_start(const char *url, bool force);
+
+// Call every 10 minutes; starts a check every CONFIG_OTA_PULL_INTERVAL_MIN
+void ota_pull_on_interval(void);
+
+// "idle", "checking", "downloading", "up_to_date", "too_old", "not_in_rollout", "failed"
+const char *ota_pull_state(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_ota_ops.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_HASH_MAX_SIZE 32
+
+typedef enum {
+    OTA_HASH_SHA256, // 32 bytes
+    OTA_HASH_MD5,    // 16 bytes, legacy TCP protocol
+} ota_hash_t;
+
+typedef struct {
+    uint32_t bytes;
+    uint32_t ms;   // ota_writer_begin() to the end of ota_writer_finish()
+    uint32_t kbps; // KB/s over ms
+    esp_err_t result;
+} ota_stats_t;
+
+/* Transport-independent OTA session shared by the TCP and HTTP uploaders. The receiving task
+ * fills buffers from a small pool (CONFIG_OTA_PIPELINE_BUFFERS x CONFIG_OTA_PIPELINE_BUF_SIZE)
+ * while a writer task hashes them and writes them to the next update partition, erasing sector
+ * by sector as it goes, so the socket keeps draining while flash erases and programs.
+ * One session at a time; every begin that returned ESP_OK must be followed by
+ * ota_writer_finish() or ota_writer_abort(), from the same task. */
+
+// image_size may be 0 if unknown. ESP_ERR_INVALID_STATE if another session is running.
+esp_err_t ota_writer_begin(size_t image_size, ota_hash_t hash);
+
+/* Zero-copy: take a free pool buffer (blocks while all are queued for writing; NULL once a write
+ * failed), fill up to *size bytes and hand it back with commit (len 0 just returns it). */
+uint8_t *ota_writer_acquire(size_t *size);
+esp_err_t ota_writer_commit(uint8_t *buf, size_t len);
+
+// Copying variant for producers with their own buffers; packs data into full pool buffers
+esp_err_t ota_writer_write(const void *data, size_t len);
+
+// Output of a streaming stage (ota_inflate, ota_delta); ota_writer_sink ends the chain
+typedef esp_err_t (*ota_sink_t)(void *ctx, const uint8_t *data, size_t len);
+esp_err_t ota_writer_sink(void *ctx, const uint8_t *data, size_t len);
+
+/* Waits for the writer, checks the digest against expected (skipped if NULL), validates the image
+ * (esp_ota_end(): image hash and, with signed apps enabled, the signature) and makes it the boot
+ * partition. The session ends either way; the caller restarts on ESP_OK.
+ * ESP_ERR_INVALID_CRC: digest mismatch, ESP_ERR_OTA_VALIDATE_FAILED: not a valid (signed) image. */
+esp_err_t ota_writer_finish(const uint8_t *expected, size_t expected_len);
+void ota_writer_abort(void);
+
+bool ota_writer_busy(void);
+size_t ota_writer_written(void);
+
+// Last finished session, kept across the restart that follows a successful update
+bool ota_writer_last_stats(ota_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,211 @@
+#include "ota_delta.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "psa/crypto.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG "cikon:ota"
+#define DELTA_MAGIC "CDP1"
+#define HEADER_SIZE 44 // magic, source size, target size, source sha256
+#define RECORD_SIZE 12 // diff_len, extra_len, seek
+#define SCRATCH_SIZE 1024
+
+typedef enum {
+    DELTA_HEADER,
+    DELTA_RECORD,
+    DELTA_DIFF,
+    DELTA_EXTRA,
+    DELTA_DONE,
+} delta_state_t;
+
+struct ota_delta {
+    ota_sink_t sink;
+    void *sink_ctx;
+    const esp_partition_t *source;
+    delta_state_t state;
+    uint8_t hdr[HEADER_SIZE]; // Header or record being assembled
+    size_t hdr_len;
+    uint32_t source_size;
+    uint32_t target_size;
+    uint32_t written;
+    uint32_t source_pos;
+    uint32_t diff_left;
+    uint32_t extra_left;
+    int32_t seek;
+    uint8_t scratch[SCRATCH_SIZE];
+};
+
+static uint32_t get_u32(const uint8_t *p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Hashes the first source_size bytes of the running partition
+static esp_err_t check_source(ota_delta_t *d, const uint8_t expected[32]) {
+    if (d->source_size > d->source->size) {
+        ESP_LOGE(TAG, "Delta source (%" PRIu32 " B) larger than running partition",
+                 d->source_size);
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    psa_crypto_init();
+    psa_hash_operation_t sha = PSA_HASH_OPERATION_INIT;
+    if (psa_hash_setup(&sha, PSA_ALG_SHA_256) != PSA_SUCCESS)
+        return ESP_FAIL;
+
+    for (uint32_t pos = 0; pos < d->source_size; pos += SCRATCH_SIZE) {
+        size_t n = d->source_size - pos < SCRATCH_SIZE ? d->source_size - pos : SCRATCH_SIZE;
+        if (esp_partition_read(d->source, pos, d->scratch, n) != ESP_OK) {
+            psa_hash_abort(&sha);
+            return ESP_FAIL;
+        }
+        psa_hash_update(&sha, d->scratch, n);
+    }
+
+    uint8_t digest[32];
+    size_t digest_len;
+    if (psa_hash_finish(&sha, digest, sizeof(digest), &digest_len) != PSA_SUCCESS)
+        return ESP_FAIL;
+    if (memcmp(digest, expected, sizeof(digest))) {
+        ESP_LOGE(TAG, "Delta patch was made for a different firmware");
+        return ESP_ERR_INVALID_VERSION;
+    }
+    ESP_LOGI(TAG, "Delta: %" PRIu32 " B source verified, building %" PRIu32 " B image",
+             d->source_size, d->target_size);
+    return ESP_OK;
+}
+
+static esp_err_t parse_header(ota_delta_t *d) {
+    if (memcmp(d->hdr, DELTA_MAGIC, 4)) {
+        ESP_LOGE(TAG, "Not a delta patch");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    d->source_size = get_u32(d->hdr + 4);
+    d->target_size = get_u32(d->hdr + 8);
+    return check_source(d, d->hdr + 12);
+}
+
+static esp_err_t parse_record(ota_delta_t *d) {
+    d->diff_left = get_u32(d->hdr);
+    d->extra_left = get_u32(d->hdr + 4);
+    d->seek = (int32_t)get_u32(d->hdr + 8);
+
+    if ((uint64_t)d->source_pos + d->diff_left > d->source_size ||
+        (uint64_t)d->written + d->diff_left + d->extra_left > d->target_size) {
+        ESP_LOGE(TAG, "Corrupt delta record at %" PRIu32 " B", d->written);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ESP_OK;
+}
+
+// Adds diff bytes to the source bytes at the current position
+static esp_err_t apply_diff(ota_delta_t *d, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        size_t n = len < SCRATCH_SIZE ? len : SCRATCH_SIZE;
+        esp_err_t err = esp_partition_read(d->source, d->source_pos, d->scratch, n);
+        if (err != ESP_OK)
+            return err;
+        for (size_t i = 0; i < n; i++) {
+            d->scratch[i] += data[i];
+        }
+        err = d->sink(d->sink_ctx, d->scratch, n);
+        if (err != ESP_OK)
+            return err;
+
+        d->source_pos += n;
+        d->written += n;
+        d->diff_left -= n;
+        data += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+// Moves to the next part of the current record, or past the record once both parts are done
+static void next_state(ota_delta_t *d) {
+    if (d->diff_left) {
+        d->state = DELTA_DIFF;
+    } else if (d->extra_left) {
+        d->state = DELTA_EXTRA;
+    } else {
+        d->source_pos += d->seek;
+        d->state = d->written == d->target_size ? DELTA_DONE : DELTA_RECORD;
+    }
+}
+
+ota_delta_t *ota_delta_new(ota_sink_t sink, void *sink_ctx) {
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    ota_delta_t *d = running ? calloc(1, sizeof(*d)) : NULL;
+    if (!d) {
+        ESP_LOGE(TAG, "Cannot start delta update");
+        return NULL;
+    }
+    d->sink = sink;
+    d->sink_ctx = sink_ctx;
+    d->source = running;
+    d->state = DELTA_HEADER;
+    return d;
+}
+
+esp_err_t ota_delta_sink(void *ctx, const uint8_t *data, size_t len) {
+    ota_delta_t *d = ctx;
+    esp_err_t err = ESP_OK;
+
+    while (len > 0 && err == ESP_OK) {
+        size_t n;
+        switch (d->state) {
+        case DELTA_HEADER:
+        case DELTA_RECORD: {
+            size_t want = d->state == DELTA_HEADER ? HEADER_SIZE : RECORD_SIZE;
+            n = want - d->hdr_len < len ? want - d->hdr_len : len;
+            memcpy(d->hdr + d->hdr_len, data, n);
+            d->hdr_len += n;
+            if (d->hdr_len < want)
+                break;
+
+            d->hdr_len = 0;
+            if (d->state == DELTA_HEADER) {
+                err = parse_header(d);
+                d->state = d->target_size ? DELTA_RECORD : DELTA_DONE;
+            } else {
+                err = parse_record(d);
+                next_state(d);
+            }
+            break;
+        }
+        case DELTA_DIFF:
+            n = d->diff_left < len ? d->diff_left : len;
+            err = apply_diff(d, data, n);
+            if (err == ESP_OK && !d->diff_left)
+                next_state(d);
+            break;
+        case DELTA_EXTRA:
+            n = d->extra_left < len ? d->extra_left : len;
+            err = d->sink(d->sink_ctx, data, n);
+            d->written += n;
+            d->extra_left -= n;
+            if (err == ESP_OK && !d->extra_left)
+                next_state(d);
+            break;
+        default:
+            ESP_LOGE(TAG, "Data after the end of the delta patch");
+            return ESP_ERR_INVALID_SIZE;
+        }
+        data += n;
+        len -= n;
+    }
+    return err;
+}
+
+esp_err_t ota_delta_finish(ota_delta_t *d) {
+    if (d->state != DELTA_DONE) {
+        ESP_LOGE(TAG, "Delta patch truncated at %" PRIu32 "/%" PRIu32 " B", d->written,
+                 d->target_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+void ota_delta_free(ota_delta_t *d) { free(d); }
@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+"""Make / apply delta OTA patches against the firmware running on the device (CONFIG_OTA_DELTA).
+
+    ota_delta.py make  old.bin new.bin patch.cdp
+    ota_delta.py apply old.bin patch.cdp out.bin
+
+Patch stream, zlib-compressed as a whole (little endian):
+
+    header  : magic "CDP1", u32 source size, u32 target size, u8 source sha256[32]
+    records : u32 diff_len, u32 extra_len, i32 seek, diff_len bytes, extra_len bytes
+
+A record outputs diff_len bytes of (old byte + diff byte) mod 256 from the current source
+position, then extra_len literal bytes, then moves the source position by diff_len + seek
+(bsdiff's control tuples, streamed in order so the device needs no random access to the patch).
+Regions are matched on 32-byte blocks and extended across small differences, so code that only
+moved keeps mostly-zero diff bytes, which zlib then compresses away. "make" applies the patch
+again and compares the result before writing it.
+Keep in sync with ota_delta.c.
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+import zlib
+
+MAGIC = b"CDP1"
+HEADER = struct.Struct("<4sII32s")
+RECORD = struct.Struct("<IIi")
+BLOCK = 32       # Match seed length
+STEP = 4         # Old image indexed every STEP bytes
+MAX_CANDIDATES = 8
+GIVE_UP = 64     # Stop extending after this many bytes without improvement
+FAST = 64        # Exact comparison stride while extending
+
+
+def index_old(old):
+    idx = {}
+    for i in range(0, len(old) - BLOCK + 1, STEP):
+        lst = idx.setdefault(old[i:i + BLOCK], [])
+        if len(lst) < MAX_CANDIDATES:
+            lst.append(i)
+    return idx
+
+
+def extend(old, new, o, p):
+    """bsdiff-style forward extension: longest length where matches outweigh mismatches."""
+    i = score = best_score = best = 0
+    limit = min(len(old) - o, len(new) - p)
+    while i < limit and i - best <= GIVE_UP:
+        if i + FAST <= limit and old[o + i:o + i + FAST] == new[p + i:p + i + FAST]:
+            i += FAST
+            score += FAST
+        else:
+            score += old[o + i] == new[p + i]
+            i += 1
+        if score * 2 - i > best_score * 2 - best:
+            best_score, best = score, i
+    return best
+
+
+def make(old, new):
+    idx = index_old(old)
+    records = []
+    start = 0        # New offset where the open record's diff starts
+    old_pos = 0      # Its source offset
+    diff_len = 0
+    p = 0
+    while p < len(new):
+        candidates = idx.get(new[p:p + BLOCK], ())
+        # Continuing the current displacement is usually the best guess
+        same = old_pos + (p - start)
+        best_len, best_o = 0, 0
+        for o in ((same,) if same < len(old) else ()) + tuple(candidates):
+            n = extend(old, new, o, p)
+            if n > best_len:
+                best_len, best_o = n, o
+        if best_len < BLOCK:
+            p += 1
+            continue
+        extra = p - (start + diff_len)
+        records.append((diff_len, extra, best_o - (old_pos + diff_len), start, old_pos))
+        start, old_pos, diff_len = p, best_o, best_len
+        p += best_len
+    records.append((diff_len, len(new) - (start + diff_len), 0, start, old_pos))
+
+    out = bytearray(HEADER.pack(MAGIC, len(old), len(new), hashlib.sha256(old).digest()))
+    for diff_len, extra, seek, at, src in records:
+        out += RECORD.pack(diff_len, extra, seek)
+        out += bytes((new[at + i] - old[src + i]) & 0xFF for i in range(diff_len))
+        out += new[at + diff_len:at + diff_len + extra]
+    return zlib.compress(bytes(out), 9), len(records)
+
+
+def apply(old, patch):
+    data = zlib.decompress(patch)
+    magic, src_size, dst_size, sha = HEADER.unpack_from(data)
+    if magic != MAGIC:
+        sys.exit("ota_delta: not a delta patch")
+    if src_size != len(old) or hashlib.sha256(old).digest() != sha:
+        sys.exit("ota_delta: patch was made for a different source image")
+    pos, src, out = HEADER.size, 0, bytearray()
+    while len(out) < dst_size:
+        diff_len, extra, seek = RECORD.unpack_from(data, pos)
+        pos += RECORD.size
+        out += bytes((old[src + i] + data[pos + i]) & 0xFF for i in range(diff_len))
+        pos += diff_len
+        out += data[pos:pos + extra]
+        pos += extra
+        src += diff_len + seek
+    if len(out) != dst_size or pos != len(data):
+        sys.exit("ota_delta: corrupt patch")
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="cmd", required=True)
+    m = sub.add_parser("make", help="diff two app images")
+    m.add_argument("old")
+    m.add_argument("new")
+    m.add_argument("patch")
+    a = sub.add_parser("apply", help="rebuild the new image (what the device does)")
+    a.add_argument("old")
+    a.add_argument("patch")
+    a.add_argument("out")
+    args = parser.parse_args()
+
+    with open(args.old, "rb") as f:
+        old = f.read()
+    if args.cmd == "make":
+        with open(args.new, "rb") as f:
+            new = f.read()
+        patch, count = make(old, new)
+        if apply(old, patch) != new:
+            sys.exit("ota_delta: round trip mismatch")
+        with open(args.patch, "wb") as f:
+            f.write(patch)
+        full = len(zlib.compress(new, 9))
+        print(f"ota_delta: {len(new)} B image, {full} B compressed, patch {len(patch)} B "
+              f"({100 * len(patch) // max(full, 1)}% of compressed), {count} records")
+        print(f"  md5    {hashlib.md5(new).hexdigest()}")
+        print(f"  sha256 {hashlib.sha256(new).hexdigest()}")
+    else:
+        with open(args.patch, "rb") as f:
+            out = apply(old, f.read())
+        with open(args.out, "wb") as f:
+            f.write(out)
+        print(f"ota_delta: {len(out)} B -> {args.out}")
+
+
+if __name__ == "__main__":
+    main()
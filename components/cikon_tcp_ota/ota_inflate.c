@@ -0,0 +1,92 @@
+#include "ota_inflate.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "rom/miniz.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define TAG "cikon:ota"
+#define DICT_SIZE TINFL_LZ_DICT_SIZE // Circular output window, covers any zlib window (<= 32 KB)
+
+struct ota_inflate {
+    tinfl_decompressor tinfl;
+    ota_sink_t sink;
+    void *sink_ctx;
+    size_t out_pos; // Next write position in dict
+    bool done;
+    size_t in_total;
+    size_t out_total;
+    int64_t busy_us; // Time spent inflating, excluding the receive side
+    uint8_t dict[DICT_SIZE];
+};
+
+ota_inflate_t *ota_inflate_new(ota_sink_t sink, void *sink_ctx) {
+    ota_inflate_t *z = malloc(sizeof(*z));
+    if (!z) {
+        ESP_LOGE(TAG, "No memory for inflate (%zu B)", sizeof(*z));
+        return NULL;
+    }
+    tinfl_init(&z->tinfl);
+    z->sink = sink;
+    z->sink_ctx = sink_ctx;
+    z->out_pos = 0;
+    z->done = false;
+    z->in_total = z->out_total = 0;
+    z->busy_us = 0;
+    return z;
+}
+
+esp_err_t ota_inflate_feed(ota_inflate_t *z, const uint8_t *data, size_t len) {
+    if (z->done)
+        return len ? ESP_ERR_INVALID_SIZE : ESP_OK; // Trailing bytes after the stream
+
+    z->in_total += len;
+    tinfl_status status;
+    do {
+        size_t in_bytes = len;
+        size_t out_bytes = DICT_SIZE - z->out_pos;
+        int64_t start = esp_timer_get_time();
+        status = tinfl_decompress(&z->tinfl, data, &in_bytes, z->dict, z->dict + z->out_pos,
+                                  &out_bytes,
+                                  TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+        z->busy_us += esp_timer_get_time() - start;
+        data += in_bytes;
+        len -= in_bytes;
+
+        if (out_bytes) {
+            esp_err_t err = z->sink(z->sink_ctx, z->dict + z->out_pos, out_bytes);
+            if (err != ESP_OK)
+                return err;
+            z->out_pos = (z->out_pos + out_bytes) & (DICT_SIZE - 1);
+            z->out_total += out_bytes;
+        }
+
+        if (status < TINFL_STATUS_DONE) {
+            ESP_LOGE(TAG, "Corrupt compressed image (%d) at %zu B", status, z->in_total - len);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (status == TINFL_STATUS_DONE) {
+            z->done = true;
+            return len ? ESP_ERR_INVALID_SIZE : ESP_OK;
+        }
+    } while (len > 0 || status == TINFL_STATUS_HAS_MORE_OUTPUT);
+
+    return ESP_OK;
+}
+
+esp_err_t ota_inflate_finish(ota_inflate_t *z) {
+    if (!z->done) {
+        ESP_LOGE(TAG, "Compressed image truncated after %zu B", z->in_total);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint32_t ms = (uint32_t)(z->busy_us / 1000);
+    ESP_LOGI(TAG, "Inflated %zu B -> %zu B (%" PRIu32 "%%) in %" PRIu32 " ms (%" PRIu32 " KB/s)",
+             z->in_total, z->out_total,
+             z->out_total ? (uint32_t)(100ULL * z->in_total / z->out_total) : 0, ms,
+             ms ? (uint32_t)(z->out_total / ms) : 0);
+    return ESP_OK;
+}
+
+void ota_inflate_free(ota_inflate_t *z) { free(z); }
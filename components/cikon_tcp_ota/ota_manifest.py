@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Write / serve the update manifest read by pull OTA (CONFIG_OTA_PULL, see ota_pull.h).
+
+    ota_manifest.py make build/firmware.bin out/manifest.json --rollout 10
+    ota_manifest.py bucket 1.4.0 A1B2C3D4E5F6 ...
+    ota_manifest.py serve out --port 8000
+
+make copies the image next to the manifest and writes
+    {"version", "url", "size", "sha256", "rollout", "min_version"}
+with url relative to the manifest; version defaults to the one embedded in the app image
+(esp_app_desc_t). bucket prints which bucket (0..99) each device id falls into for a release:
+a device updates when its bucket is below rollout. serve is a plain HTTP server for trying it
+on a local network (devices need CONFIG_OTA_PULL_ALLOW_HTTP for http:// URLs).
+Keep in sync with ota_pull.c.
+"""
+
+import argparse
+import functools
+import hashlib
+import http.server
+import json
+import os
+import shutil
+import struct
+import sys
+
+APP_DESC_OFFSET = 32  # Image header (24 B) + first segment header (8 B)
+APP_DESC_MAGIC = 0xABCD5432
+
+
+def image_version(image):
+    magic, _, _, _, version = struct.unpack_from("<IIII32s", image, APP_DESC_OFFSET)
+    if magic != APP_DESC_MAGIC:
+        return None
+    return version.rstrip(b"\0").decode(errors="replace")
+
+
+def bucket(device_id, version):
+    digest = hashlib.sha256(f"{device_id}:{version}".encode()).digest()
+    return int.from_bytes(digest[:4], "big") % 100
+
+
+def make(args):
+    with open(args.image, "rb") as f:
+        image = f.read()
+    version = args.version or image_version(image)
+    if not version:
+        sys.exit("ota_manifest: no app description in the image, pass --version")
+    if not 0 <= args.rollout <= 100:
+        sys.exit("ota_manifest: rollout is a percentage (0..100)")
+
+    out_dir = os.path.dirname(os.path.abspath(args.manifest))
+    name = os.path.basename(args.image)
+    if os.path.abspath(args.image) != os.path.join(out_dir, name):
+        shutil.copyfile(args.image, os.path.join(out_dir, name))
+
+    manifest = {
+        "version": version,
+        "url": args.url or name,
+        "size": len(image),
+        "sha256": hashlib.sha256(image).hexdigest(),
+        "rollout": args.rollout,
+    }
+    if args.min_version:
+        manifest["min_version"] = args.min_version
+    with open(args.manifest, "w") as f:
+        json.dump(manifest, f, indent=2)
+        f.write("\n")
+    print(f"ota_manifest: {version}, {len(image)} B, rollout {args.rollout}% -> {args.manifest}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="cmd", required=True)
+    m = sub.add_parser("make", help="write a manifest for an app image")
+    m.add_argument("image")
+    m.add_argument("manifest")
+    m.add_argument("--version", help="default: the version embedded in the image")
+    m.add_argument("--url", help="image URL, default: the image name next to the manifest")
+    m.add_argument("--rollout", type=int, default=100, help="percentage of devices (default 100)")
+    m.add_argument("--min-version", help="devices running older firmware skip this release")
+    b = sub.add_parser("bucket", help="rollout bucket of devices for a version")
+    b.add_argument("version")
+    b.add_argument("ids", nargs="+", help="device ids (tele 'id', MAC without separators)")
+    s = sub.add_parser("serve", help="serve a directory over HTTP")
+    s.add_argument("dir")
+    s.add_argument("--port", type=int, default=8000)
+    args = parser.parse_args()
+
+    if args.cmd == "make":
+        make(args)
+    elif args.cmd == "bucket":
+        for device_id in args.ids:
+            print(f"{device_id} {bucket(device_id, args.version)}")
+    else:
+        handler = functools.partial(http.server.SimpleHTTPRequestHandler, directory=args.dir)
+        print(f"ota_manifest: serving {args.dir} on port {args.port}")
+        http.server.ThreadingHTTPServer(("", args.port), handler).serve_forever()
+
+
+if __name__ == "__main__":
+    main()
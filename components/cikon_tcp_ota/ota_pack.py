@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""Compress an app image for OTA (CONFIG_OTA_COMPRESSED).
+
+Writes a zlib stream (RFC 1950) that ota_inflate.c inflates on the device while the image is
+being flashed. The window is at most 32 KB (wbits 15), which the device's inflate window always
+covers; a smaller --wbits only lowers the ratio, the device allocates the same.
+The MD5 / SHA-256 sent with the upload are those of the uncompressed image, printed here.
+
+The result is inflated again in 1 KB pieces (like the device receives it) and compared with
+the input before it is written.
+"""
+
+import argparse
+import hashlib
+import os
+import sys
+import time
+import zlib
+
+CHUNK = 1024
+
+
+def inflate_streaming(data):
+    d = zlib.decompressobj()
+    out = bytearray()
+    for i in range(0, len(data), CHUNK):
+        out += d.decompress(data[i:i + CHUNK])
+    out += d.flush()
+    if not d.eof or d.unused_data:
+        raise ValueError("truncated or trailing data")
+    return bytes(out)
+
+
+def pack(src, out, wbits):
+    with open(src, "rb") as f:
+        image = f.read()
+
+    c = zlib.compressobj(9, zlib.DEFLATED, wbits, 9)
+    packed = c.compress(image) + c.flush()
+
+    start = time.perf_counter()
+    if inflate_streaming(packed) != image:
+        sys.exit("ota_pack: round trip mismatch")
+    secs = time.perf_counter() - start
+
+    with open(out, "wb") as f:
+        f.write(packed)
+
+    print(f"ota_pack: {os.path.basename(src)} {len(image)} B -> {len(packed)} B "
+          f"({100 * len(packed) // max(len(image), 1)}%), host inflate "
+          f"{len(image) / 1024 / max(secs, 1e-9):.0f} KB/s -> {out}")
+    print(f"  md5    {hashlib.md5(image).hexdigest()}")
+    print(f"  sha256 {hashlib.sha256(image).hexdigest()}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("image")
+    parser.add_argument("out")
+    parser.add_argument("--wbits", type=int, default=15, choices=range(9, 16))
+    args = parser.parse_args()
+    pack(args.image, args.out, args.wbits)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,364 @@
+#include "ota_pull.h"
+#include "freertos/FreeRTOS.h" // IWYU pragma: keep
+#include "freertos/task.h"
+
+#include "cJSON.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "psa/crypto.h"
+#if CONFIG_OTA_PULL_CERT_BUNDLE
+#include "esp_crt_bundle.h"
+#endif
+
+#include "certs.h"
+#include "ota_writer.h"
+#include "platform_services.h"
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG "cikon:ota:pull"
+#define MANIFEST_MAX 1024
+#define VERSION_MAX 32
+#define VERSION_PARTS 4
+#define SHA256_SIZE 32
+#define HTTP_TIMEOUT_MS 10000
+#define MAX_REDIRECTS 5
+#define RESTART_DELAY_MS 500
+
+typedef struct {
+    char version[VERSION_MAX];
+    char min_version[VERSION_MAX];
+    char url[OTA_PULL_URL_MAX];
+    uint32_t size;
+    uint8_t sha[SHA256_SIZE];
+    uint32_t rollout;
+} manifest_t;
+
+static volatile bool s_running = false;
+static char s_url[OTA_PULL_URL_MAX];
+static bool s_force;
+static const char *volatile s_state = "idle";
+
+// "v1.2.3", "1.2.3-4-gabcdef": numeric parts up to the first character that is not a digit or dot
+static int version_cmp(const char *a, const char *b) {
+    a += *a == 'v';
+    b += *b == 'v';
+    for (int i = 0; i < VERSION_PARTS; i++) {
+        char *end;
+        unsigned long x = isdigit((unsigned char)*a) ? strtoul(a, &end, 10) : 0;
+        a = isdigit((unsigned char)*a) && *end == '.' ? end + 1 : "";
+        unsigned long y = isdigit((unsigned char)*b) ? strtoul(b, &end, 10) : 0;
+        b = isdigit((unsigned char)*b) && *end == '.' ? end + 1 : "";
+        if (x != y)
+            return x < y ? -1 : 1;
+    }
+    return 0;
+}
+
+// Stable for a device and release, so raising the rollout percentage only adds devices
+static uint32_t rollout_bucket(const char *version) {
+    char key[VERSION_MAX + 16];
+    snprintf(key, sizeof(key), "%s:%s", get_device_info()->id, version);
+
+    uint8_t digest[SHA256_SIZE];
+    size_t len;
+    psa_crypto_init();
+    if (psa_hash_compute(PSA_ALG_SHA_256, (const uint8_t *)key, strlen(key), digest,
+                         sizeof(digest), &len) != PSA_SUCCESS)
+        return 0;
+    uint32_t head = (uint32_t)digest[0] << 24 | (uint32_t)digest[1] << 16 |
+                    (uint32_t)digest[2] << 8 | digest[3];
+    return head % 100;
+}
+
+// Absolute URLs are kept; "/path" is taken from the manifest's host, anything else from its dir
+static bool resolve_url(const char *base, const char *ref, char *out, size_t size) {
+    if (strstr(ref, "://"))
+        return (size_t)snprintf(out, size, "%s", ref) < size;
+
+    const char *host = strstr(base, "://");
+    if (!host)
+        return false;
+    const char *path = strchr(host + 3, '/');
+    if (!path)
+        path = base + strlen(base);
+
+    const char *slash = ref[0] == '/' ? NULL : strrchr(path, '/');
+    int prefix = slash ? slash + 1 - base : path - base;
+    const char *sep = ref[0] == '/' || slash ? "" : "/";
+    return (size_t)snprintf(out, size, "%.*s%s%s", prefix, base, sep, ref) < size;
+}
+
+static bool parse_sha256(const char *hex, uint8_t out[SHA256_SIZE]) {
+    if (!hex || strlen(hex) != SHA256_SIZE * 2)
+        return false;
+    for (int i = 0; i < SHA256_SIZE; i++) {
+        char byte[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+        if (!isxdigit((unsigned char)byte[0]) || !isxdigit((unsigned char)byte[1]))
+            return false;
+        out[i] = (uint8_t)strtoul(byte, NULL, 16);
+    }
+    return true;
+}
+
+static bool copy_string(const cJSON *json, const char *key, char *out, size_t size) {
+    const char *s = cJSON_GetStringValue(cJSON_GetObjectItem(json, key));
+    return s && (size_t)snprintf(out, size, "%s", s) < size;
+}
+
+static esp_err_t parse_manifest(const char *text, const char *manifest_url, manifest_t *m) {
+    cJSON *json = cJSON_Parse(text);
+    if (!json)
+        return ESP_ERR_INVALID_RESPONSE;
+
+    char url[OTA_PULL_URL_MAX];
+    const cJSON *size = cJSON_GetObjectItem(json, "size");
+    const cJSON *rollout = cJSON_GetObjectItem(json, "rollout");
+    bool ok = copy_string(json, "version", m->version, sizeof(m->version)) &&
+              copy_string(json, "url", url, sizeof(url)) &&
+              resolve_url(manifest_url, url, m->url, sizeof(m->url)) && cJSON_IsNumber(size) &&
+              size->valuedouble > 0 &&
+              parse_sha256(cJSON_GetStringValue(cJSON_GetObjectItem(json, "sha256")), m->sha);
+    m->size = ok ? (uint32_t)size->valuedouble : 0;
+    m->rollout = cJSON_IsNumber(rollout) ? (uint32_t)rollout->valuedouble : 100;
+    if (!copy_string(json, "min_version", m->min_version, sizeof(m->min_version)))
+        m->min_version[0] = '\0';
+    cJSON_Delete(json);
+
+    if (!ok) {
+        ESP_LOGE(TAG, "Manifest needs version, url, size and sha256");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ESP_OK;
+}
+
+// The manifest's SHA-256 is only as trustworthy as the server it came from: plain http:// is
+// refused (also as a redirect target) unless OTA_PULL_ALLOW_HTTP is set
+static bool url_allowed(const char *url) {
+    if (!strncmp(url, "https://", 8))
+        return true;
+#if CONFIG_OTA_PULL_ALLOW_HTTP
+    if (!strncmp(url, "http://", 7))
+        return true;
+#endif
+    ESP_LOGE(TAG, "Refusing %s: https:// required", url);
+    return false;
+}
+
+// esp_http_client follows Location only in perform(), not for open() / fetch_headers()
+static bool is_redirect(int status) {
+    return (status >= 301 && status <= 303) || status == 307 || status == 308;
+}
+
+/* Opened GET with a 200 response, or NULL. *length is -1 if the server did not send one.
+ * Redirects are followed; final_url (OTA_PULL_URL_MAX) receives the URL that answered. */
+static esp_http_client_handle_t http_get(const char *url, int64_t *length, char *final_url) {
+    snprintf(final_url, OTA_PULL_URL_MAX, "%s", url);
+    if (!url_allowed(url))
+        return NULL;
+
+    // Also set for http://, a redirect may lead to https://
+    esp_http_client_config_t cfg = {.url = url, .timeout_ms = HTTP_TIMEOUT_MS};
+#if CONFIG_OTA_PULL_CERT_BUNDLE
+    cfg.crt_bundle_attach = esp_crt_bundle_attach;
+#else
+    cfg.cert_pem = certs_available() ? get_ca_pem_start() : NULL;
+#endif
+
+    esp_http_client_handle_t client = esp_http_client_init(&cfg);
+    if (!client)
+        return NULL;
+
+    esp_err_t err = ESP_OK;
+    int status = 0;
+    for (int hops = 0; err == ESP_OK; hops++) {
+        err = esp_http_client_open(client, 0);
+        if (err != ESP_OK)
+            break;
+        *length = esp_http_client_fetch_headers(client);
+        status = esp_http_client_get_status_code(client);
+        if (!is_redirect(status))
+            break;
+        if (hops == MAX_REDIRECTS) {
+            err = ESP_ERR_INVALID_RESPONSE;
+            break;
+        }
+        esp_http_client_flush_response(client, NULL);
+        err = esp_http_client_set_redirection(client);
+        if (err == ESP_OK)
+            err = esp_http_client_get_url(client, final_url, OTA_PULL_URL_MAX);
+        if (err == ESP_OK && !url_allowed(final_url))
+            err = ESP_ERR_NOT_ALLOWED;
+        if (err == ESP_OK)
+            ESP_LOGI(TAG, "HTTP %d, following to %s", status, final_url);
+    }
+
+    if (err == ESP_OK && status == 200)
+        return client;
+    if (err == ESP_OK)
+        ESP_LOGE(TAG, "GET %s: HTTP %d", final_url, status);
+    else
+        ESP_LOGE(TAG, "GET %s: %s", final_url, esp_err_to_name(err));
+    esp_http_client_cleanup(client);
+    return NULL;
+}
+
+// A relative image url is taken from where the manifest was found, after redirects
+static esp_err_t fetch_manifest(const char *url, manifest_t *m) {
+    int64_t length;
+    char final_url[OTA_PULL_URL_MAX];
+    esp_http_client_handle_t client = http_get(url, &length, final_url);
+    if (!client)
+        return ESP_FAIL;
+
+    char *text = malloc(MANIFEST_MAX + 1);
+    size_t len = 0;
+    int got = 1;
+    while (text && len < MANIFEST_MAX &&
+           (got = esp_http_client_read(client, text + len, MANIFEST_MAX - len)) > 0)
+        len += got;
+    esp_http_client_cleanup(client);
+
+    esp_err_t err = !text ? ESP_ERR_NO_MEM : got < 0 ? ESP_FAIL : ESP_OK;
+    if (err == ESP_OK && len == MANIFEST_MAX)
+        err = ESP_ERR_INVALID_SIZE;
+    if (err == ESP_OK) {
+        text[len] = '\0';
+        err = parse_manifest(text, final_url, m);
+    }
+    free(text);
+    return err;
+}
+
+// Straight into pipeline buffers, like the HTTP upload path
+static esp_err_t download(const manifest_t *m) {
+    int64_t length;
+    char final_url[OTA_PULL_URL_MAX];
+    esp_http_client_handle_t client = http_get(m->url, &length, final_url);
+    if (!client)
+        return ESP_FAIL;
+    if (length >= 0 && length != m->size) {
+        ESP_LOGE(TAG, "Image is %" PRId64 " B, manifest says %" PRIu32 " B", length, m->size);
+        esp_http_client_cleanup(client);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    esp_err_t err = ota_writer_begin(m->size, OTA_HASH_SHA256);
+    if (err != ESP_OK) {
+        esp_http_client_cleanup(client);
+        return err;
+    }
+
+    size_t rem = m->size;
+    while (err == ESP_OK && rem > 0) {
+        size_t size;
+        uint8_t *buf = ota_writer_acquire(&size);
+        if (!buf) {
+            err = ESP_FAIL; // Flash write failed
+            break;
+        }
+
+        size_t want = size < rem ? size : rem;
+        size_t len = 0;
+        int got;
+        while (len < want &&
+               (got = esp_http_client_read(client, (char *)buf + len, want - len)) > 0)
+            len += got;
+        err = ota_writer_commit(buf, len);
+        if (err == ESP_OK && len < want)
+            err = ESP_ERR_INVALID_SIZE; // Connection closed early
+        rem -= len;
+    }
+    esp_http_client_cleanup(client);
+
+    if (err != ESP_OK) {
+        ota_writer_abort();
+        return err;
+    }
+    return ota_writer_finish(m->sha, SHA256_SIZE);
+}
+
+static const char *pull(const char *url, bool force) {
+    manifest_t m;
+    if (fetch_manifest(url, &m) != ESP_OK)
+        return "failed";
+
+    const char *running = get_device_info()->app_version;
+    if (!force && version_cmp(m.version, running) <= 0) {
+        ESP_LOGI(TAG, "Up to date (%s, manifest %s)", running, m.version);
+        return "up_to_date";
+    }
+    if (m.min_version[0] && version_cmp(running, m.min_version) < 0) {
+        ESP_LOGW(TAG, "%s needs at least %s, running %s", m.version, m.min_version, running);
+        return "too_old";
+    }
+    uint32_t bucket = rollout_bucket(m.version);
+    if (!force && bucket >= m.rollout) {
+        ESP_LOGI(TAG, "%s not rolled out here yet (bucket %" PRIu32 ", rollout %" PRIu32 "%%)",
+                 m.version, bucket, m.rollout);
+        return "not_in_rollout";
+    }
+
+    ESP_LOGI(TAG, "Updating %s -> %s (%" PRIu32 " B, bucket %" PRIu32 ") from %s", running,
+             m.version, m.size, bucket, m.url);
+    s_state = "downloading";
+    esp_err_t err = download(&m);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Update failed: %s", esp_err_to_name(err));
+        return "failed";
+    }
+
+    ESP_LOGI(TAG, "Update installed, restarting");
+    vTaskDelay(pdMS_TO_TICKS(RESTART_DELAY_MS));
+    esp_safe_restart();
+    return "idle";
+}
+
+static void pull_task(void *args) {
+    s_state = pull(s_url, s_force);
+    s_running = false;
+    vTaskDelete(NULL);
+}
+
+esp_err_t ota_pull_start(const char *url, bool force) {
+    if (!url || !url[0])
+        url = CONFIG_OTA_PULL_URL;
+    if (!url[0]) {
+        ESP_LOGW(TAG, "No manifest URL configured");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!url_allowed(url))
+        return ESP_ERR_INVALID_ARG;
+    if (s_running || ota_writer_busy()) {
+        ESP_LOGW(TAG, "Update check or OTA already running");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    snprintf(s_url, sizeof(s_url), "%s", url);
+    s_force = force;
+    s_state = "checking";
+    s_running = true;
+    if (xTaskCreate(pull_task, "ota_pull", CONFIG_OTA_PULL_TASK_STACK_SIZE, NULL,
+                    CONFIG_TCP_OTA_TASK_PRIORITY, NULL) != pdPASS) {
+        s_running = false;
+        s_state = "failed";
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void ota_pull_on_interval(void) {
+    static uint32_t minutes = 0;
+    if (!CONFIG_OTA_PULL_INTERVAL_MIN || !CONFIG_OTA_PULL_URL[0])
+        return;
+
+    minutes += 10;
+    if (minutes < CONFIG_OTA_PULL_INTERVAL_MIN)
+        return;
+    minutes = 0;
+    ota_pull_start(NULL, false);
+}
+
+const char *ota_pull_state(void) { return s_state; }
@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+"""Upload firmware with the framed, resumable TCP OTA protocol (v2, see tcp_ota_v2.h).
+
+    ota_upload.py <device> build/firmware.bin [--zlib | --delta running.bin]
+
+After the magic / ACK handshake every message is a frame (big endian):
+
+    u8 type, u16 payload length, payload, u32 CRC-32 of type, length and payload
+
+    HELLO  0x01  TLVs (u8 tag, u8 len, value): 1 image size u32, 2 SHA-256, 3 version, 4 encoding
+    DATA   0x02  u32 sequence number, up to <block> bytes of the stream
+    END    0x03  -
+    READY  0x81  TLVs: 5 stream offset u32, 6 next sequence number u32, 7 block size u16
+    RESULT 0x82  i32 esp_err_t, message
+
+The stream is the image itself, its zlib stream (encoding 1) or a zlib-compressed delta patch
+from ota_delta.py (encoding 2); size and SHA-256 always describe the image. When the connection
+drops or a frame is rejected, the uploader reconnects, sends the same HELLO and continues from
+the offset in READY. --drop-at / --corrupt-at inject one fault each to exercise that path.
+Keep in sync with tcp_ota_v2.c.
+"""
+
+import argparse
+import hashlib
+import os
+import socket
+import struct
+import sys
+import time
+import zlib
+
+MAGIC = bytes([0xAF, 0xCA, 0xEC, 0x2D, 0xFE, 0x56])
+ACK = bytes([0xAA, 0x55])
+HELLO, DATA, END, READY, RESULT = 0x01, 0x02, 0x03, 0x81, 0x82
+TLV_SIZE, TLV_SHA256, TLV_VERSION, TLV_ENCODING = 1, 2, 3, 4
+TLV_OFFSET, TLV_SEQ, TLV_BLOCK = 5, 6, 7
+ENCODING = {"plain": 0, "zlib": 1, "delta": 2}
+ESP_ERR_INVALID_CRC = 0x109
+TIMEOUT = 30  # Covers the flash erase stalls and the final image validation
+
+
+class Retry(Exception):
+    """Transport problem: reconnect and resume."""
+
+
+def frame(kind, payload=b""):
+    head = struct.pack(">BH", kind, len(payload))
+    return head + payload + struct.pack(">I", zlib.crc32(head + payload))
+
+
+def recv_exact(sock, n):
+    data = b""
+    while len(data) < n:
+        chunk = sock.recv(n - len(data))
+        if not chunk:
+            raise Retry("connection closed")
+        data += chunk
+    return data
+
+
+def recv_frame(sock):
+    head = recv_exact(sock, 3)
+    kind, length = struct.unpack(">BH", head)
+    payload = recv_exact(sock, length)
+    (crc,) = struct.unpack(">I", recv_exact(sock, 4))
+    if crc != zlib.crc32(head + payload):
+        raise Retry("bad frame from device")
+    return kind, payload
+
+
+def tlvs(payload):
+    out, i = {}, 0
+    while i + 2 <= len(payload):
+        tag, n = payload[i], payload[i + 1]
+        out[tag] = payload[i + 2:i + 2 + n]
+        i += 2 + n
+    return out
+
+
+def result(payload):
+    (err,) = struct.unpack(">i", payload[:4])
+    return err, payload[4:].decode(errors="replace")
+
+
+class Faults:
+    def __init__(self, drop_at, corrupt_at):
+        self.drop_at, self.corrupt_at = drop_at, corrupt_at
+
+    def apply(self, sock, offset, data, packet):
+        """Returns the frame to send; drops the connection or corrupts a block once each."""
+        end = offset + len(data)
+        if self.drop_at is not None and offset <= self.drop_at < end:
+            self.drop_at = None
+            sock.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, struct.pack("ii", 1, 0))
+            sock.close()
+            raise Retry(f"injected disconnect at {offset}")
+        if self.corrupt_at is not None and offset <= self.corrupt_at < end:
+            i = 3 + 4 + self.corrupt_at - offset
+            self.corrupt_at = None
+            packet = packet[:i] + bytes([packet[i] ^ 0x01]) + packet[i + 1:]
+            print(f"injected corruption at {offset}")
+        return packet
+
+
+def session(args, hello, stream, faults):
+    with socket.create_connection((args.device, args.port), timeout=TIMEOUT) as sock:
+        sock.sendall(MAGIC)
+        if recv_exact(sock, 2) != ACK:
+            sys.exit("ota_upload: device does not speak OTA v2")
+        sock.sendall(frame(HELLO, hello))
+
+        kind, payload = recv_frame(sock)
+        if kind == RESULT:
+            sys.exit("ota_upload: rejected: %d %s" % result(payload))
+        if kind != READY:
+            raise Retry(f"unexpected frame 0x{kind:02x}")
+        ready = tlvs(payload)
+        (offset,) = struct.unpack(">I", ready[TLV_OFFSET])
+        (seq,) = struct.unpack(">I", ready[TLV_SEQ])
+        (block,) = struct.unpack(">H", ready[TLV_BLOCK])
+        print(f"{'resuming at' if offset else 'starting,'} {offset}/{len(stream)} B")
+
+        start = time.monotonic()
+        sent = offset
+        while offset < len(stream):
+            data = stream[offset:offset + block]
+            packet = faults.apply(sock, offset, data, frame(DATA, struct.pack(">I", seq) + data))
+            try:
+                sock.sendall(packet)
+            except OSError as e:
+                raise Retry(e)
+            offset += len(data)
+            seq += 1
+        sock.sendall(frame(END))
+
+        print(f"sent {offset - sent} B in {time.monotonic() - start:.1f} s, waiting for the device")
+        kind, payload = recv_frame(sock)
+        if kind != RESULT:
+            raise Retry(f"unexpected frame 0x{kind:02x}")
+        err, msg = result(payload)
+        if err == ESP_ERR_INVALID_CRC:
+            raise Retry(msg)
+        if err:
+            sys.exit(f"ota_upload: failed: {err} {msg}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("device")
+    parser.add_argument("image")
+    parser.add_argument("--port", type=int, default=5555)
+    parser.add_argument("--version", help="informational, e.g. 9.5")
+    encoding = parser.add_mutually_exclusive_group()
+    encoding.add_argument("--zlib", action="store_true", help="send the image zlib-compressed")
+    encoding.add_argument("--delta", metavar="RUNNING", help="send a patch against this image")
+    parser.add_argument("--retries", type=int, default=5)
+    parser.add_argument("--drop-at", type=int, help="close the connection at this stream offset")
+    parser.add_argument("--corrupt-at", type=int, help="corrupt the block with this stream offset")
+    args = parser.parse_args()
+
+    with open(args.image, "rb") as f:
+        image = f.read()
+    if args.delta:
+        sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+        import ota_delta
+        with open(args.delta, "rb") as f:
+            stream, _ = ota_delta.make(f.read(), image)
+        kind = "delta"
+    elif args.zlib:
+        stream, kind = zlib.compress(image, 9), "zlib"
+    else:
+        stream, kind = image, "plain"
+
+    hello = struct.pack(">BBI", TLV_SIZE, 4, len(image))
+    hello += struct.pack(">BB", TLV_SHA256, 32) + hashlib.sha256(image).digest()
+    hello += struct.pack(">BBB", TLV_ENCODING, 1, ENCODING[kind])
+    if args.version:
+        major, minor = (int(x) for x in args.version.split("."))
+        hello += struct.pack(">BBBB", TLV_VERSION, 2, major, minor)
+    print(f"ota_upload: {len(image)} B image, {kind} stream {len(stream)} B")
+
+    faults = Faults(args.drop_at, args.corrupt_at)
+    for attempt in range(args.retries + 1):
+        try:
+            session(args, hello, stream, faults)
+            print("ota_upload: done, device is restarting")
+            return
+        except (Retry, OSError) as e:
+            print(f"ota_upload: {e} (attempt {attempt + 1}/{args.retries + 1})")
+            time.sleep(1)
+    sys.exit("ota_upload: giving up")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,320 @@
+#include "ota_writer.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h" // IWYU pragma: keep
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "psa/crypto.h"
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG "cikon:ota"
+#define STATS_MAGIC 0x4f544153 // "OTAS"
+
+typedef struct {
+    uint8_t *buf; // NULL = end of stream, writer task exits
+    size_t len;
+} ota_chunk_t;
+
+static atomic_bool s_busy = false;
+static esp_ota_handle_t s_handle = 0;
+static const esp_partition_t *s_partition = NULL;
+static psa_hash_operation_t s_hash = PSA_HASH_OPERATION_INIT;
+static ota_hash_t s_hash_alg = OTA_HASH_SHA256;
+static size_t s_size = 0;
+static volatile size_t s_written = 0;
+static volatile esp_err_t s_error = ESP_OK; // First write error, set by the writer task
+static int s_last_percent = -1;
+static TickType_t s_started = 0;
+
+static uint8_t *s_pool = NULL;
+static QueueHandle_t s_free = NULL; // uint8_t *, buffers the producer may fill
+static QueueHandle_t s_full = NULL; // ota_chunk_t, buffers waiting for flash
+static SemaphoreHandle_t s_done = NULL;
+static uint8_t *s_cur = NULL; // Partially filled buffer of ota_writer_write()
+static size_t s_cur_len = 0;
+
+// Survives esp_restart() (not a power cycle), so telemetry can report the update that just ran
+static RTC_NOINIT_ATTR struct {
+    uint32_t magic;
+    ota_stats_t stats;
+} s_last;
+
+static void writer_task(void *args) {
+    ota_chunk_t chunk;
+
+    for (;;) {
+        xQueueReceive(s_full, &chunk, portMAX_DELAY);
+        if (!chunk.buf)
+            break;
+
+        // After a failure keep recycling buffers so the producer never blocks
+        if (s_error == ESP_OK) {
+            esp_err_t err = esp_ota_write(s_handle, chunk.buf, chunk.len);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write OTA data chunk (%zu bytes): %s", chunk.len,
+                         esp_err_to_name(err));
+                s_error = err;
+            } else {
+                psa_hash_update(&s_hash, chunk.buf, chunk.len);
+                s_written += chunk.len;
+            }
+        }
+        xQueueSend(s_free, &chunk.buf, portMAX_DELAY);
+
+        if (s_size) {
+            int percent = (int)((100ULL * s_written) / s_size);
+            if (percent / 10 != s_last_percent / 10) {
+                ESP_LOGI(TAG, "Progress: %d%% (%zu/%zu bytes)", percent, s_written, s_size);
+                s_last_percent = percent;
+            }
+        }
+    }
+
+    xSemaphoreGive(s_done);
+    vTaskDelete(NULL);
+}
+
+static void pipeline_free(void) {
+    if (s_free)
+        vQueueDelete(s_free);
+    if (s_full)
+        vQueueDelete(s_full);
+    free(s_pool);
+    s_free = s_full = NULL;
+    s_pool = NULL;
+    s_cur = NULL;
+    s_cur_len = 0;
+}
+
+static esp_err_t pipeline_start(void) {
+    if (!s_done) {
+        static StaticSemaphore_t done_buf;
+        s_done = xSemaphoreCreateBinaryStatic(&done_buf);
+    }
+
+    s_pool = malloc(CONFIG_OTA_PIPELINE_BUFFERS * CONFIG_OTA_PIPELINE_BUF_SIZE);
+    s_free = xQueueCreate(CONFIG_OTA_PIPELINE_BUFFERS, sizeof(uint8_t *));
+    // One extra slot for the end-of-stream marker
+    s_full = xQueueCreate(CONFIG_OTA_PIPELINE_BUFFERS + 1, sizeof(ota_chunk_t));
+    if (!s_pool || !s_free || !s_full) {
+        ESP_LOGE(TAG, "No memory for %d x %d B OTA buffers", CONFIG_OTA_PIPELINE_BUFFERS,
+                 CONFIG_OTA_PIPELINE_BUF_SIZE);
+        pipeline_free();
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < CONFIG_OTA_PIPELINE_BUFFERS; i++) {
+        uint8_t *buf = s_pool + i * CONFIG_OTA_PIPELINE_BUF_SIZE;
+        xQueueSend(s_free, &buf, 0);
+    }
+
+    if (xTaskCreate(writer_task, "ota_writer", CONFIG_OTA_WRITER_TASK_STACK_SIZE, NULL,
+                    CONFIG_TCP_OTA_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create OTA writer task");
+        pipeline_free();
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+// Flushes the partial buffer, lets the writer drain the queue and exit
+static void pipeline_stop(void) {
+    if (s_cur)
+        ota_writer_commit(s_cur, s_cur_len);
+
+    ota_chunk_t end = {NULL, 0};
+    xQueueSend(s_full, &end, portMAX_DELAY);
+    xSemaphoreTake(s_done, portMAX_DELAY);
+    pipeline_free();
+}
+
+static void session_end(esp_err_t result) {
+    uint32_t ms = pdTICKS_TO_MS(xTaskGetTickCount() - s_started);
+    s_last.stats = (ota_stats_t){
+        .bytes = s_written,
+        .ms = ms,
+        .kbps = ms ? (uint32_t)(s_written / ms) : 0, // B/ms ~ KB/s
+        .result = result,
+    };
+    s_last.magic = STATS_MAGIC;
+    ESP_LOGI(TAG, "OTA %s: %zu B in %" PRIu32 " ms (%" PRIu32 " KB/s)",
+             result == ESP_OK ? "done" : "failed", s_written, ms, s_last.stats.kbps);
+    atomic_store(&s_busy, false);
+}
+
+esp_err_t ota_writer_begin(size_t image_size, ota_hash_t hash) {
+    if (atomic_exchange(&s_busy, true)) {
+        ESP_LOGW(TAG, "OTA already in progress");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_partition = esp_ota_get_next_update_partition(NULL);
+    if (!s_partition) {
+        ESP_LOGE(TAG, "No OTA update partition");
+        atomic_store(&s_busy, false);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (image_size > s_partition->size) {
+        ESP_LOGE(TAG, "Image (%zu B) larger than %s", image_size, s_partition->label);
+        atomic_store(&s_busy, false);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // Erase sector by sector in the writer task (overlapping the transfer) instead of the whole
+    // image upfront while the sender waits
+    esp_err_t err = esp_ota_begin(s_partition, OTA_WITH_SEQUENTIAL_WRITES, &s_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to begin OTA update: %s", esp_err_to_name(err));
+        atomic_store(&s_busy, false);
+        return err;
+    }
+
+    psa_crypto_init();
+    s_hash = (psa_hash_operation_t)PSA_HASH_OPERATION_INIT;
+    s_hash_alg = hash;
+    if (psa_hash_setup(&s_hash, hash == OTA_HASH_MD5 ? PSA_ALG_MD5 : PSA_ALG_SHA_256) !=
+        PSA_SUCCESS) {
+        ESP_LOGE(TAG, "Failed to setup hash");
+        esp_ota_abort(s_handle);
+        atomic_store(&s_busy, false);
+        return ESP_FAIL;
+    }
+
+    err = pipeline_start();
+    if (err != ESP_OK) {
+        psa_hash_abort(&s_hash);
+        esp_ota_abort(s_handle);
+        atomic_store(&s_busy, false);
+        return err;
+    }
+
+    s_size = image_size;
+    s_written = 0;
+    s_error = ESP_OK;
+    s_last_percent = -1;
+    s_started = xTaskGetTickCount();
+    ESP_LOGI(TAG, "Writing %zu B to %s", image_size, s_partition->label);
+    return ESP_OK;
+}
+
+uint8_t *ota_writer_acquire(size_t *size) {
+    if (s_cur) {
+        ota_writer_commit(s_cur, s_cur_len);
+        s_cur = NULL;
+    }
+    if (s_error != ESP_OK)
+        return NULL;
+
+    uint8_t *buf;
+    xQueueReceive(s_free, &buf, portMAX_DELAY);
+    *size = CONFIG_OTA_PIPELINE_BUF_SIZE;
+    return buf;
+}
+
+esp_err_t ota_writer_commit(uint8_t *buf, size_t len) {
+    if (len) {
+        ota_chunk_t chunk = {buf, len};
+        xQueueSend(s_full, &chunk, portMAX_DELAY);
+    } else {
+        xQueueSend(s_free, &buf, portMAX_DELAY);
+    }
+    return s_error;
+}
+
+esp_err_t ota_writer_write(const void *data, size_t len) {
+    const uint8_t *src = data;
+
+    while (len > 0) {
+        if (!s_cur) {
+            size_t size;
+            s_cur = ota_writer_acquire(&size);
+            s_cur_len = 0;
+            if (!s_cur)
+                return s_error;
+        }
+        size_t n = CONFIG_OTA_PIPELINE_BUF_SIZE - s_cur_len;
+        n = n < len ? n : len;
+        memcpy(s_cur + s_cur_len, src, n);
+        s_cur_len += n;
+        src += n;
+        len -= n;
+
+        if (s_cur_len == CONFIG_OTA_PIPELINE_BUF_SIZE) {
+            uint8_t *full = s_cur;
+            s_cur = NULL;
+            esp_err_t err = ota_writer_commit(full, CONFIG_OTA_PIPELINE_BUF_SIZE);
+            if (err != ESP_OK)
+                return err;
+        }
+    }
+    return s_error;
+}
+
+esp_err_t ota_writer_sink(void *ctx, const uint8_t *data, size_t len) {
+    return ota_writer_write(data, len);
+}
+
+esp_err_t ota_writer_finish(const uint8_t *expected, size_t expected_len) {
+    pipeline_stop();
+
+    esp_err_t err = s_error;
+    uint8_t digest[OTA_HASH_MAX_SIZE];
+    size_t digest_len = 0;
+    if (err == ESP_OK && (psa_hash_finish(&s_hash, digest, sizeof(digest), &digest_len) !=
+                          PSA_SUCCESS)) {
+        ESP_LOGE(TAG, "Failed to finalize hash");
+        err = ESP_FAIL;
+    }
+    if (err == ESP_OK && expected &&
+        (expected_len != digest_len || memcmp(digest, expected, digest_len))) {
+        ESP_LOGE(TAG, "%s mismatch!", s_hash_alg == OTA_HASH_MD5 ? "MD5" : "SHA-256");
+        err = ESP_ERR_INVALID_CRC;
+    }
+    if (err != ESP_OK) {
+        psa_hash_abort(&s_hash);
+        esp_ota_abort(s_handle);
+        session_end(err);
+        return err;
+    }
+
+    // Verifies the image (and its signature when signed apps are enabled)
+    err = esp_ota_end(s_handle);
+    if (err == ESP_OK)
+        err = esp_ota_set_boot_partition(s_partition);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Finalizing OTA update failed: %s", esp_err_to_name(err));
+        session_end(err);
+        return err;
+    }
+
+    // The new image boots pending verification; supervisor marks it valid or the bootloader
+    // rolls back
+    ESP_LOGI(TAG, "Boot partition set to %s", s_partition->label);
+    session_end(ESP_OK);
+    return ESP_OK;
+}
+
+void ota_writer_abort(void) {
+    if (!atomic_load(&s_busy))
+        return;
+
+    pipeline_stop();
+    psa_hash_abort(&s_hash);
+    esp_ota_abort(s_handle);
+    ESP_LOGW(TAG, "OTA aborted after %zu B", s_written);
+    session_end(ESP_ERR_INVALID_STATE);
+}
+
+bool ota_writer_busy(void) { return atomic_load(&s_busy); }
+
+size_t ota_writer_written(void) { return s_written; }
+
+bool ota_writer_last_stats(ota_stats_t *out) {
+    if (s_last.magic != STATS_MAGIC)
+        return false;
+    *out = s_last.stats;
+    return true;
+}
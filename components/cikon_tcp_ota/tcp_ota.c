@@ -3,11 +3,13 @@
 
 #include "esp_err.h"
 #include "esp_log.h"
-#include "esp_ota_ops.h"
-#include "esp_partition.h"
 
 #include "lwip/sockets.h"
-#include "psa/crypto.h"
+
+#include "ota_delta.h"
+#include "ota_inflate.h"
+#include "ota_writer.h"
+#include "tcp_ota_v2.h"
 
 #include "platform_services.h"
 #include <inttypes.h>
@@ -22,6 +24,13 @@
 
 #define RX_BUFFER_SIZE 1024
 #define MAGIC_BYTES 0xAF, 0xCA, 0xEC, 0x2D, 0xFE, 0x55
+// Same protocol, zlib-compressed payload (size and MD5 still describe the inflated image)
+#define MAGIC_BYTES_ZLIB 0xAF, 0xCA, 0xEC, 0x2D, 0xFE, 0x5A
+// Zlib-compressed delta patch against the running firmware (ota_delta.py); size and MD5 describe
+// the rebuilt image
+#define MAGIC_BYTES_DELTA 0xAF, 0xCA, 0xEC, 0x2D, 0xFE, 0x5D
+// Framed, resumable protocol (tcp_ota_v2.h)
+#define MAGIC_BYTES_V2 0xAF, 0xCA, 0xEC, 0x2D, 0xFE, 0x56
 #define ACK_CODE 0xAA, 0x55
 
 #define MD5_SIZE 16
@@ -74,6 +83,64 @@ int read_all(const int client_sock, uint8_t *rx_buffer) {
     return len <= 0 ? 0 : len;
 }
 
+// Receive straight into pipeline buffers; recv() blocks only while all of them are being written
+static void receive_plain(const int client_sock) {
+    int read_bytes = 1;
+    while (read_bytes > 0) {
+        size_t size;
+        uint8_t *buf = ota_writer_acquire(&size);
+        if (!buf)
+            break;
+
+        size_t len = 0;
+        while (len < size && (read_bytes = recv(client_sock, buf + len, size - len, 0)) > 0)
+            len += read_bytes;
+        if (read_bytes < 0)
+            ESP_LOGE(TAG, "Receiving data failed: errno %d", errno);
+
+        if (ota_writer_commit(buf, len) != ESP_OK)
+            break;
+    }
+}
+
+// Inflates in this task; the inflated image goes through the same pipeline and MD5 check. A delta
+// patch is applied against the running partition between the inflater and the pipeline.
+static bool receive_compressed(const int client_sock, uint8_t *rx_buffer, bool delta) {
+#if CONFIG_OTA_COMPRESSED
+#if CONFIG_OTA_DELTA
+    ota_delta_t *d = delta ? ota_delta_new(ota_writer_sink, NULL) : NULL;
+    if (delta && !d)
+        return false;
+    ota_inflate_t *z =
+        d ? ota_inflate_new(ota_delta_sink, d) : ota_inflate_new(ota_writer_sink, NULL);
+#else
+    ota_inflate_t *z = ota_inflate_new(ota_writer_sink, NULL);
+#endif
+    if (!z) {
+#if CONFIG_OTA_DELTA
+        ota_delta_free(d);
+#endif
+        return false;
+    }
+
+    int read_bytes;
+    esp_err_t err = ESP_OK;
+    while (err == ESP_OK && (read_bytes = read_all(client_sock, rx_buffer)) > 0)
+        err = ota_inflate_feed(z, rx_buffer, read_bytes);
+    if (err == ESP_OK)
+        err = ota_inflate_finish(z);
+    ota_inflate_free(z);
+#if CONFIG_OTA_DELTA
+    if (d && err == ESP_OK)
+        err = ota_delta_finish(d);
+    ota_delta_free(d);
+#endif
+    return err == ESP_OK;
+#else
+    return false;
+#endif
+}
+
 static void handle_ota(const int client_sock) {
     uint32_t firmware_size = 0;
     uint8_t sw_version[SW_VERSION_SIZE];
@@ -81,13 +148,30 @@ static void handle_ota(const int client_sock) {
 
     uint8_t rx_buffer[RX_BUFFER_SIZE];
     const uint8_t magic_bytes[] = {MAGIC_BYTES};
+    bool compressed = false;
+    bool delta = false;
 
     // Mark that update is in progress (cannot be interrupted)
     ota_update_in_progress = true;
 
     OTA_LOG_STEP(0); // Magic header
     if (read_all(client_sock, rx_buffer) == sizeof(magic_bytes)) {
-        if (memcmp(rx_buffer, magic_bytes, sizeof(magic_bytes))) {
+        if (!memcmp(rx_buffer, (const uint8_t[]){MAGIC_BYTES_V2}, sizeof(magic_bytes))) {
+            if (send_ack(client_sock))
+                tcp_ota_v2_handle(client_sock);
+            ota_update_in_progress = false;
+            return;
+        }
+        // A v1 upload replaces an interrupted v2 one
+        tcp_ota_v2_drop();
+#if CONFIG_OTA_COMPRESSED
+        compressed = !memcmp(rx_buffer, (const uint8_t[]){MAGIC_BYTES_ZLIB}, sizeof(magic_bytes));
+#endif
+#if CONFIG_OTA_DELTA
+        delta = !memcmp(rx_buffer, (const uint8_t[]){MAGIC_BYTES_DELTA}, sizeof(magic_bytes));
+        compressed |= delta;
+#endif
+        if (!compressed && memcmp(rx_buffer, magic_bytes, sizeof(magic_bytes))) {
             ESP_LOGE(TAG, "Invalid OTA magic header");
             ota_update_in_progress = false;
             return;
@@ -119,107 +203,57 @@ static void handle_ota(const int client_sock) {
 
     OTA_LOG_STEP(2);
 
-    esp_ota_handle_t ota_handle = 0;
-    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
-    vTaskDelay(1);
-
-    esp_err_t err = esp_ota_begin(update_partition, firmware_size, &ota_handle);
+    // MD5 is computed by the writer task while it writes
+    esp_err_t err = ota_writer_begin(firmware_size, OTA_HASH_MD5);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to begin OTA update: %s", esp_err_to_name(err));
-        return;
-    }
-    vTaskDelay(1);
-
-    // Initialize PSA Crypto (if not already initialized)
-    psa_crypto_init();
-    vTaskDelay(1);
-
-    // Initialize MD5 hash operation
-    psa_hash_operation_t hash_op = PSA_HASH_OPERATION_INIT;
-    psa_status_t status = psa_hash_setup(&hash_op, PSA_ALG_MD5);
-    if (status != PSA_SUCCESS) {
-        ESP_LOGE(TAG, "Failed to setup MD5 hash: %ld", (long)status);
-        esp_ota_end(ota_handle);
+        ota_update_in_progress = false;
         return;
     }
-    vTaskDelay(1);
 
     // Ready for image transmission
     OTA_LOG_STEP(3); // Write
 
-    uint32_t total_read_bytes = 0;
-    uint16_t read_bytes = -1;
-    uint8_t last_percent_reported = -1;
-    uint16_t chunk_count = 0;
-
-    while (read_bytes) {
-        read_bytes = read_all(client_sock, rx_buffer);
-        total_read_bytes += read_bytes;
-        chunk_count++;
-
-        int percent = (100 * total_read_bytes) / firmware_size;
-        if (percent / 10 != last_percent_reported / 10) {
-            ESP_LOGI(TAG, "Progress: %d%% (%" PRIu32 "/%" PRIu32 " bytes)", percent,
-                     total_read_bytes, firmware_size);
-            last_percent_reported = percent;
-        }
-
-        err = esp_ota_write(ota_handle, rx_buffer, read_bytes);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write OTA data chunk (%d bytes): %s", read_bytes,
-                     esp_err_to_name(err));
-            esp_ota_end(ota_handle);
-            psa_hash_abort(&hash_op);
+    if (compressed) {
+        if (!receive_compressed(client_sock, rx_buffer, delta)) {
+            ota_writer_abort();
+            ota_update_in_progress = false;
             return;
         }
-        psa_hash_update(&hash_op, rx_buffer, read_bytes);
-
-        // Yield to watchdog every 10 chunks (~10KB) instead of every chunk
-        if (chunk_count % 10 == 0) {
-            vTaskDelay(1);
-        }
-    }
-
-    RETURN_IF_FALSE(send_ack(client_sock));
-
-    OTA_LOG_STEP(4);
-
-    err = esp_ota_end(ota_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Finalizing OTA update failed: %s", esp_err_to_name(err));
-        return;
-    }
-
-    vTaskDelay(1);
-
-    uint8_t md5_calc[MD5_SIZE];
-    size_t hash_length;
-    status = psa_hash_finish(&hash_op, md5_calc, sizeof(md5_calc), &hash_length);
-    if (status != PSA_SUCCESS || hash_length != MD5_SIZE) {
-        ESP_LOGE(TAG, "Failed to finalize MD5: status=%ld, len=%zu", (long)status, hash_length);
-        return;
+    } else {
+        receive_plain(client_sock);
     }
-    vTaskDelay(1);
 
-    // Compare calculated MD5 with expected
-    if (memcmp(md5_calc, md5_expected, sizeof(md5_expected))) {
-        ESP_LOGE(TAG, "MD5 mismatch!");
-        return;
-    }
-
-    err = esp_ota_set_boot_partition(update_partition);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Setting new boot partition failed: %s", esp_err_to_name(err));
+    if (!send_ack(client_sock)) {
+        ota_writer_abort();
         ota_update_in_progress = false;
         return;
     }
 
+    OTA_LOG_STEP(4);
+
+    // Checked against the MD5 before the image is validated and activated
+    err = ota_writer_finish(md5_expected, sizeof(md5_expected));
     ota_update_in_progress = false;
+    if (err != ESP_OK)
+        return;
 
     OTA_LOG_STEP(5); // Reboot
     esp_safe_restart();
 }
 
+// False if nobody connected within the resume timeout; the parked session is dropped then
+static bool wait_for_resume(void) {
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(ota_listen_sock, &fds);
+    struct timeval timeout = {.tv_sec = CONFIG_TCP_OTA_RESUME_TIMEOUT};
+    if (select(ota_listen_sock + 1, &fds, NULL, NULL, &timeout) > 0 || ota_shutdown_requested)
+        return true;
+
+    tcp_ota_v2_drop();
+    return false;
+}
+
 void tcp_ota_task(void *args) {
 
     struct sockaddr_storage dest_addr;
@@ -258,6 +292,10 @@ void tcp_ota_task(void *args) {
     while (!ota_shutdown_requested) {
         ESP_LOGI(TAG, "Listening for connections, port: %d.", ota_listen_port);
 
+        // An interrupted v2 upload holds the OTA session until its client comes back
+        if (tcp_ota_v2_parked() && !wait_for_resume())
+            continue;
+
         struct sockaddr_storage source_addr;
         socklen_t addr_len = sizeof(source_addr);
         int client_sock = accept(ota_listen_sock, (struct sockaddr *)&source_addr, &addr_len);
@@ -289,6 +327,7 @@ void tcp_ota_task(void *args) {
         close(ota_listen_sock);
         ota_listen_sock = -1;
     }
+    tcp_ota_v2_drop();
 
     ota_shutdown_requested = false;
     ota_task_handle = NULL;
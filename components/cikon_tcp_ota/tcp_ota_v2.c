@@ -0,0 +1,346 @@
+#include "tcp_ota_v2.h"
+#include "freertos/FreeRTOS.h" // IWYU pragma: keep
+#include "freertos/task.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+#include "lwip/sockets.h"
+
+#include "ota_delta.h"
+#include "ota_inflate.h"
+#include "ota_writer.h"
+
+#include "platform_services.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG "cikon:ota"
+
+#define BLOCK_SIZE 4096
+#define FRAME_HDR_SIZE 3 // type, payload length
+#define FRAME_CRC_SIZE 4
+#define FRAME_MAX_PAYLOAD (4 + BLOCK_SIZE) // DATA: sequence number + block
+#define SHA256_SIZE 32
+#define RECV_TIMEOUT_S 10    // A stalled connection parks the session like a dropped one
+#define RESTART_DELAY_MS 500 // Lets RESULT reach the client
+
+typedef enum {
+    FRAME_HELLO = 0x01,  // TLVs
+    FRAME_DATA = 0x02,   // u32 sequence number, stream bytes
+    FRAME_END = 0x03,    // Empty
+    FRAME_READY = 0x81,  // TLVs
+    FRAME_RESULT = 0x82, // i32 esp_err_t, message
+} frame_type_t;
+
+// TLV: u8 tag, u8 length, value
+typedef enum {
+    TLV_SIZE = 1,     // u32 image size (after inflating / patching)
+    TLV_SHA256 = 2,   // SHA-256 of the image
+    TLV_VERSION = 3,  // 2 bytes, informational
+    TLV_ENCODING = 4, // u8 encoding_t
+    TLV_OFFSET = 5,   // u32 stream bytes received so far
+    TLV_SEQ = 6,      // u32 next sequence number
+    TLV_BLOCK = 7,    // u16 largest DATA block accepted
+} tlv_tag_t;
+
+typedef enum {
+    ENCODING_PLAIN,
+    ENCODING_ZLIB,  // CONFIG_OTA_COMPRESSED
+    ENCODING_DELTA, // CONFIG_OTA_DELTA
+} encoding_t;
+
+typedef enum {
+    RECV_OK,
+    RECV_CLOSED, // Connection dropped or timed out
+    RECV_CORRUPT,
+} recv_result_t;
+
+// Survives the connection it was started on until it ends or is dropped
+static struct {
+    bool active;
+    uint32_t size;
+    uint8_t sha[SHA256_SIZE];
+    uint8_t encoding;
+    uint32_t offset;
+    uint32_t seq;
+    ota_inflate_t *z;
+    ota_delta_t *d;
+} session;
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static bool recv_exact(int sock, uint8_t *buf, size_t len) {
+    while (len > 0) {
+        int got = recv(sock, buf, len, 0);
+        if (got <= 0)
+            return false;
+        buf += got;
+        len -= got;
+    }
+    return true;
+}
+
+static recv_result_t recv_frame(int sock, uint8_t *buf, uint8_t *type, size_t *len) {
+    uint8_t hdr[FRAME_HDR_SIZE];
+    if (!recv_exact(sock, hdr, sizeof(hdr)))
+        return RECV_CLOSED;
+
+    *type = hdr[0];
+    *len = (size_t)hdr[1] << 8 | hdr[2];
+    if (*len > FRAME_MAX_PAYLOAD)
+        return RECV_CORRUPT; // Framing is lost, the rest of the connection is useless
+
+    uint8_t crc[FRAME_CRC_SIZE];
+    if (!recv_exact(sock, buf, *len) || !recv_exact(sock, crc, sizeof(crc)))
+        return RECV_CLOSED;
+
+    uint32_t actual = esp_rom_crc32_le(esp_rom_crc32_le(0, hdr, sizeof(hdr)), buf, *len);
+    return actual == get_u32(crc) ? RECV_OK : RECV_CORRUPT;
+}
+
+static bool send_frame(int sock, uint8_t type, const uint8_t *payload, size_t len) {
+    uint8_t frame[FRAME_HDR_SIZE + 64 + FRAME_CRC_SIZE];
+    if (len > 64)
+        return false;
+
+    frame[0] = type;
+    frame[1] = len >> 8;
+    frame[2] = len;
+    memcpy(frame + FRAME_HDR_SIZE, payload, len);
+    put_u32(frame + FRAME_HDR_SIZE + len, esp_rom_crc32_le(0, frame, FRAME_HDR_SIZE + len));
+
+    size_t total = FRAME_HDR_SIZE + len + FRAME_CRC_SIZE;
+    return send(sock, frame, total, 0) == (int)total;
+}
+
+static void send_result(int sock, esp_err_t err, const char *msg) {
+    uint8_t payload[64];
+    size_t n = strnlen(msg, sizeof(payload) - 4);
+    put_u32(payload, (uint32_t)err);
+    memcpy(payload + 4, msg, n);
+    send_frame(sock, FRAME_RESULT, payload, 4 + n);
+}
+
+static void send_ready(int sock) {
+    const uint8_t ready[] = {
+        TLV_OFFSET, 4, session.offset >> 24, session.offset >> 16, session.offset >> 8,
+        session.offset, TLV_SEQ, 4, session.seq >> 24, session.seq >> 16, session.seq >> 8,
+        session.seq, TLV_BLOCK, 2, BLOCK_SIZE >> 8, BLOCK_SIZE & 0xFF,
+    };
+    send_frame(sock, FRAME_READY, ready, sizeof(ready));
+}
+
+// Stream bytes go to the writer directly or through the inflater (and delta applier)
+static esp_err_t session_feed(const uint8_t *data, size_t len) {
+#if CONFIG_OTA_COMPRESSED
+    if (session.z)
+        return ota_inflate_feed(session.z, data, len);
+#endif
+    return ota_writer_write(data, len);
+}
+
+static void session_free(void) {
+#if CONFIG_OTA_COMPRESSED
+    ota_inflate_free(session.z);
+#endif
+#if CONFIG_OTA_DELTA
+    ota_delta_free(session.d);
+#endif
+    session.z = NULL;
+    session.d = NULL;
+    session.active = false;
+}
+
+static esp_err_t session_start(uint32_t size, const uint8_t *sha, uint8_t encoding) {
+    esp_err_t err = ota_writer_begin(size, OTA_HASH_SHA256);
+    if (err != ESP_OK)
+        return err;
+
+    session.size = size;
+    memcpy(session.sha, sha, SHA256_SIZE);
+    session.encoding = encoding;
+    session.offset = session.seq = 0;
+#if CONFIG_OTA_DELTA
+    if (encoding == ENCODING_DELTA) {
+        session.d = ota_delta_new(ota_writer_sink, NULL);
+        session.z = session.d ? ota_inflate_new(ota_delta_sink, session.d) : NULL;
+    }
+#endif
+#if CONFIG_OTA_COMPRESSED
+    if (encoding == ENCODING_ZLIB)
+        session.z = ota_inflate_new(ota_writer_sink, NULL);
+#endif
+    session.active = true;
+    if (encoding != ENCODING_PLAIN && !session.z) {
+        session_free();
+        ota_writer_abort();
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t session_finish(void) {
+    esp_err_t err = ESP_OK;
+#if CONFIG_OTA_COMPRESSED
+    if (session.z)
+        err = ota_inflate_finish(session.z);
+#endif
+#if CONFIG_OTA_DELTA
+    if (session.d && err == ESP_OK)
+        err = ota_delta_finish(session.d);
+#endif
+    session_free();
+    if (err != ESP_OK) {
+        ota_writer_abort();
+        return err;
+    }
+    return ota_writer_finish(session.sha, SHA256_SIZE);
+}
+
+static bool encoding_supported(uint8_t encoding) {
+    switch (encoding) {
+    case ENCODING_PLAIN:
+        return true;
+#if CONFIG_OTA_COMPRESSED
+    case ENCODING_ZLIB:
+        return true;
+#endif
+#if CONFIG_OTA_DELTA
+    case ENCODING_DELTA:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+// Parses HELLO and starts a new session or picks up the parked one for the same image
+static esp_err_t handle_hello(const uint8_t *tlv, size_t len) {
+    uint32_t size = 0;
+    const uint8_t *sha = NULL;
+    uint8_t encoding = ENCODING_PLAIN;
+
+    for (size_t i = 0; i + 2 <= len && i + 2 + tlv[i + 1] <= len; i += 2 + tlv[i + 1]) {
+        const uint8_t *value = tlv + i + 2;
+        uint8_t vlen = tlv[i + 1];
+        if (tlv[i] == TLV_SIZE && vlen == 4)
+            size = get_u32(value);
+        else if (tlv[i] == TLV_SHA256 && vlen == SHA256_SIZE)
+            sha = value;
+        else if (tlv[i] == TLV_VERSION && vlen == 2)
+            ESP_LOGI(TAG, "Firmware version %u.%u", value[0], value[1]);
+        else if (tlv[i] == TLV_ENCODING && vlen == 1)
+            encoding = value[0];
+        // Unknown tags are skipped, so clients may send more than this device knows about
+    }
+    if (!size || !sha)
+        return ESP_ERR_INVALID_ARG;
+    if (!encoding_supported(encoding))
+        return ESP_ERR_NOT_SUPPORTED;
+
+    if (session.active && session.size == size && session.encoding == encoding &&
+        !memcmp(session.sha, sha, SHA256_SIZE)) {
+        ESP_LOGI(TAG, "Resuming OTA at %" PRIu32 " B (block %" PRIu32 ")", session.offset,
+                 session.seq);
+        return ESP_OK;
+    }
+    if (session.active) {
+        ESP_LOGW(TAG, "Different image offered, dropping the parked OTA");
+        tcp_ota_v2_drop();
+    }
+    ESP_LOGI(TAG, "OTA v2: %" PRIu32 " B image, encoding %u", size, encoding);
+    return session_start(size, sha, encoding);
+}
+
+void tcp_ota_v2_handle(int client_sock) {
+    struct timeval timeout = {.tv_sec = RECV_TIMEOUT_S};
+    setsockopt(client_sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    uint8_t *buf = malloc(FRAME_MAX_PAYLOAD);
+    if (!buf) {
+        send_result(client_sock, ESP_ERR_NO_MEM, "No memory");
+        return;
+    }
+
+    uint8_t type;
+    size_t len;
+    recv_result_t rx = recv_frame(client_sock, buf, &type, &len);
+    if (rx != RECV_OK || type != FRAME_HELLO) {
+        if (rx != RECV_CLOSED)
+            send_result(client_sock, ESP_ERR_INVALID_ARG, "Expected HELLO");
+        free(buf);
+        return;
+    }
+
+    esp_err_t err = handle_hello(buf, len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "OTA v2 rejected: %s", esp_err_to_name(err));
+        send_result(client_sock, err, esp_err_to_name(err));
+        free(buf);
+        return;
+    }
+    send_ready(client_sock);
+
+    while ((rx = recv_frame(client_sock, buf, &type, &len)) == RECV_OK) {
+        if (type == FRAME_END)
+            break;
+        if (type != FRAME_DATA || len < 4 || get_u32(buf) != session.seq) {
+            rx = RECV_CORRUPT;
+            break;
+        }
+
+        err = session_feed(buf + 4, len - 4);
+        if (err != ESP_OK) {
+            // Not a transport problem: resuming would hit the same error
+            ESP_LOGE(TAG, "OTA v2 failed at %" PRIu32 " B: %s", session.offset,
+                     esp_err_to_name(err));
+            session_free();
+            ota_writer_abort();
+            send_result(client_sock, err, esp_err_to_name(err));
+            free(buf);
+            return;
+        }
+        session.offset += len - 4;
+        session.seq++;
+    }
+    free(buf);
+
+    if (rx != RECV_OK) {
+        ESP_LOGW(TAG, "OTA v2 %s at %" PRIu32 " B, waiting for the client to resume",
+                 rx == RECV_CORRUPT ? "bad frame" : "connection lost", session.offset);
+        if (rx == RECV_CORRUPT)
+            send_result(client_sock, ESP_ERR_INVALID_CRC, "Bad frame, reconnect to resume");
+        return;
+    }
+
+    err = session_finish();
+    send_result(client_sock, err, esp_err_to_name(err));
+    if (err != ESP_OK)
+        return;
+
+    ESP_LOGI(TAG, "OTA v2 complete, restarting");
+    vTaskDelay(pdMS_TO_TICKS(RESTART_DELAY_MS));
+    esp_safe_restart();
+}
+
+bool tcp_ota_v2_parked(void) { return session.active; }
+
+void tcp_ota_v2_drop(void) {
+    if (!session.active)
+        return;
+    ESP_LOGW(TAG, "Dropping parked OTA at %" PRIu32 " B", session.offset);
+    session_free();
+    ota_writer_abort();
+}
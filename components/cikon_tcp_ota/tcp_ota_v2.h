@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdbool.h>
+
+/* Framed, resumable TCP OTA protocol (v2), selected by its magic bytes after the common
+ * handshake (magic, ACK). All integers big endian, every message is a frame:
+ *   u8 type, u16 payload length, payload, u32 CRC-32 of type, length and payload
+ * Client: HELLO (TLVs: image size, SHA-256, optional version and encoding), DATA (u32 sequence
+ * number, up to 4 KB of the stream), END. Device: READY (TLVs: stream offset and sequence
+ * number to continue from, block size), RESULT (i32 esp_err_t, message).
+ * A dropped connection, a bad CRC or an out-of-order block leaves the session open; a client
+ * that reconnects with the same HELLO continues where the device stopped. */
+
+// Runs one v2 connection; the session stays parked if it ends before END
+void tcp_ota_v2_handle(int client_sock);
+
+bool tcp_ota_v2_parked(void);
+// Aborts a parked session (resume timeout, another upload, shutdown)
+void tcp_ota_v2_drop(void);
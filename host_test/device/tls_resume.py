@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""HTTPS session resumption against a flashed device (HTTPS_SESSION_TICKETS).
+
+Opens --count connections with full handshakes, then --count connections
+offering the session ticket of the previous one, each fetching /tele before
+closing. Reports handshake times and the device heap (free_heap / min_heap
+from /tele) in the host test "BENCH <name>: <value> <unit>" format.
+
+Fails if no connection was resumed or resumed handshakes are not faster.
+
+    tls_resume.py 192.168.1.50 [--port 443] [--count 10] [--ca ca.pem]
+"""
+
+import argparse
+import json
+import socket
+import ssl
+import statistics
+import sys
+import time
+
+
+def connect(args, ctx, session=None):
+    """Returns (handshake seconds, resumed, session, /tele as dict)."""
+    raw = socket.create_connection((args.host, args.port), timeout=args.timeout)
+    sock = ctx.wrap_socket(raw, server_hostname=args.host, session=session,
+                           do_handshake_on_connect=False)
+    start = time.perf_counter()
+    sock.do_handshake()
+    elapsed = time.perf_counter() - start
+
+    # TLS 1.3 tickets arrive after the handshake: read the response before taking the session
+    sock.sendall(f"GET /tele HTTP/1.1\r\nHost: {args.host}\r\nConnection: close\r\n\r\n".encode())
+    data = b""
+    while True:
+        chunk = sock.recv(4096)
+        if not chunk:
+            break
+        data += chunk
+    resumed, session = sock.session_reused, sock.session
+    sock.close()
+
+    _, _, body = data.partition(b"\r\n\r\n")
+    try:
+        tele = json.loads(body)
+    except ValueError:
+        tele = {}
+    return elapsed, resumed, session, tele
+
+
+def bench(name, value, unit=""):
+    print(f"BENCH {name}: {value:.2f} {unit}".rstrip())
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=443)
+    parser.add_argument("--count", type=int, default=10)
+    parser.add_argument("--timeout", type=float, default=10.0)
+    parser.add_argument("--ca", help="CA to verify the device against (default: no verification)")
+    args = parser.parse_args()
+
+    ctx = ssl.create_default_context(cafile=args.ca) if args.ca else ssl.SSLContext(
+        ssl.PROTOCOL_TLS_CLIENT)
+    if not args.ca:
+        ctx.check_hostname = False
+        ctx.verify_mode = ssl.CERT_NONE
+
+    full, resumed, heap = [], [], []
+    for _ in range(args.count):
+        elapsed, _, session, tele = connect(args, ctx)
+        full.append(elapsed)
+        heap.append(tele.get("free_heap"))
+
+    hits = 0
+    for _ in range(args.count):
+        elapsed, reused, next_session, tele = connect(args, ctx, session)
+        (resumed if reused else full).append(elapsed)
+        hits += reused
+        heap.append(tele.get("free_heap"))
+        session = next_session or session
+    min_heap = tele.get("min_heap")
+
+    bench("full_handshake_ms", statistics.median(full) * 1000, "ms")
+    if resumed:
+        bench("resumed_handshake_ms", statistics.median(resumed) * 1000, "ms")
+    bench("resumed_connections", hits)
+    heap = [h for h in heap if isinstance(h, (int, float))]
+    if heap:
+        bench("free_heap_first", heap[0], "B")
+        bench("free_heap_last", heap[-1], "B")
+    if isinstance(min_heap, (int, float)):
+        bench("min_heap", min_heap, "B")
+
+    if not hits:
+        sys.exit("no session was resumed: HTTPS_SESSION_TICKETS off, or tickets rejected")
+    if statistics.median(resumed) >= statistics.median(full):
+        sys.exit("resumed handshakes are not faster than full ones")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,7 @@
+/* Host stand-in for ESP-IDF esp_attr.h: placement attributes have no meaning on the host */
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define EXT_RAM_BSS_ATTR
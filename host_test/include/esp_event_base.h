@@ -0,0 +1,18 @@
+/* Host stand-in for ESP-IDF esp_event_base.h */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef const char *esp_event_base_t;
+typedef void (*esp_event_handler_t)(void *event_handler_arg, esp_event_base_t event_base,
+                                    int32_t event_id, void *event_data);
+
+#define ESP_EVENT_ANY_ID -1
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,39 @@
+/* Host stand-in for the ESP-IDF esp_http_client.h streaming API (open / fetch_headers / read) over
+ * POSIX sockets: plain http:// with Content-Length or close-delimited bodies, one request per
+ * connection. https:// fails in open() (no TLS on the host). Redirects are followed only through
+ * esp_http_client_set_redirection(), as with the real client outside perform(). */
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_http_client *esp_http_client_handle_t;
+
+typedef struct {
+    const char *url;
+    const char *cert_pem;
+    esp_err_t (*crt_bundle_attach)(void *conf);
+    int timeout_ms;
+} esp_http_client_config_t;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config);
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len);
+// Content-Length, or -1 without one
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client);
+int esp_http_client_get_status_code(esp_http_client_handle_t client);
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len);
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t client, int *len);
+// Switches to the Location of the last response (absolute or "/path")
+esp_err_t esp_http_client_set_redirection(esp_http_client_handle_t client);
+esp_err_t esp_http_client_get_url(esp_http_client_handle_t client, char *url, const int len);
+esp_err_t esp_http_client_close(esp_http_client_handle_t client);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,33 @@
+/* Host stand-in for ESP-IDF esp_https_server.h: TLS is not emulated, the server runs as plain
+ * HTTP and fake_httpd_secure() reports how it was started. */
+#pragma once
+
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    httpd_config_t httpd;
+    const uint8_t *servercert;
+    size_t servercert_len;
+    const uint8_t *prvtkey_pem;
+    size_t prvtkey_len;
+    bool session_tickets;
+    uint16_t port_secure;
+    uint16_t port_insecure;
+} httpd_ssl_config_t;
+
+#define HTTPD_SSL_CONFIG_DEFAULT()                                                                 \
+    {                                                                                              \
+        .httpd = HTTPD_DEFAULT_CONFIG(), .session_tickets = false, .port_secure = 443,             \
+        .port_insecure = 80,                                                                       \
+    }
+
+esp_err_t httpd_ssl_start(httpd_handle_t *handle, httpd_ssl_config_t *config);
+esp_err_t httpd_ssl_stop(httpd_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
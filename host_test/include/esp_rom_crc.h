@@ -0,0 +1,9 @@
+/* Host stand-in for ESP-IDF esp_rom_crc.h: the little-endian CRC-32 is zlib's crc32() */
+#pragma once
+
+#include <stdint.h>
+#include <zlib.h>
+
+static inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    return (uint32_t)crc32(crc, buf, len);
+}
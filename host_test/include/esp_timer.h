@@ -0,0 +1,14 @@
+/* Host stand-in for ESP-IDF esp_timer.h (CLOCK_MONOTONIC) */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int64_t esp_timer_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
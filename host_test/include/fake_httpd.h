@@ -0,0 +1,75 @@
+/* Client side of the in-process HTTP server behind the host esp_http_server.h.
+ *
+ * Requests are queued to a single "httpd" thread that matches URI handlers and runs them, like
+ * the esp_http_server task. A response is complete when its handler returned and every async
+ * copy of the request was completed. Everything the handlers send is recorded; "writes" counts
+ * the socket writes that carried data, the closest host measure of TCP segments. */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int method;              // HTTP_GET, ...
+    const char *uri;         // Path and query
+    const char *headers;     // "Name: value\n" lines, may be NULL
+    const void *body;
+    size_t body_len;
+    size_t content_len;      // Announced Content-Length; above body_len the client dies there
+    uint32_t send_delay_ms;  // Per socket write to this client: a slow reader
+    uint32_t recv_delay_ms;  // Per httpd_req_recv() of the body: a slow uploader
+    uint32_t timeout_every;  // Every Nth httpd_req_recv() of the body times out: a lossy link
+    size_t read_limit;       // Response body bytes the client reads before it goes away, 0: all
+} fake_httpd_request_t;
+
+typedef struct {
+    int status;              // From the status line, 200 if the handler set none
+    char *headers;           // "Name: value\n" lines as sent, Content-Type included
+    char *body;              // NUL terminated
+    size_t body_len;
+    size_t bytes;            // On the wire: status line, headers, chunk framing and body
+    size_t writes;
+    bool closed;             // Handler returned an error: esp_http_server closes the socket
+    uint64_t start_us;
+    uint64_t first_byte_us;  // 0 if nothing was sent
+    uint64_t done_us;
+} fake_httpd_resp_t;
+
+// Queues the request; the returned response is filled in as the handler runs
+fake_httpd_resp_t *fake_httpd_start(const fake_httpd_request_t *request);
+bool fake_httpd_wait(fake_httpd_resp_t *resp, uint32_t timeout_ms);
+bool fake_httpd_done(const fake_httpd_resp_t *resp);
+void fake_httpd_free(fake_httpd_resp_t *resp);
+
+// Start + wait (5 s); NULL if the server is not running or the handler never completed
+fake_httpd_resp_t *fake_httpd_do(const fake_httpd_request_t *request);
+fake_httpd_resp_t *fake_httpd_get(const char *uri, const char *headers);
+
+// Case-insensitive response header lookup into buf; NULL if absent
+const char *fake_httpd_header(const fake_httpd_resp_t *resp, const char *name, char *buf,
+                              size_t size);
+
+// Waits until the server thread has nothing queued
+void fake_httpd_sync(void);
+bool fake_httpd_running(void);
+bool fake_httpd_secure(void);
+
+/* WebSocket client: connect runs the handshake (GET to the handler) and returns the socket, or
+ * -1 if no WebSocket handler took it. Text frames go to the handler like esp_http_server
+ * delivers them; frames the server sends are recorded per socket. */
+int fake_httpd_ws_connect(const char *uri);
+void fake_httpd_ws_send(int fd, const char *text);
+void fake_httpd_ws_close(int fd);
+bool fake_httpd_ws_open(int fd);
+size_t fake_httpd_ws_count(int fd);
+const char *fake_httpd_ws_frame(int fd, size_t index); // NULL past the end
+const char *fake_httpd_ws_last(int fd);
+
+#ifdef __cplusplus
+}
+#endif
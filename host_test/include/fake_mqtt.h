@@ -0,0 +1,64 @@
+/* Control side of the in-process MQTT broker behind the host mqtt_client.h.
+ *
+ * Every publish is recorded in order. QoS > 0 and enqueued messages stay in the outbox until a
+ * test acknowledges them (or auto-ack is on), which posts MQTT_EVENT_PUBLISHED. Events run on a
+ * separate "mqtt task" thread like in esp-mqtt; fake_mqtt_sync() waits until it is idle. */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    char *topic;   // Full topic, resolved through the alias table
+    char *payload;
+    int qos;
+    bool retain;
+    bool enqueued; // Sent with esp_mqtt_client_enqueue()
+    int msg_id;
+    size_t chunks;       // Writes of the client's output buffer size it took (topic + payload)
+    uint16_t alias;      // MQTT 5 topic alias sent with the message, 0 if none
+    bool alias_only;     // Topic name left empty on the wire, alias alone identified it
+    uint32_t expiry_s;   // MQTT 5 message expiry interval
+    char *correlation;   // MQTT 5 correlation data (not NUL terminated)
+    uint16_t correlation_len;
+} fake_mqtt_msg_t;
+
+// Drops recorded messages, the outbox and all settings (does not touch client state)
+void fake_mqtt_reset(void);
+
+void fake_mqtt_connect(void);
+void fake_mqtt_disconnect(void);
+void fake_mqtt_sync(void);
+
+// Inbound message on a subscribed topic; response_topic and correlation may be NULL (MQTT 3)
+void fake_mqtt_deliver(const char *topic, const char *payload, const char *response_topic,
+                       const char *correlation, uint16_t correlation_len);
+
+// PUBACK: removes the message from the outbox and posts MQTT_EVENT_PUBLISHED
+bool fake_mqtt_ack(int msg_id);
+size_t fake_mqtt_ack_all(void);
+void fake_mqtt_set_auto_ack(bool on);
+
+// Topic Alias Maximum from CONNACK; esp-mqtt refuses larger aliases locally (returns -1)
+void fake_mqtt_set_topic_alias_max(uint16_t max);
+size_t fake_mqtt_refused(void);
+
+// Benchmarks turn recording off to keep memory flat; counters still run
+void fake_mqtt_set_record(bool on);
+size_t fake_mqtt_published(void);
+
+size_t fake_mqtt_count(void);
+const fake_mqtt_msg_t *fake_mqtt_get(size_t index);
+const fake_mqtt_msg_t *fake_mqtt_last(const char *topic);
+size_t fake_mqtt_count_prefix(const char *prefix);
+size_t fake_mqtt_outbox_count(void);
+void fake_mqtt_clear_log(void);
+
+#ifdef __cplusplus
+}
+#endif
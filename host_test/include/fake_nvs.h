@@ -0,0 +1,19 @@
+/* Test access to the in-memory NVS behind the host nvs.h */
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Drops every namespace and key
+void fake_nvs_reset(void);
+// Number of keys in a namespace
+size_t fake_nvs_count(const char *namespace_name);
+// Total nvs_set_* and nvs_erase_* calls since the last reset (flash wear indicator)
+size_t fake_nvs_writes(void);
+
+#ifdef __cplusplus
+}
+#endif
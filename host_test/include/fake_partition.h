@@ -0,0 +1,22 @@
+/* Test access to the RAM partitions behind the host esp_partition.h */
+#pragma once
+
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Registers (or replaces) a partition of size bytes, erased to 0xff, with the file at path, if
+ * any, written at offset 0. False if the file is missing or larger than the partition. */
+bool fake_partition_add(const char *label, esp_partition_type_t type,
+                        esp_partition_subtype_t subtype, size_t size, const char *path);
+void fake_partition_remove(const char *label);
+// The partition contents, writable by the test (e.g. to corrupt an image); NULL if absent
+uint8_t *fake_partition_data(const char *label);
+// Mappings not yet released with esp_partition_munmap()
+size_t fake_partition_mapped(void);
+
+#ifdef __cplusplus
+}
+#endif
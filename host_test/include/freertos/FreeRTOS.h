@@ -0,0 +1,74 @@
+/* Host stand-in for the ESP-IDF FreeRTOS headers: tasks are pthreads, one tick is one ms.
+ * Implemented in stubs/freertos.c. */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t StackType_t;
+
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS 1
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000U))
+#define pdTICKS_TO_MS(ticks) ((TickType_t)(((uint64_t)(ticks) * 1000U) / configTICK_RATE_HZ))
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+#define errQUEUE_FULL ((BaseType_t)0)
+
+#define tskIDLE_PRIORITY 0
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+#ifndef BIT0
+#define BIT31 0x80000000
+#define BIT7 0x00000080
+#define BIT6 0x00000040
+#define BIT5 0x00000020
+#define BIT4 0x00000010
+#define BIT3 0x00000008
+#define BIT2 0x00000004
+#define BIT1 0x00000002
+#define BIT0 0x00000001
+#endif
+
+// Opaque objects; static variants only reserve the storage the caller provides
+typedef struct host_task *TaskHandle_t;
+typedef struct host_queue *QueueHandle_t;
+typedef struct host_queue *SemaphoreHandle_t;
+typedef struct host_event_group *EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef struct {
+    void *p;
+} StaticQueue_t, StaticSemaphore_t, StaticEventGroup_t, StaticTask_t;
+
+typedef struct {
+    int lock;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+void host_enter_critical(portMUX_TYPE *mux);
+void host_exit_critical(portMUX_TYPE *mux);
+#define portENTER_CRITICAL(mux) host_enter_critical(mux)
+#define portEXIT_CRITICAL(mux) host_exit_critical(mux)
+#define taskENTER_CRITICAL(mux) host_enter_critical(mux)
+#define taskEXIT_CRITICAL(mux) host_exit_critical(mux)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,32 @@
+/* Host stand-in for ESP-IDF esp_ringbuf (freertos/ringbuf.h), byte buffers only: sends are all
+ * or nothing, a receive hands out the contiguous queued bytes up to the wrap point and holds them
+ * until vRingbufferReturnItem(). Implemented in stubs/freertos.c. */
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct host_ringbuf *RingbufHandle_t;
+
+typedef enum {
+    RINGBUF_TYPE_NOSPLIT,
+    RINGBUF_TYPE_ALLOWSPLIT,
+    RINGBUF_TYPE_BYTEBUF,
+} RingbufferType_t;
+
+// NULL for the item buffer types
+RingbufHandle_t xRingbufferCreate(size_t size, RingbufferType_t type);
+void vRingbufferDelete(RingbufHandle_t ring);
+BaseType_t xRingbufferSend(RingbufHandle_t ring, const void *data, size_t size, TickType_t ticks);
+void *xRingbufferReceiveUpTo(RingbufHandle_t ring, size_t *size, TickType_t ticks,
+                             size_t max_size);
+void *xRingbufferReceive(RingbufHandle_t ring, size_t *size, TickType_t ticks);
+void vRingbufferReturnItem(RingbufHandle_t ring, void *item);
+size_t xRingbufferGetCurFreeSize(RingbufHandle_t ring);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,74 @@
+/* Minimal test and benchmark helpers shared by the host tests (stubs/host_test.c) */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int host_test_failures;
+
+#define CHECK(cond)                                                                                \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond);              \
+            host_test_failures++;                                                                  \
+        }                                                                                          \
+    } while (0)
+
+#define CHECK_INT_EQ(actual, expected)                                                             \
+    do {                                                                                           \
+        long long a_ = (long long)(actual), e_ = (long long)(expected);                            \
+        if (a_ != e_) {                                                                            \
+            fprintf(stderr, "%s:%d: CHECK failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__,  \
+                    #actual, #expected, a_, e_);                                                   \
+            host_test_failures++;                                                                  \
+        }                                                                                          \
+    } while (0)
+
+#define CHECK_STR_EQ(actual, expected)                                                             \
+    do {                                                                                           \
+        const char *a_ = (actual), *e_ = (expected);                                               \
+        if (!a_ || !e_ || strcmp(a_, e_)) {                                                        \
+            fprintf(stderr, "%s:%d: CHECK failed: %s == \"%s\" (got \"%s\")\n", __FILE__,         \
+                    __LINE__, #actual, e_ ? e_ : "(null)", a_ ? a_ : "(null)");                    \
+            host_test_failures++;                                                                  \
+        }                                                                                          \
+    } while (0)
+
+// Polls cond every millisecond; evaluates to whether it became true within timeout_ms
+#define WAIT_FOR(cond, timeout_ms)                                                                 \
+    ({                                                                                             \
+        uint64_t deadline_ = host_test_now_us() + (uint64_t)(timeout_ms) * 1000;                   \
+        bool ok_;                                                                                  \
+        while (!(ok_ = (cond)) && host_test_now_us() < deadline_)                                  \
+            host_test_sleep_ms(1);                                                                 \
+        ok_;                                                                                       \
+    })
+
+uint64_t host_test_now_us(void);
+void host_test_sleep_ms(uint32_t ms);
+
+// Bytes currently allocated on the heap, for footprint reports (deltas between two calls). Without
+// sanitizers this is glibc's main arena, so measure allocations made by the calling thread.
+size_t host_test_heap_bytes(void);
+
+// esp_safe_restart() calls so far (stubs/platform_services.c); the host process keeps running
+int host_test_restarts(void);
+
+// The version get_device_info() reports (default "1.0.0", device id "A1B2C3D4E5F6")
+void host_test_set_app_version(const char *version);
+
+// Prints "BENCH <name>: <value> <unit>"; ctest logs keep these lines for comparison across runs
+void host_test_bench(const char *name, double value, const char *unit);
+
+// Prints the summary and returns the process exit code
+int host_test_done(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,19 @@
+/* Host stand-in for lwip/sockets.h: the POSIX socket API lwIP mirrors */
+#pragma once
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// lwIP takes the IP protocol level as the protocol of a stream socket (as in the ESP-IDF
+// examples); Linux wants 0 or IPPROTO_TCP
+static inline int lwip_host_socket(int domain, int type, int protocol) {
+    if (type == SOCK_STREAM && (protocol == IPPROTO_IP || protocol == IPPROTO_IPV6))
+        protocol = 0;
+    return socket(domain, type, protocol);
+}
+#define socket(domain, type, protocol) lwip_host_socket(domain, type, protocol)
@@ -0,0 +1,11 @@
+/* BSD string functions newlib provides and glibc only has from 2.38; force-included after
+ * sdkconfig.h, implemented in stubs/newlib_compat.c */
+#pragma once
+
+#include <string.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+#define HOST_NEED_STRLCPY 1
+size_t strlcpy(char *dst, const char *src, size_t size);
+size_t strlcat(char *dst, const char *src, size_t size);
+#endif
@@ -0,0 +1,40 @@
+/* Host stand-in for the PSA Crypto hash API (mbedTLS 3.x) backed by OpenSSL: MD5 and SHA-256 */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int32_t psa_status_t;
+typedef uint32_t psa_algorithm_t;
+
+#define PSA_SUCCESS ((psa_status_t)0)
+#define PSA_ERROR_GENERIC_ERROR ((psa_status_t)-132)
+#define PSA_ERROR_NOT_SUPPORTED ((psa_status_t)-134)
+#define PSA_ERROR_BAD_STATE ((psa_status_t)-137)
+#define PSA_ERROR_BUFFER_TOO_SMALL ((psa_status_t)-138)
+
+#define PSA_ALG_MD5 ((psa_algorithm_t)0x02000003)
+#define PSA_ALG_SHA_256 ((psa_algorithm_t)0x02000009)
+
+typedef struct {
+    void *ctx; // EVP_MD_CTX
+} psa_hash_operation_t;
+
+#define PSA_HASH_OPERATION_INIT {NULL}
+
+psa_status_t psa_crypto_init(void);
+psa_status_t psa_hash_setup(psa_hash_operation_t *op, psa_algorithm_t alg);
+psa_status_t psa_hash_update(psa_hash_operation_t *op, const uint8_t *input, size_t input_length);
+psa_status_t psa_hash_finish(psa_hash_operation_t *op, uint8_t *hash, size_t hash_size,
+                             size_t *hash_length);
+psa_status_t psa_hash_abort(psa_hash_operation_t *op);
+psa_status_t psa_hash_compute(psa_algorithm_t alg, const uint8_t *input, size_t input_length,
+                              uint8_t *hash, size_t hash_size, size_t *hash_length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,4 @@
+/* Host stand-in for the ESP ROM miniz: the same library version, built from source */
+#pragma once
+
+#include <miniz.h>
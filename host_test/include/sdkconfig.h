@@ -0,0 +1,188 @@
+/* Host sdkconfig: Kconfig defaults of the components under test, force-included into every
+ * source. A test overrides a symbol with target_compile_definitions(); bool options that are
+ * "n" stay undefined, as in the generated header. */
+#pragma once
+
+// cikon_mqtt
+#ifndef CONFIG_MQTT_TELEMETRY_INTERVAL_MS
+#define CONFIG_MQTT_TELEMETRY_INTERVAL_MS 5000
+#endif
+#ifndef CONFIG_MQTT_RX_BUFFER_SIZE
+#define CONFIG_MQTT_RX_BUFFER_SIZE 1024
+#endif
+#ifndef CONFIG_MQTT_QOS
+#define CONFIG_MQTT_QOS 0
+#endif
+#ifndef CONFIG_MQTT_COMMAND_TASK_STACK_SIZE
+#define CONFIG_MQTT_COMMAND_TASK_STACK_SIZE 4096
+#endif
+#ifndef CONFIG_MQTT_COMMAND_TASK_PRIORITY
+#define CONFIG_MQTT_COMMAND_TASK_PRIORITY 10
+#endif
+#ifndef CONFIG_MQTT_TELEMETRY_TASK_STACK_SIZE
+#define CONFIG_MQTT_TELEMETRY_TASK_STACK_SIZE 4096
+#endif
+#ifndef CONFIG_MQTT_TELEMETRY_TASK_PRIORITY
+#define CONFIG_MQTT_TELEMETRY_TASK_PRIORITY 5
+#endif
+#if CONFIG_MQTT_USE_PROTOCOL_5 && !defined(CONFIG_MQTT5_TELEMETRY_EXPIRY_S)
+#define CONFIG_MQTT5_TELEMETRY_EXPIRY_S 15
+#endif
+#ifndef CONFIG_MQTT_ENABLE_HA_DISCOVERY
+#define CONFIG_MQTT_ENABLE_HA_DISCOVERY 1
+#endif
+#ifndef CONFIG_MQTT_HA_ENTITY_BLOCK
+#define CONFIG_MQTT_HA_ENTITY_BLOCK 16
+#endif
+#ifndef CONFIG_MQTT_HA_INCREMENTAL_DISCOVERY
+#define CONFIG_MQTT_HA_INCREMENTAL_DISCOVERY 1
+#endif
+#ifndef CONFIG_MQTT_HA_DISCOVERY_OUTBOX_HWM
+#define CONFIG_MQTT_HA_DISCOVERY_OUTBOX_HWM 4096
+#endif
+#ifndef CONFIG_MQTT_HA_DISCOVERY_PACE_MS
+#define CONFIG_MQTT_HA_DISCOVERY_PACE_MS 50
+#endif
+#ifndef CONFIG_MQTT_HA_DISCOVERY_DRAIN_TIMEOUT_MS
+#define CONFIG_MQTT_HA_DISCOVERY_DRAIN_TIMEOUT_MS 10000
+#endif
+#ifndef CONFIG_MQTT_HA_DISCOVERY_TASK_STACK_SIZE
+#define CONFIG_MQTT_HA_DISCOVERY_TASK_STACK_SIZE 4096
+#endif
+#ifndef CONFIG_MQTT_HA_DISCOVERY_TASK_PRIORITY
+#define CONFIG_MQTT_HA_DISCOVERY_TASK_PRIORITY 3
+#endif
+
+// ESP-IDF (esp_http_server, lwip, LittleFS); the mount point is a per-test directory set by
+// cikon_host_test()
+#ifndef CONFIG_HTTPD_WS_SUPPORT
+#define CONFIG_HTTPD_WS_SUPPORT 1
+#endif
+#ifndef CONFIG_LWIP_MAX_SOCKETS
+#define CONFIG_LWIP_MAX_SOCKETS 10
+#endif
+#ifndef CONFIG_VFS_LITTLEFS_MOUNT_POINT
+#define CONFIG_VFS_LITTLEFS_MOUNT_POINT "/tmp/cikon_host_fs"
+#endif
+
+// cikon_http
+#ifndef CONFIG_HTTP_STATIC_ETAG
+#define CONFIG_HTTP_STATIC_ETAG 1
+#endif
+#ifndef CONFIG_HTTP_STATIC_WORKERS
+#define CONFIG_HTTP_STATIC_WORKERS 0
+#endif
+#if CONFIG_HTTP_STATIC_WORKERS > 0 && !defined(CONFIG_HTTP_STATIC_WORKER_STACK_SIZE)
+#define CONFIG_HTTP_STATIC_WORKER_STACK_SIZE 3072
+#endif
+#if CONFIG_HTTP_WEB_BUNDLE && !defined(CONFIG_HTTP_WEB_BUNDLE_PARTITION)
+#define CONFIG_HTTP_WEB_BUNDLE_PARTITION "www"
+#endif
+#ifndef CONFIG_HTTP_EVENTS
+#define CONFIG_HTTP_EVENTS 1
+#endif
+#ifndef CONFIG_HTTP_LONGPOLL_MAX
+#define CONFIG_HTTP_LONGPOLL_MAX 4
+#endif
+#if CONFIG_HTTP_LONGPOLL_MAX > 0 && !defined(CONFIG_HTTP_LONGPOLL_MAX_WAIT_MS)
+#define CONFIG_HTTP_LONGPOLL_MAX_WAIT_MS 30000
+#endif
+#if CONFIG_HTTP_LONGPOLL_MAX > 0 && !defined(CONFIG_HTTP_LONGPOLL_STACK_SIZE)
+#define CONFIG_HTTP_LONGPOLL_STACK_SIZE 4096
+#endif
+#ifndef CONFIG_HTTP_POST_MAX_BODY
+#define CONFIG_HTTP_POST_MAX_BODY 2048
+#endif
+#if CONFIG_HTTP_ENABLE_WEBDAV && !defined(CONFIG_HTTP_WEBDAV_PUT_BUF_SIZE)
+#define CONFIG_HTTP_WEBDAV_PUT_BUF_SIZE 4096
+#endif
+#if CONFIG_HTTP_ENABLE_WEBDAV && !defined(CONFIG_HTTP_WEBDAV_RESUME_TTL)
+#define CONFIG_HTTP_WEBDAV_RESUME_TTL 3600
+#endif
+#if CONFIG_HTTP_ENABLE_WEBDAV && !defined(CONFIG_HTTP_WEBDAV_XML_BUF_SIZE)
+#define CONFIG_HTTP_WEBDAV_XML_BUF_SIZE 2048
+#endif
+#ifndef CONFIG_HTTP_STACK_SIZE
+#define CONFIG_HTTP_STACK_SIZE 7168
+#endif
+#ifndef CONFIG_HTTP_MAX_HANDLERS
+#define CONFIG_HTTP_MAX_HANDLERS 24
+#endif
+#ifndef CONFIG_HTTP_CTRL_PORT
+#define CONFIG_HTTP_CTRL_PORT 32769
+#endif
+#ifndef CONFIG_HTTP_MAX_OPEN_SOCKETS
+#define CONFIG_HTTP_MAX_OPEN_SOCKETS 4
+#endif
+#ifndef CONFIG_HTTP_SESSION_TIMEOUT
+#define CONFIG_HTTP_SESSION_TIMEOUT 10
+#endif
+#ifndef CONFIG_HTTPS_STACK_SIZE
+#define CONFIG_HTTPS_STACK_SIZE 10240
+#endif
+#ifndef CONFIG_HTTPS_CTRL_PORT
+#define CONFIG_HTTPS_CTRL_PORT 32769
+#endif
+#ifndef CONFIG_HTTPS_MAX_OPEN_SOCKETS
+#define CONFIG_HTTPS_MAX_OPEN_SOCKETS 4
+#endif
+
+// cikon_supervisor
+#ifndef CONFIG_SUPERVISOR_QUEUE_LENGTH
+#define CONFIG_SUPERVISOR_QUEUE_LENGTH 8
+#endif
+#ifndef CONFIG_SUPERVISOR_MAX_COMMANDS
+#define CONFIG_SUPERVISOR_MAX_COMMANDS 30
+#endif
+
+// cikon_tcp_ota
+#ifndef CONFIG_TCP_OTA_PORT
+#define CONFIG_TCP_OTA_PORT 5555
+#endif
+#ifndef CONFIG_TCP_OTA_TASK_STACK_SIZE
+#define CONFIG_TCP_OTA_TASK_STACK_SIZE 5120
+#endif
+#ifndef CONFIG_TCP_OTA_TASK_PRIORITY
+#define CONFIG_TCP_OTA_TASK_PRIORITY 4
+#endif
+#ifndef CONFIG_TCP_OTA_RESUME_TIMEOUT
+#define CONFIG_TCP_OTA_RESUME_TIMEOUT 120
+#endif
+#ifndef CONFIG_OTA_COMPRESSED
+#define CONFIG_OTA_COMPRESSED 1
+#endif
+#ifndef CONFIG_OTA_DELTA
+#define CONFIG_OTA_DELTA 1
+#endif
+#ifndef CONFIG_OTA_PIPELINE_BUF_SIZE
+#define CONFIG_OTA_PIPELINE_BUF_SIZE 8192
+#endif
+#ifndef CONFIG_OTA_PIPELINE_BUFFERS
+#define CONFIG_OTA_PIPELINE_BUFFERS 2
+#endif
+#ifndef CONFIG_OTA_WRITER_TASK_STACK_SIZE
+#define CONFIG_OTA_WRITER_TASK_STACK_SIZE 3072
+#endif
+#if CONFIG_OTA_PULL && !defined(CONFIG_OTA_PULL_URL)
+#define CONFIG_OTA_PULL_URL ""
+#endif
+#if CONFIG_OTA_PULL && !defined(CONFIG_OTA_PULL_INTERVAL_MIN)
+#define CONFIG_OTA_PULL_INTERVAL_MIN 0
+#endif
+#if CONFIG_OTA_PULL && !defined(CONFIG_OTA_PULL_TASK_STACK_SIZE)
+#define CONFIG_OTA_PULL_TASK_STACK_SIZE 6144
+#endif
+
+// cikon_tcp_monitor
+#ifndef CONFIG_TCP_MONITOR_TASK_STACK_SIZE
+#define CONFIG_TCP_MONITOR_TASK_STACK_SIZE 3072
+#endif
+#ifndef CONFIG_TCP_MONITOR_TASK_PRIORITY
+#define CONFIG_TCP_MONITOR_TASK_PRIORITY 3
+#endif
+#ifndef CONFIG_RING_BUFFER_SIZE
+#define CONFIG_RING_BUFFER_SIZE 4096
+#endif
+#ifndef CONFIG_MAX_LOG_SIZE
+#define CONFIG_MAX_LOG_SIZE 256
+#endif
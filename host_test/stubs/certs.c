@@ -0,0 +1,18 @@
+/* No certificates on the host: TLS endpoints stay disabled */
+#include "certs.h"
+
+const char *get_ca_pem_start(void) { return NULL; }
+size_t get_ca_pem_size(void) { return 0; }
+const char *get_client_pem_start(void) { return NULL; }
+size_t get_client_pem_size(void) { return 0; }
+const char *get_client_key_start(void) { return NULL; }
+size_t get_client_key_size(void) { return 0; }
+bool certs_available(void) { return false; }
+
+bool certs_acquire_parsed(mbedtls_x509_crt **chain, mbedtls_pk_context **key) {
+    (void)chain;
+    (void)key;
+    return false;
+}
+
+void certs_release_parsed(void) {}
@@ -0,0 +1,200 @@
+/* esp_http_client over a blocking POSIX socket: every open() sends one GET with
+ * "Connection: close" and reads the response head; read() returns the body up to Content-Length
+ * (or until the server closes). Enough for the pull OTA client against a local Python server. */
+#include "esp_http_client.h"
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define URL_MAX 512
+#define HEAD_MAX 4096
+
+struct esp_http_client {
+    char url[URL_MAX];
+    char location[URL_MAX];
+    int timeout_ms;
+    int sock;
+    int status;
+    int64_t length; // -1: until the server closes
+    int64_t left;
+    char head[HEAD_MAX]; // Response head, then body bytes received along with it
+    size_t pending, pending_pos;
+};
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config) {
+    if (!config || !config->url || strlen(config->url) >= URL_MAX)
+        return NULL;
+    esp_http_client_handle_t client = calloc(1, sizeof(*client));
+    if (!client)
+        return NULL;
+    snprintf(client->url, sizeof(client->url), "%s", config->url);
+    client->timeout_ms = config->timeout_ms ? config->timeout_ms : 5000;
+    client->sock = -1;
+    return client;
+}
+
+// "http://host[:port]/path" into its parts; false for anything else
+static bool split_url(const char *url, char *host, size_t host_size, char *port,
+                      const char **path) {
+    if (strncmp(url, "http://", 7))
+        return false;
+    const char *start = url + 7;
+    const char *end = start + strcspn(start, ":/");
+    if (end == start || (size_t)(end - start) >= host_size)
+        return false;
+    snprintf(host, host_size, "%.*s", (int)(end - start), start);
+    const char *slash = strchr(end, '/');
+    if (*end == ':')
+        snprintf(port, 8, "%.*s", (int)((slash ? slash : end + strlen(end)) - end - 1), end + 1);
+    else
+        snprintf(port, 8, "80");
+    *path = slash ? slash : "/";
+    return true;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client) {
+    if (client->sock >= 0)
+        close(client->sock);
+    client->sock = -1;
+    client->pending = client->pending_pos = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len) {
+    (void)write_len;
+    esp_http_client_close(client);
+    char host[256], port[8];
+    const char *path;
+    if (!split_url(client->url, host, sizeof(host), port, &path))
+        return ESP_ERR_NOT_SUPPORTED;
+
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM}, *res;
+    if (getaddrinfo(host, port, &hints, &res))
+        return ESP_FAIL;
+    int sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    struct timeval tv = {.tv_sec = client->timeout_ms / 1000,
+                         .tv_usec = (client->timeout_ms % 1000) * 1000};
+    bool ok = sock >= 0 && setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0 &&
+              connect(sock, res->ai_addr, res->ai_addrlen) == 0;
+    freeaddrinfo(res);
+
+    char request[URL_MAX + 512];
+    int n = snprintf(request, sizeof(request),
+                     "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: ESP32 HTTP Client/1.0\r\n"
+                     "Connection: close\r\n\r\n",
+                     path, host);
+    ok = ok && send(sock, request, n, MSG_NOSIGNAL) == n;
+    if (!ok) {
+        if (sock >= 0)
+            close(sock);
+        return ESP_FAIL;
+    }
+    client->sock = sock;
+    client->status = 0;
+    client->location[0] = '\0';
+    return ESP_OK;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client) {
+    size_t len = 0;
+    char *end = NULL;
+    while (!end && len < sizeof(client->head) - 1) {
+        ssize_t got = recv(client->sock, client->head + len, sizeof(client->head) - 1 - len, 0);
+        if (got <= 0)
+            return -1;
+        len += got;
+        client->head[len] = '\0';
+        end = strstr(client->head, "\r\n\r\n");
+    }
+    if (!end || sscanf(client->head, "HTTP/1.%*d %d", &client->status) != 1)
+        return -1;
+
+    client->length = -1;
+    *end = '\0';
+    for (char *line = strstr(client->head, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+        char *value = line + 2;
+        if (!strncasecmp(value, "Content-Length:", 15))
+            client->length = strtoll(value + 15, NULL, 10);
+        else if (!strncasecmp(value, "Location:", 9))
+            sscanf(value + 9, " %511[^\r\n]", client->location);
+    }
+    client->pending_pos = end + 4 - client->head;
+    client->pending = len;
+    client->left = client->length;
+    return client->length;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client) { return client->status; }
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len) {
+    if (client->sock < 0)
+        return -1;
+    if (client->left >= 0 && len > client->left)
+        len = (int)client->left;
+    if (len <= 0)
+        return 0;
+    ssize_t got;
+    if (client->pending_pos < client->pending) {
+        got = client->pending - client->pending_pos < (size_t)len
+                  ? (ssize_t)(client->pending - client->pending_pos)
+                  : len;
+        memcpy(buffer, client->head + client->pending_pos, got);
+        client->pending_pos += got;
+    } else {
+        got = recv(client->sock, buffer, len, 0);
+        if (got < 0)
+            return -1;
+    }
+    if (client->left >= 0)
+        client->left -= got;
+    return (int)got;
+}
+
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t client, int *len) {
+    char buf[512];
+    int total = 0, got;
+    while ((got = esp_http_client_read(client, buf, sizeof(buf))) > 0)
+        total += got;
+    if (len)
+        *len = total;
+    return got < 0 ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t esp_http_client_set_redirection(esp_http_client_handle_t client) {
+    if (!client->location[0])
+        return ESP_ERR_INVALID_ARG;
+    if (client->location[0] != '/') {
+        snprintf(client->url, sizeof(client->url), "%s", client->location);
+        return ESP_OK;
+    }
+    // Same scheme and host, new path
+    const char *host = strstr(client->url, "://");
+    const char *path = host ? strchr(host + 3, '/') : NULL;
+    int prefix = path ? (int)(path - client->url) : (int)strlen(client->url);
+    char url[URL_MAX];
+    if ((size_t)snprintf(url, sizeof(url), "%.*s%s", prefix, client->url, client->location) >=
+        sizeof(url))
+        return ESP_ERR_INVALID_ARG;
+    memcpy(client->url, url, sizeof(url));
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_get_url(esp_http_client_handle_t client, char *url, const int len) {
+    if ((int)strlen(client->url) >= len)
+        return ESP_ERR_INVALID_SIZE;
+    memcpy(url, client->url, strlen(client->url) + 1);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+    if (!client)
+        return ESP_FAIL;
+    esp_http_client_close(client);
+    free(client);
+    return ESP_OK;
+}
@@ -0,0 +1,919 @@
+/* In-process HTTP server behind the host esp_http_server.h. One server at a time; requests,
+ * WebSocket frames and queued work run in order on a dedicated thread, like the esp_http_server
+ * task. Header values set on a response are kept as pointers and read when the headers go out,
+ * so handlers get the same lifetime rules as on the device. */
+#include "esp_http_server.h"
+#include "esp_https_server.h"
+#include "fake_httpd.h"
+#include "host_test.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define FIRST_FD 54
+#define DEFAULT_WAIT_MS 5000
+
+typedef struct {
+    const char *field;
+    const char *value;
+} resp_hdr_t;
+
+typedef struct conn {
+    fake_httpd_resp_t resp; // First: the client holds a pointer to it
+    struct conn *next;
+    int fd;
+
+    // Request as sent by the client
+    int method;
+    char *uri;
+    char *headers;
+    char *body;
+    size_t body_len;
+    size_t content_len;
+    size_t body_read;
+    uint32_t send_delay_ms;
+    uint32_t recv_delay_ms;
+    uint32_t timeout_every;
+    uint32_t recv_calls;
+    size_t read_limit;
+    bool upgrade;
+
+    // Connection state
+    bool open;       // Listed by httpd_get_client_list()
+    bool websocket;  // Handshake done
+    bool dead;       // Client went away mid-body: further socket I/O fails
+    bool returned;   // Handler returned
+    int async;       // Async copies of the request not completed yet
+    bool complete;
+    const httpd_uri_t *ws_handler;
+
+    // Response in progress
+    const char *status;
+    const char *type;
+    resp_hdr_t *hdrs;
+    size_t hdr_count;
+    bool hdrs_sent;
+    bool finished; // Last byte of the body was sent
+    size_t body_cap;
+
+    // WebSocket frames: the one being delivered, and what the server sent
+    const char *in_frame;
+    size_t in_len;
+    char **out_frames;
+    size_t out_count, out_cap;
+} conn_t;
+
+typedef enum { JOB_REQUEST, JOB_WS_FRAME, JOB_WS_CLOSE, JOB_WORK } job_type_t;
+
+typedef struct job {
+    struct job *next;
+    job_type_t type;
+    conn_t *conn;
+    char *frame;
+    httpd_work_fn_t work;
+    void *arg;
+} job_t;
+
+typedef struct {
+    httpd_config_t cfg;
+    httpd_uri_t *handlers;
+    size_t handler_count;
+    httpd_err_handler_func_t err_handlers[HTTPD_ERR_CODE_MAX];
+    pthread_t thread;
+    bool stopping;
+    bool secure;
+} server_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static server_t *server;
+static bool busy;
+static job_t *jobs_head, *jobs_tail;
+static conn_t *conns;
+static int next_fd = FIRST_FD;
+
+static const struct {
+    const char *status;
+    const char *msg;
+} err_table[HTTPD_ERR_CODE_MAX] = {
+    [HTTPD_500_INTERNAL_SERVER_ERROR] = {"500 Internal Server Error", "Server Error"},
+    [HTTPD_501_METHOD_NOT_IMPLEMENTED] = {"501 Method Not Implemented", "Not Implemented"},
+    [HTTPD_505_VERSION_NOT_SUPPORTED] = {"505 Version Not Supported", "Version Not Supported"},
+    [HTTPD_400_BAD_REQUEST] = {"400 Bad Request", "Bad Request"},
+    [HTTPD_401_UNAUTHORIZED] = {"401 Unauthorized", "Unauthorized"},
+    [HTTPD_403_FORBIDDEN] = {"403 Forbidden", "Forbidden"},
+    [HTTPD_404_NOT_FOUND] = {"404 Not Found", "Not Found"},
+    [HTTPD_405_METHOD_NOT_ALLOWED] = {"405 Method Not Allowed", "Method Not Allowed"},
+    [HTTPD_408_REQ_TIMEOUT] = {"408 Request Timeout", "Request Timeout"},
+    [HTTPD_411_LENGTH_REQUIRED] = {"411 Length Required", "Length Required"},
+    [HTTPD_413_CONTENT_TOO_LARGE] = {"413 Content Too Large", "Content Too Large"},
+    [HTTPD_414_URI_TOO_LONG] = {"414 URI Too Long", "URI Too Long"},
+    [HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE] = {"431 Request Header Fields Too Large",
+                                            "Header Fields Too Large"},
+};
+
+static char *dup_n(const char *s, size_t len) {
+    char *copy = malloc(len + 1);
+    if (s)
+        memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+static void append(char **buf, size_t *len, size_t *cap, const char *data, size_t n) {
+    if (*len + n + 1 > *cap) {
+        *cap = (*len + n + 1) * 2;
+        *buf = realloc(*buf, *cap);
+    }
+    memcpy(*buf + *len, data, n);
+    *len += n;
+    (*buf)[*len] = '\0';
+}
+
+static void push_job_locked(job_t *job) {
+    if (jobs_tail)
+        jobs_tail->next = job;
+    else
+        jobs_head = job;
+    jobs_tail = job;
+    pthread_cond_broadcast(&cond);
+}
+
+static conn_t *conn_by_fd_locked(int fd) {
+    for (conn_t *c = conns; c; c = c->next) {
+        if (c->fd == fd)
+            return c;
+    }
+    return NULL;
+}
+
+static void conn_free(conn_t *c) {
+    free(c->uri);
+    free(c->headers);
+    free(c->body);
+    free(c->hdrs);
+    free(c->resp.headers);
+    free(c->resp.body);
+    for (size_t i = 0; i < c->out_count; i++) {
+        free(c->out_frames[i]);
+    }
+    free(c->out_frames);
+    free(c);
+}
+
+static void conn_unlink_locked(conn_t *c) {
+    for (conn_t **p = &conns; *p; p = &(*p)->next) {
+        if (*p == c) {
+            *p = c->next;
+            return;
+        }
+    }
+}
+
+static void maybe_complete_locked(conn_t *c) {
+    if (c->complete || !c->returned || c->async > 0)
+        return;
+    c->complete = true;
+    c->resp.done_us = host_test_now_us();
+    if (!c->websocket)
+        c->open = false;
+    pthread_cond_broadcast(&cond);
+}
+
+// Status line and headers, once per response; chunked or with Content-Length
+static void flush_headers_locked(conn_t *c, bool chunked, size_t content_len) {
+    if (c->hdrs_sent)
+        return;
+    c->hdrs_sent = true;
+
+    const char *status = c->status ? c->status : HTTPD_200;
+    c->resp.status = atoi(status);
+
+    size_t len = 0, cap = 0;
+    char line[CONFIG_HTTPD_MAX_REQ_HDR_LEN];
+    int n = snprintf(line, sizeof(line), "Content-Type: %s\n", c->type ? c->type : "text/html");
+    append(&c->resp.headers, &len, &cap, line, n);
+    for (size_t i = 0; i < c->hdr_count; i++) {
+        n = snprintf(line, sizeof(line), "%s: %s\n", c->hdrs[i].field, c->hdrs[i].value);
+        append(&c->resp.headers, &len, &cap, line, n);
+    }
+    if (chunked)
+        n = snprintf(line, sizeof(line), "Transfer-Encoding: chunked\n");
+    else
+        n = snprintf(line, sizeof(line), "Content-Length: %zu\n", content_len);
+    append(&c->resp.headers, &len, &cap, line, n);
+
+    // "HTTP/1.1 <status>\r\n", every header line with \r\n, blank line
+    size_t lines = 2 + c->hdr_count;
+    c->resp.bytes += strlen("HTTP/1.1 \r\n") + strlen(status) + len + lines + 2;
+}
+
+static esp_err_t conn_send(conn_t *c, const char *data, size_t len, size_t framing) {
+    pthread_mutex_lock(&lock);
+    if (c->dead) {
+        pthread_mutex_unlock(&lock);
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    // A client that stops reading takes what fits under its limit and closes the socket
+    bool cut = c->read_limit && c->resp.body_len + len > c->read_limit;
+    if (cut) {
+        len = c->read_limit - c->resp.body_len;
+        c->dead = true;
+    }
+    if (len)
+        append(&c->resp.body, &c->resp.body_len, &c->body_cap, data, len);
+    c->resp.bytes += len + framing;
+    c->resp.writes++;
+    if (!c->resp.first_byte_us)
+        c->resp.first_byte_us = host_test_now_us();
+    uint32_t delay = c->send_delay_ms;
+    pthread_mutex_unlock(&lock);
+
+    if (delay)
+        host_test_sleep_ms(delay);
+    return cut ? ESP_ERR_HTTPD_RESP_SEND : ESP_OK;
+}
+
+static httpd_req_t *req_new(conn_t *c, int method) {
+    httpd_req_t *req = calloc(1, sizeof(*req));
+    req->handle = server;
+    req->method = method;
+    snprintf((char *)req->uri, sizeof(req->uri), "%s", c->uri);
+    req->content_len = c->content_len;
+    req->aux = c;
+    return req;
+}
+
+static bool uri_matches(const char *tmpl, const char *uri, size_t len) {
+    if (server->cfg.uri_match_fn)
+        return server->cfg.uri_match_fn(tmpl, uri, len);
+    return strlen(tmpl) == len && !strncmp(tmpl, uri, len);
+}
+
+static esp_err_t handle_err(httpd_req_t *req, httpd_err_code_t code) {
+    if (server->err_handlers[code])
+        return server->err_handlers[code](req, code);
+    httpd_resp_send_err(req, code, NULL);
+    return ESP_FAIL;
+}
+
+static void serve_request(conn_t *c) {
+    httpd_req_t *req = req_new(c, c->method);
+    size_t path_len = strcspn(c->uri, "?");
+
+    const httpd_uri_t *match = NULL;
+    bool uri_known = false;
+    for (size_t i = 0; i < server->handler_count && !match; i++) {
+        const httpd_uri_t *h = &server->handlers[i];
+        if (!uri_matches(h->uri, c->uri, path_len))
+            continue;
+        uri_known = true;
+        if ((int)h->method == c->method || (int)h->method == HTTP_ANY)
+            match = h;
+    }
+
+    esp_err_t ret;
+    if (!match) {
+        ret = handle_err(req, uri_known ? HTTPD_405_METHOD_NOT_ALLOWED : HTTPD_404_NOT_FOUND);
+    } else {
+        req->user_ctx = match->user_ctx;
+        if (match->is_websocket && c->upgrade) {
+            pthread_mutex_lock(&lock);
+            c->websocket = true;
+            c->ws_handler = match;
+            c->resp.status = 101;
+            c->hdrs_sent = true;
+            pthread_mutex_unlock(&lock);
+        }
+        ret = match->handler(req);
+    }
+
+    pthread_mutex_lock(&lock);
+    if (ret != ESP_OK) {
+        c->resp.closed = true;
+        c->websocket = false;
+    }
+    c->returned = true;
+    maybe_complete_locked(c);
+    pthread_mutex_unlock(&lock);
+    free(req);
+}
+
+static void serve_frame(conn_t *c, const char *frame) {
+    pthread_mutex_lock(&lock);
+    bool live = c->open && c->websocket;
+    pthread_mutex_unlock(&lock);
+    if (!live)
+        return;
+
+    httpd_req_t *req = req_new(c, 0);
+    req->user_ctx = c->ws_handler->user_ctx;
+    c->in_frame = frame;
+    c->in_len = strlen(frame);
+    esp_err_t ret = c->ws_handler->handler(req);
+    c->in_frame = NULL;
+    free(req);
+
+    if (ret != ESP_OK) {
+        pthread_mutex_lock(&lock);
+        c->open = false;
+        c->websocket = false;
+        c->resp.closed = true;
+        pthread_mutex_unlock(&lock);
+    }
+}
+
+static void *server_loop(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (!jobs_head && !server->stopping)
+            pthread_cond_wait(&cond, &lock);
+        if (!jobs_head)
+            break;
+
+        job_t *job = jobs_head;
+        jobs_head = job->next;
+        if (!jobs_head)
+            jobs_tail = NULL;
+        busy = true;
+        pthread_mutex_unlock(&lock);
+
+        switch (job->type) {
+        case JOB_REQUEST:
+            serve_request(job->conn);
+            break;
+        case JOB_WS_FRAME:
+            serve_frame(job->conn, job->frame);
+            break;
+        case JOB_WS_CLOSE:
+            pthread_mutex_lock(&lock);
+            job->conn->open = false;
+            job->conn->websocket = false;
+            pthread_mutex_unlock(&lock);
+            break;
+        case JOB_WORK:
+            job->work(job->arg);
+            break;
+        }
+        free(job->frame);
+        free(job);
+
+        pthread_mutex_lock(&lock);
+        busy = false;
+        pthread_cond_broadcast(&cond);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config) {
+    pthread_mutex_lock(&lock);
+    if (server) {
+        pthread_mutex_unlock(&lock);
+        return ESP_ERR_HTTPD_TASK;
+    }
+    server = calloc(1, sizeof(*server));
+    server->cfg = *config;
+    server->handlers = calloc(config->max_uri_handlers, sizeof(*server->handlers));
+    pthread_create(&server->thread, NULL, server_loop, NULL);
+    pthread_mutex_unlock(&lock);
+    *handle = server;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle) {
+    pthread_mutex_lock(&lock);
+    if (!server || handle != server) {
+        pthread_mutex_unlock(&lock);
+        return ESP_ERR_INVALID_ARG;
+    }
+    server->stopping = true;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+    pthread_join(server->thread, NULL);
+
+    pthread_mutex_lock(&lock);
+    for (conn_t *c = conns; c; c = c->next) {
+        c->open = false;
+        c->websocket = false;
+    }
+    free(server->handlers);
+    free(server);
+    server = NULL;
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+esp_err_t httpd_ssl_start(httpd_handle_t *handle, httpd_ssl_config_t *config) {
+    esp_err_t err = httpd_start(handle, &config->httpd);
+    if (err == ESP_OK)
+        server->secure = true;
+    return err;
+}
+
+esp_err_t httpd_ssl_stop(httpd_handle_t handle) { return httpd_stop(handle); }
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler) {
+    server_t *s = handle;
+    for (size_t i = 0; i < s->handler_count; i++) {
+        if (!strcmp(s->handlers[i].uri, uri_handler->uri) &&
+            s->handlers[i].method == uri_handler->method)
+            return ESP_ERR_HTTPD_HANDLER_EXISTS;
+    }
+    if (s->handler_count == s->cfg.max_uri_handlers)
+        return ESP_ERR_HTTPD_HANDLERS_FULL;
+    s->handlers[s->handler_count++] = *uri_handler;
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_err_handler(httpd_handle_t handle, httpd_err_code_t error,
+                                     httpd_err_handler_func_t handler_fn) {
+    if (error >= HTTPD_ERR_CODE_MAX)
+        return ESP_ERR_INVALID_ARG;
+    ((server_t *)handle)->err_handlers[error] = handler_fn;
+    return ESP_OK;
+}
+
+// Same rules as esp_http_server: trailing '*' matches any rest, '?' makes the last char optional
+bool httpd_uri_match_wildcard(const char *tmpl, const char *uri, size_t len) {
+    size_t tpl_len = strlen(tmpl);
+    char last = tpl_len > 0 ? tmpl[tpl_len - 1] : 0;
+    char prevlast = tpl_len > 1 ? tmpl[tpl_len - 2] : 0;
+    bool asterisk = last == '*' || (prevlast == '*' && last == '?');
+    bool quest = last == '?' || (prevlast == '?' && last == '*');
+
+    size_t special = asterisk + quest * 2;
+    if (tpl_len < special)
+        return false;
+    size_t exact = tpl_len - special;
+    if (len < exact)
+        return false;
+
+    if (!quest) {
+        if (!asterisk && len != exact)
+            return false;
+        return strncmp(tmpl, uri, exact) == 0;
+    }
+    if (len > exact && tmpl[exact] != uri[exact])
+        return false;
+    if (strncmp(tmpl, uri, exact) != 0)
+        return false;
+    return asterisk || len <= exact + 1;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val,
+                                      size_t val_size) {
+    conn_t *c = r->aux;
+    size_t field_len = strlen(field);
+    for (const char *line = c->headers; line && *line;) {
+        const char *end = strchr(line, '\n');
+        size_t line_len = end ? (size_t)(end - line) : strlen(line);
+        if (line_len > field_len && line[field_len] == ':' &&
+            !strncasecmp(line, field, field_len)) {
+            const char *v = line + field_len + 1;
+            while (*v == ' ')
+                v++;
+            size_t v_len = line_len - (size_t)(v - line);
+            if (val_size == 0)
+                return ESP_ERR_INVALID_ARG;
+            size_t n = v_len < val_size - 1 ? v_len : val_size - 1;
+            memcpy(val, v, n);
+            val[n] = '\0';
+            return n < v_len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+        }
+        line = end ? end + 1 : NULL;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *r, char *buf, size_t buf_len) {
+    const char *q = strchr(r->uri, '?');
+    if (!q || buf_len == 0)
+        return ESP_ERR_NOT_FOUND;
+    q++;
+    size_t len = strlen(q);
+    size_t n = len < buf_len - 1 ? len : buf_len - 1;
+    memcpy(buf, q, n);
+    buf[n] = '\0';
+    return n < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t val_size) {
+    size_t key_len = strlen(key);
+    for (const char *p = qry; p && *p;) {
+        const char *end = strchr(p, '&');
+        size_t pair_len = end ? (size_t)(end - p) : strlen(p);
+        if (pair_len > key_len && p[key_len] == '=' && !strncmp(p, key, key_len)) {
+            size_t v_len = pair_len - key_len - 1;
+            size_t n = v_len < val_size - 1 ? v_len : val_size - 1;
+            memcpy(val, p + key_len + 1, n);
+            val[n] = '\0';
+            return n < v_len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+        }
+        p = end ? end + 1 : NULL;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+int httpd_req_recv(httpd_req_t *r, char *buf, size_t buf_len) {
+    conn_t *c = r->aux;
+    if (c->dead)
+        return HTTPD_SOCK_ERR_FAIL;
+    size_t announced = c->content_len - c->body_read;
+    if (announced == 0)
+        return 0;
+
+    size_t avail = c->body_len - c->body_read;
+    if (avail == 0) {
+        // The client died before sending all it announced
+        pthread_mutex_lock(&lock);
+        c->dead = true;
+        pthread_mutex_unlock(&lock);
+        return HTTPD_SOCK_ERR_FAIL;
+    }
+
+    if (c->timeout_every && ++c->recv_calls % c->timeout_every == 0)
+        return HTTPD_SOCK_ERR_TIMEOUT;
+    if (c->recv_delay_ms)
+        host_test_sleep_ms(c->recv_delay_ms);
+    size_t n = buf_len;
+    if (n > avail)
+        n = avail;
+    if (n > announced)
+        n = announced;
+    memcpy(buf, c->body + c->body_read, n);
+    c->body_read += n;
+    return (int)n;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status) {
+    ((conn_t *)r->aux)->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type) {
+    ((conn_t *)r->aux)->type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value) {
+    conn_t *c = r->aux;
+    if (c->hdr_count >= server->cfg.max_resp_headers)
+        return ESP_ERR_HTTPD_RESP_HDR;
+    if (!c->hdrs)
+        c->hdrs = calloc(server->cfg.max_resp_headers, sizeof(*c->hdrs));
+    c->hdrs[c->hdr_count++] = (resp_hdr_t){field, value};
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len) {
+    conn_t *c = r->aux;
+    size_t len = buf_len == HTTPD_RESP_USE_STRLEN ? (buf ? strlen(buf) : 0) : (size_t)buf_len;
+
+    pthread_mutex_lock(&lock);
+    flush_headers_locked(c, false, len);
+    c->finished = true;
+    pthread_mutex_unlock(&lock);
+    return conn_send(c, buf, len, 0);
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len) {
+    conn_t *c = r->aux;
+    size_t len = buf_len == HTTPD_RESP_USE_STRLEN ? (buf ? strlen(buf) : 0) : (size_t)buf_len;
+
+    pthread_mutex_lock(&lock);
+    flush_headers_locked(c, true, 0);
+    if (!buf || !len)
+        c->finished = true;
+    pthread_mutex_unlock(&lock);
+
+    if (!buf || !len)
+        return conn_send(c, NULL, 0, strlen("0\r\n\r\n"));
+
+    char size_line[16];
+    return conn_send(c, buf, len, snprintf(size_line, sizeof(size_line), "%zx\r\n", len) + 2);
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg) {
+    if (error >= HTTPD_ERR_CODE_MAX)
+        error = HTTPD_500_INTERNAL_SERVER_ERROR;
+    httpd_resp_set_status(req, err_table[error].status);
+    httpd_resp_set_type(req, HTTPD_TYPE_TEXT);
+    return httpd_resp_send(req, msg ? msg : err_table[error].msg, HTTPD_RESP_USE_STRLEN);
+}
+
+esp_err_t httpd_req_async_handler_begin(httpd_req_t *r, httpd_req_t **out) {
+    httpd_req_t *copy = malloc(sizeof(*copy));
+    if (!copy)
+        return ESP_ERR_NO_MEM;
+    memcpy(copy, r, sizeof(*copy));
+
+    pthread_mutex_lock(&lock);
+    ((conn_t *)r->aux)->async++;
+    pthread_mutex_unlock(&lock);
+    *out = copy;
+    return ESP_OK;
+}
+
+esp_err_t httpd_req_async_handler_complete(httpd_req_t *r) {
+    conn_t *c = r->aux;
+    pthread_mutex_lock(&lock);
+    c->async--;
+    maybe_complete_locked(c);
+    pthread_mutex_unlock(&lock);
+    free(r);
+    return ESP_OK;
+}
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *arg) {
+    pthread_mutex_lock(&lock);
+    if (!server || handle != server || server->stopping) {
+        pthread_mutex_unlock(&lock);
+        return ESP_FAIL;
+    }
+    job_t *job = calloc(1, sizeof(*job));
+    job->type = JOB_WORK;
+    job->work = work;
+    job->arg = arg;
+    push_job_locked(job);
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+esp_err_t httpd_get_client_list(httpd_handle_t handle, size_t *fds, int *client_fds) {
+    (void)handle;
+    size_t n = 0;
+    pthread_mutex_lock(&lock);
+    for (conn_t *c = conns; c && n < *fds; c = c->next) {
+        if (c->open)
+            client_fds[n++] = c->fd;
+    }
+    pthread_mutex_unlock(&lock);
+    *fds = n;
+    return ESP_OK;
+}
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *pkt, size_t max_len) {
+    conn_t *c = req->aux;
+    if (!c->in_frame)
+        return ESP_FAIL;
+    pkt->final = true;
+    pkt->fragmented = false;
+    pkt->type = HTTPD_WS_TYPE_TEXT;
+    if (max_len == 0) {
+        pkt->len = c->in_len;
+        return ESP_OK;
+    }
+    size_t n = c->in_len < max_len ? c->in_len : max_len;
+    memcpy(pkt->payload, c->in_frame, n);
+    pkt->len = n;
+    return ESP_OK;
+}
+
+static esp_err_t ws_record_locked(conn_t *c, const httpd_ws_frame_t *frame) {
+    if (!c || !c->open || !c->websocket)
+        return ESP_FAIL;
+    if (c->out_count == c->out_cap) {
+        c->out_cap = c->out_cap ? c->out_cap * 2 : 8;
+        c->out_frames = realloc(c->out_frames, c->out_cap * sizeof(*c->out_frames));
+    }
+    c->out_frames[c->out_count++] = dup_n((const char *)frame->payload, frame->len);
+    pthread_cond_broadcast(&cond);
+    return ESP_OK;
+}
+
+esp_err_t httpd_ws_send_frame(httpd_req_t *req, httpd_ws_frame_t *pkt) {
+    pthread_mutex_lock(&lock);
+    esp_err_t err = ws_record_locked(req->aux, pkt);
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t *frame) {
+    (void)hd;
+    pthread_mutex_lock(&lock);
+    esp_err_t err = ws_record_locked(conn_by_fd_locked(fd), frame);
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t hd, int fd) {
+    (void)hd;
+    pthread_mutex_lock(&lock);
+    conn_t *c = conn_by_fd_locked(fd);
+    httpd_ws_client_info_t info = !c || !c->open ? HTTPD_WS_CLIENT_INVALID
+                                  : c->websocket ? HTTPD_WS_CLIENT_WEBSOCKET
+                                                 : HTTPD_WS_CLIENT_HTTP;
+    pthread_mutex_unlock(&lock);
+    return info;
+}
+
+/* Client side */
+
+static conn_t *conn_start(const fake_httpd_request_t *request, bool upgrade) {
+    conn_t *c = calloc(1, sizeof(*c));
+    c->method = request->method;
+    c->uri = dup_n(request->uri, strlen(request->uri));
+    c->headers = request->headers ? dup_n(request->headers, strlen(request->headers)) : NULL;
+    c->body = dup_n(request->body, request->body_len);
+    c->body_len = request->body_len;
+    c->content_len = request->content_len > request->body_len ? request->content_len
+                                                              : request->body_len;
+    c->send_delay_ms = request->send_delay_ms;
+    c->recv_delay_ms = request->recv_delay_ms;
+    c->timeout_every = request->timeout_every;
+    c->read_limit = request->read_limit;
+    c->upgrade = upgrade;
+    c->open = true;
+    c->resp.start_us = host_test_now_us();
+
+    pthread_mutex_lock(&lock);
+    if (!server || server->stopping) {
+        pthread_mutex_unlock(&lock);
+        conn_free(c);
+        return NULL;
+    }
+    c->fd = next_fd++;
+    c->next = conns;
+    conns = c;
+
+    job_t *job = calloc(1, sizeof(*job));
+    job->type = JOB_REQUEST;
+    job->conn = c;
+    push_job_locked(job);
+    pthread_mutex_unlock(&lock);
+    return c;
+}
+
+fake_httpd_resp_t *fake_httpd_start(const fake_httpd_request_t *request) {
+    conn_t *c = conn_start(request, false);
+    return c ? &c->resp : NULL;
+}
+
+bool fake_httpd_wait(fake_httpd_resp_t *resp, uint32_t timeout_ms) {
+    conn_t *c = (conn_t *)resp;
+    uint64_t deadline = host_test_now_us() + (uint64_t)timeout_ms * 1000;
+
+    pthread_mutex_lock(&lock);
+    while (!c->complete && host_test_now_us() < deadline) {
+        pthread_mutex_unlock(&lock);
+        host_test_sleep_ms(1);
+        pthread_mutex_lock(&lock);
+    }
+    bool done = c->complete;
+    pthread_mutex_unlock(&lock);
+    return done;
+}
+
+bool fake_httpd_done(const fake_httpd_resp_t *resp) {
+    pthread_mutex_lock(&lock);
+    bool done = ((const conn_t *)resp)->complete;
+    pthread_mutex_unlock(&lock);
+    return done;
+}
+
+void fake_httpd_free(fake_httpd_resp_t *resp) {
+    if (!resp)
+        return;
+    conn_t *c = (conn_t *)resp;
+    // Still referenced by a handler that never completed: leave it to the server
+    if (!fake_httpd_wait(resp, DEFAULT_WAIT_MS))
+        return;
+    pthread_mutex_lock(&lock);
+    conn_unlink_locked(c);
+    pthread_mutex_unlock(&lock);
+    conn_free(c);
+}
+
+fake_httpd_resp_t *fake_httpd_do(const fake_httpd_request_t *request) {
+    fake_httpd_resp_t *resp = fake_httpd_start(request);
+    if (resp && !fake_httpd_wait(resp, DEFAULT_WAIT_MS)) {
+        fprintf(stderr, "fake_httpd: %s did not complete\n", request->uri);
+        return NULL;
+    }
+    return resp;
+}
+
+fake_httpd_resp_t *fake_httpd_get(const char *uri, const char *headers) {
+    return fake_httpd_do(&(fake_httpd_request_t){.method = HTTP_GET, .uri = uri,
+                                                 .headers = headers});
+}
+
+const char *fake_httpd_header(const fake_httpd_resp_t *resp, const char *name, char *buf,
+                              size_t size) {
+    size_t name_len = strlen(name);
+    for (const char *line = resp->headers; line && *line;) {
+        const char *end = strchr(line, '\n');
+        size_t line_len = end ? (size_t)(end - line) : strlen(line);
+        if (line_len > name_len + 1 && line[name_len] == ':' &&
+            !strncasecmp(line, name, name_len)) {
+            snprintf(buf, size, "%.*s", (int)(line_len - name_len - 2), line + name_len + 2);
+            return buf;
+        }
+        line = end ? end + 1 : NULL;
+    }
+    return NULL;
+}
+
+void fake_httpd_sync(void) {
+    pthread_mutex_lock(&lock);
+    while (server && (jobs_head || busy))
+        pthread_cond_wait(&cond, &lock);
+    pthread_mutex_unlock(&lock);
+}
+
+bool fake_httpd_running(void) {
+    pthread_mutex_lock(&lock);
+    bool running = server != NULL;
+    pthread_mutex_unlock(&lock);
+    return running;
+}
+
+bool fake_httpd_secure(void) {
+    pthread_mutex_lock(&lock);
+    bool secure = server && server->secure;
+    pthread_mutex_unlock(&lock);
+    return secure;
+}
+
+int fake_httpd_ws_connect(const char *uri) {
+    conn_t *c = conn_start(&(fake_httpd_request_t){.method = HTTP_GET, .uri = uri,
+                                                   .headers = "Upgrade: websocket\n"},
+                           true);
+    if (!c)
+        return -1;
+    if (!fake_httpd_wait(&c->resp, DEFAULT_WAIT_MS))
+        return -1;
+
+    pthread_mutex_lock(&lock);
+    bool ws = c->websocket;
+    pthread_mutex_unlock(&lock);
+    if (!ws) {
+        fake_httpd_free(&c->resp);
+        return -1;
+    }
+    return c->fd;
+}
+
+static void ws_job(int fd, job_type_t type, const char *text) {
+    pthread_mutex_lock(&lock);
+    conn_t *c = conn_by_fd_locked(fd);
+    if (c && server && !server->stopping) {
+        job_t *job = calloc(1, sizeof(*job));
+        job->type = type;
+        job->conn = c;
+        job->frame = text ? dup_n(text, strlen(text)) : NULL;
+        push_job_locked(job);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void fake_httpd_ws_send(int fd, const char *text) { ws_job(fd, JOB_WS_FRAME, text); }
+
+void fake_httpd_ws_close(int fd) {
+    ws_job(fd, JOB_WS_CLOSE, NULL);
+    fake_httpd_sync();
+
+    pthread_mutex_lock(&lock);
+    conn_t *c = conn_by_fd_locked(fd);
+    if (c)
+        conn_unlink_locked(c);
+    pthread_mutex_unlock(&lock);
+    if (c)
+        conn_free(c);
+}
+
+bool fake_httpd_ws_open(int fd) {
+    pthread_mutex_lock(&lock);
+    conn_t *c = conn_by_fd_locked(fd);
+    bool open = c && c->open && c->websocket;
+    pthread_mutex_unlock(&lock);
+    return open;
+}
+
+size_t fake_httpd_ws_count(int fd) {
+    pthread_mutex_lock(&lock);
+    conn_t *c = conn_by_fd_locked(fd);
+    size_t n = c ? c->out_count : 0;
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+const char *fake_httpd_ws_frame(int fd, size_t index) {
+    pthread_mutex_lock(&lock);
+    conn_t *c = conn_by_fd_locked(fd);
+    const char *frame = c && index < c->out_count ? c->out_frames[index] : NULL;
+    pthread_mutex_unlock(&lock);
+    return frame;
+}
+
+const char *fake_httpd_ws_last(int fd) {
+    pthread_mutex_lock(&lock);
+    conn_t *c = conn_by_fd_locked(fd);
+    const char *frame = c && c->out_count ? c->out_frames[c->out_count - 1] : NULL;
+    pthread_mutex_unlock(&lock);
+    return frame;
+}
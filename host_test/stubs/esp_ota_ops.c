@@ -0,0 +1,96 @@
+/* OTA updates into the RAM partitions: sectors are erased as sequential writes reach them, like
+ * OTA_WITH_SEQUENTIAL_WRITES on the device. One update at a time. */
+#include "esp_ota_ops.h"
+#include <pthread.h>
+
+#define SECTOR_SIZE 4096
+#define IMAGE_MAGIC 0xE9 // esp_image_header_t.magic
+#define HANDLE 1
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static const esp_partition_t *target;
+static const esp_partition_t *boot;
+static size_t written, erased;
+
+const esp_partition_t *esp_ota_get_running_partition(void) {
+    return esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0,
+                                    NULL);
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from) {
+    (void)start_from;
+    return esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1,
+                                    NULL);
+}
+
+const esp_partition_t *esp_ota_get_boot_partition(void) {
+    pthread_mutex_lock(&lock);
+    const esp_partition_t *p = boot;
+    pthread_mutex_unlock(&lock);
+    return p ? p : esp_ota_get_running_partition();
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size,
+                        esp_ota_handle_t *out_handle) {
+    if (!partition || partition == esp_ota_get_running_partition())
+        return ESP_ERR_INVALID_ARG;
+    if (image_size != OTA_SIZE_UNKNOWN && image_size != OTA_WITH_SEQUENTIAL_WRITES &&
+        image_size > partition->size)
+        return ESP_ERR_INVALID_SIZE;
+
+    pthread_mutex_lock(&lock);
+    esp_err_t err = target ? ESP_ERR_INVALID_STATE : ESP_OK;
+    if (err == ESP_OK) {
+        target = partition;
+        written = erased = 0;
+        *out_handle = HANDLE;
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size) {
+    pthread_mutex_lock(&lock);
+    esp_err_t err = handle == HANDLE && target ? ESP_OK : ESP_ERR_INVALID_ARG;
+    if (err == ESP_OK && size > target->size - written)
+        err = ESP_ERR_INVALID_SIZE;
+    while (err == ESP_OK && erased < written + size) {
+        err = esp_partition_erase_range(target, erased, SECTOR_SIZE);
+        erased += SECTOR_SIZE;
+    }
+    if (err == ESP_OK)
+        err = esp_partition_write(target, written, data, size);
+    if (err == ESP_OK)
+        written += size;
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+    pthread_mutex_lock(&lock);
+    esp_err_t err = handle == HANDLE && target ? ESP_OK : ESP_ERR_NOT_FOUND;
+    uint8_t magic = 0;
+    if (err == ESP_OK && (written == 0 || esp_partition_read(target, 0, &magic, 1) != ESP_OK ||
+                          magic != IMAGE_MAGIC))
+        err = ESP_ERR_OTA_VALIDATE_FAILED;
+    target = NULL;
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+    pthread_mutex_lock(&lock);
+    esp_err_t err = handle == HANDLE && target ? ESP_OK : ESP_ERR_NOT_FOUND;
+    target = NULL;
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition) {
+    if (!partition || partition->type != ESP_PARTITION_TYPE_APP)
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&lock);
+    boot = partition;
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
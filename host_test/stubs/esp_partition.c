@@ -0,0 +1,188 @@
+/* RAM partitions: a fixed table, so the esp_partition_t pointers handed out stay valid. Writes
+ * can only clear bits, like NOR flash, until the range is erased again. */
+#include "esp_partition.h"
+#include "fake_partition.h"
+#include <pthread.h>
+#include <string.h>
+
+#define MAX_PARTITIONS 8
+#define SECTOR_SIZE 4096
+
+typedef struct {
+    bool used;
+    esp_partition_t part;
+    uint8_t *data;
+} slot_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static slot_t slots[MAX_PARTITIONS];
+static size_t mapped;
+
+static slot_t *slot_of(const esp_partition_t *partition) {
+    for (size_t i = 0; i < MAX_PARTITIONS; i++) {
+        if (slots[i].used && &slots[i].part == partition)
+            return &slots[i];
+    }
+    return NULL;
+}
+
+static slot_t *slot_by_label(const char *label) {
+    for (size_t i = 0; i < MAX_PARTITIONS; i++) {
+        if (slots[i].used && !strcmp(slots[i].part.label, label))
+            return &slots[i];
+    }
+    return NULL;
+}
+
+bool fake_partition_add(const char *label, esp_partition_type_t type,
+                        esp_partition_subtype_t subtype, size_t size, const char *path) {
+    uint8_t *data = malloc(size);
+    if (!data)
+        return false;
+    memset(data, 0xff, size);
+
+    if (path) {
+        FILE *f = fopen(path, "rb");
+        if (!f) {
+            free(data);
+            return false;
+        }
+        size_t n = fread(data, 1, size, f);
+        bool fits = n < size || fgetc(f) == EOF;
+        fclose(f);
+        if (!fits) {
+            free(data);
+            return false;
+        }
+    }
+
+    pthread_mutex_lock(&lock);
+    slot_t *s = slot_by_label(label);
+    for (size_t i = 0; !s && i < MAX_PARTITIONS; i++) {
+        if (!slots[i].used)
+            s = &slots[i];
+    }
+    if (!s) {
+        pthread_mutex_unlock(&lock);
+        free(data);
+        return false;
+    }
+    free(s->data);
+    s->used = true;
+    s->data = data;
+    s->part = (esp_partition_t){.type = type,
+                                .subtype = subtype,
+                                .address = 0x100000 * (uint32_t)(s - slots + 1),
+                                .size = size,
+                                .erase_size = SECTOR_SIZE};
+    snprintf(s->part.label, sizeof(s->part.label), "%s", label);
+    pthread_mutex_unlock(&lock);
+    return true;
+}
+
+void fake_partition_remove(const char *label) {
+    pthread_mutex_lock(&lock);
+    slot_t *s = slot_by_label(label);
+    if (s) {
+        free(s->data);
+        s->data = NULL;
+        s->used = false;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+uint8_t *fake_partition_data(const char *label) {
+    pthread_mutex_lock(&lock);
+    slot_t *s = slot_by_label(label);
+    pthread_mutex_unlock(&lock);
+    return s ? s->data : NULL;
+}
+
+size_t fake_partition_mapped(void) {
+    pthread_mutex_lock(&lock);
+    size_t n = mapped;
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char *label) {
+    const esp_partition_t *found = NULL;
+    pthread_mutex_lock(&lock);
+    for (size_t i = 0; i < MAX_PARTITIONS && !found; i++) {
+        const esp_partition_t *p = &slots[i].part;
+        if (slots[i].used && (type == ESP_PARTITION_TYPE_ANY || p->type == type) &&
+            (subtype == ESP_PARTITION_SUBTYPE_ANY || p->subtype == subtype) &&
+            (!label || !strcmp(p->label, label)))
+            found = p;
+    }
+    pthread_mutex_unlock(&lock);
+    return found;
+}
+
+static esp_err_t check_range(const slot_t *s, size_t offset, size_t size) {
+    if (!s)
+        return ESP_ERR_INVALID_ARG;
+    return offset > s->part.size || size > s->part.size - offset ? ESP_ERR_INVALID_SIZE : ESP_OK;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst,
+                             size_t size) {
+    pthread_mutex_lock(&lock);
+    slot_t *s = slot_of(partition);
+    esp_err_t err = check_range(s, src_offset, size);
+    if (err == ESP_OK)
+        memcpy(dst, s->data + src_offset, size);
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src,
+                              size_t size) {
+    pthread_mutex_lock(&lock);
+    slot_t *s = slot_of(partition);
+    esp_err_t err = check_range(s, dst_offset, size);
+    for (size_t i = 0; err == ESP_OK && i < size; i++) {
+        s->data[dst_offset + i] &= ((const uint8_t *)src)[i];
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+    if (offset % SECTOR_SIZE || size % SECTOR_SIZE)
+        return ESP_ERR_INVALID_ARG;
+
+    pthread_mutex_lock(&lock);
+    slot_t *s = slot_of(partition);
+    esp_err_t err = check_range(s, offset, size);
+    if (err == ESP_OK)
+        memset(s->data + offset, 0xff, size);
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void **out_ptr,
+                             esp_partition_mmap_handle_t *out_handle) {
+    (void)memory;
+    pthread_mutex_lock(&lock);
+    slot_t *s = slot_of(partition);
+    esp_err_t err = check_range(s, offset, size);
+    if (err == ESP_OK) {
+        *out_ptr = s->data + offset;
+        *out_handle = (esp_partition_mmap_handle_t)(s - slots + 1);
+        mapped++;
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle) {
+    (void)handle;
+    pthread_mutex_lock(&lock);
+    if (mapped > 0)
+        mapped--;
+    pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,550 @@
+/* FreeRTOS on pthreads. Enough of the kernel for component code to run unmodified on the host:
+ * tasks are detached threads, semaphores and queues share one condition-variable object, ticks
+ * are milliseconds of CLOCK_MONOTONIC. Priorities and stack sizes are ignored. */
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/ringbuf.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+struct host_task {
+    TaskFunction_t fn;
+    void *arg;
+    char name[16];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+};
+
+typedef enum { Q_QUEUE, Q_MUTEX, Q_RECURSIVE, Q_SEMAPHORE } queue_kind_t;
+
+struct host_queue {
+    queue_kind_t kind;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UBaseType_t length, item_size, count, head;
+    pthread_t owner; // Mutexes only
+    UBaseType_t depth;
+    uint8_t *items;
+};
+
+struct host_ringbuf {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint8_t *data;
+    size_t size, read, used;
+    size_t held; // Handed out by a receive, still counted in used
+};
+
+struct host_event_group {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    EventBits_t bits;
+};
+
+static _Thread_local TaskHandle_t current_task;
+static atomic_uint task_count;
+static pthread_mutex_t critical_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+static void cond_init(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static struct timespec deadline(TickType_t ticks) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ns = (uint64_t)ts.tv_nsec + (uint64_t)pdTICKS_TO_MS(ticks) * 1000000ULL;
+    ts.tv_sec += (time_t)(ns / 1000000000ULL);
+    ts.tv_nsec = (long)(ns % 1000000000ULL);
+    return ts;
+}
+
+// Waits on cond until pred holds; false on timeout. Lock must be held.
+#define WAIT_UNTIL(pred, cond, lock, ticks)                                                        \
+    ({                                                                                             \
+        bool ok_ = true;                                                                           \
+        struct timespec ts_ = deadline(ticks);                                                     \
+        while (!(pred)) {                                                                          \
+            if ((ticks) == portMAX_DELAY) {                                                        \
+                pthread_cond_wait(cond, lock);                                                     \
+            } else if ((ticks) == 0 ||                                                             \
+                       pthread_cond_timedwait(cond, lock, &ts_) == ETIMEDOUT) {                    \
+                ok_ = (pred);                                                                      \
+                break;                                                                             \
+            }                                                                                      \
+        }                                                                                          \
+        ok_;                                                                                       \
+    })
+
+/* ---- tasks ---- */
+
+static TaskHandle_t task_new(TaskFunction_t fn, void *arg, const char *name) {
+    TaskHandle_t task = calloc(1, sizeof(*task));
+    if (!task)
+        return NULL;
+    task->fn = fn;
+    task->arg = arg;
+    snprintf(task->name, sizeof(task->name), "%s", name ? name : "");
+    pthread_mutex_init(&task->lock, NULL);
+    cond_init(&task->cond);
+    return task;
+}
+
+// Threads not started by xTaskCreate (main, fake drivers) get a handle on first use
+static TaskHandle_t self(void) {
+    if (!current_task)
+        current_task = task_new(NULL, NULL, "main");
+    return current_task;
+}
+
+static void *task_main(void *arg) {
+    TaskHandle_t task = arg;
+    current_task = task;
+    task->fn(task->arg);
+    // Returning from a FreeRTOS task is a bug on the device; mirror vTaskDelete(NULL)
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *created,
+                                   BaseType_t core) {
+    (void)stack_depth, (void)priority, (void)core;
+    TaskHandle_t task = task_new(fn, arg, name);
+    if (!task)
+        return pdFAIL;
+
+    // Handle must be visible before the task runs, as with a higher-priority FreeRTOS task
+    if (created)
+        *created = task;
+    atomic_fetch_add(&task_count, 1);
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int rc = pthread_create(&thread, &attr, task_main, task);
+    pthread_attr_destroy(&attr);
+    if (rc) {
+        atomic_fetch_sub(&task_count, 1);
+        if (created)
+            *created = NULL;
+        free(task);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *created) {
+    return xTaskCreatePinnedToCore(fn, name, stack_depth, arg, priority, created, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task && task != current_task)
+        return;
+
+    task = current_task;
+    current_task = NULL;
+    if (task) {
+        if (task->fn)
+            atomic_fetch_sub(&task_count, 1);
+        pthread_cond_destroy(&task->cond);
+        pthread_mutex_destroy(&task->lock);
+        free(task);
+    }
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec ts = {.tv_sec = ticks / 1000, .tv_nsec = (long)(ticks % 1000) * 1000000L};
+    if (!ticks) {
+        sched_yield();
+        return;
+    }
+    while (nanosleep(&ts, &ts) && errno == EINTR) {
+    }
+}
+
+TickType_t xTaskGetTickCount(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)((uint64_t)ts.tv_sec * 1000U + (uint64_t)ts.tv_nsec / 1000000U);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) { return self(); }
+
+const char *pcTaskGetName(TaskHandle_t task) {
+    return (task ? task : self())->name;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void) { return atomic_load(&task_count); }
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    if (!task)
+        return pdFAIL;
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    TaskHandle_t task = self();
+    pthread_mutex_lock(&task->lock);
+    WAIT_UNTIL(task->notify > 0, &task->cond, &task->lock, ticks);
+    uint32_t value = task->notify;
+    if (value)
+        task->notify = clear_on_exit ? 0 : value - 1;
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+void host_enter_critical(portMUX_TYPE *mux) {
+    (void)mux;
+    pthread_mutex_lock(&critical_lock);
+}
+
+void host_exit_critical(portMUX_TYPE *mux) {
+    (void)mux;
+    pthread_mutex_unlock(&critical_lock);
+}
+
+/* ---- queues and semaphores ---- */
+
+static QueueHandle_t queue_new(queue_kind_t kind, UBaseType_t length, UBaseType_t item_size,
+                               UBaseType_t count) {
+    QueueHandle_t q = calloc(1, sizeof(*q));
+    if (!q)
+        return NULL;
+    if (item_size) {
+        q->items = calloc(length, item_size);
+        if (!q->items) {
+            free(q);
+            return NULL;
+        }
+    }
+    q->kind = kind;
+    q->length = length;
+    q->item_size = item_size;
+    q->count = count;
+    pthread_mutex_init(&q->lock, NULL);
+    cond_init(&q->cond);
+    return q;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    return queue_new(Q_QUEUE, length, item_size, 0);
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *storage,
+                                 StaticQueue_t *buffer) {
+    (void)storage, (void)buffer;
+    return xQueueCreate(length, item_size);
+}
+
+void vQueueDelete(QueueHandle_t q) {
+    if (!q)
+        return;
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->lock);
+    free(q->items);
+    free(q);
+}
+
+static BaseType_t queue_send(QueueHandle_t q, const void *item, TickType_t ticks, bool front) {
+    pthread_mutex_lock(&q->lock);
+    if (!WAIT_UNTIL(q->count < q->length, &q->cond, &q->lock, ticks)) {
+        pthread_mutex_unlock(&q->lock);
+        return errQUEUE_FULL;
+    }
+    UBaseType_t slot;
+    if (front) {
+        q->head = (q->head + q->length - 1) % q->length;
+        slot = q->head;
+    } else {
+        slot = (q->head + q->count) % q->length;
+    }
+    if (q->item_size)
+        memcpy(q->items + (size_t)slot * q->item_size, item, q->item_size);
+    q->count++;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks) {
+    return queue_send(q, item, ticks, false);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t q, const void *item, TickType_t ticks) {
+    return queue_send(q, item, ticks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t q, const void *item, TickType_t ticks) {
+    return queue_send(q, item, ticks, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks) {
+    pthread_mutex_lock(&q->lock);
+    if (!WAIT_UNTIL(q->count > 0, &q->cond, &q->lock, ticks)) {
+        pthread_mutex_unlock(&q->lock);
+        return pdFALSE;
+    }
+    if (q->item_size)
+        memcpy(item, q->items + (size_t)q->head * q->item_size, q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t q) {
+    pthread_mutex_lock(&q->lock);
+    q->count = q->head = 0;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q) {
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->length - q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) { return queue_new(Q_MUTEX, 1, 0, 1); }
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer) {
+    (void)buffer;
+    return xSemaphoreCreateMutex();
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void) {
+    return queue_new(Q_RECURSIVE, 1, 0, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) { return queue_new(Q_SEMAPHORE, 1, 0, 0); }
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer) {
+    (void)buffer;
+    return xSemaphoreCreateBinary();
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+    return queue_new(Q_SEMAPHORE, max_count, 0, initial_count);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) { vQueueDelete(sem); }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    pthread_mutex_lock(&sem->lock);
+    if (sem->kind == Q_RECURSIVE && sem->depth && pthread_equal(sem->owner, pthread_self())) {
+        sem->depth++;
+        pthread_mutex_unlock(&sem->lock);
+        return pdTRUE;
+    }
+    if (!WAIT_UNTIL(sem->count > 0, &sem->cond, &sem->lock, ticks)) {
+        pthread_mutex_unlock(&sem->lock);
+        return pdFALSE;
+    }
+    sem->count--;
+    if (sem->kind == Q_MUTEX || sem->kind == Q_RECURSIVE) {
+        sem->owner = pthread_self();
+        sem->depth = 1;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    pthread_mutex_lock(&sem->lock);
+    if (sem->kind == Q_MUTEX || sem->kind == Q_RECURSIVE) {
+        // Giving a mutex the caller does not hold fails, as in FreeRTOS
+        if (!sem->depth || !pthread_equal(sem->owner, pthread_self())) {
+            pthread_mutex_unlock(&sem->lock);
+            return pdFALSE;
+        }
+        if (--sem->depth) {
+            pthread_mutex_unlock(&sem->lock);
+            return pdTRUE;
+        }
+    } else if (sem->count >= sem->length) {
+        pthread_mutex_unlock(&sem->lock);
+        return pdFALSE;
+    }
+    sem->count++;
+    pthread_cond_broadcast(&sem->cond);
+    pthread_mutex_unlock(&sem->lock);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks) {
+    return xSemaphoreTake(sem, ticks);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem) { return xSemaphoreGive(sem); }
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t sem) { return uxQueueMessagesWaiting(sem); }
+
+/* ---- event groups ---- */
+
+EventGroupHandle_t xEventGroupCreate(void) {
+    EventGroupHandle_t group = calloc(1, sizeof(*group));
+    if (!group)
+        return NULL;
+    pthread_mutex_init(&group->lock, NULL);
+    cond_init(&group->cond);
+    return group;
+}
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *buffer) {
+    (void)buffer;
+    return xEventGroupCreate();
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+    if (!group)
+        return;
+    pthread_cond_destroy(&group->cond);
+    pthread_mutex_destroy(&group->lock);
+    free(group);
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    pthread_mutex_lock(&group->lock);
+    EventBits_t bits = group->bits;
+    pthread_mutex_unlock(&group->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    pthread_mutex_lock(&group->lock);
+    group->bits |= bits;
+    EventBits_t now = group->bits;
+    pthread_cond_broadcast(&group->cond);
+    pthread_mutex_unlock(&group->lock);
+    return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    pthread_mutex_lock(&group->lock);
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return before;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks) {
+    pthread_mutex_lock(&group->lock);
+    bool met = WAIT_UNTIL(wait_for_all ? (group->bits & bits) == bits : (group->bits & bits) != 0,
+                          &group->cond, &group->lock, ticks);
+    EventBits_t value = group->bits;
+    if (met && clear_on_exit)
+        group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return value;
+}
+
+/* ---- byte ring buffers ---- */
+
+RingbufHandle_t xRingbufferCreate(size_t size, RingbufferType_t type) {
+    if (type != RINGBUF_TYPE_BYTEBUF || size == 0)
+        return NULL;
+    RingbufHandle_t ring = calloc(1, sizeof(*ring));
+    if (!ring)
+        return NULL;
+    ring->data = malloc(size);
+    if (!ring->data) {
+        free(ring);
+        return NULL;
+    }
+    ring->size = size;
+    pthread_mutex_init(&ring->lock, NULL);
+    cond_init(&ring->cond);
+    return ring;
+}
+
+void vRingbufferDelete(RingbufHandle_t ring) {
+    if (!ring)
+        return;
+    pthread_mutex_destroy(&ring->lock);
+    pthread_cond_destroy(&ring->cond);
+    free(ring->data);
+    free(ring);
+}
+
+BaseType_t xRingbufferSend(RingbufHandle_t ring, const void *data, size_t size, TickType_t ticks) {
+    if (size > ring->size)
+        return pdFALSE;
+    pthread_mutex_lock(&ring->lock);
+    bool fits = WAIT_UNTIL(ring->size - ring->used >= size, &ring->cond, &ring->lock, ticks);
+    if (fits) {
+        size_t write = (ring->read + ring->used) % ring->size;
+        size_t first = size < ring->size - write ? size : ring->size - write;
+        memcpy(ring->data + write, data, first);
+        memcpy(ring->data, (const uint8_t *)data + first, size - first);
+        ring->used += size;
+        pthread_cond_broadcast(&ring->cond);
+    }
+    pthread_mutex_unlock(&ring->lock);
+    return fits ? pdTRUE : pdFALSE;
+}
+
+void *xRingbufferReceiveUpTo(RingbufHandle_t ring, size_t *size, TickType_t ticks,
+                             size_t max_size) {
+    pthread_mutex_lock(&ring->lock);
+    bool ready = ring->held == 0 &&
+                 WAIT_UNTIL(ring->used > 0, &ring->cond, &ring->lock, ticks) && max_size > 0;
+    void *item = NULL;
+    if (ready) {
+        size_t n = ring->used < ring->size - ring->read ? ring->used : ring->size - ring->read;
+        ring->held = n < max_size ? n : max_size;
+        *size = ring->held;
+        item = ring->data + ring->read;
+    }
+    pthread_mutex_unlock(&ring->lock);
+    return item;
+}
+
+void *xRingbufferReceive(RingbufHandle_t ring, size_t *size, TickType_t ticks) {
+    return xRingbufferReceiveUpTo(ring, size, ticks, ring->size);
+}
+
+void vRingbufferReturnItem(RingbufHandle_t ring, void *item) {
+    pthread_mutex_lock(&ring->lock);
+    if (item == ring->data + ring->read && ring->held) {
+        ring->read = (ring->read + ring->held) % ring->size;
+        ring->used -= ring->held;
+        ring->held = 0;
+        pthread_cond_broadcast(&ring->cond);
+    }
+    pthread_mutex_unlock(&ring->lock);
+}
+
+size_t xRingbufferGetCurFreeSize(RingbufHandle_t ring) {
+    pthread_mutex_lock(&ring->lock);
+    size_t free_size = ring->size - ring->used;
+    pthread_mutex_unlock(&ring->lock);
+    return free_size;
+}
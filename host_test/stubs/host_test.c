@@ -0,0 +1,44 @@
+#include "host_test.h"
+#include <malloc.h>
+#include <time.h>
+
+#if defined(__SANITIZE_ADDRESS__)
+// From <sanitizer/allocator_interface.h>, which not every toolchain installs
+size_t __sanitizer_get_current_allocated_bytes(void);
+#endif
+
+int host_test_failures;
+
+uint64_t host_test_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+void host_test_sleep_ms(uint32_t ms) {
+    struct timespec ts = {.tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+size_t host_test_heap_bytes(void) {
+#if defined(__SANITIZE_ADDRESS__)
+    // ASan replaces malloc, so mallinfo2() would only see its own bookkeeping
+    return __sanitizer_get_current_allocated_bytes();
+#else
+    return mallinfo2().uordblks;
+#endif
+}
+
+void host_test_bench(const char *name, double value, const char *unit) {
+    printf("BENCH %s: %.2f %s\n", name, value, unit);
+    fflush(stdout);
+}
+
+int host_test_done(const char *name) {
+    if (host_test_failures) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, host_test_failures);
+        return 1;
+    }
+    printf("%s: OK\n", name);
+    return 0;
+}
@@ -0,0 +1,526 @@
+/* In-process MQTT broker behind the host mqtt_client.h. One client at a time; events are posted to
+ * a queue and dispatched on a dedicated thread, like the esp-mqtt task. Return values follow
+ * esp-mqtt: msg_id 0 for QoS 0, -1 when the message cannot be sent or stored. */
+#include "fake_mqtt.h"
+#include "mqtt_client.h"
+#include <pthread.h>
+
+#define ALIAS_TABLE_SIZE 65536
+
+typedef struct event {
+    struct event *next;
+    esp_mqtt_event_id_t id;
+    int msg_id;
+    char *topic;
+    char *payload;
+    char *response_topic;
+    char *correlation;
+    uint16_t correlation_len;
+} event_t;
+
+typedef struct {
+    int msg_id;
+    size_t bytes;
+} outbox_entry_t;
+
+struct esp_mqtt_client {
+    esp_event_handler_t handler;
+    void *handler_args;
+    esp_mqtt_protocol_ver_t protocol_ver;
+    bool started;
+    size_t out_buffer; // esp-mqtt's output buffer, larger messages are written in chunks of it
+    esp_mqtt5_publish_property_config_t prop;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static pthread_t event_thread;
+static bool event_thread_running;
+static bool dispatching;
+static event_t *events_head, *events_tail;
+
+static esp_mqtt_client_handle_t client;
+static bool connected;
+static int next_msg_id = 1;
+
+static fake_mqtt_msg_t **log_msgs;
+static size_t log_count, log_cap;
+static bool record = true;
+static size_t published;
+
+static outbox_entry_t *outbox;
+static size_t outbox_count, outbox_cap;
+static bool auto_ack;
+
+static uint16_t alias_max = UINT16_MAX;
+static size_t refused;
+static char **alias_topics; // Broker side alias -> topic table, reset on every connect
+
+static char *dup_n(const char *s, size_t len) {
+    if (!s)
+        return NULL;
+    char *copy = malloc(len + 1);
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+static char *dup_s(const char *s) { return s ? dup_n(s, strlen(s)) : NULL; }
+
+static void *event_loop(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (!events_head)
+            pthread_cond_wait(&cond, &lock);
+
+        event_t *ev = events_head;
+        events_head = ev->next;
+        if (!events_head)
+            events_tail = NULL;
+
+        esp_mqtt_client_handle_t target = client;
+        dispatching = true;
+        pthread_mutex_unlock(&lock);
+
+        if (target && target->handler) {
+            esp_mqtt5_event_property_t prop = {
+                .response_topic = ev->response_topic,
+                .response_topic_len = ev->response_topic ? (int)strlen(ev->response_topic) : 0,
+                .correlation_data = ev->correlation,
+                .correlation_data_len = ev->correlation_len,
+            };
+            esp_mqtt_event_t event = {
+                .event_id = ev->id,
+                .client = target,
+                .msg_id = ev->msg_id,
+                .topic = ev->topic,
+                .topic_len = ev->topic ? (int)strlen(ev->topic) : 0,
+                .data = ev->payload,
+                .data_len = ev->payload ? (int)strlen(ev->payload) : 0,
+                .total_data_len = ev->payload ? (int)strlen(ev->payload) : 0,
+                .protocol_ver = target->protocol_ver,
+                .property = target->protocol_ver == MQTT_PROTOCOL_V_5 ? &prop : NULL,
+            };
+            target->handler(target->handler_args, "MQTT_EVENTS", ev->id, &event);
+        }
+
+        free(ev->topic);
+        free(ev->payload);
+        free(ev->response_topic);
+        free(ev->correlation);
+        free(ev);
+
+        pthread_mutex_lock(&lock);
+        dispatching = false;
+        pthread_cond_broadcast(&cond);
+    }
+    return NULL;
+}
+
+// Caller holds lock; takes ownership of ev
+static void post_locked(event_t *ev) {
+    if (!event_thread_running) {
+        pthread_create(&event_thread, NULL, event_loop, NULL);
+        pthread_detach(event_thread);
+        event_thread_running = true;
+    }
+    ev->next = NULL;
+    if (events_tail)
+        events_tail->next = ev;
+    else
+        events_head = ev;
+    events_tail = ev;
+    pthread_cond_broadcast(&cond);
+}
+
+static void post_simple_locked(esp_mqtt_event_id_t id, int msg_id) {
+    event_t *ev = calloc(1, sizeof(*ev));
+    ev->id = id;
+    ev->msg_id = msg_id;
+    post_locked(ev);
+}
+
+static void record_locked(fake_mqtt_msg_t *msg) {
+    published++;
+    if (!record) {
+        free(msg->topic);
+        free(msg->payload);
+        free(msg->correlation);
+        free(msg);
+        return;
+    }
+    if (log_count == log_cap) {
+        log_cap = log_cap ? log_cap * 2 : 256;
+        log_msgs = realloc(log_msgs, log_cap * sizeof(*log_msgs));
+    }
+    log_msgs[log_count++] = msg;
+}
+
+static void outbox_add_locked(int msg_id, size_t bytes) {
+    if (outbox_count == outbox_cap) {
+        outbox_cap = outbox_cap ? outbox_cap * 2 : 64;
+        outbox = realloc(outbox, outbox_cap * sizeof(*outbox));
+    }
+    outbox[outbox_count++] = (outbox_entry_t){msg_id, bytes};
+}
+
+static bool ack_locked(int msg_id) {
+    for (size_t i = 0; i < outbox_count; i++) {
+        if (outbox[i].msg_id == msg_id) {
+            memmove(&outbox[i], &outbox[i + 1], (outbox_count - i - 1) * sizeof(*outbox));
+            outbox_count--;
+            post_simple_locked(MQTT_EVENT_PUBLISHED, msg_id);
+            return true;
+        }
+    }
+    return false;
+}
+
+static int publish(esp_mqtt_client_handle_t c, const char *topic, const char *data, int len,
+                   int qos, int retain, bool enqueued) {
+    if (!c || !topic)
+        return -1;
+    if (!data)
+        data = "";
+    if (len <= 0)
+        len = (int)strlen(data);
+
+    pthread_mutex_lock(&lock);
+
+    const esp_mqtt5_publish_property_config_t *prop =
+        c->protocol_ver == MQTT_PROTOCOL_V_5 ? &c->prop : NULL;
+    uint16_t alias = prop ? prop->topic_alias : 0;
+
+    // esp-mqtt checks the alias against the CONNACK Topic Alias Maximum before sending
+    if (alias > alias_max) {
+        refused++;
+        pthread_mutex_unlock(&lock);
+        return -1;
+    }
+
+    // Without a connection only messages that go to the outbox survive
+    bool stored = qos > 0 || enqueued;
+    if (!connected && !stored) {
+        pthread_mutex_unlock(&lock);
+        return -1;
+    }
+
+    fake_mqtt_msg_t *msg = calloc(1, sizeof(*msg));
+    msg->qos = qos;
+    msg->retain = retain;
+    msg->enqueued = enqueued;
+    msg->payload = dup_n(data, (size_t)len);
+    msg->alias = alias;
+    msg->alias_only = alias && !topic[0];
+    if (prop) {
+        msg->expiry_s = prop->message_expiry_interval;
+        msg->correlation_len = prop->correlation_data ? prop->correlation_data_len : 0;
+        msg->correlation = dup_n(prop->correlation_data, msg->correlation_len);
+    }
+
+    bool protocol_error = false;
+    if (msg->alias_only) {
+        protocol_error = !alias_topics[alias];
+        msg->topic = dup_s(protocol_error ? "" : alias_topics[alias]);
+    } else {
+        msg->topic = dup_s(topic);
+        if (alias) {
+            free(alias_topics[alias]);
+            alias_topics[alias] = dup_s(topic);
+        }
+    }
+    size_t size = strlen(msg->topic) + (size_t)len;
+    msg->chunks = (size + c->out_buffer - 1) / c->out_buffer;
+
+    msg->msg_id = qos > 0 ? next_msg_id++ : 0;
+    if (qos > 0) {
+        outbox_add_locked(msg->msg_id, size);
+        if (auto_ack && connected)
+            ack_locked(msg->msg_id);
+    }
+    int msg_id = msg->msg_id;
+    record_locked(msg);
+
+    // A broker drops the connection on an alias it does not know
+    if (protocol_error && connected) {
+        connected = false;
+        post_simple_locked(MQTT_EVENT_DISCONNECTED, 0);
+    }
+
+    pthread_mutex_unlock(&lock);
+    return msg_id;
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config) {
+    esp_mqtt_client_handle_t c = calloc(1, sizeof(*c));
+    c->protocol_ver = config->session.protocol_ver == MQTT_PROTOCOL_V_5 ? MQTT_PROTOCOL_V_5
+                                                                       : MQTT_PROTOCOL_V_3_1_1;
+    // Like esp-mqtt: out_size defaults to size, which defaults to 1024
+    int out_buffer = config->buffer.out_size ? config->buffer.out_size : config->buffer.size;
+    c->out_buffer = out_buffer > 0 ? (size_t)out_buffer : 1024;
+    pthread_mutex_lock(&lock);
+    if (!alias_topics)
+        alias_topics = calloc(ALIAS_TABLE_SIZE, sizeof(*alias_topics));
+    client = c;
+    pthread_mutex_unlock(&lock);
+    return c;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t c, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t handler, void *handler_args) {
+    (void)event;
+    if (!c)
+        return ESP_ERR_INVALID_ARG;
+    c->handler = handler;
+    c->handler_args = handler_args;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t c) {
+    if (!c)
+        return ESP_ERR_INVALID_ARG;
+    c->started = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t c) {
+    if (!c)
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&lock);
+    c->started = false;
+    connected = false;
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t c) {
+    if (!c)
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&lock);
+    // Wait for a dispatch in flight so the handler never sees a freed client
+    while (dispatching || events_head)
+        pthread_cond_wait(&cond, &lock);
+    if (client == c)
+        client = NULL;
+    pthread_mutex_unlock(&lock);
+    free(c);
+    return ESP_OK;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t c, const char *topic, const char *data,
+                            int len, int qos, int retain) {
+    return publish(c, topic, data, len, qos, retain, false);
+}
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t c, const char *topic, const char *data,
+                            int len, int qos, int retain, bool store) {
+    (void)store;
+    return publish(c, topic, data, len, qos, retain, true);
+}
+
+int esp_mqtt_client_subscribe_single(esp_mqtt_client_handle_t c, const char *topic, int qos) {
+    (void)topic;
+    (void)qos;
+    if (!c)
+        return -1;
+    pthread_mutex_lock(&lock);
+    int msg_id = connected ? next_msg_id++ : -1;
+    pthread_mutex_unlock(&lock);
+    return msg_id;
+}
+
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t c) {
+    (void)c;
+    pthread_mutex_lock(&lock);
+    size_t bytes = 0;
+    for (size_t i = 0; i < outbox_count; i++) {
+        bytes += outbox[i].bytes;
+    }
+    pthread_mutex_unlock(&lock);
+    return (int)bytes;
+}
+
+esp_err_t esp_mqtt5_client_set_publish_property(esp_mqtt_client_handle_t c,
+                                                const esp_mqtt5_publish_property_config_t *prop) {
+    if (!c || !prop)
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&lock);
+    c->prop = *prop;
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+static void clear_log_locked(void) {
+    for (size_t i = 0; i < log_count; i++) {
+        free(log_msgs[i]->topic);
+        free(log_msgs[i]->payload);
+        free(log_msgs[i]->correlation);
+        free(log_msgs[i]);
+    }
+    log_count = 0;
+}
+
+void fake_mqtt_reset(void) {
+    pthread_mutex_lock(&lock);
+    clear_log_locked();
+    outbox_count = 0;
+    auto_ack = false;
+    record = true;
+    published = 0;
+    refused = 0;
+    alias_max = UINT16_MAX;
+    pthread_mutex_unlock(&lock);
+}
+
+void fake_mqtt_connect(void) {
+    pthread_mutex_lock(&lock);
+    connected = true;
+    if (alias_topics) {
+        for (size_t i = 0; i < ALIAS_TABLE_SIZE; i++) {
+            free(alias_topics[i]);
+            alias_topics[i] = NULL;
+        }
+    }
+    post_simple_locked(MQTT_EVENT_CONNECTED, 0);
+    // Messages left in the outbox are retransmitted on the new connection
+    if (auto_ack) {
+        while (outbox_count)
+            ack_locked(outbox[0].msg_id);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void fake_mqtt_disconnect(void) {
+    pthread_mutex_lock(&lock);
+    connected = false;
+    post_simple_locked(MQTT_EVENT_DISCONNECTED, 0);
+    pthread_mutex_unlock(&lock);
+}
+
+void fake_mqtt_sync(void) {
+    pthread_mutex_lock(&lock);
+    while (events_head || dispatching)
+        pthread_cond_wait(&cond, &lock);
+    pthread_mutex_unlock(&lock);
+}
+
+void fake_mqtt_deliver(const char *topic, const char *payload, const char *response_topic,
+                       const char *correlation, uint16_t correlation_len) {
+    event_t *ev = calloc(1, sizeof(*ev));
+    ev->id = MQTT_EVENT_DATA;
+    ev->topic = dup_s(topic);
+    ev->payload = dup_s(payload);
+    ev->response_topic = dup_s(response_topic);
+    ev->correlation_len = correlation ? correlation_len : 0;
+    ev->correlation = dup_n(correlation, ev->correlation_len);
+
+    pthread_mutex_lock(&lock);
+    post_locked(ev);
+    pthread_mutex_unlock(&lock);
+}
+
+bool fake_mqtt_ack(int msg_id) {
+    pthread_mutex_lock(&lock);
+    bool found = ack_locked(msg_id);
+    pthread_mutex_unlock(&lock);
+    return found;
+}
+
+size_t fake_mqtt_ack_all(void) {
+    pthread_mutex_lock(&lock);
+    size_t n = 0;
+    while (outbox_count) {
+        ack_locked(outbox[0].msg_id);
+        n++;
+    }
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+void fake_mqtt_set_auto_ack(bool on) {
+    pthread_mutex_lock(&lock);
+    auto_ack = on;
+    if (on && connected) {
+        while (outbox_count)
+            ack_locked(outbox[0].msg_id);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void fake_mqtt_set_topic_alias_max(uint16_t max) {
+    pthread_mutex_lock(&lock);
+    alias_max = max;
+    pthread_mutex_unlock(&lock);
+}
+
+size_t fake_mqtt_refused(void) {
+    pthread_mutex_lock(&lock);
+    size_t n = refused;
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+void fake_mqtt_set_record(bool on) {
+    pthread_mutex_lock(&lock);
+    record = on;
+    pthread_mutex_unlock(&lock);
+}
+
+size_t fake_mqtt_published(void) {
+    pthread_mutex_lock(&lock);
+    size_t n = published;
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+size_t fake_mqtt_count(void) {
+    pthread_mutex_lock(&lock);
+    size_t n = log_count;
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+const fake_mqtt_msg_t *fake_mqtt_get(size_t index) {
+    pthread_mutex_lock(&lock);
+    const fake_mqtt_msg_t *msg = index < log_count ? log_msgs[index] : NULL;
+    pthread_mutex_unlock(&lock);
+    return msg;
+}
+
+const fake_mqtt_msg_t *fake_mqtt_last(const char *topic) {
+    pthread_mutex_lock(&lock);
+    const fake_mqtt_msg_t *msg = NULL;
+    for (size_t i = log_count; i-- > 0;) {
+        if (!strcmp(log_msgs[i]->topic, topic)) {
+            msg = log_msgs[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return msg;
+}
+
+size_t fake_mqtt_count_prefix(const char *prefix) {
+    size_t len = strlen(prefix);
+    pthread_mutex_lock(&lock);
+    size_t n = 0;
+    for (size_t i = 0; i < log_count; i++) {
+        n += !strncmp(log_msgs[i]->topic, prefix, len);
+    }
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+size_t fake_mqtt_outbox_count(void) {
+    pthread_mutex_lock(&lock);
+    size_t n = outbox_count;
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+void fake_mqtt_clear_log(void) {
+    pthread_mutex_lock(&lock);
+    clear_log_locked();
+    pthread_mutex_unlock(&lock);
+}
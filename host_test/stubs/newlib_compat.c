@@ -0,0 +1,21 @@
+#include "newlib_compat.h"
+#include <string.h>
+
+#if HOST_NEED_STRLCPY
+size_t strlcpy(char *dst, const char *src, size_t size) {
+    size_t len = strlen(src);
+    if (size) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+
+size_t strlcat(char *dst, const char *src, size_t size) {
+    size_t used = strnlen(dst, size);
+    if (used == size)
+        return size + strlen(src);
+    return used + strlcpy(dst + used, src, size - used);
+}
+#endif
@@ -0,0 +1,306 @@
+/* In-memory NVS: one partition, values survive nvs_close() until fake_nvs_reset(). Writes are
+ * visible before nvs_commit(), as with the real implementation. */
+#include "fake_nvs.h"
+#include "nvs.h"
+#include <pthread.h>
+#include <string.h>
+
+#define MAX_HANDLES 32
+
+typedef struct {
+    char ns[NVS_NS_NAME_MAX_SIZE];
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_type_t type;
+    void *data;
+    size_t len;
+} entry_t;
+
+typedef struct {
+    bool used;
+    bool writable;
+    char ns[NVS_NS_NAME_MAX_SIZE];
+} handle_t;
+
+struct nvs_opaque_iterator_t {
+    size_t pos, count;
+    nvs_entry_info_t *infos;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static entry_t *entries;
+static size_t entry_count, entry_cap;
+static handle_t handles[MAX_HANDLES];
+static size_t writes;
+
+static bool name_ok(const char *name) {
+    return name && *name && strlen(name) < NVS_KEY_NAME_MAX_SIZE;
+}
+
+static handle_t *get_handle(nvs_handle_t h) {
+    return (h >= 1 && h <= MAX_HANDLES && handles[h - 1].used) ? &handles[h - 1] : NULL;
+}
+
+static entry_t *find(const char *ns, const char *key) {
+    for (size_t i = 0; i < entry_count; i++) {
+        if (!strcmp(entries[i].ns, ns) && !strcmp(entries[i].key, key))
+            return &entries[i];
+    }
+    return NULL;
+}
+
+static void drop(size_t i) {
+    free(entries[i].data);
+    entries[i] = entries[--entry_count];
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out) {
+    if (!name_ok(namespace_name))
+        return ESP_ERR_NVS_INVALID_NAME;
+
+    pthread_mutex_lock(&lock);
+    for (size_t i = 0; i < MAX_HANDLES; i++) {
+        if (!handles[i].used) {
+            handles[i] = (handle_t){.used = true, .writable = open_mode == NVS_READWRITE};
+            snprintf(handles[i].ns, sizeof(handles[i].ns), "%s", namespace_name);
+            *out = (nvs_handle_t)(i + 1);
+            pthread_mutex_unlock(&lock);
+            return ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t h) {
+    pthread_mutex_lock(&lock);
+    handle_t *handle = get_handle(h);
+    if (handle)
+        handle->used = false;
+    pthread_mutex_unlock(&lock);
+}
+
+esp_err_t nvs_commit(nvs_handle_t h) {
+    pthread_mutex_lock(&lock);
+    esp_err_t err = get_handle(h) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+static esp_err_t set_value(nvs_handle_t h, const char *key, nvs_type_t type, const void *value,
+                           size_t len) {
+    if (!name_ok(key))
+        return ESP_ERR_NVS_INVALID_NAME;
+
+    pthread_mutex_lock(&lock);
+    handle_t *handle = get_handle(h);
+    esp_err_t err = !handle ? ESP_ERR_NVS_INVALID_HANDLE
+                    : !handle->writable ? ESP_ERR_NVS_READ_ONLY
+                                        : ESP_OK;
+    void *copy = err == ESP_OK ? malloc(len ? len : 1) : NULL;
+    if (err == ESP_OK && !copy)
+        err = ESP_ERR_NO_MEM;
+    if (err != ESP_OK) {
+        pthread_mutex_unlock(&lock);
+        return err;
+    }
+    memcpy(copy, value, len);
+
+    entry_t *e = find(handle->ns, key);
+    if (!e) {
+        if (entry_count == entry_cap) {
+            size_t cap = entry_cap ? entry_cap * 2 : 64;
+            entry_t *grown = realloc(entries, cap * sizeof(*grown));
+            if (!grown) {
+                free(copy);
+                pthread_mutex_unlock(&lock);
+                return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+            }
+            entries = grown;
+            entry_cap = cap;
+        }
+        e = &entries[entry_count++];
+        memset(e, 0, sizeof(*e));
+        snprintf(e->ns, sizeof(e->ns), "%s", handle->ns);
+        snprintf(e->key, sizeof(e->key), "%s", key);
+    } else {
+        free(e->data);
+    }
+    e->type = type;
+    e->data = copy;
+    e->len = len;
+    writes++;
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+// Copies out a value; variable-length types follow the NVS length protocol
+static esp_err_t get_value(nvs_handle_t h, const char *key, nvs_type_t type, void *out,
+                           size_t *len) {
+    pthread_mutex_lock(&lock);
+    handle_t *handle = get_handle(h);
+    if (!handle) {
+        pthread_mutex_unlock(&lock);
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    entry_t *e = find(handle->ns, key);
+    esp_err_t err = !e ? ESP_ERR_NVS_NOT_FOUND
+                    : e->type != type ? ESP_ERR_NVS_TYPE_MISMATCH
+                                      : ESP_OK;
+    if (err == ESP_OK) {
+        if (!out) {
+            *len = e->len;
+        } else if (*len < e->len) {
+            err = ESP_ERR_NVS_INVALID_LENGTH;
+        } else {
+            memcpy(out, e->data, e->len);
+            *len = e->len;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t h, const char *key) {
+    pthread_mutex_lock(&lock);
+    handle_t *handle = get_handle(h);
+    esp_err_t err = !handle ? ESP_ERR_NVS_INVALID_HANDLE
+                    : !handle->writable ? ESP_ERR_NVS_READ_ONLY
+                                        : ESP_ERR_NVS_NOT_FOUND;
+    if (handle && handle->writable) {
+        entry_t *e = find(handle->ns, key);
+        if (e) {
+            drop((size_t)(e - entries));
+            writes++;
+            err = ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t h) {
+    pthread_mutex_lock(&lock);
+    handle_t *handle = get_handle(h);
+    esp_err_t err = !handle ? ESP_ERR_NVS_INVALID_HANDLE
+                    : !handle->writable ? ESP_ERR_NVS_READ_ONLY
+                                        : ESP_OK;
+    if (err == ESP_OK) {
+        for (size_t i = entry_count; i-- > 0;) {
+            if (!strcmp(entries[i].ns, handle->ns))
+                drop(i);
+        }
+        writes++;
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+#define SCALAR(suffix, ctype, nvs_type)                                                            \
+    esp_err_t nvs_set_##suffix(nvs_handle_t h, const char *key, ctype value) {                     \
+        return set_value(h, key, nvs_type, &value, sizeof(value));                                 \
+    }                                                                                              \
+    esp_err_t nvs_get_##suffix(nvs_handle_t h, const char *key, ctype *out) {                      \
+        size_t len = sizeof(*out);                                                                 \
+        return get_value(h, key, nvs_type, out, &len);                                             \
+    }
+
+SCALAR(u8, uint8_t, NVS_TYPE_U8)
+SCALAR(u16, uint16_t, NVS_TYPE_U16)
+SCALAR(u32, uint32_t, NVS_TYPE_U32)
+SCALAR(u64, uint64_t, NVS_TYPE_U64)
+
+esp_err_t nvs_set_str(nvs_handle_t h, const char *key, const char *value) {
+    return set_value(h, key, NVS_TYPE_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t h, const char *key, char *out, size_t *length) {
+    return get_value(h, key, NVS_TYPE_STR, out, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *value, size_t length) {
+    return set_value(h, key, NVS_TYPE_BLOB, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *length) {
+    return get_value(h, key, NVS_TYPE_BLOB, out, length);
+}
+
+esp_err_t nvs_entry_find(const char *part_name, const char *namespace_name, nvs_type_t type,
+                         nvs_iterator_t *output_iterator) {
+    (void)part_name;
+    *output_iterator = NULL;
+
+    pthread_mutex_lock(&lock);
+    nvs_iterator_t it = calloc(1, sizeof(*it));
+    it->infos = calloc(entry_count + 1, sizeof(*it->infos));
+    for (size_t i = 0; i < entry_count; i++) {
+        const entry_t *e = &entries[i];
+        if ((namespace_name && strcmp(e->ns, namespace_name)) ||
+            (type != NVS_TYPE_ANY && e->type != type))
+            continue;
+        nvs_entry_info_t *info = &it->infos[it->count++];
+        memcpy(info->namespace_name, e->ns, sizeof(info->namespace_name));
+        memcpy(info->key, e->key, sizeof(info->key));
+        info->type = e->type;
+    }
+    pthread_mutex_unlock(&lock);
+
+    if (!it->count) {
+        nvs_release_iterator(it);
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *output_iterator = it;
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_next(nvs_iterator_t *iterator) {
+    if (!iterator || !*iterator)
+        return ESP_ERR_INVALID_ARG;
+    if (++(*iterator)->pos < (*iterator)->count)
+        return ESP_OK;
+    nvs_release_iterator(*iterator);
+    *iterator = NULL;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_entry_info(const nvs_iterator_t iterator, nvs_entry_info_t *out_info) {
+    if (!iterator)
+        return ESP_ERR_INVALID_ARG;
+    *out_info = iterator->infos[iterator->pos];
+    return ESP_OK;
+}
+
+void nvs_release_iterator(nvs_iterator_t iterator) {
+    if (!iterator)
+        return;
+    free(iterator->infos);
+    free(iterator);
+}
+
+void fake_nvs_reset(void) {
+    pthread_mutex_lock(&lock);
+    while (entry_count)
+        drop(entry_count - 1);
+    free(entries);
+    entries = NULL;
+    entry_cap = 0;
+    writes = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+size_t fake_nvs_count(const char *namespace_name) {
+    pthread_mutex_lock(&lock);
+    size_t n = 0;
+    for (size_t i = 0; i < entry_count; i++) {
+        n += !strcmp(entries[i].ns, namespace_name);
+    }
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+size_t fake_nvs_writes(void) {
+    pthread_mutex_lock(&lock);
+    size_t n = writes;
+    pthread_mutex_unlock(&lock);
+    return n;
+}
@@ -0,0 +1,32 @@
+/* The restart side of platform_services.h: the host only counts restart requests. Device info
+ * is fixed apart from the app version, which tests set. */
+#include "host_test.h"
+#include "platform_services.h"
+#include <stdatomic.h>
+
+static atomic_int restarts;
+static void (*restart_cb)(void);
+
+void set_restart_callback(void (*cb)(void)) { restart_cb = cb; }
+
+void esp_safe_restart() {
+    if (restart_cb)
+        restart_cb();
+    atomic_fetch_add(&restarts, 1);
+}
+
+bool restart_pending(void) { return atomic_load(&restarts) > 0; }
+
+int host_test_restarts(void) { return atomic_load(&restarts); }
+
+static device_info_t device_info = {
+    .app_version = "1.0.0",
+    .idf_version = "v5.3",
+    .chip = "host",
+    .cores = 1,
+    .id = "A1B2C3D4E5F6",
+};
+
+const device_info_t *get_device_info(void) { return &device_info; }
+
+void host_test_set_app_version(const char *version) { device_info.app_version = version; }
@@ -0,0 +1,62 @@
+/* PSA hash operations on OpenSSL EVP digests */
+#include "psa/crypto.h"
+#include <openssl/evp.h>
+
+static const EVP_MD *digest_of(psa_algorithm_t alg) {
+    return alg == PSA_ALG_MD5 ? EVP_md5() : alg == PSA_ALG_SHA_256 ? EVP_sha256() : NULL;
+}
+
+psa_status_t psa_crypto_init(void) { return PSA_SUCCESS; }
+
+psa_status_t psa_hash_setup(psa_hash_operation_t *op, psa_algorithm_t alg) {
+    const EVP_MD *md = digest_of(alg);
+    if (!md)
+        return PSA_ERROR_NOT_SUPPORTED;
+    if (op->ctx)
+        return PSA_ERROR_BAD_STATE;
+    op->ctx = EVP_MD_CTX_new();
+    if (!op->ctx || !EVP_DigestInit_ex(op->ctx, md, NULL)) {
+        psa_hash_abort(op);
+        return PSA_ERROR_GENERIC_ERROR;
+    }
+    return PSA_SUCCESS;
+}
+
+psa_status_t psa_hash_update(psa_hash_operation_t *op, const uint8_t *input, size_t input_length) {
+    if (!op->ctx)
+        return PSA_ERROR_BAD_STATE;
+    return EVP_DigestUpdate(op->ctx, input, input_length) ? PSA_SUCCESS : PSA_ERROR_GENERIC_ERROR;
+}
+
+psa_status_t psa_hash_finish(psa_hash_operation_t *op, uint8_t *hash, size_t hash_size,
+                             size_t *hash_length) {
+    if (!op->ctx)
+        return PSA_ERROR_BAD_STATE;
+    if (hash_size < (size_t)EVP_MD_CTX_get_size(op->ctx)) {
+        psa_hash_abort(op);
+        return PSA_ERROR_BUFFER_TOO_SMALL;
+    }
+    unsigned int len = 0;
+    int ok = EVP_DigestFinal_ex(op->ctx, hash, &len);
+    *hash_length = len;
+    psa_hash_abort(op);
+    return ok ? PSA_SUCCESS : PSA_ERROR_GENERIC_ERROR;
+}
+
+psa_status_t psa_hash_abort(psa_hash_operation_t *op) {
+    EVP_MD_CTX_free(op->ctx);
+    op->ctx = NULL;
+    return PSA_SUCCESS;
+}
+
+psa_status_t psa_hash_compute(psa_algorithm_t alg, const uint8_t *input, size_t input_length,
+                              uint8_t *hash, size_t hash_size, size_t *hash_length) {
+    psa_hash_operation_t op = PSA_HASH_OPERATION_INIT;
+    psa_status_t status = psa_hash_setup(&op, alg);
+    if (status == PSA_SUCCESS)
+        status = psa_hash_update(&op, input, input_length);
+    if (status == PSA_SUCCESS)
+        return psa_hash_finish(&op, hash, hash_size, hash_length);
+    psa_hash_abort(&op);
+    return status;
+}
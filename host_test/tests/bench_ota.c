@@ -0,0 +1,175 @@
+/* HTTP vs. TCP OTA (user-044): the same image through POST /ota and through the TCP OTA protocol
+ * on a loopback socket, plain and zlib-compressed, into the RAM "ota_1" partition. Both share
+ * the writer pipeline, so the difference is the receive path: the fake HTTP server hands the body
+ * over from memory, TCP reads a real socket. Flash erase and program time is not modelled, so
+ * this compares per-byte overhead, not device throughput. Every upload must land byte for byte
+ * and trigger the restart. */
+#include "esp_ota_ops.h"
+#include "fake_partition.h"
+#include "http_fixture.h"
+#include "lwip/sockets.h"
+#include "psa/crypto.h"
+#include "tcp_ota.h"
+#include <sched.h>
+#include <zlib.h>
+
+#define PARTITION_SIZE (2 * 1024 * 1024)
+#define IMAGE_SIZE (1536 * 1024)
+#define RUNS 3
+#define TCP_PORT 35555
+
+static uint8_t image[IMAGE_SIZE];
+static uint8_t *packed;
+static size_t packed_len;
+
+static void make_image(void) {
+    // Firmware-like: repetitive code and tables with some noise, compresses to roughly 60 %
+    uint32_t x = 2463534242u;
+    for (size_t i = 0; i < sizeof(image); i++) {
+        x ^= x << 13, x ^= x >> 17, x ^= x << 5;
+        image[i] = (x & 3) ? (uint8_t)(i / 16 + (i & 7)) : (uint8_t)x;
+    }
+    image[0] = 0xE9; // esp_image_header_t.magic
+
+    uLongf len = compressBound(sizeof(image));
+    packed = malloc(len);
+    CHECK(compress2(packed, &len, image, sizeof(image), 9) == Z_OK);
+    packed_len = len;
+}
+
+static void reset_partitions(void) {
+    CHECK(fake_partition_add("ota_0", ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0,
+                             PARTITION_SIZE, NULL));
+    CHECK(fake_partition_add("ota_1", ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1,
+                             PARTITION_SIZE, NULL));
+}
+
+static bool landed(void) {
+    const uint8_t *data = fake_partition_data("ota_1");
+    return data && !memcmp(data, image, sizeof(image)) &&
+           esp_ota_get_boot_partition() == esp_ota_get_next_update_partition(NULL);
+}
+
+static double mbps(uint64_t us) { return us ? (double)IMAGE_SIZE / us : 0; } // B/us = MB/s
+
+/* Time from the request to the answer, sent once the image is verified and activated. With
+ * timeout_every, that share of the receives times out first. */
+static uint64_t http_post(bool compressed, uint32_t timeout_every) {
+    uint8_t sha[32];
+    size_t sha_len;
+    psa_hash_compute(PSA_ALG_SHA_256, image, sizeof(image), sha, sizeof(sha), &sha_len);
+    char headers[160];
+    int n = snprintf(headers, sizeof(headers), "X-OTA-SHA256: ");
+    for (size_t i = 0; i < sha_len; i++) {
+        n += snprintf(headers + n, sizeof(headers) - n, "%02x", sha[i]);
+    }
+    snprintf(headers + n, sizeof(headers) - n, "\n%s",
+             compressed ? "Content-Encoding: deflate\n" : "");
+
+    reset_partitions();
+    int restarts = host_test_restarts();
+    fake_httpd_resp_t *resp = fake_httpd_do(&(fake_httpd_request_t){
+        .method = HTTP_POST,
+        .uri = "/ota",
+        .headers = headers,
+        .body = compressed ? (const char *)packed : (const char *)image,
+        .body_len = compressed ? packed_len : sizeof(image),
+        .timeout_every = timeout_every});
+    CHECK(resp && resp->status == 200);
+    uint64_t us = resp ? resp->first_byte_us - resp->start_us : 0;
+    fake_httpd_free(resp);
+    CHECK(landed());
+    CHECK_INT_EQ(host_test_restarts(), restarts + 1);
+    return us;
+}
+
+static uint64_t http_upload(bool compressed) { return http_post(compressed, 0); }
+
+// Every other receive times out: each one that delivers data restarts the retry count
+static void test_lossy_link(void) {
+    http_post(false, 2);
+    http_post(true, 2);
+}
+
+static bool send_step(int sock, const void *data, size_t len) {
+    uint8_t ack[2];
+    return send(sock, data, len, 0) == (ssize_t)len && recv(sock, ack, 2, MSG_WAITALL) == 2 &&
+           ack[0] == 0xAA && ack[1] == 0x55;
+}
+
+// Time from connect to the restart request, which follows verification and activation
+static uint64_t tcp_upload(bool compressed) {
+    uint8_t md5[16];
+    size_t md5_len;
+    psa_hash_compute(PSA_ALG_MD5, image, sizeof(image), md5, sizeof(md5), &md5_len);
+    const uint8_t magic[] = {0xAF, 0xCA, 0xEC, 0x2D, 0xFE, compressed ? 0x5A : 0x55};
+    const uint8_t version[] = {1, 0};
+    const uint8_t size[] = {IMAGE_SIZE >> 24, (IMAGE_SIZE >> 16) & 0xff, (IMAGE_SIZE >> 8) & 0xff,
+                            IMAGE_SIZE & 0xff};
+
+    reset_partitions();
+    int restarts = host_test_restarts();
+    uint64_t start = host_test_now_us();
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(TCP_PORT),
+                               .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    bool ok = connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+    // Every header field is one recv() on the device: wait for its ACK before the next
+    ok = ok && send_step(sock, magic, sizeof(magic)) && send_step(sock, version, sizeof(version)) &&
+         send_step(sock, size, sizeof(size)) && send_step(sock, md5, md5_len);
+    const uint8_t *body = compressed ? packed : image;
+    size_t left = compressed ? packed_len : sizeof(image);
+    while (ok && left > 0) {
+        ssize_t sent = send(sock, body, left, 0);
+        ok = sent > 0;
+        body += ok ? sent : 0;
+        left -= ok ? sent : 0;
+    }
+    shutdown(sock, SHUT_WR);
+    uint8_t ack[2];
+    ok = ok && recv(sock, ack, 2, MSG_WAITALL) == 2;
+    CHECK(ok);
+
+    uint64_t deadline = start + 10 * 1000000;
+    while (host_test_restarts() == restarts && host_test_now_us() < deadline)
+        sched_yield();
+    uint64_t us = host_test_now_us() - start;
+    close(sock);
+    CHECK_INT_EQ(host_test_restarts(), restarts + 1);
+    CHECK(landed());
+    return us;
+}
+
+static void bench(const char *name, uint64_t (*upload)(bool), bool compressed) {
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < RUNS; i++) {
+        uint64_t us = upload(compressed);
+        best = us < best ? us : best;
+    }
+    char label[64];
+    snprintf(label, sizeof(label), "%s_us", name);
+    host_test_bench(label, best, "us");
+    snprintf(label, sizeof(label), "%s_mbps", name);
+    host_test_bench(label, mbps(best), "MB/s");
+}
+
+int main(void) {
+    make_image();
+    printf("Image %d B, compressed %zu B\n", IMAGE_SIZE, packed_len);
+    fixture_fs_reset();
+    CHECK(fixture_http_start());
+    tcp_ota_configure(TCP_PORT);
+    tcp_ota_init();
+    host_test_sleep_ms(50); // Listening
+
+    test_lossy_link();
+    bench("http_plain", http_upload, false);
+    bench("tcp_plain", tcp_upload, false);
+    bench("http_deflate", http_upload, true);
+    bench("tcp_deflate", tcp_upload, true);
+
+    tcp_ota_shutdown();
+    http_shutdown();
+    free(packed);
+    return host_test_done("bench_ota");
+}
@@ -0,0 +1,78 @@
+/* PROPFIND Depth: 1 listing cost (user-041): latency, socket writes (TCP segments) and bytes for
+ * directories of 10, 100 and 500 files, with the XML coalesced into CONFIG_HTTP_WEBDAV_XML_BUF_SIZE
+ * chunks. Built with the default buffer and with the Kconfig minimum for comparison. */
+#include "http_fixture.h"
+
+static const int sizes[] = {10, 100, 500};
+
+static size_t count(const char *haystack, const char *needle) {
+    size_t n = 0;
+    for (const char *p = haystack; (p = strstr(p, needle)); p += strlen(needle)) {
+        n++;
+    }
+    return n;
+}
+
+static void make_dir(int entries) {
+    char path[64];
+    for (int i = 0; i < entries; i++) {
+        snprintf(path, sizeof(path), "/list%d/file%04d.txt", entries, i);
+        CHECK(fixture_fs_write(path, path, 1 + i % 40));
+    }
+}
+
+static void bench_listing(int entries) {
+    char uri[32], name[64];
+    snprintf(uri, sizeof(uri), "/dav/list%d/", entries);
+    int runs = entries >= 500 ? 10 : 50;
+
+    uint64_t total_us = 0;
+    size_t writes = 0, bytes = 0;
+    for (int i = 0; i < runs; i++) {
+        fake_httpd_resp_t *resp = fake_httpd_do(&(fake_httpd_request_t){
+            .method = HTTP_PROPFIND, .uri = uri, .headers = "Depth: 1\n"});
+        CHECK(resp && resp->status == 207);
+        if (!resp)
+            continue;
+        if (i == 0) {
+            // The collection itself plus one response per file, complete document
+            CHECK_INT_EQ(count(resp->body, "<D:response>"), entries + 1);
+            CHECK(strstr(resp->body, "file0000.txt</D:href>") != NULL);
+            const char *end = "</D:multistatus>";
+            size_t len = strlen(resp->body);
+            CHECK(len > strlen(end) && !strcmp(resp->body + len - strlen(end), end));
+        }
+        total_us += resp->done_us - resp->start_us;
+        writes = resp->writes;
+        bytes = resp->bytes;
+        fake_httpd_free(resp);
+    }
+
+    snprintf(name, sizeof(name), "propfind_%d_latency_us", entries);
+    host_test_bench(name, (double)total_us / runs, "us");
+    snprintf(name, sizeof(name), "propfind_%d_segments", entries);
+    host_test_bench(name, writes, "");
+    snprintf(name, sizeof(name), "propfind_%d_bytes", entries);
+    host_test_bench(name, bytes, "B");
+
+    // Full chunks except the last one; never one write per entry
+    CHECK(writes <= bytes / CONFIG_HTTP_WEBDAV_XML_BUF_SIZE + 2);
+    CHECK(writes < (size_t)entries || entries <= 10);
+}
+
+int main(void) {
+    fixture_fs_reset();
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+        make_dir(sizes[i]);
+    }
+    CHECK(fixture_http_start());
+
+    printf("XML buffer %d B\n", CONFIG_HTTP_WEBDAV_XML_BUF_SIZE);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+        bench_listing(sizes[i]);
+    }
+
+    http_shutdown();
+    return host_test_done(CONFIG_HTTP_WEBDAV_XML_BUF_SIZE == 512 ? "bench_propfind_512"
+                                                                 : "bench_propfind");
+}
@@ -0,0 +1,190 @@
+/* TCP log monitor (user-050): tcp_monitor.c with a client on a loopback socket. Paced bursts of
+ * sequence-numbered lines arrive complete and in order, an oversized entry ends in " [+N B]".
+ * Then floods from one logging task, yielding now and then or in a tight loop: lines/s
+ * delivered, the share dropped at the full ring and log lines per send(). Whole lines are
+ * dropped, and the "--- N B of log dropped ---" notices the client reads add up to what
+ * tcp_monitor_dropped_bytes() reports for telemetry. */
+#include "esp_log.h"
+#include "host_test.h"
+#include "lwip/sockets.h"
+#include "tcp_monitor.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#define PORT 36666
+#define BURSTS 10
+#define BURST_LINES 20
+#define FLOOD_MS 1000
+#define TAG "bench"
+
+// Every send() of the process; only the monitor task sends
+static atomic_uint sends;
+ssize_t __real_send(int sock, const void *data, size_t size, int flags);
+ssize_t __wrap_send(int sock, const void *data, size_t size, int flags) {
+    atomic_fetch_add(&sends, 1);
+    return __real_send(sock, data, size, flags);
+}
+
+static atomic_uint lines;        // Sequence-numbered lines received
+static atomic_uint notice_bytes; // Sum of the drop notices
+static atomic_uint out_of_order; // Lines received after a later one
+static atomic_uint skipped;      // Gaps in the sequence
+static atomic_uint truncated;    // Lines ending in the " [+N B]" marker
+static atomic_ullong last_rx_us;
+static atomic_bool stop;
+static unsigned next_seq;
+
+static void parse_line(const char *line) {
+    const char *p;
+    unsigned value;
+    if ((p = strstr(line, "--- ")) && sscanf(p, "--- %u B of log dropped", &value) == 1) {
+        atomic_fetch_add(&notice_bytes, value);
+    } else if ((p = strstr(line, "seq=")) && sscanf(p, "seq=%u", &value) == 1) {
+        if (value < next_seq)
+            atomic_fetch_add(&out_of_order, 1);
+        else if (value > next_seq)
+            atomic_fetch_add(&skipped, 1);
+        next_seq = value + 1;
+        if (strstr(line, " B]"))
+            atomic_fetch_add(&truncated, 1);
+        atomic_fetch_add(&lines, 1);
+    }
+}
+
+static void *client(void *arg) {
+    (void)arg;
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(PORT),
+                               .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    bool connected = false;
+    for (int i = 0; i < 100 && !connected; i++) {
+        connected = connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+        if (!connected)
+            host_test_sleep_ms(20);
+    }
+    CHECK(connected);
+    struct timeval tv = {.tv_usec = 100 * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    static char buf[64 * 1024], line[2 * CONFIG_MAX_LOG_SIZE];
+    size_t line_len = 0;
+    while (connected && !atomic_load(&stop)) {
+        ssize_t got = recv(sock, buf, sizeof(buf), 0);
+        if (got == 0)
+            break;
+        if (got < 0)
+            continue;
+        atomic_store(&last_rx_us, host_test_now_us());
+        for (ssize_t i = 0; i < got; i++) {
+            if (buf[i] != '\n') {
+                if (line_len < sizeof(line) - 1)
+                    line[line_len++] = buf[i];
+                continue;
+            }
+            line[line_len] = '\0';
+            parse_line(line);
+            line_len = 0;
+        }
+    }
+    close(sock);
+    return NULL;
+}
+
+static int null_vprintf(const char *fmt, va_list args) {
+    (void)fmt;
+    (void)args;
+    return 0;
+}
+
+static bool quiet_for_ms(unsigned ms) {
+    return host_test_now_us() - atomic_load(&last_rx_us) > ms * 1000ull;
+}
+
+static void test_in_order(void) {
+    unsigned seq = 0;
+    for (int burst = 0; burst < BURSTS; burst++) {
+        for (int i = 0; i < BURST_LINES; i++, seq++)
+            ESP_LOGW(TAG, "seq=%u burst %d line %d", seq, burst, i);
+        bool delivered = WAIT_FOR(atomic_load(&lines) == seq, 2000);
+        CHECK(delivered);
+    }
+    CHECK_INT_EQ(atomic_load(&out_of_order), 0);
+    CHECK_INT_EQ(atomic_load(&skipped), 0);
+    CHECK_INT_EQ(tcp_monitor_dropped_bytes(), 0);
+
+    // Cut to CONFIG_MAX_LOG_SIZE, still one line
+    char payload[2 * CONFIG_MAX_LOG_SIZE];
+    memset(payload, 'x', sizeof(payload) - 1);
+    payload[sizeof(payload) - 1] = '\0';
+    ESP_LOGW(TAG, "seq=%u %s", seq++, payload);
+    bool delivered = WAIT_FOR(atomic_load(&lines) == seq, 2000);
+    CHECK(delivered);
+    CHECK_INT_EQ(atomic_load(&truncated), 1);
+    next_seq = 0; // Each flood starts over, the client is idle until then
+}
+
+/* One logging task for FLOOD_MS, yielding every yield_every lines (0: never, which on the host
+ * also starves the monitor task of the ring lock) */
+static void bench_flood(const char *name, unsigned yield_every) {
+    atomic_store(&lines, 0);
+    atomic_store(&skipped, 0);
+    unsigned dropped_before = tcp_monitor_dropped_bytes();
+    unsigned notices_before = atomic_load(&notice_bytes);
+    unsigned sends_before = atomic_load(&sends);
+
+    uint64_t start = host_test_now_us();
+    unsigned seq = 0;
+    while (host_test_now_us() - start < FLOOD_MS * 1000ull) {
+        ESP_LOGW(TAG, "seq=%u flood line with a typical payload of some forty bytes", seq++);
+        if (yield_every && seq % yield_every == 0)
+            sched_yield();
+    }
+
+    // Drained, and the last notice out
+    bool drained = WAIT_FOR(quiet_for_ms(300), 5000);
+    CHECK(drained);
+    uint64_t elapsed = atomic_load(&last_rx_us) - start;
+    unsigned delivered = atomic_load(&lines);
+    unsigned dropped = tcp_monitor_dropped_bytes() - dropped_before;
+    unsigned sent = atomic_load(&sends) - sends_before;
+
+    CHECK_INT_EQ(atomic_load(&out_of_order), 0);
+    CHECK(delivered > 0 && delivered <= seq);
+    CHECK_INT_EQ(atomic_load(&notice_bytes) - notices_before, dropped);
+    CHECK((delivered < seq) == (dropped > 0)); // A line is delivered whole or counted as dropped
+    CHECK(tcp_monitor_client_connected());
+    next_seq = 0;
+
+    char bench[64];
+    snprintf(bench, sizeof(bench), "tcp_monitor %s produced", name);
+    host_test_bench(bench, seq * 1e6 / (FLOOD_MS * 1000.0), "lines/s");
+    snprintf(bench, sizeof(bench), "tcp_monitor %s delivered", name);
+    host_test_bench(bench, elapsed ? delivered * 1e6 / elapsed : 0, "lines/s");
+    snprintf(bench, sizeof(bench), "tcp_monitor %s dropped", name);
+    host_test_bench(bench, 100.0 * (seq - delivered) / seq, "%");
+    snprintf(bench, sizeof(bench), "tcp_monitor %s lines per send", name);
+    host_test_bench(bench, sent ? (double)delivered / sent : 0, "lines");
+}
+
+int main(void) {
+    // The monitor forwards every line to the previous sink (the UART on the device)
+    esp_log_set_vprintf(null_vprintf);
+    tcp_monitor_configure(PORT);
+    tcp_monitor_init();
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, client, NULL);
+    bool connected = WAIT_FOR(tcp_monitor_client_connected(), 3000);
+    CHECK(connected);
+
+    test_in_order();
+    bench_flood("yielding", 32);
+    bench_flood("tight loop", 0);
+
+    atomic_store(&stop, true);
+    pthread_join(thread, NULL);
+    tcp_monitor_shutdown();
+    return host_test_done("bench_tcp_monitor");
+}
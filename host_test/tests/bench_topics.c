@@ -0,0 +1,104 @@
+/* Publish path cost with precomputed topics (user-026).
+ *
+ * Drives mqtt_publish_telemetry() with per-entity state topics, so every iteration publishes the
+ * tele message plus one retained state per entity, all addressed through the topic arenas. The
+ * reference loop formats the same topics the way the publish path did before the arenas
+ * (sanitize + snprintf per message) to show what the arenas take off each message. */
+#include "cJSON.h"
+#include "ha.h"
+#include "json_parser.h"
+#include "mqtt_fixture.h"
+
+// Not in mqtt.h: the telemetry task's publish step, called directly to time it
+void mqtt_publish_telemetry(void);
+
+#define ENTITIES 64
+#define ITERATIONS 2000
+
+static char names[ENTITIES][16];
+static volatile int tick;
+
+static void telemetry(cJSON *root) {
+    cJSON *temps = cJSON_AddObjectToObject(root, "temps");
+    for (int i = 0; i < ENTITIES; i++) {
+        cJSON_AddNumberToObject(temps, names[i], tick + i);
+    }
+}
+
+// Topic formatting the arenas replace: tele topic plus one state topic per entity
+static size_t format_topics_reference(void) {
+    char topic[128];
+    size_t bytes = 0;
+
+    bytes += snprintf(topic, sizeof(topic), "%s/%s/tele", FIXTURE_NODE, FIXTURE_CLIENT_ID);
+    for (int i = 0; i < ENTITIES; i++) {
+        char *sanitized = sanitize(names[i]);
+        bytes += snprintf(topic, sizeof(topic), "%s/%s/state", mqtt_get_topics()->base, sanitized);
+        free(sanitized);
+    }
+    return bytes;
+}
+
+int main(void) {
+    for (int i = 0; i < ENTITIES; i++) {
+        snprintf(names[i], sizeof(names[i]), "temp%d", i);
+        ha_register_entity(&(ha_entity_config_t){
+            .type = HA_SENSOR,
+            .name = names[i],
+            .device_class = "temperature",
+            .parent_key = "temps",
+        });
+    }
+
+    fake_mqtt_set_auto_ack(true);
+    CHECK(fixture_mqtt_start(NULL, telemetry));
+
+    // Discovery builds the entity topic arena that state publishes use
+    publish_ha_mqtt_discovery(false);
+    CHECK(WAIT_FOR(fake_mqtt_count_prefix(FIXTURE_DISC_PREFIX "/") == ENTITIES, 5000));
+
+    tick = 1;
+    mqtt_publish_telemetry();
+    CHECK(fake_mqtt_last(FIXTURE_BASE "/tele") != NULL);
+    CHECK(fake_mqtt_last(FIXTURE_BASE "/temp0/state") != NULL);
+    CHECK(fake_mqtt_last(FIXTURE_BASE "/temp63/state") != NULL);
+
+    fake_mqtt_set_record(false);
+    size_t published = fake_mqtt_published();
+    uint64_t start = host_test_now_us();
+    for (int i = 0; i < ITERATIONS; i++) {
+        tick = 2 + i;
+        mqtt_publish_telemetry();
+    }
+    uint64_t publish_us = host_test_now_us() - start;
+    size_t messages = fake_mqtt_published() - published;
+    CHECK(messages >= (size_t)ITERATIONS * (ENTITIES + 1));
+
+    start = host_test_now_us();
+    size_t sink = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        sink += format_topics_reference();
+    }
+    uint64_t format_us = host_test_now_us() - start;
+    CHECK(sink > 0);
+
+    double per_msg_ns = publish_us * 1000.0 / messages;
+    double format_ns = format_us * 1000.0 / ((double)ITERATIONS * (ENTITIES + 1));
+    host_test_bench("publish_path_per_msg", per_msg_ns, "ns");
+    host_test_bench("topic_snprintf_per_msg", format_ns, "ns");
+    host_test_bench("topic_snprintf_share", 100.0 * format_ns / (per_msg_ns + format_ns), "%");
+
+    // A configuration change swaps in a new table; strings taken before it stay intact
+    const mqtt_topics_t *before = mqtt_get_topics();
+    const char *tele = before->tele;
+    mqtt_config_t cfg = *mqtt_get_config();
+    cfg.mqtt_node = "other";
+    mqtt_configure(&cfg);
+    const mqtt_topics_t *after = mqtt_get_topics();
+    CHECK(after != before);
+    CHECK_INT_EQ(after->generation, before->generation + 1);
+    CHECK_STR_EQ(tele, FIXTURE_BASE "/tele");
+    CHECK_STR_EQ(after->tele, "other/" FIXTURE_CLIENT_ID "/tele");
+
+    return host_test_done("bench_topics");
+}
@@ -0,0 +1,303 @@
+/* Command parsing under random input (user-037): cmnd_process_json_results() and POST /cmnd get
+ * random bytes, generated JSON objects and mutations of them (truncated, bytes flipped or
+ * inserted), deep nesting and oversized bodies. Every input must be accepted exactly when it is a
+ * JSON object, report one result per key, hand valid JSON to the command handlers and free
+ * everything (AddressSanitizer / LeakSanitizer). Deterministic: HOST_TEST_SEED picks another
+ * sequence. */
+#include "cJSON.h"
+#include "cmnd.h"
+#include "http_fixture.h"
+
+#define DIRECT_RUNS 20000
+#define HTTP_RUNS 2000
+#define MAX_KEYS 6 // Below the queue length, so results never depend on queue timing
+#define BUF_SIZE (CONFIG_HTTP_POST_MAX_BODY + 512)
+
+static const char *known[] = {"led", "restart", "ha", "interval"};
+static const char *unknown[] = {"nope", "", "LED", "\\u006ced", "a\\\"b"};
+
+static QueueHandle_t queue;
+static size_t handled, bad_args;
+static uint64_t rng_state;
+
+static uint32_t rnd(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)rng_state;
+}
+
+static uint32_t rnd_below(uint32_t n) {
+    return n ? rnd() % n : 0;
+}
+
+static void handler(const char *args) {
+    cJSON *parsed = cJSON_Parse(args);
+    bad_args += !parsed;
+    cJSON_Delete(parsed);
+    handled++;
+}
+
+// What the supervisor task does with queued jobs
+static void drain(void) {
+    command_job_t *job;
+    while (xQueueReceive(queue, &job, 0) == pdTRUE) {
+        job->cmnd->handler(job->args_json_str);
+        free(job->args_json_str);
+        free(job);
+    }
+}
+
+typedef struct {
+    char *buf;
+    size_t len, cap;
+} out_t;
+
+static void put(out_t *o, const char *s) {
+    size_t n = strlen(s);
+    if (o->len + n < o->cap) {
+        memcpy(o->buf + o->len, s, n + 1);
+        o->len += n;
+    }
+}
+
+static void gen_value(out_t *o, int depth) {
+    static const char *scalars[] = {"true", "false", "null", "0", "-1.5e3", "\"on\"", "\"off\"",
+                                    "\"\\u00e9\\n\"", "\"\\ud800\"", "1e400", "\"\""};
+    uint32_t kind = depth > 3 ? 0 : rnd_below(4);
+    if (kind == 0 || kind == 1) {
+        put(o, scalars[rnd_below(sizeof(scalars) / sizeof(*scalars))]);
+    } else if (kind == 2) {
+        put(o, "[");
+        for (uint32_t i = 0, n = rnd_below(4); i < n; i++) {
+            if (i)
+                put(o, ",");
+            gen_value(o, depth + 1);
+        }
+        put(o, "]");
+    } else {
+        put(o, "{");
+        for (uint32_t i = 0, n = rnd_below(4); i < n; i++) {
+            put(o, i ? ",\"k\":" : "\"k\":");
+            gen_value(o, depth + 1);
+        }
+        put(o, "}");
+    }
+}
+
+static void gen_object(out_t *o) {
+    put(o, rnd_below(8) ? "{" : " \n{ ");
+    for (uint32_t i = 0, n = rnd_below(MAX_KEYS + 1); i < n; i++) {
+        put(o, i ? ",\"" : "\"");
+        put(o, rnd_below(2) ? known[rnd_below(4)] : unknown[rnd_below(5)]);
+        put(o, "\":");
+        gen_value(o, 1);
+    }
+    put(o, "}");
+}
+
+// Fills buf with one input; returns its length (may contain NUL bytes)
+static size_t gen_input(char *buf, size_t cap) {
+    out_t o = {buf, 0, cap};
+    buf[0] = '\0';
+    switch (rnd_below(8)) {
+    case 0: // Random bytes
+        o.len = rnd_below(256);
+        for (size_t i = 0; i < o.len; i++) {
+            buf[i] = (char)rnd();
+        }
+        buf[o.len] = '\0';
+        return o.len;
+    case 1: // Deeper than cJSON's nesting limit, or just below it
+        for (uint32_t i = 0, n = 900 + rnd_below(300); i < n && o.len + 2 < cap; i++) {
+            put(&o, rnd_below(2) ? "[" : "{\"a\":");
+        }
+        return o.len;
+    case 2: // Not an object
+        gen_value(&o, 0);
+        return o.len;
+    case 3:
+    case 4: // Mutated object
+        gen_object(&o);
+        for (uint32_t i = 0, n = 1 + rnd_below(3); i < n && o.len; i++) {
+            switch (rnd_below(3)) {
+            case 0:
+                o.len = rnd_below(o.len);
+                break;
+            case 1:
+                buf[rnd_below(o.len)] ^= (char)(1 << rnd_below(8));
+                break;
+            default:
+                if (o.len + 1 < cap) {
+                    size_t at = rnd_below(o.len);
+                    memmove(buf + at + 1, buf + at, o.len - at);
+                    buf[at] = "{}[]\",:\\"[rnd_below(8)];
+                    o.len++;
+                }
+            }
+        }
+        buf[o.len] = '\0';
+        return o.len;
+    default:
+        gen_object(&o);
+        return o.len;
+    }
+}
+
+/* Checks a result object against the input: one "accepted" per registered command, "unknown"
+ * for the rest, in input order */
+static void check_results(const char *input, const cJSON *results) {
+    cJSON *root = cJSON_Parse(input);
+    CHECK(root && cJSON_IsObject(root));
+    if (!root)
+        return;
+
+    const cJSON *r = results ? results->child : NULL;
+    for (const cJSON *item = root->child; item; item = item->next, r = r ? r->next : NULL) {
+        CHECK(r && !strcmp(r->string, item->string));
+        if (!r)
+            break;
+        const char *expected = cmnd_find(item->string) ? "accepted" : "unknown";
+        if (!cJSON_IsString(r) || strcmp(r->valuestring, expected)) {
+            fprintf(stderr, "\"%s\": got %s, expected %s\n", item->string,
+                    cJSON_IsString(r) ? r->valuestring : "?", expected);
+            host_test_failures++;
+        }
+    }
+    CHECK(r == NULL);
+    cJSON_Delete(root);
+}
+
+static bool is_object(const char *input) {
+    cJSON *root = cJSON_Parse(input);
+    bool object = cJSON_IsObject(root);
+    cJSON_Delete(root);
+    return object;
+}
+
+static void fuzz_direct(void) {
+    static char buf[BUF_SIZE];
+    size_t accepted = 0;
+    for (int i = 0; i < DIRECT_RUNS; i++) {
+        gen_input(buf, sizeof(buf));
+        cJSON *results = cJSON_CreateObject();
+        bool ok = cmnd_process_json_results(buf, results);
+        CHECK_INT_EQ(ok, is_object(buf));
+        if (ok)
+            check_results(buf, results);
+        else
+            CHECK(results->child == NULL);
+        accepted += ok;
+        cJSON_Delete(results);
+
+        // Without a results object the same commands are submitted
+        if (i % 16 == 0)
+            CHECK_INT_EQ(cmnd_process_json_results(buf, NULL), ok);
+        drain();
+    }
+    CHECK(!cmnd_process_json_results(NULL, NULL));
+    CHECK(accepted > DIRECT_RUNS / 10 && accepted < DIRECT_RUNS * 9 / 10);
+    host_test_bench("direct_inputs_accepted", accepted, "");
+}
+
+static void fuzz_http(void) {
+    static char buf[BUF_SIZE];
+    size_t status[6] = {0};
+    for (int i = 0; i < HTTP_RUNS; i++) {
+        size_t len = gen_input(buf, sizeof(buf));
+        fake_httpd_request_t req = {
+            .method = HTTP_POST, .uri = "/cmnd", .body = buf, .body_len = len};
+        uint32_t mode = rnd_below(16);
+        if (mode == 0) {
+            // Client dies inside the body
+            req.content_len = len + 1 + rnd_below(64);
+        } else if (mode == 1) {
+            // Above the limit: refused from Content-Length alone
+            req.content_len = CONFIG_HTTP_POST_MAX_BODY + 1 + rnd_below(1 << 20);
+            req.body_len = rnd_below(len + 1);
+        }
+
+        fake_httpd_resp_t *resp = fake_httpd_do(&req);
+        CHECK(resp != NULL);
+        if (!resp)
+            continue;
+
+        size_t announced = req.content_len ? req.content_len : len;
+        if (announced > CONFIG_HTTP_POST_MAX_BODY) {
+            CHECK_INT_EQ(resp->status, 413);
+        } else if (announced == 0) {
+            CHECK_INT_EQ(resp->status, 400);
+        } else if (mode == 0) {
+            CHECK_INT_EQ(resp->status, 500);
+        } else if (is_object(buf)) {
+            // The handler sees the body up to its first NUL, as cJSON does
+            CHECK_INT_EQ(resp->status, 200);
+            cJSON *results = cJSON_Parse(resp->body);
+            CHECK(cJSON_IsObject(results));
+            check_results(buf, results);
+            cJSON_Delete(results);
+        } else {
+            CHECK_INT_EQ(resp->status, 400);
+        }
+        CHECK_INT_EQ(resp->closed, resp->status != 200);
+        status[resp->status / 100]++;
+        fake_httpd_free(resp);
+        drain();
+    }
+    host_test_bench("http_2xx", status[2], "");
+    host_test_bench("http_4xx", status[4], "");
+    host_test_bench("http_5xx", status[5], "");
+    CHECK(status[2] > 0 && status[4] > 0 && status[5] > 0);
+}
+
+static void test_queue_full(void) {
+    // Nine accepted commands for an eight-slot queue nobody drains
+    char body[256] = "{";
+    for (int i = 0; i < CONFIG_SUPERVISOR_QUEUE_LENGTH + 1; i++) {
+        strcat(body, i ? ",\"led\":1" : "\"led\":1");
+    }
+    strcat(body, "}");
+
+    cJSON *results = cJSON_CreateObject();
+    CHECK(cmnd_process_json_results(body, results));
+    const cJSON *last = results->child;
+    while (last && last->next) {
+        last = last->next;
+    }
+    CHECK(last && !strcmp(last->valuestring, "queue_full"));
+    CHECK_STR_EQ(results->child->valuestring, "accepted");
+    cJSON_Delete(results);
+
+    size_t before = handled;
+    drain();
+    CHECK_INT_EQ(handled - before, CONFIG_SUPERVISOR_QUEUE_LENGTH);
+}
+
+int main(void) {
+    const char *seed = getenv("HOST_TEST_SEED");
+    rng_state = seed ? strtoull(seed, NULL, 0) : 0x2545f4914f6cdd1dULL;
+    if (!rng_state)
+        rng_state = 1;
+    printf("seed %llu\n", (unsigned long long)rng_state);
+
+    queue = xQueueCreate(CONFIG_SUPERVISOR_QUEUE_LENGTH, sizeof(command_job_t *));
+    cmnd_init(queue);
+    for (size_t i = 0; i < sizeof(known) / sizeof(*known); i++) {
+        cmnd_register(known[i], NULL, handler);
+    }
+
+    fuzz_direct();
+    test_queue_full();
+
+    fixture_fs_reset();
+    CHECK(fixture_http_start());
+    http_register_json_post("/cmnd", cmnd_process_json_results);
+    fuzz_http();
+    http_shutdown();
+
+    CHECK(handled > 0);
+    CHECK_INT_EQ(bad_args, 0);
+    host_test_bench("commands_handled", handled, "");
+    vQueueDelete(queue);
+    return host_test_done("fuzz_cmnd");
+}
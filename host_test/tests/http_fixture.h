@@ -0,0 +1,90 @@
+/* Shared setup for tests that drive cikon_http against the fake server. The LittleFS mount point
+ * (CONFIG_VFS_LITTLEFS_MOUNT_POINT) is a directory of the test's own under the build tree. */
+#pragma once
+
+#include "esp_http_server.h"
+#include "fake_httpd.h"
+#include "host_test.h"
+#include "http_server.h"
+#include <ftw.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#define FIXTURE_FS CONFIG_VFS_LITTLEFS_MOUNT_POINT
+#define FIXTURE_WWW FIXTURE_FS "/www"
+
+static inline int fixture_rm(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+// mkdir -p for the directories leading to path (and path itself with the trailing '/')
+static inline void fixture_mkdirs(const char *path) {
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (char *p = dir + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            mkdir(dir, 0755);
+            *p = '/';
+        }
+    }
+}
+
+// Empties the mount point and creates <mount>/www
+static inline void fixture_fs_reset(void) {
+    nftw(FIXTURE_FS, fixture_rm, 16, FTW_DEPTH | FTW_PHYS);
+    fixture_mkdirs(FIXTURE_WWW "/");
+}
+
+// Writes a file below the mount point, creating its directories
+static inline bool fixture_fs_write(const char *rel, const void *data, size_t len) {
+    char path[512];
+    snprintf(path, sizeof(path), FIXTURE_FS "%s", rel);
+    fixture_mkdirs(path);
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(data, 1, len, f) == len;
+    return fclose(f) == 0 && ok;
+}
+
+// Reads a file below the mount point; NULL if missing. Free the result.
+static inline char *fixture_fs_read(const char *rel, size_t *len) {
+    char path[512];
+    snprintf(path, sizeof(path), FIXTURE_FS "%s", rel);
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc(size + 1);
+    size_t n = fread(data, 1, size, f);
+    fclose(f);
+    data[n] = '\0';
+    if (len)
+        *len = n;
+    return data;
+}
+
+static inline bool fixture_fs_exists(const char *rel) {
+    char path[512];
+    struct stat st;
+    snprintf(path, sizeof(path), FIXTURE_FS "%s", rel);
+    return stat(path, &st) == 0;
+}
+
+#ifdef FIXTURE_STAGED_WWW
+// Copies the pages staged by web_assets.py at build time into <mount>/www
+static inline bool fixture_fs_stage_pages(void) {
+    return system("cp -R '" FIXTURE_STAGED_WWW "/.' '" FIXTURE_WWW "/'") == 0;
+}
+#endif
+
+static inline bool fixture_http_start(void) {
+    http_init(&(http_config_t){.port = 80, .ctrl_port = 32769, .max_open_sockets = 4});
+    return fake_httpd_running();
+}
@@ -0,0 +1,36 @@
+/* Shared setup for tests that drive cikon_mqtt against the fake broker */
+#pragma once
+
+#include "fake_mqtt.h"
+#include "host_test.h"
+#include "mqtt.h"
+
+#define FIXTURE_NODE "cikon"
+#define FIXTURE_CLIENT_ID "a1b2c3d4e5f6"
+#define FIXTURE_BASE FIXTURE_NODE "/" FIXTURE_CLIENT_ID
+#define FIXTURE_DISC_PREFIX "homeassistant"
+
+// Configures the client, connects it to the fake broker and waits for the CONNECTED handler
+static inline bool fixture_mqtt_start(mqtt_command_callback_t command_cb,
+                                      mqtt_telemetry_callback_t telemetry_cb) {
+    mqtt_config_t cfg = {
+        .client_id = FIXTURE_CLIENT_ID,
+        .device_name = "Cikon host",
+        .device_manufacturer = "cikon",
+        .device_model = "host",
+        .device_sw_version = "0.0.0-host",
+        .device_hw_version = "host",
+        .device_uri = "127.0.0.1",
+        .mqtt_node = FIXTURE_NODE,
+        .mqtt_broker = "mqtt://127.0.0.1",
+        .mqtt_disc_pref = FIXTURE_DISC_PREFIX,
+        .mqtt_max_retry = 255,
+        .command_cb = command_cb,
+        .telemetry_cb = telemetry_cb,
+    };
+    mqtt_configure(&cfg);
+    mqtt_init();
+    fake_mqtt_connect();
+    fake_mqtt_sync();
+    return WAIT_FOR(mqtt_is_connected(), 1000);
+}
@@ -0,0 +1,124 @@
+/* Device-based HA discovery (user-031). With CONFIG_MQTT_HA_DEVICE_DISCOVERY the 64 entities go
+ * out as components of one retained payload, larger than the MQTT output buffer, so esp-mqtt
+ * writes it in chunks and keeps it in the outbox until the PUBACK. test_ha_device_entities builds
+ * the same file without the option, one config per entity. Both report the discovery bytes and
+ * the time from connecting until every config is acknowledged. */
+#include "cJSON.h"
+#include "ha.h"
+#include "mqtt_fixture.h"
+
+#define ENTITIES 64
+#define DISC FIXTURE_DISC_PREFIX "/"
+#define DEVICE_TOPIC DISC "device/" FIXTURE_CLIENT_ID "/config"
+
+#if CONFIG_MQTT_HA_DEVICE_DISCOVERY
+#define MODE "device"
+#define NAME "test_ha_device"
+#define CONFIGS 1
+#else
+#define MODE "entities"
+#define NAME "test_ha_device_entities"
+#define CONFIGS ENTITIES
+#endif
+
+static char names[ENTITIES][16];
+
+static size_t discovery_bytes(void) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < fake_mqtt_count(); i++) {
+        const fake_mqtt_msg_t *msg = fake_mqtt_get(i);
+        if (!strncmp(msg->topic, DISC, strlen(DISC)))
+            bytes += strlen(msg->topic) + strlen(msg->payload);
+    }
+    return bytes;
+}
+
+// Connect, announce as inet_common does on "ha on", wait until the broker has every config
+static void bench_connect_to_ready(void) {
+    fake_mqtt_set_auto_ack(true);
+    uint64_t start = host_test_now_us();
+    CHECK(fixture_mqtt_start(NULL, NULL));
+    publish_ha_mqtt_discovery(false);
+    bool ready = WAIT_FOR(fake_mqtt_count_prefix(DISC) == CONFIGS && mqtt_get_outbox_size() == 0,
+                          5000);
+    CHECK(ready);
+    uint64_t elapsed = host_test_now_us() - start;
+
+    host_test_bench("ha_" MODE "_discovery_bytes", (double)discovery_bytes(), "B");
+    host_test_bench("ha_" MODE "_discovery_messages", (double)fake_mqtt_count_prefix(DISC), "msgs");
+    host_test_bench("ha_" MODE "_connect_to_ready", elapsed / 1000.0, "ms");
+}
+
+#if CONFIG_MQTT_HA_DEVICE_DISCOVERY
+static void test_components(const char *payload) {
+    cJSON *root = cJSON_Parse(payload);
+    CHECK(root != NULL);
+
+    // Shared options once at the top, inherited by every component
+    CHECK_STR_EQ(cJSON_GetStringValue(cJSON_GetObjectItem(root, "~")), FIXTURE_BASE);
+    CHECK_STR_EQ(cJSON_GetStringValue(cJSON_GetObjectItem(root, "cmd_t")), "~/cmnd");
+    CHECK_STR_EQ(cJSON_GetStringValue(cJSON_GetObjectItem(root, "avty_t")), "~/aval");
+    CHECK(cJSON_IsObject(cJSON_GetObjectItem(root, "dev")));
+    CHECK(cJSON_IsObject(cJSON_GetObjectItem(root, "o")));
+
+    const cJSON *cmps = cJSON_GetObjectItem(root, "cmps");
+    CHECK_INT_EQ(cJSON_GetArraySize(cmps), ENTITIES);
+    const cJSON *cmp;
+    int checked = 0;
+    cJSON_ArrayForEach(cmp, cmps) {
+        // Keyed by unique_id, with the platform and none of the shared options repeated
+        const char *uniq_id = cJSON_GetStringValue(cJSON_GetObjectItem(cmp, "uniq_id"));
+        CHECK_STR_EQ(uniq_id ? uniq_id : "", cmp->string);
+        CHECK_STR_EQ(cJSON_GetStringValue(cJSON_GetObjectItem(cmp, "p")), "sensor");
+        CHECK(!cJSON_HasObjectItem(cmp, "dev"));
+        CHECK(!cJSON_HasObjectItem(cmp, "~"));
+        CHECK(!cJSON_HasObjectItem(cmp, "cmd_t"));
+        CHECK(!cJSON_HasObjectItem(cmp, "avty_t"));
+        checked++;
+    }
+    CHECK_INT_EQ(checked, ENTITIES);
+    cJSON_Delete(root);
+}
+
+// Above the output buffer: several chunks, and in the outbox as a whole until acknowledged
+static void test_chunked_outbox(void) {
+    fake_mqtt_set_auto_ack(false);
+    fake_mqtt_clear_log();
+    publish_ha_mqtt_discovery(false);
+    CHECK(WAIT_FOR(fake_mqtt_last(DEVICE_TOPIC) != NULL, 2000));
+
+    const fake_mqtt_msg_t *msg = fake_mqtt_last(DEVICE_TOPIC);
+    size_t size = msg ? strlen(msg->topic) + strlen(msg->payload) : 0;
+    CHECK(size > CONFIG_MQTT_RX_BUFFER_SIZE);
+    CHECK_INT_EQ(msg ? msg->chunks : 0, (size + CONFIG_MQTT_RX_BUFFER_SIZE - 1) /
+                                            CONFIG_MQTT_RX_BUFFER_SIZE);
+    CHECK(msg && msg->enqueued && msg->qos == 1 && msg->retain);
+    CHECK_INT_EQ(fake_mqtt_count_prefix(DISC), 1);
+    CHECK_INT_EQ(mqtt_get_outbox_size(), size);
+    test_components(msg ? msg->payload : "");
+
+    host_test_sleep_ms(100);
+    CHECK_INT_EQ(mqtt_get_outbox_size(), size);
+    CHECK(msg && fake_mqtt_ack(msg->msg_id));
+    CHECK_INT_EQ(mqtt_get_outbox_size(), 0);
+    fake_mqtt_set_auto_ack(true);
+}
+#endif
+
+int main(void) {
+    for (int i = 0; i < ENTITIES; i++) {
+        snprintf(names[i], sizeof(names[i]), "sensor%d", i);
+        ha_register_entity(&(ha_entity_config_t){
+            .type = HA_SENSOR,
+            .name = names[i],
+            .device_class = "temperature",
+            .parent_key = "temps",
+        });
+    }
+
+    bench_connect_to_ready();
+#if CONFIG_MQTT_HA_DEVICE_DISCOVERY
+    test_chunked_outbox();
+#endif
+    return host_test_done(NAME);
+}
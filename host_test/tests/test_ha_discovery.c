@@ -0,0 +1,130 @@
+/* Incremental HA discovery (user-029): configs go out at QoS 1 and are cached in NVS only after
+ * their PUBACK; "ha on" republishes everything, registry changes only what changed. */
+#include "fake_nvs.h"
+#include "ha.h"
+#include "mqtt_fixture.h"
+
+#define NS "ha_disc"
+#define DISC FIXTURE_DISC_PREFIX "/"
+#define ENTITIES 5
+
+static char names[ENTITIES][16];
+
+static const ha_entity_config_t extra[] = {
+    {.type = HA_SENSOR, .name = "extra", .device_class = "power"},
+    {.type = HA_ENTITY_NONE},
+};
+
+static size_t count_discovery(const char *payload) {
+    size_t n = 0;
+    for (size_t i = 0; i < fake_mqtt_count(); i++) {
+        const fake_mqtt_msg_t *m = fake_mqtt_get(i);
+        if (!strncmp(m->topic, DISC, strlen(DISC)) && (!payload || !strcmp(m->payload, payload)))
+            n++;
+    }
+    return n;
+}
+
+// Discovery settles acknowledged configs while pacing and at the end of a run
+static bool settled(size_t records) {
+    bool ok = WAIT_FOR(fake_nvs_count(NS) == records, 3000);
+    host_test_sleep_ms(100);
+    return ok && fake_nvs_count(NS) == records;
+}
+
+static void test_cached_after_puback(void) {
+    publish_ha_mqtt_discovery(false);
+    CHECK(WAIT_FOR(count_discovery(NULL) == ENTITIES, 2000));
+
+    for (size_t i = 0; i < fake_mqtt_count(); i++) {
+        const fake_mqtt_msg_t *m = fake_mqtt_get(i);
+        if (strncmp(m->topic, DISC, strlen(DISC)))
+            continue;
+        CHECK_INT_EQ(m->qos, 1);
+        CHECK(m->retain);
+        CHECK(m->msg_id > 0);
+    }
+
+    // Nothing is cached before the broker acknowledged it
+    host_test_sleep_ms(100);
+    CHECK_INT_EQ(fake_nvs_count(NS), 0);
+
+    // Ack three; the rest time out (drain timeout) and stay uncached
+    size_t acked = 0;
+    for (size_t i = 0; i < fake_mqtt_count() && acked < 3; i++) {
+        const fake_mqtt_msg_t *m = fake_mqtt_get(i);
+        if (!strncmp(m->topic, DISC, strlen(DISC)) && fake_mqtt_ack(m->msg_id))
+            acked++;
+    }
+    CHECK(settled(3));
+    host_test_sleep_ms(CONFIG_MQTT_HA_DISCOVERY_DRAIN_TIMEOUT_MS + 200);
+    CHECK_INT_EQ(fake_nvs_count(NS), 3);
+    fake_mqtt_ack_all();
+}
+
+static void test_ha_command_bypasses_cache(void) {
+    fake_mqtt_set_auto_ack(true);
+    fake_mqtt_clear_log();
+
+    // Three configs are current in NVS, "ha on" still republishes all of them
+    publish_ha_mqtt_discovery(false);
+    CHECK(WAIT_FOR(count_discovery(NULL) == ENTITIES, 2000));
+    CHECK(settled(ENTITIES));
+    host_test_sleep_ms(100);
+    CHECK_INT_EQ(count_discovery(NULL), ENTITIES);
+}
+
+static void test_registry_change_is_incremental(void) {
+    fake_mqtt_clear_log();
+
+    ha_register_entities(extra, extra);
+    CHECK(settled(ENTITIES + 1));
+    CHECK_INT_EQ(count_discovery(NULL), 1);
+    CHECK(fake_mqtt_last(DISC "sensor/a1b2c3_extra/config") != NULL);
+}
+
+static void test_stale_removal_erased_on_puback(void) {
+    fake_mqtt_set_auto_ack(false);
+    fake_mqtt_clear_log();
+
+    ha_unregister_entities(extra);
+    CHECK(WAIT_FOR(count_discovery("") == 1, 2000));
+
+    const fake_mqtt_msg_t *removal = fake_mqtt_last(DISC "sensor/a1b2c3_extra/config");
+    CHECK(removal && removal->qos == 1 && removal->retain && !removal->payload[0]);
+
+    // The record outlives the unacknowledged removal
+    host_test_sleep_ms(100);
+    CHECK_INT_EQ(fake_nvs_count(NS), ENTITIES + 1);
+
+    CHECK(removal && fake_mqtt_ack(removal->msg_id));
+    CHECK(settled(ENTITIES));
+    CHECK_INT_EQ(count_discovery(NULL), 1);
+    fake_mqtt_set_auto_ack(true);
+}
+
+// A single entity registered after the announcement is published on its own as well
+static void test_register_entity_after_announce(void) {
+    fake_mqtt_clear_log();
+
+    ha_register_entity(&(ha_entity_config_t){.type = HA_SENSOR, .name = "late"});
+    CHECK(settled(ENTITIES + 1));
+    CHECK_INT_EQ(count_discovery(NULL), 1);
+    CHECK(fake_mqtt_last(DISC "sensor/a1b2c3_late/config") != NULL);
+}
+
+int main(void) {
+    for (int i = 0; i < ENTITIES; i++) {
+        snprintf(names[i], sizeof(names[i]), "sensor%d", i);
+        ha_register_entity(&(ha_entity_config_t){.type = HA_SENSOR, .name = names[i]});
+    }
+    CHECK(fixture_mqtt_start(NULL, NULL));
+
+    test_cached_after_puback();
+    test_ha_command_bypasses_cache();
+    test_registry_change_is_incremental();
+    test_stale_removal_erased_on_puback();
+    test_register_entity_after_announce();
+
+    return host_test_done("test_ha_discovery");
+}
@@ -0,0 +1,75 @@
+/* HA discovery pacing (user-030): configs are enqueued at QoS 1 so they count in the outbox and
+ * the high-water mark holds them back; a paused run is resumed on the next connect. */
+#include "fake_nvs.h"
+#include "ha.h"
+#include "mqtt_fixture.h"
+
+#define NS "ha_disc"
+#define DISC FIXTURE_DISC_PREFIX "/"
+#define ENTITIES 10
+
+static char names[ENTITIES][16];
+
+static size_t discovery_in_outbox(void) {
+    size_t n = 0;
+    for (size_t i = 0; i < fake_mqtt_count(); i++) {
+        const fake_mqtt_msg_t *m = fake_mqtt_get(i);
+        n += !strncmp(m->topic, DISC, strlen(DISC));
+    }
+    return n;
+}
+
+static void test_outbox_hwm(void) {
+    publish_ha_mqtt_discovery(false);
+
+    // Each config is ~330 B: two fill the 512 B high-water mark
+    CHECK(WAIT_FOR(discovery_in_outbox() == 2, 1000));
+    host_test_sleep_ms(200);
+    CHECK_INT_EQ(discovery_in_outbox(), 2);
+    CHECK(fake_mqtt_outbox_count() == 2);
+
+    for (size_t i = 0; i < fake_mqtt_count(); i++) {
+        const fake_mqtt_msg_t *m = fake_mqtt_get(i);
+        if (!strncmp(m->topic, DISC, strlen(DISC))) {
+            CHECK(m->enqueued);
+            CHECK_INT_EQ(m->qos, 1);
+        }
+    }
+
+    // PUBACKs drain the outbox and let the next two out
+    fake_mqtt_ack_all();
+    CHECK(WAIT_FOR(discovery_in_outbox() == 4, 1000));
+    host_test_sleep_ms(200);
+    CHECK_INT_EQ(discovery_in_outbox(), 4);
+}
+
+static void test_resume_on_connect(void) {
+    // No more PUBACKs: the run pauses after the drain timeout with two configs cached
+    CHECK(WAIT_FOR(fake_nvs_count(NS) == 2, 1000));
+    host_test_sleep_ms(2 * CONFIG_MQTT_HA_DISCOVERY_DRAIN_TIMEOUT_MS + 200);
+    CHECK_INT_EQ(discovery_in_outbox(), 4);
+    CHECK_INT_EQ(fake_nvs_count(NS), 2);
+
+    // The broker comes back: the paused run starts over and completes
+    fake_mqtt_disconnect();
+    fake_mqtt_sync();
+    fake_mqtt_set_auto_ack(true);
+    fake_mqtt_clear_log();
+    fake_mqtt_connect();
+
+    CHECK(WAIT_FOR(fake_nvs_count(NS) == ENTITIES, 3000));
+    CHECK(discovery_in_outbox() >= ENTITIES - 2);
+}
+
+int main(void) {
+    for (int i = 0; i < ENTITIES; i++) {
+        snprintf(names[i], sizeof(names[i]), "sensor%d", i);
+        ha_register_entity(&(ha_entity_config_t){.type = HA_SENSOR, .name = names[i]});
+    }
+    CHECK(fixture_mqtt_start(NULL, NULL));
+
+    test_outbox_hwm();
+    test_resume_on_connect();
+
+    return host_test_done("test_ha_pacing");
+}
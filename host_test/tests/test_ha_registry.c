@@ -0,0 +1,163 @@
+/* Growable HA entity registry (user-032): 500 entities, half copied and half referenced from
+ * adapter tables, with footprint reports. Adapters are then unregistered and registered again
+ * from several threads while telemetry publishes states and discovery reruns, all through the
+ * registry mutex. */
+#include <pthread.h>
+
+#include "cJSON.h"
+#include "ha.h"
+#include "mqtt_fixture.h"
+
+#define ADAPTERS 5
+#define PER_ADAPTER 50
+#define COPIED 250
+#define ENTITIES (COPIED + ADAPTERS * PER_ADAPTER)
+#define CHURN_ROUNDS 100
+
+static char copied_names[COPIED][16];
+static char adapter_names[ADAPTERS][PER_ADAPTER][16];
+static ha_entity_config_t adapters[ADAPTERS][PER_ADAPTER + 1]; // HA_ENTITY_NONE terminated
+
+static volatile bool churning;
+
+// Discovery is done once nothing new has been published for a while
+static bool discovery_idle(void) {
+    size_t last = fake_mqtt_published();
+    for (int quiet = 0; quiet < 200; quiet++) {
+        host_test_sleep_ms(1);
+        if (fake_mqtt_published() != last) {
+            last = fake_mqtt_published();
+            quiet = 0;
+        }
+    }
+    return true;
+}
+
+static void *churn_adapter(void *arg) {
+    const ha_entity_config_t *table = arg;
+    for (int i = 0; i < CHURN_ROUNDS; i++) {
+        ha_unregister_entities(table);
+        ha_register_entities(table, table);
+    }
+    return NULL;
+}
+
+static void *publish_states(void *arg) {
+    (void)arg;
+    cJSON *tele = cJSON_CreateObject();
+    cJSON *values = cJSON_AddObjectToObject(tele, "values");
+    for (int a = 0; a < ADAPTERS; a++) {
+        cJSON_AddNumberToObject(values, adapter_names[a][0], a);
+    }
+
+    for (int tick = 0; churning; tick++) {
+        for (cJSON *v = values->child; v; v = v->next) {
+            v->valuedouble = v->valueint = tick;
+        }
+        ha_publish_entity_states(tele);
+        host_test_sleep_ms(1);
+    }
+    cJSON_Delete(tele);
+    return NULL;
+}
+
+static void test_footprint(void) {
+    size_t heap_start = host_test_heap_bytes();
+    for (int i = 0; i < COPIED; i++) {
+        snprintf(copied_names[i], sizeof(copied_names[i]), "copied%d", i);
+        ha_register_entity(&(ha_entity_config_t){.type = HA_SENSOR, .name = copied_names[i]});
+    }
+    size_t heap_copied = host_test_heap_bytes();
+
+    for (int a = 0; a < ADAPTERS; a++) {
+        ha_register_entities(adapters[a], adapters[a]);
+    }
+    size_t heap_registry = host_test_heap_bytes();
+
+    // The topic arena is built by the first discovery run
+    fake_mqtt_set_record(false);
+    size_t published = fake_mqtt_published();
+    publish_ha_mqtt_discovery(false);
+    CHECK(WAIT_FOR(fake_mqtt_published() - published >= ENTITIES, 10000));
+    CHECK(discovery_idle());
+    CHECK_INT_EQ(fake_mqtt_published() - published, ENTITIES);
+    size_t heap_arena = host_test_heap_bytes();
+
+    host_test_bench("registry_copied_per_entity", (heap_copied - heap_start) / (double)COPIED, "B");
+    host_test_bench("registry_referenced_per_entity",
+                    (heap_registry - heap_copied) / (double)(ADAPTERS * PER_ADAPTER), "B");
+    host_test_bench("registry_500_entities", heap_registry - heap_start, "B");
+    host_test_bench("topic_arena_500_entities", heap_arena - heap_registry, "B");
+    host_test_bench("config_copies_500_entities", ENTITIES * sizeof(ha_entity_config_t), "B");
+
+    // Referenced entries point at the adapter's table instead of carrying a copy of it
+    CHECK((heap_registry - heap_copied) / (ADAPTERS * PER_ADAPTER) < sizeof(ha_entity_config_t));
+    CHECK(heap_registry - heap_copied < heap_copied - heap_start);
+}
+
+// Unregisters and registers all adapters but the last one from their own threads while another
+// thread publishes states; discovery reruns on every change
+static void churn(void) {
+    pthread_t threads[ADAPTERS - 1], states;
+
+    churning = true;
+    pthread_create(&states, NULL, publish_states, NULL);
+    for (int a = 0; a < ADAPTERS - 1; a++) {
+        pthread_create(&threads[a], NULL, churn_adapter, adapters[a]);
+    }
+    for (int a = 0; a < ADAPTERS - 1; a++) {
+        pthread_join(threads[a], NULL);
+    }
+    churning = false;
+    pthread_join(states, NULL);
+    CHECK(discovery_idle());
+}
+
+static void test_churn(void) {
+    // The first pass makes the one-time allocations of the state publish path
+    churn();
+    size_t heap_before = host_test_heap_bytes();
+    churn();
+
+    // Same entity count: the registry keeps its capacity, the arena is rebuilt at the same size.
+    // Without ASan the count also moves with glibc's per-thread caches, hence the slack.
+    size_t heap_after = host_test_heap_bytes();
+    host_test_bench("heap_delta_after_churn", (double)heap_after - (double)heap_before, "B");
+    CHECK(heap_after < heap_before + CONFIG_MQTT_HA_ENTITY_BLOCK * sizeof(ha_entity_config_t));
+
+    // Everything is registered exactly once again
+    fake_mqtt_set_record(true);
+    fake_mqtt_clear_log();
+    publish_ha_mqtt_discovery(false);
+    CHECK(WAIT_FOR(fake_mqtt_count_prefix(FIXTURE_DISC_PREFIX "/") >= ENTITIES, 10000));
+    CHECK(discovery_idle());
+    CHECK_INT_EQ(fake_mqtt_count_prefix(FIXTURE_DISC_PREFIX "/"), ENTITIES);
+    CHECK(fake_mqtt_last(FIXTURE_DISC_PREFIX "/sensor/a1b2c3_copied0/config") != NULL);
+    CHECK(fake_mqtt_last(FIXTURE_DISC_PREFIX "/sensor/a1b2c3_a0_e0/config") != NULL);
+    CHECK(fake_mqtt_last(FIXTURE_DISC_PREFIX "/sensor/a1b2c3_a4_e49/config") != NULL);
+}
+
+int main(void) {
+    for (int a = 0; a < ADAPTERS; a++) {
+        for (int e = 0; e < PER_ADAPTER; e++) {
+            snprintf(adapter_names[a][e], sizeof(adapter_names[a][e]), "a%d_e%d", a, e);
+            adapters[a][e] = (ha_entity_config_t){
+                .type = HA_SENSOR,
+                .name = adapter_names[a][e],
+                .parent_key = "values",
+            };
+        }
+        adapters[a][PER_ADAPTER] = (ha_entity_config_t){.type = HA_ENTITY_NONE};
+    }
+
+    fake_mqtt_set_auto_ack(true);
+    CHECK(fixture_mqtt_start(NULL, NULL));
+
+    // The birth message must not land among the discovery configs counted by test_footprint
+    CHECK(WAIT_FOR(fake_mqtt_last(FIXTURE_BASE "/aval") != NULL, 1000));
+
+    test_footprint();
+    test_churn();
+
+    return host_test_done("test_ha_registry");
+}
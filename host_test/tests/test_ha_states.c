@@ -0,0 +1,178 @@
+/* Per-entity HA state topics (user-028). With CONFIG_MQTT_HA_ENTITY_STATE_TOPICS a value goes out
+ * retained on its own topic when it changes, not with every telemetry message, and all of them
+ * again after a reconnect. test_ha_states_tele builds the same file without the option, where
+ * every entity templates against the shared tele message. Both report, for one changed value per
+ * telemetry message, the Home Assistant template evaluations (one per entity subscribed to the
+ * topic of each message, as read from the discovery configs) and the bytes sent per change. */
+#include "cJSON.h"
+#include "ha.h"
+#include "mqtt_fixture.h"
+
+// Not in mqtt.h: the telemetry task's publish step, called directly
+void mqtt_publish_telemetry(void);
+
+#define ENTITIES 32
+#define TICKS 200
+
+#if CONFIG_MQTT_HA_ENTITY_STATE_TOPICS
+#define MODE "state_topics"
+#define NAME "test_ha_states"
+#define STATE_TOPICS ENTITIES // stat_t topics in the discovery configs
+#else
+#define MODE "tele"
+#define NAME "test_ha_states_tele"
+#define STATE_TOPICS 1
+#endif
+
+static char names[ENTITIES][16];
+static int values[ENTITIES];
+
+// Entities whose stat_t is each topic, from the retained discovery configs
+static struct {
+    char topic[128];
+    int entities;
+} subscriptions[ENTITIES];
+static size_t subscription_count;
+
+static void telemetry(cJSON *root) {
+    cJSON *temps = cJSON_AddObjectToObject(root, "temps");
+    for (int i = 0; i < ENTITIES; i++) {
+        cJSON_AddNumberToObject(temps, names[i], values[i]);
+    }
+}
+
+static size_t count_suffix(const char *suffix) {
+    size_t n = 0, len = strlen(suffix);
+    for (size_t i = 0; i < fake_mqtt_count(); i++) {
+        const char *topic = fake_mqtt_get(i)->topic;
+        n += strlen(topic) >= len && !strcmp(topic + strlen(topic) - len, suffix);
+    }
+    return n;
+}
+
+static void read_subscriptions(void) {
+    for (size_t i = 0; i < fake_mqtt_count(); i++) {
+        const fake_mqtt_msg_t *msg = fake_mqtt_get(i);
+        if (strncmp(msg->topic, FIXTURE_DISC_PREFIX "/", strlen(FIXTURE_DISC_PREFIX "/")))
+            continue;
+        cJSON *config = cJSON_Parse(msg->payload);
+        const char *stat_t = cJSON_GetStringValue(cJSON_GetObjectItem(config, "stat_t"));
+        CHECK(stat_t && !strncmp(stat_t, "~/", 2));
+        char topic[128];
+        snprintf(topic, sizeof(topic), FIXTURE_BASE "%s", stat_t ? stat_t + 1 : "");
+        size_t s = 0;
+        while (s < subscription_count && strcmp(subscriptions[s].topic, topic))
+            s++;
+        if (s == subscription_count) {
+            snprintf(subscriptions[s].topic, sizeof(subscriptions[s].topic), "%s", topic);
+            subscription_count++;
+        }
+        subscriptions[s].entities++;
+        cJSON_Delete(config);
+    }
+}
+
+static int evaluations(const char *topic) {
+    for (size_t s = 0; s < subscription_count; s++) {
+        if (!strcmp(subscriptions[s].topic, topic))
+            return subscriptions[s].entities;
+    }
+    return 0;
+}
+
+#if CONFIG_MQTT_HA_ENTITY_STATE_TOPICS
+static void test_on_change(void) {
+    // First telemetry: every value, retained on its own topic
+    fake_mqtt_clear_log();
+    mqtt_publish_telemetry();
+    CHECK_INT_EQ(count_suffix("/state"), ENTITIES);
+    const fake_mqtt_msg_t *state = fake_mqtt_last(FIXTURE_BASE "/temp7/state");
+    CHECK(state && state->retain);
+    CHECK_INT_EQ(state ? state->qos : -1, CONFIG_MQTT_QOS);
+    CHECK_STR_EQ(state ? state->payload : "", "7");
+
+    // Nothing changed, nothing but the tele message
+    fake_mqtt_clear_log();
+    mqtt_publish_telemetry();
+    CHECK_INT_EQ(count_suffix("/state"), 0);
+    CHECK_INT_EQ(count_suffix("/tele"), 1);
+
+    // One value changed, one state
+    values[3] = 1000;
+    fake_mqtt_clear_log();
+    mqtt_publish_telemetry();
+    CHECK_INT_EQ(count_suffix("/state"), 1);
+    state = fake_mqtt_last(FIXTURE_BASE "/temp3/state");
+    CHECK_STR_EQ(state ? state->payload : "", "1000");
+
+    // A new connection publishes every state again (the telemetry task's first message)
+    fake_mqtt_disconnect();
+    fake_mqtt_sync();
+    fake_mqtt_clear_log();
+    fake_mqtt_connect();
+    CHECK(WAIT_FOR(mqtt_is_connected() && count_suffix("/state") == ENTITIES, 2000));
+    fake_mqtt_sync();
+    fake_mqtt_clear_log();
+    mqtt_publish_telemetry();
+    CHECK_INT_EQ(count_suffix("/state"), 0);
+}
+#endif
+
+// One value changes per telemetry message, as with a slowly varying set of sensors
+static void bench_changes(void) {
+    fake_mqtt_clear_log();
+    for (int tick = 0; tick < TICKS; tick++) {
+        values[tick % ENTITIES] += 1;
+        mqtt_publish_telemetry();
+    }
+
+    size_t bytes = 0, state_bytes = 0, evals = 0;
+    for (size_t i = 0; i < fake_mqtt_count(); i++) {
+        const fake_mqtt_msg_t *msg = fake_mqtt_get(i);
+        size_t size = strlen(msg->topic) + strlen(msg->payload);
+        bytes += size;
+        if (strstr(msg->topic, "/state"))
+            state_bytes += size;
+        evals += evaluations(msg->topic);
+    }
+#if CONFIG_MQTT_HA_ENTITY_STATE_TOPICS
+    CHECK_INT_EQ(evals, TICKS);
+#else
+    CHECK_INT_EQ(evals, TICKS * ENTITIES);
+    CHECK_INT_EQ(count_suffix("/state"), 0);
+#endif
+
+    // The tele message still goes out every time, the state topics come on top of it
+    host_test_bench("ha_" MODE "_template_evals_per_change", (double)evals / TICKS, "evals");
+    host_test_bench("ha_" MODE "_bytes_per_change", (double)bytes / TICKS, "B");
+    host_test_bench("ha_" MODE "_state_bytes_per_change", (double)state_bytes / TICKS, "B");
+}
+
+int main(void) {
+    for (int i = 0; i < ENTITIES; i++) {
+        snprintf(names[i], sizeof(names[i]), "temp%d", i);
+        values[i] = i;
+        ha_register_entity(&(ha_entity_config_t){
+            .type = HA_SENSOR,
+            .name = names[i],
+            .device_class = "temperature",
+            .parent_key = "temps",
+        });
+    }
+
+    fake_mqtt_set_auto_ack(true);
+    CHECK(fixture_mqtt_start(NULL, telemetry));
+    CHECK(WAIT_FOR(fake_mqtt_last(FIXTURE_BASE "/tele") != NULL, 1000));
+
+    // Discovery builds the entity topic arena that state publishes use
+    publish_ha_mqtt_discovery(false);
+    CHECK(WAIT_FOR(fake_mqtt_count_prefix(FIXTURE_DISC_PREFIX "/") == ENTITIES, 5000));
+    read_subscriptions();
+    CHECK_INT_EQ(subscription_count, STATE_TOPICS);
+
+#if CONFIG_MQTT_HA_ENTITY_STATE_TOPICS
+    test_on_change();
+#endif
+    bench_changes();
+    return host_test_done(NAME);
+}
@@ -0,0 +1,97 @@
+/* Content negotiation of static assets (user-038): the stored variant the client weights highest
+ * is sent, q=0 refuses a coding, a request without Accept-Encoding gets identity only, and an
+ * asset stored compressed only gets 406 instead of bytes the client cannot decode. */
+#include "http_fixture.h"
+
+typedef struct {
+    const char *uri;
+    const char *accept; // NULL: no Accept-Encoding header
+    int status;
+    const char *encoding; // Expected Content-Encoding, NULL for none
+    const char *body;
+} case_t;
+
+static const case_t cases[] = {
+    // app.js: br and gz stored
+    {"/app.js", NULL, 406, NULL, NULL},
+    {"/app.js", "", 406, NULL, NULL},
+    {"/app.js", "identity", 406, NULL, NULL},
+    {"/app.js", "gzip", 200, "gzip", "app.js gz"},
+    {"/app.js", "gzip, deflate, br", 200, "br", "app.js br"},
+    {"/app.js", "br;q=0, gzip", 200, "gzip", "app.js gz"},
+    {"/app.js", "br; q=0, gzip", 200, "gzip", "app.js gz"},
+    {"/app.js", "gzip;q=0, br;q=0", 406, NULL, NULL},
+    {"/app.js", "gzip;q=0.000", 406, NULL, NULL},
+    {"/app.js", "gzip;q=1.0, br;q=0.5", 200, "gzip", "app.js gz"},
+    {"/app.js", "gzip;q=0.5, br;q=0.8", 200, "br", "app.js br"},
+    {"/app.js", "GZIP", 200, "gzip", "app.js gz"},
+    {"/app.js", "x-gzip", 200, "gzip", "app.js gz"},
+    {"/app.js", "gzipped, brotli", 406, NULL, NULL},
+    {"/app.js", "*", 200, "br", "app.js br"},
+    {"/app.js", "*;q=0", 406, NULL, NULL},
+    {"/app.js", "br;q=0, *", 200, "gzip", "app.js gz"},
+    // style.css: gz only
+    {"/style.css", "deflate, br", 406, NULL, NULL},
+    {"/style.css", "deflate, gzip", 200, "gzip", "style.css gz"},
+    // logo.png: identity only
+    {"/logo.png", NULL, 200, NULL, "logo.png"},
+    {"/logo.png", "gzip, br", 200, NULL, "logo.png"},
+    {"/logo.png", "identity;q=0", 406, NULL, NULL},
+    {"/logo.png", "*;q=0", 406, NULL, NULL},
+    {"/logo.png", "*;q=0, identity", 200, NULL, "logo.png"},
+    // Not in the manifest, .gz only (e.g. uploaded over WebDAV)
+    {"/notes.txt", NULL, 404, NULL, NULL},
+    {"/notes.txt", "gzip;q=0", 404, NULL, NULL},
+    {"/notes.txt", "gzip", 200, "gzip", "notes.txt gz"},
+};
+
+static void write_assets(void) {
+    const char *manifest = "/app.js br,gz 11111111\n"
+                           "/logo.png id 22222222\n"
+                           "/style.css gz 33333333\n";
+    CHECK(fixture_fs_write("/www/.manifest", manifest, strlen(manifest)));
+    CHECK(fixture_fs_write("/www/app.js.br", "app.js br", 9));
+    CHECK(fixture_fs_write("/www/app.js.gz", "app.js gz", 9));
+    CHECK(fixture_fs_write("/www/style.css.gz", "style.css gz", 12));
+    CHECK(fixture_fs_write("/www/logo.png", "logo.png", 8));
+    CHECK(fixture_fs_write("/www/notes.txt.gz", "notes.txt gz", 12));
+}
+
+static void test_negotiation(void) {
+    char headers[128], buf[64];
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); i++) {
+        const case_t *c = &cases[i];
+        if (c->accept)
+            snprintf(headers, sizeof(headers), "Accept-Encoding: %s\n", c->accept);
+        fake_httpd_resp_t *resp = fake_httpd_get(c->uri, c->accept ? headers : NULL);
+        CHECK(resp != NULL);
+        if (!resp)
+            continue;
+
+        const char *encoding = fake_httpd_header(resp, "Content-Encoding", buf, sizeof(buf));
+        bool ok = resp->status == c->status &&
+                  (c->encoding ? encoding && !strcmp(encoding, c->encoding) : !encoding) &&
+                  (!c->body || !strcmp(resp->body, c->body));
+        if (!ok) {
+            fprintf(stderr, "%s with \"%s\": got %d %s \"%s\", expected %d %s\n", c->uri,
+                    c->accept ? c->accept : "(none)", resp->status, encoding ? encoding : "-",
+                    resp->body ? resp->body : "", c->status, c->encoding ? c->encoding : "-");
+            host_test_failures++;
+        }
+        // Caches must key compressed-only answers on the header too
+        if (resp->status == 406)
+            CHECK(fake_httpd_header(resp, "Vary", buf, sizeof(buf)) != NULL);
+        fake_httpd_free(resp);
+    }
+}
+
+int main(void) {
+    fixture_fs_reset();
+    write_assets();
+    CHECK(fixture_http_start());
+
+    test_negotiation();
+
+    http_shutdown();
+    return host_test_done("test_http_encoding");
+}
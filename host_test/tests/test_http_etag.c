@@ -0,0 +1,133 @@
+/* Static asset revalidation (user-033): manifest assets carry their content hash as ETag, other
+ * files size + mtime; a matching If-None-Match gets 304 without a body, and hashed names are
+ * cacheable as immutable. Reports the bytes of a cold load and a warm reload of the real pages. */
+#include "http_fixture.h"
+#include <utime.h>
+
+#define MAX_ASSETS 16
+#define ACCEPT "Accept-Encoding: gzip, deflate, br\n"
+
+typedef struct {
+    char uri[128];
+    char etag[32];
+    bool immutable;
+} asset_t;
+
+static asset_t assets[MAX_ASSETS];
+static size_t asset_count;
+
+static size_t load_manifest(void) {
+    char *manifest = fixture_fs_read("/www/.manifest", NULL);
+    CHECK(manifest != NULL);
+    for (char *line = manifest ? strtok(manifest, "\n") : NULL; line && asset_count < MAX_ASSETS;
+         line = strtok(NULL, "\n")) {
+        sscanf(line, "%127s", assets[asset_count++].uri);
+    }
+    free(manifest);
+    return asset_count;
+}
+
+// Browser cold load: every asset, no validators
+static size_t cold_load(void) {
+    size_t bytes = 0;
+    char buf[64];
+    for (size_t i = 0; i < asset_count; i++) {
+        fake_httpd_resp_t *resp = fake_httpd_get(assets[i].uri, ACCEPT);
+        CHECK(resp && resp->status == 200 && resp->body_len > 0);
+        if (!resp)
+            continue;
+
+        CHECK(fake_httpd_header(resp, "ETag", assets[i].etag, sizeof(assets[i].etag)));
+        const char *cc = fake_httpd_header(resp, "Cache-Control", buf, sizeof(buf));
+        assets[i].immutable = cc && strstr(cc, "immutable");
+        bytes += resp->bytes;
+        fake_httpd_free(resp);
+    }
+    return bytes;
+}
+
+// Browser reload: immutable assets come from its cache, the rest is revalidated
+static size_t warm_reload(size_t *requests) {
+    size_t bytes = 0;
+    char headers[128];
+    for (size_t i = 0; i < asset_count; i++) {
+        if (assets[i].immutable)
+            continue;
+        snprintf(headers, sizeof(headers), ACCEPT "If-None-Match: %s\n", assets[i].etag);
+        fake_httpd_resp_t *resp = fake_httpd_get(assets[i].uri, headers);
+        CHECK(resp && resp->status == 304 && resp->body_len == 0);
+        if (resp)
+            bytes += resp->bytes;
+        (*requests)++;
+        fake_httpd_free(resp);
+    }
+    return bytes;
+}
+
+static void test_manifest_assets(void) {
+    CHECK(load_manifest() >= 3);
+
+    size_t cold = cold_load();
+    size_t immutable = 0;
+    for (size_t i = 0; i < asset_count; i++) {
+        // web_assets.py hashes js/css names; index.html keeps its name and must revalidate
+        bool hashed = strstr(assets[i].uri, ".js") || strstr(assets[i].uri, ".css");
+        CHECK_INT_EQ(assets[i].immutable, hashed);
+        CHECK(assets[i].etag[0] == '"');
+        immutable += assets[i].immutable;
+    }
+    CHECK(immutable >= 2);
+
+    size_t requests = 0;
+    size_t warm = warm_reload(&requests);
+    CHECK_INT_EQ(requests, asset_count - immutable);
+
+    host_test_bench("cold_load_bytes", cold, "B");
+    host_test_bench("warm_reload_bytes", warm, "B");
+    host_test_bench("warm_reload_requests", requests, "");
+
+    // A stale validator gets the full body again
+    fake_httpd_resp_t *resp = fake_httpd_get("/", ACCEPT "If-None-Match: \"00000000-gz\"\n");
+    CHECK(resp && resp->status == 200 && resp->body_len > 0);
+    fake_httpd_free(resp);
+}
+
+static void test_uploaded_file(void) {
+    // Not in the manifest (uploaded over WebDAV): the tag follows size and mtime
+    const char *v1 = "first version";
+    CHECK(fixture_fs_write("/www/notes.txt", v1, strlen(v1)));
+
+    char etag[32], buf[64];
+    fake_httpd_resp_t *resp = fake_httpd_get("/notes.txt", NULL);
+    CHECK(resp && resp->status == 200);
+    CHECK(resp && fake_httpd_header(resp, "ETag", etag, sizeof(etag)));
+    CHECK(resp && !strcmp(fake_httpd_header(resp, "Cache-Control", buf, sizeof(buf)), "no-cache"));
+    fake_httpd_free(resp);
+
+    char headers[64];
+    snprintf(headers, sizeof(headers), "If-None-Match: %s\n", etag);
+    resp = fake_httpd_get("/notes.txt", headers);
+    CHECK(resp && resp->status == 304 && resp->body_len == 0);
+    fake_httpd_free(resp);
+
+    // Rewritten with another size and a later mtime: the old tag no longer matches
+    const char *v2 = "second, longer version";
+    CHECK(fixture_fs_write("/www/notes.txt", v2, strlen(v2)));
+    utime(FIXTURE_WWW "/notes.txt", &(struct utimbuf){.actime = 2000000000, .modtime = 2000000000});
+    resp = fake_httpd_get("/notes.txt", headers);
+    CHECK(resp && resp->status == 200);
+    CHECK(resp && resp->body && !strcmp(resp->body, v2));
+    fake_httpd_free(resp);
+}
+
+int main(void) {
+    fixture_fs_reset();
+    CHECK(fixture_fs_stage_pages());
+    CHECK(fixture_http_start());
+
+    test_manifest_assets();
+    test_uploaded_file();
+
+    http_shutdown();
+    return host_test_done("test_http_etag");
+}
@@ -0,0 +1,96 @@
+/* WebSocket push channel (user-036): a subscriber gets the full state on connect, then only the
+ * top-level keys that changed, null for keys the snapshot dropped, and nothing when nothing
+ * changed; a new subscriber makes the next push a full one. */
+#include "cJSON.h"
+#include "http_fixture.h"
+
+static int temp = 20;
+static bool with_humidity = true;
+static bool with_uptime = true;
+
+static void snapshot(cJSON *root) {
+    cJSON_AddNumberToObject(root, "temp", temp);
+    if (with_humidity)
+        cJSON_AddNumberToObject(root, "humidity", 40);
+    if (with_uptime)
+        cJSON_AddStringToObject(root, "uptime", "1d");
+}
+
+static bool cmnd(const char *json, cJSON *result) {
+    cJSON *root = cJSON_Parse(json);
+    if (!root)
+        return false;
+    cJSON_AddStringToObject(result, "led", "on");
+    cJSON_Delete(root);
+    return true;
+}
+
+// Notifies and returns the frame it pushed to fd, NULL if none
+static const char *push(int fd) {
+    size_t before = fake_httpd_ws_count(fd);
+    http_events_notify();
+    fake_httpd_sync();
+    return fake_httpd_ws_count(fd) > before ? fake_httpd_ws_last(fd) : NULL;
+}
+
+static void test_deltas(void) {
+    int fd = fake_httpd_ws_connect("/events");
+    CHECK(fd >= 0);
+    CHECK_STR_EQ(fake_httpd_ws_last(fd),
+                 "{\"full\":true,\"tele\":{\"temp\":20,\"humidity\":40,\"uptime\":\"1d\"}}");
+
+    // The push after a connect is full, so a change racing the handshake cannot be lost
+    CHECK_STR_EQ(push(fd),
+                 "{\"full\":true,\"tele\":{\"temp\":20,\"humidity\":40,\"uptime\":\"1d\"}}");
+
+    temp = 21;
+    CHECK_STR_EQ(push(fd), "{\"full\":false,\"tele\":{\"temp\":21}}");
+    CHECK(push(fd) == NULL);
+
+    // Removed keys are sent as null so clients drop them
+    with_humidity = false;
+    CHECK_STR_EQ(push(fd), "{\"full\":false,\"tele\":{\"humidity\":null}}");
+    CHECK(push(fd) == NULL);
+
+    // Removed and changed in the same push; a key coming back is sent with its value
+    with_uptime = false;
+    temp = 22;
+    CHECK_STR_EQ(push(fd), "{\"full\":false,\"tele\":{\"temp\":22,\"uptime\":null}}");
+    with_humidity = true;
+    CHECK_STR_EQ(push(fd), "{\"full\":false,\"tele\":{\"humidity\":40}}");
+
+    // A second subscriber: its own full state, and a full push to everyone next
+    int fd2 = fake_httpd_ws_connect("/events");
+    CHECK(fd2 >= 0);
+    CHECK_STR_EQ(fake_httpd_ws_last(fd2), "{\"full\":true,\"tele\":{\"temp\":22,\"humidity\":40}}");
+    CHECK_STR_EQ(push(fd), "{\"full\":true,\"tele\":{\"temp\":22,\"humidity\":40}}");
+    CHECK_STR_EQ(fake_httpd_ws_last(fd2), "{\"full\":true,\"tele\":{\"temp\":22,\"humidity\":40}}");
+
+    fake_httpd_ws_close(fd);
+    fake_httpd_ws_close(fd2);
+}
+
+static void test_command_frame(void) {
+    int fd = fake_httpd_ws_connect("/events");
+    CHECK(fd >= 0);
+    fake_httpd_ws_send(fd, "{\"led\":\"on\"}");
+    fake_httpd_sync();
+    CHECK_STR_EQ(fake_httpd_ws_last(fd), "{\"cmnd\":{\"led\":\"on\"}}");
+
+    fake_httpd_ws_send(fd, "not json");
+    fake_httpd_sync();
+    CHECK_STR_EQ(fake_httpd_ws_last(fd), "{\"cmnd\":null}");
+    fake_httpd_ws_close(fd);
+}
+
+int main(void) {
+    fixture_fs_reset();
+    CHECK(fixture_http_start());
+    http_register_events("/events", snapshot, cmnd);
+
+    test_deltas();
+    test_command_frame();
+
+    http_shutdown();
+    return host_test_done("test_http_events");
+}
@@ -0,0 +1,197 @@
+/* Long-poll /tele (user-039), driven like a script would: ?since=N is parked until the version
+ * moves past N (then answered with the new body and X-Tele-Version) or the wait expires; a stale
+ * "since" or no "since" answers at once, the version wraps, slots beyond HTTP_LONGPOLL_MAX get
+ * 503, and shutdown answers what is still parked. A client following the version reaches the
+ * latest one with at most one request per change. */
+#include "cJSON.h"
+#include "http_fixture.h"
+#include <inttypes.h>
+#include <pthread.h>
+
+#define MAX_WAIT_MS CONFIG_HTTP_LONGPOLL_MAX_WAIT_MS
+#define BUMPS 20
+
+static uint32_t version_now;
+
+static uint32_t version(void) {
+    return __atomic_load_n(&version_now, __ATOMIC_SEQ_CST);
+}
+
+static void bump(void) {
+    __atomic_add_fetch(&version_now, 1, __ATOMIC_SEQ_CST);
+    http_notify_version();
+}
+
+static void tele(cJSON *root) {
+    cJSON_AddNumberToObject(root, "v", version());
+}
+
+static fake_httpd_resp_t *poll_start(const char *query) {
+    char uri[64];
+    snprintf(uri, sizeof(uri), "/tele%s", query);
+    return fake_httpd_start(&(fake_httpd_request_t){.method = HTTP_GET, .uri = uri});
+}
+
+static fake_httpd_resp_t *poll_since(uint32_t since, uint32_t wait_ms) {
+    char query[48];
+    snprintf(query, sizeof(query), "?since=%" PRIu32 "&wait=%" PRIu32, since, wait_ms);
+    return poll_start(query);
+}
+
+// X-Tele-Version of a response; the body must have been built at that version
+static uint32_t resp_version(const fake_httpd_resp_t *resp) {
+    char buf[16];
+    const char *hdr = fake_httpd_header(resp, "X-Tele-Version", buf, sizeof(buf));
+    CHECK(hdr != NULL);
+    cJSON *body = cJSON_Parse(resp->body);
+    cJSON *v = cJSON_GetObjectItem(body, "v");
+    uint32_t header_version = hdr ? strtoul(hdr, NULL, 10) : 0;
+    CHECK(cJSON_IsNumber(v) && (uint32_t)v->valuedouble == header_version);
+    cJSON_Delete(body);
+    return header_version;
+}
+
+static void test_immediate(void) {
+    fake_httpd_resp_t *resp = fake_httpd_get("/tele", NULL);
+    CHECK(resp && resp->status == 200 && resp_version(resp) == version());
+    fake_httpd_free(resp);
+
+    // Already moved past "since", or nothing to wait for
+    resp = fake_httpd_do(&(fake_httpd_request_t){.method = HTTP_GET, .uri = "/tele?since=0"});
+    CHECK(version() > 0);
+    CHECK(resp && resp->status == 200 && resp_version(resp) == version());
+    fake_httpd_free(resp);
+
+    fake_httpd_resp_t *now = poll_since(version(), 0);
+    CHECK(fake_httpd_wait(now, 200) && now->status == 200);
+    fake_httpd_free(now);
+}
+
+static void test_wakes_on_change(void) {
+    uint32_t since = version();
+    fake_httpd_resp_t *resp = poll_since(since, MAX_WAIT_MS);
+    host_test_sleep_ms(100);
+    CHECK(!fake_httpd_done(resp));
+
+    uint64_t bumped = host_test_now_us();
+    bump();
+    CHECK(fake_httpd_wait(resp, 500));
+    CHECK_INT_EQ(resp->status, 200);
+    CHECK_INT_EQ(resp_version(resp), since + 1);
+    host_test_bench("notify_to_answer_us", resp->done_us - bumped, "us");
+    fake_httpd_free(resp);
+}
+
+static void test_wait_expires(void) {
+    uint32_t since = version();
+    fake_httpd_resp_t *resp = poll_since(since, 200);
+    CHECK(fake_httpd_wait(resp, 2000));
+    uint64_t waited_ms = (resp->done_us - resp->start_us) / 1000;
+    CHECK(waited_ms >= 190 && waited_ms < 1000);
+    CHECK_INT_EQ(resp->status, 200);
+    CHECK_INT_EQ(resp_version(resp), since);
+    fake_httpd_free(resp);
+
+    // A longer wait than allowed is capped
+    resp = poll_since(since, 600000);
+    CHECK(fake_httpd_wait(resp, MAX_WAIT_MS + 1000));
+    waited_ms = (resp->done_us - resp->start_us) / 1000;
+    CHECK(waited_ms >= MAX_WAIT_MS - 10 && waited_ms < MAX_WAIT_MS + 500);
+    fake_httpd_free(resp);
+}
+
+static void test_slots_full(void) {
+    fake_httpd_resp_t *parked[CONFIG_HTTP_LONGPOLL_MAX];
+    for (int i = 0; i < CONFIG_HTTP_LONGPOLL_MAX; i++) {
+        parked[i] = poll_since(version(), MAX_WAIT_MS);
+    }
+    fake_httpd_sync();
+
+    char buf[8];
+    fake_httpd_resp_t *extra = poll_since(version(), MAX_WAIT_MS);
+    CHECK(fake_httpd_wait(extra, 500));
+    CHECK_INT_EQ(extra->status, 503);
+    CHECK_STR_EQ(fake_httpd_header(extra, "Retry-After", buf, sizeof(buf)), "1");
+    fake_httpd_free(extra);
+
+    // One change answers every parked request
+    bump();
+    for (int i = 0; i < CONFIG_HTTP_LONGPOLL_MAX; i++) {
+        CHECK(fake_httpd_wait(parked[i], 500) && parked[i]->status == 200);
+        fake_httpd_free(parked[i]);
+    }
+}
+
+static void test_version_wraps(void) {
+    __atomic_store_n(&version_now, UINT32_MAX, __ATOMIC_SEQ_CST);
+    fake_httpd_resp_t *resp = poll_since(UINT32_MAX, MAX_WAIT_MS);
+    host_test_sleep_ms(50);
+    CHECK(!fake_httpd_done(resp));
+    bump();
+    CHECK(fake_httpd_wait(resp, 500));
+    CHECK_INT_EQ(resp_version(resp), 0);
+    fake_httpd_free(resp);
+
+    // "since" from before the wrap is stale
+    resp = poll_since(UINT32_MAX - 5, MAX_WAIT_MS);
+    CHECK(fake_httpd_wait(resp, 200));
+    fake_httpd_free(resp);
+}
+
+static void *bumper(void *arg) {
+    (void)arg;
+    for (int i = 0; i < BUMPS; i++) {
+        host_test_sleep_ms(20);
+        bump();
+    }
+    return NULL;
+}
+
+// The loop a script runs: since = X-Tele-Version of the previous answer
+static void test_client_follows(void) {
+    uint32_t last = version(), target = version() + BUMPS;
+    size_t requests = 0, missed = 0;
+    pthread_t thread;
+    pthread_create(&thread, NULL, bumper, NULL);
+    while (last != target && requests < 4 * BUMPS) {
+        fake_httpd_resp_t *resp = poll_since(last, MAX_WAIT_MS);
+        CHECK(fake_httpd_wait(resp, MAX_WAIT_MS + 500) && resp->status == 200);
+        uint32_t v = resp_version(resp);
+        missed += v - last - 1;
+        last = v;
+        requests++;
+        fake_httpd_free(resp);
+    }
+    pthread_join(thread, NULL);
+
+    CHECK_INT_EQ(last, target);
+    CHECK(requests <= BUMPS);
+    host_test_bench("client_requests", requests, "");
+    host_test_bench("client_versions_coalesced", missed, "");
+}
+
+static void test_shutdown_answers_parked(void) {
+    fake_httpd_resp_t *resp = poll_since(version(), MAX_WAIT_MS);
+    fake_httpd_sync();
+    http_shutdown();
+    CHECK(fake_httpd_wait(resp, 500));
+    CHECK_INT_EQ(resp->status, 200);
+    fake_httpd_free(resp);
+}
+
+int main(void) {
+    __atomic_store_n(&version_now, 7, __ATOMIC_SEQ_CST);
+    fixture_fs_reset();
+    CHECK(fixture_http_start());
+    http_register_json_get_versioned("/tele", tele, version);
+
+    test_immediate();
+    test_wakes_on_change();
+    test_wait_expires();
+    test_slots_full();
+    test_version_wraps();
+    test_client_follows();
+    test_shutdown_answers_parked();
+
+    return host_test_done("test_http_longpoll");
+}
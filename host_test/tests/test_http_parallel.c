@@ -0,0 +1,97 @@
+/* Re-entrant static file handler (user-034): 20 files fetched in parallel by slow clients each
+ * get their own file back intact, and with worker tasks a slow download does not hold up
+ * POST /cmnd. Built twice, with CONFIG_HTTP_STATIC_WORKERS=2 and without workers. */
+#include "cJSON.h"
+#include "http_fixture.h"
+
+#define FILES 20
+#define FILE_SIZE (8 * 1024)
+#define SLOW_SIZE (64 * 1024)
+#define WRITE_DELAY_MS 2
+#define SLOW_DELAY_MS 20
+
+static char contents[FILES][FILE_SIZE];
+
+static bool cmnd(const char *json, cJSON *result) {
+    cJSON_AddStringToObject(result, "echo", json);
+    return true;
+}
+
+static void test_parallel_fetch(void) {
+    for (int i = 0; i < FILES; i++) {
+        char path[32];
+        for (int j = 0; j < FILE_SIZE; j++) {
+            contents[i][j] = 'a' + (i + j / 1024) % 26;
+        }
+        snprintf(path, sizeof(path), "/www/file%02d.txt", i);
+        CHECK(fixture_fs_write(path, contents[i], FILE_SIZE));
+    }
+
+    fake_httpd_resp_t *resp[FILES];
+    uint64_t start = host_test_now_us();
+    for (int i = 0; i < FILES; i++) {
+        char uri[32];
+        snprintf(uri, sizeof(uri), "/file%02d.txt", i);
+        resp[i] = fake_httpd_start(&(fake_httpd_request_t){
+            .method = HTTP_GET, .uri = uri, .send_delay_ms = WRITE_DELAY_MS});
+        CHECK(resp[i] != NULL);
+    }
+
+    for (int i = 0; i < FILES; i++) {
+        CHECK(resp[i] && fake_httpd_wait(resp[i], 10000));
+        if (!resp[i])
+            continue;
+        CHECK_INT_EQ(resp[i]->status, 200);
+        CHECK_INT_EQ(resp[i]->body_len, FILE_SIZE);
+        CHECK(resp[i]->body_len == FILE_SIZE && !memcmp(resp[i]->body, contents[i], FILE_SIZE));
+    }
+    host_test_bench("parallel_20_files_ms", (host_test_now_us() - start) / 1000.0, "ms");
+    for (int i = 0; i < FILES; i++) {
+        fake_httpd_free(resp[i]);
+    }
+}
+
+static void test_slow_client(void) {
+    static char big[SLOW_SIZE];
+    memset(big, 'z', sizeof(big));
+    CHECK(fixture_fs_write("/www/big.bin", big, sizeof(big)));
+
+    // 64 writes of 1 KB at 20 ms each: the download takes over a second
+    fake_httpd_resp_t *slow = fake_httpd_start(&(fake_httpd_request_t){
+        .method = HTTP_GET, .uri = "/big.bin", .send_delay_ms = SLOW_DELAY_MS});
+    CHECK(WAIT_FOR(slow->first_byte_us != 0, 1000));
+
+    const char *body = "{\"led\":1}";
+    fake_httpd_resp_t *post = fake_httpd_start(&(fake_httpd_request_t){
+        .method = HTTP_POST, .uri = "/cmnd", .body = body, .body_len = strlen(body)});
+    CHECK(fake_httpd_wait(post, 5000));
+    CHECK_INT_EQ(post->status, 200);
+    CHECK(fake_httpd_wait(slow, 5000));
+    CHECK_INT_EQ(slow->body_len, SLOW_SIZE);
+
+    double cmnd_ms = (post->done_us - post->start_us) / 1000.0;
+    host_test_bench("cmnd_latency_during_slow_download_ms", cmnd_ms, "ms");
+#if CONFIG_HTTP_STATIC_WORKERS > 0
+    // A worker streams the download; the server task answers /cmnd right away
+    CHECK(post->done_us < slow->done_us);
+    CHECK(cmnd_ms < 200);
+#else
+    // Inline streaming: /cmnd waits for the whole download
+    CHECK(post->done_us >= slow->done_us);
+#endif
+    fake_httpd_free(post);
+    fake_httpd_free(slow);
+}
+
+int main(void) {
+    fixture_fs_reset();
+    CHECK(fixture_http_start());
+    http_register_json_post("/cmnd", cmnd);
+
+    test_parallel_fetch();
+    test_slow_client();
+
+    http_shutdown();
+    return host_test_done(CONFIG_HTTP_STATIC_WORKERS > 0 ? "test_http_parallel"
+                                                         : "test_http_parallel_inline");
+}
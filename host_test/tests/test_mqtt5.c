@@ -0,0 +1,140 @@
+/* MQTT 5 mode (user-027): topic aliases capped by the broker limit, the full topic on QoS 1
+ * publishes with a bound alias, the "offline" PUBACK seen even when it arrives before the publish
+ * returns, command replies carrying the per-command results with the request's correlation
+ * data. */
+#include "cJSON.h"
+#include "mqtt_fixture.h"
+
+#define RESPONSE_TOPIC "client/replies"
+
+static volatile int commands;
+static volatile bool results_given;
+
+static bool command(const char *payload, cJSON *results) {
+    commands++;
+    results_given = results != NULL;
+
+    cJSON *root = cJSON_Parse(payload);
+    if (!cJSON_IsObject(root)) {
+        cJSON_Delete(root);
+        return false;
+    }
+    for (cJSON *item = root->child; item; item = item->next) {
+        cJSON_AddStringToObject(results, item->string,
+                                strcmp(item->string, "led") ? "unknown" : "accepted");
+    }
+    cJSON_Delete(root);
+    return true;
+}
+
+static void telemetry(cJSON *root) { cJSON_AddNumberToObject(root, "uptime", 1); }
+
+static size_t count_topic(const char *topic) {
+    size_t n = 0;
+    for (size_t i = 0; i < fake_mqtt_count(); i++) {
+        n += !strcmp(fake_mqtt_get(i)->topic, topic);
+    }
+    return n;
+}
+
+static void test_alias_cap(void) {
+    // Broker allows a single alias: tele (1) keeps it, aval (2) is refused once and then capped
+    CHECK(WAIT_FOR(fake_mqtt_last(FIXTURE_BASE "/aval") && fake_mqtt_last(FIXTURE_BASE "/tele"),
+                   1000));
+
+    const fake_mqtt_msg_t *aval = fake_mqtt_last(FIXTURE_BASE "/aval");
+    CHECK_STR_EQ(aval->payload, "online");
+    CHECK_INT_EQ(aval->alias, 0);
+    CHECK_INT_EQ(fake_mqtt_refused(), 1);
+
+    const fake_mqtt_msg_t *tele = fake_mqtt_last(FIXTURE_BASE "/tele");
+    CHECK_INT_EQ(tele->alias, 1);
+    CHECK(!tele->alias_only);
+    CHECK_INT_EQ(tele->expiry_s, CONFIG_MQTT5_TELEMETRY_EXPIRY_S);
+
+    // Bound alias: later telemetry goes out with an empty topic name
+    size_t tele_count = count_topic(FIXTURE_BASE "/tele");
+    mqtt_trigger_telemetry();
+    CHECK(WAIT_FOR(count_topic(FIXTURE_BASE "/tele") > tele_count, 1000));
+    tele = fake_mqtt_last(FIXTURE_BASE "/tele");
+    CHECK_INT_EQ(tele->alias, 1);
+    CHECK(tele->alias_only);
+
+    // The cap holds for the rest of the connection, nothing else is refused
+    mqtt_publish_offline_state();
+    aval = fake_mqtt_last(FIXTURE_BASE "/aval");
+    CHECK_STR_EQ(aval->payload, "offline");
+    CHECK_INT_EQ(aval->alias, 0);
+    CHECK_INT_EQ(fake_mqtt_refused(), 1);
+
+    // A new connection starts from the full alias range again
+    fake_mqtt_set_topic_alias_max(10);
+    fake_mqtt_disconnect();
+    fake_mqtt_sync();
+    fake_mqtt_clear_log();
+    fake_mqtt_connect();
+    CHECK(WAIT_FOR(fake_mqtt_last(FIXTURE_BASE "/aval") != NULL, 1000));
+    aval = fake_mqtt_last(FIXTURE_BASE "/aval");
+    CHECK_INT_EQ(aval->alias, 2);
+    CHECK(!aval->alias_only);
+    CHECK_INT_EQ(fake_mqtt_refused(), 1);
+}
+
+static void test_offline_state(void) {
+    // aval's alias is bound by the birth message; the QoS 1 "offline" still names the topic, an
+    // alias-only message replayed from the outbox after a reconnect would be a protocol error
+    CHECK(WAIT_FOR(fake_mqtt_last(FIXTURE_BASE "/aval") != NULL, 1000));
+    uint64_t start = host_test_now_us();
+    mqtt_publish_offline_state();
+    uint64_t took_ms = (host_test_now_us() - start) / 1000;
+
+    const fake_mqtt_msg_t *aval = fake_mqtt_last(FIXTURE_BASE "/aval");
+    CHECK_STR_EQ(aval->payload, "offline");
+    CHECK_INT_EQ(aval->qos, 1);
+    CHECK_INT_EQ(aval->alias, 2);
+    CHECK(!aval->alias_only);
+
+    // Auto-ack answers before mqtt_publish_ex() returns: confirmed, not the 1 s timeout
+    CHECK(took_ms < 500);
+}
+
+static void test_command_reply(void) {
+    int before = commands;
+    fake_mqtt_deliver(FIXTURE_BASE "/cmnd", "{\"led\":1,\"bogus\":2}", RESPONSE_TOPIC, "id-1", 4);
+    CHECK(WAIT_FOR(fake_mqtt_last(RESPONSE_TOPIC) != NULL, 1000));
+    CHECK_INT_EQ(commands, before + 1);
+    CHECK(results_given);
+
+    const fake_mqtt_msg_t *reply = fake_mqtt_last(RESPONSE_TOPIC);
+    CHECK_STR_EQ(reply->payload, "{\"cmnd\":{\"led\":\"accepted\",\"bogus\":\"unknown\"}}");
+    CHECK_INT_EQ(reply->correlation_len, 4);
+    CHECK(reply->correlation && !memcmp(reply->correlation, "id-1", 4));
+    CHECK_INT_EQ(reply->alias, 0);
+
+    // Rejected payload: null results, correlation still echoed
+    fake_mqtt_deliver(FIXTURE_BASE "/cmnd", "not json", RESPONSE_TOPIC, "id-2", 4);
+    CHECK(WAIT_FOR(count_topic(RESPONSE_TOPIC) == 2, 1000));
+    reply = fake_mqtt_last(RESPONSE_TOPIC);
+    CHECK_STR_EQ(reply->payload, "{\"cmnd\":null}");
+    CHECK(reply->correlation && !memcmp(reply->correlation, "id-2", 4));
+
+    // Without a response topic the command runs and nothing is replied
+    before = commands;
+    fake_mqtt_deliver(FIXTURE_BASE "/cmnd", "{\"led\":0}", NULL, NULL, 0);
+    CHECK(WAIT_FOR(commands == before + 1, 1000));
+    CHECK(!results_given);
+    host_test_sleep_ms(50);
+    CHECK_INT_EQ(count_topic(RESPONSE_TOPIC), 2);
+}
+
+int main(void) {
+    fake_mqtt_set_auto_ack(true);
+    fake_mqtt_set_topic_alias_max(1);
+    CHECK(fixture_mqtt_start(command, telemetry));
+
+    test_alias_cap();
+    test_offline_state();
+    test_command_reply();
+
+    return host_test_done("test_mqtt5");
+}
@@ -0,0 +1,178 @@
+/* Delta OTA (user-047): patches made by ota_delta.py between real executables of this tree go
+ * through POST /ota as application/x-ota-delta, are applied against the running partition and
+ * land in ota_1 byte for byte. The pairs are host (x86-64) builds, not ESP32 app images, built
+ * from the same sources with one Kconfig option or one constant changed, and two different test
+ * programs sharing the HTTP server; the patch sizes reported are the real ones for these pairs.
+ * A patch for other firmware is refused with 409, and without a running partition to patch
+ * against the upload fails with 500 instead of flashing the inflated patch. */
+#include "esp_ota_ops.h"
+#include "fake_partition.h"
+#include "http_fixture.h"
+#include "psa/crypto.h"
+#include <zlib.h>
+
+#define PARTITION_SIZE (2 * 1024 * 1024)
+#define DELTA_TYPE "Content-Type: application/x-ota-delta\n"
+
+typedef struct {
+    const char *name;
+    const char *old_path, *new_path;
+} pair_t;
+
+static const pair_t pairs[] = {
+    {"kconfig", FIXTURE_KCONFIG_OLD, FIXTURE_KCONFIG_NEW},
+    {"constant", FIXTURE_CONSTANT_OLD, FIXTURE_CONSTANT_NEW},
+    {"other_program", FIXTURE_OTHER_OLD, FIXTURE_OTHER_NEW},
+};
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+} blob_t;
+
+static blob_t load(const char *path) {
+    blob_t b = {0};
+    FILE *f = fopen(path, "rb");
+    CHECK(f != NULL);
+    if (!f)
+        return b;
+    fseek(f, 0, SEEK_END);
+    b.len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    b.data = malloc(b.len ? b.len : 1);
+    b.len = fread(b.data, 1, b.len, f);
+    fclose(f);
+    b.data[0] = 0xE9; // esp_image_header_t.magic, the only check the host esp_ota_end() makes
+    return b;
+}
+
+static void reset_partitions(const char *running) {
+    CHECK(fake_partition_add("ota_0", ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0,
+                             PARTITION_SIZE, running));
+    CHECK(fake_partition_add("ota_1", ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1,
+                             PARTITION_SIZE, NULL));
+    // Booting the running one again, as after the restart that follows an update
+    CHECK(esp_ota_set_boot_partition(esp_ota_get_running_partition()) == ESP_OK);
+}
+
+static fake_httpd_resp_t *upload(const blob_t *patch, const blob_t *image) {
+    uint8_t sha[32];
+    size_t sha_len;
+    psa_hash_compute(PSA_ALG_SHA_256, image->data, image->len, sha, sizeof(sha), &sha_len);
+    char headers[160];
+    int n = snprintf(headers, sizeof(headers), "X-OTA-SHA256: ");
+    for (size_t i = 0; i < sha_len; i++) {
+        n += snprintf(headers + n, sizeof(headers) - n, "%02x", sha[i]);
+    }
+    snprintf(headers + n, sizeof(headers) - n, "\n" DELTA_TYPE);
+    return fake_httpd_do(&(fake_httpd_request_t){.method = HTTP_POST,
+                                                 .uri = "/ota",
+                                                 .headers = headers,
+                                                 .body = (const char *)patch->data,
+                                                 .body_len = patch->len});
+}
+
+static bool activated(const blob_t *image) {
+    const uint8_t *data = fake_partition_data("ota_1");
+    return data && !memcmp(data, image->data, image->len) &&
+           esp_ota_get_boot_partition() == esp_ota_get_next_update_partition(NULL);
+}
+
+// Writes both images to the test FS and diffs them; the patch is empty on failure
+static blob_t make_patch(const blob_t *old, const blob_t *new) {
+    CHECK(fixture_fs_write("/old.bin", old->data, old->len));
+    CHECK(fixture_fs_write("/new.bin", new->data, new->len));
+    char cmd[1024];
+    snprintf(cmd, sizeof(cmd), "%s '%s' make '%s' '%s' '%s' > /dev/null", FIXTURE_PYTHON,
+             FIXTURE_OTA_DELTA_PY, FIXTURE_FS "/old.bin", FIXTURE_FS "/new.bin",
+             FIXTURE_FS "/patch.bin");
+    CHECK(system(cmd) == 0);
+    blob_t patch = {0};
+    patch.data = (uint8_t *)fixture_fs_read("/patch.bin", &patch.len);
+    CHECK(patch.data != NULL);
+    return patch;
+}
+
+static void test_pair(const pair_t *p) {
+    blob_t old = load(p->old_path), new = load(p->new_path);
+    if (!old.data || !new.data)
+        return;
+    blob_t patch = make_patch(&old, &new);
+
+    reset_partitions(FIXTURE_FS "/old.bin");
+    int restarts = host_test_restarts();
+    fake_httpd_resp_t *resp = upload(&patch, &new);
+    CHECK(resp && resp->status == 200);
+    fake_httpd_free(resp);
+    CHECK(activated(&new));
+    CHECK_INT_EQ(host_test_restarts(), restarts + 1);
+
+    // What a full compressed upload (ota_pack.py, zlib level 9) of the same image would send
+    uLongf full = compressBound(new.len);
+    uint8_t *packed = malloc(full);
+    CHECK(compress2(packed, &full, new.data, new.len, 9) == Z_OK);
+    free(packed);
+
+    printf("%s: %s -> %s\n", p->name, p->old_path, p->new_path);
+    char name[64];
+    snprintf(name, sizeof(name), "delta_%s_image", p->name);
+    host_test_bench(name, new.len, "B");
+    snprintf(name, sizeof(name), "delta_%s_compressed", p->name);
+    host_test_bench(name, full, "B");
+    snprintf(name, sizeof(name), "delta_%s_patch", p->name);
+    host_test_bench(name, patch.len, "B");
+    snprintf(name, sizeof(name), "delta_%s_patch_pct", p->name);
+    host_test_bench(name, full ? 100.0 * patch.len / full : 0, "%");
+
+    free(patch.data);
+    free(new.data);
+    free(old.data);
+}
+
+static void test_refused(void) {
+    blob_t old = load(pairs[0].old_path), new = load(pairs[0].new_path);
+    if (!old.data || !new.data)
+        return;
+    blob_t patch = make_patch(&old, &new);
+    int restarts = host_test_restarts();
+
+    // Running something else than the patch was made for
+    reset_partitions(FIXTURE_FS "/new.bin");
+    fake_httpd_resp_t *resp = upload(&patch, &new);
+    CHECK(resp && resp->status == 409);
+    fake_httpd_free(resp);
+    CHECK(esp_ota_get_boot_partition() != esp_ota_get_next_update_partition(NULL));
+
+    // No running partition to read the source from: the patch is never taken for the image
+    reset_partitions(NULL);
+    fake_partition_remove("ota_0");
+    resp = upload(&patch, &new);
+    CHECK(resp && resp->status == 500);
+    fake_httpd_free(resp);
+    CHECK(esp_ota_get_boot_partition() != esp_ota_get_next_update_partition(NULL));
+    CHECK_INT_EQ(host_test_restarts(), restarts);
+
+    // The writer was released: the next good upload goes through
+    reset_partitions(FIXTURE_FS "/old.bin");
+    resp = upload(&patch, &new);
+    CHECK(resp && resp->status == 200);
+    fake_httpd_free(resp);
+    CHECK(activated(&new));
+
+    free(patch.data);
+    free(new.data);
+    free(old.data);
+}
+
+int main(void) {
+    fixture_fs_reset();
+    CHECK(fixture_http_start());
+
+    for (size_t i = 0; i < sizeof(pairs) / sizeof(*pairs); i++) {
+        test_pair(&pairs[i]);
+    }
+    test_refused();
+
+    http_shutdown();
+    return host_test_done("test_ota_delta");
+}
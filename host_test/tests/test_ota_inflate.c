@@ -0,0 +1,189 @@
+/* Compressed OTA (user-046): images packed by ota_pack.py (window 32 KB and the smallest, 512 B)
+ * inflate back byte for byte through ota_inflate.c, fed in pieces from 1 B to the whole stream,
+ * including matches reaching back as far as zlib does and stored (incompressible) blocks.
+ * Truncated, trailing, corrupt and mis-headed streams are refused, and a failing sink stops the
+ * stream. */
+#include "host_test.h"
+#include "ota_inflate.h"
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#define FW_SIZE (1024 * 1024)
+#define RANDOM_SIZE (96 * 1024)
+#define WINDOW (32 * 1024)
+#define DIR CONFIG_VFS_LITTLEFS_MOUNT_POINT
+
+typedef struct {
+    uint8_t *data;
+    size_t len, cap;
+    size_t max_piece;
+    size_t fail_after; // 0: never
+} sink_t;
+
+static esp_err_t collect(void *ctx, const uint8_t *data, size_t len) {
+    sink_t *s = ctx;
+    if (s->fail_after && s->len + len > s->fail_after)
+        return ESP_FAIL;
+    if (len > s->cap - s->len)
+        return ESP_ERR_INVALID_SIZE;
+    memcpy(s->data + s->len, data, len);
+    s->len += len;
+    s->max_piece = len > s->max_piece ? len : s->max_piece;
+    return ESP_OK;
+}
+
+static uint8_t *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(*len ? *len : 1);
+    *len = fread(data, 1, *len, f);
+    fclose(f);
+    return data;
+}
+
+static uint8_t *pack(const uint8_t *image, size_t len, int wbits, size_t *packed_len) {
+    FILE *f = fopen(DIR "/image.bin", "wb");
+    CHECK(f && fwrite(image, 1, len, f) == len);
+    if (f)
+        fclose(f);
+    char cmd[1024];
+    snprintf(cmd, sizeof(cmd), "%s '%s' '%s' '%s' --wbits %d > /dev/null", FIXTURE_PYTHON,
+             FIXTURE_OTA_PACK_PY, DIR "/image.bin", DIR "/image.bin.zz", wbits);
+    CHECK(system(cmd) == 0);
+    return read_file(DIR "/image.bin.zz", packed_len);
+}
+
+// Feeds the stream in pieces of chunk bytes; returns the first error (finish included)
+static esp_err_t inflate(const uint8_t *packed, size_t len, size_t chunk, sink_t *sink) {
+    ota_inflate_t *z = ota_inflate_new(collect, sink);
+    CHECK(z != NULL);
+    if (!z)
+        return ESP_ERR_NO_MEM;
+    esp_err_t err = ESP_OK;
+    for (size_t pos = 0; err == ESP_OK && pos < len; pos += chunk) {
+        err = ota_inflate_feed(z, packed + pos, len - pos < chunk ? len - pos : chunk);
+    }
+    if (err == ESP_OK)
+        err = ota_inflate_finish(z);
+    ota_inflate_free(z);
+    return err;
+}
+
+static void check_round_trip(const char *name, const uint8_t *image, size_t len, int wbits) {
+    size_t packed_len = 0;
+    uint8_t *packed = pack(image, len, wbits, &packed_len);
+    CHECK(packed != NULL);
+    if (!packed)
+        return;
+    printf("%s, wbits %d: %zu B -> %zu B\n", name, wbits, len, packed_len);
+
+    const size_t chunks[] = {1, 13, 1024, 2048, packed_len};
+    sink_t sink = {.data = malloc(len + 1), .cap = len};
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(*chunks); i++) {
+        if (chunks[i] == 1 && packed_len > 256 * 1024)
+            continue; // Too slow under the sanitizers, the 13 B pieces cover it
+        sink.len = sink.max_piece = 0;
+        esp_err_t err = inflate(packed, packed_len, chunks[i], &sink);
+        if (err != ESP_OK || sink.len != len || memcmp(sink.data, image, len)) {
+            fprintf(stderr, "%s, wbits %d, %zu B pieces: %s, %zu of %zu B\n", name, wbits,
+                    chunks[i], esp_err_to_name(err), sink.len, len);
+            host_test_failures++;
+        }
+        // Output leaves in pieces of at most the window
+        CHECK(sink.max_piece <= WINDOW);
+    }
+    free(sink.data);
+    free(packed);
+}
+
+static void check_refused(const uint8_t *image, size_t len) {
+    size_t packed_len = 0;
+    uint8_t *packed = pack(image, len, 15, &packed_len);
+    CHECK(packed != NULL);
+    if (!packed)
+        return;
+    uint8_t *copy = malloc(packed_len + 16);
+    sink_t sink = {.data = malloc(len), .cap = len};
+
+    // Truncated: every byte accepted, finish notices
+    CHECK_INT_EQ(inflate(packed, packed_len - 10, 1024, &sink), ESP_ERR_INVALID_SIZE);
+
+    // Trailing bytes after the end of the stream
+    memcpy(copy, packed, packed_len);
+    memset(copy + packed_len, 0x55, 16);
+    sink.len = 0;
+    CHECK_INT_EQ(inflate(copy, packed_len + 16, 1024, &sink), ESP_ERR_INVALID_SIZE);
+
+    // Adler-32 of the inflated data does not match
+    copy[packed_len - 1] ^= 0x01;
+    sink.len = 0;
+    CHECK_INT_EQ(inflate(copy, packed_len, 1024, &sink), ESP_ERR_INVALID_RESPONSE);
+    copy[packed_len - 1] ^= 0x01;
+
+    // Not a zlib header (raw deflate or gzip sent by mistake)
+    copy[0] = 0x1f;
+    sink.len = 0;
+    CHECK_INT_EQ(inflate(copy, packed_len, 1024, &sink), ESP_ERR_INVALID_RESPONSE);
+    CHECK_INT_EQ(sink.len, 0);
+
+    // The sink (flash) fails half way: its error ends the stream
+    sink.len = 0;
+    sink.fail_after = len / 2;
+    CHECK_INT_EQ(inflate(packed, packed_len, 1024, &sink), ESP_FAIL);
+    CHECK(sink.len <= len / 2);
+
+    free(sink.data);
+    free(copy);
+    free(packed);
+}
+
+static void bench_inflate(const uint8_t *image, size_t len) {
+    size_t packed_len = 0;
+    uint8_t *packed = pack(image, len, 15, &packed_len);
+    sink_t sink = {.data = malloc(len), .cap = len};
+    uint64_t start = host_test_now_us();
+    CHECK(packed && inflate(packed, packed_len, 1024, &sink) == ESP_OK);
+    uint64_t us = host_test_now_us() - start;
+    host_test_bench("inflate_fw_mbps", us ? (double)len / us : 0, "MB/s");
+    host_test_bench("inflate_fw_ratio", packed ? 100.0 * packed_len / len : 0, "%");
+    free(sink.data);
+    free(packed);
+}
+
+int main(void) {
+    mkdir(DIR, 0755);
+
+    // Firmware-like: code and tables with noise, plus blocks repeating bytes as far back as zlib
+    // matches (32 KB minus its 262 B lookahead), so copies reach across the circular window
+    uint8_t *fw = malloc(FW_SIZE);
+    uint32_t x = 2463534242u;
+    for (size_t i = 0; i < FW_SIZE; i++) {
+        x ^= x << 13, x ^= x >> 17, x ^= x << 5;
+        fw[i] = (x & 3) ? (uint8_t)(i / 16 + (i & 7)) : (uint8_t)x;
+    }
+    for (size_t pos = 2 * WINDOW; pos + 4096 < FW_SIZE; pos += 5 * WINDOW) {
+        memcpy(fw + pos, fw + pos - (WINDOW - 300), 4096);
+    }
+    fw[0] = 0xE9;
+
+    uint8_t *noise = malloc(RANDOM_SIZE);
+    for (size_t i = 0; i < RANDOM_SIZE; i++) {
+        x ^= x << 13, x ^= x >> 17, x ^= x << 5;
+        noise[i] = (uint8_t)x;
+    }
+
+    check_round_trip("firmware", fw, FW_SIZE, 15);
+    check_round_trip("firmware", fw, FW_SIZE, 9);
+    check_round_trip("random", noise, RANDOM_SIZE, 15);
+    check_round_trip("tiny", (const uint8_t *)"\xE9", 1, 15);
+    check_refused(fw, FW_SIZE);
+    bench_inflate(fw, FW_SIZE);
+
+    free(noise);
+    free(fw);
+    return host_test_done("test_ota_inflate");
+}
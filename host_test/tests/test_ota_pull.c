@@ -0,0 +1,234 @@
+/* Pull OTA (user-049): ota_pull.c against "ota_manifest.py serve" on a loopback port, with
+ * manifests written by "ota_manifest.py make". With OTA_PULL_ALLOW_HTTP: a manifest reached
+ * through a 301 redirect installs the image next to it, and the up-to-date, min_version, rollout
+ * (against the buckets ota_manifest.py prints), force, missing manifest, wrong SHA-256 and short
+ * image outcomes. Without it (test_ota_pull_https_only) http:// is refused before any request. */
+#include "esp_ota_ops.h"
+#include "fake_partition.h"
+#include "host_test.h"
+#include "ota_pull.h"
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define PARTITION_SIZE (1024 * 1024)
+#define IMAGE_SIZE (200 * 1024)
+#define PORT "35557"
+#define DIR CONFIG_VFS_LITTLEFS_MOUNT_POINT
+#define WWW DIR "/www"
+#define BASE "http://127.0.0.1:" PORT
+#define DEVICE_ID "A1B2C3D4E5F6" // stubs/platform_services.c
+
+static uint8_t image[IMAGE_SIZE];
+
+static bool write_file(const char *path, const void *data, size_t len) {
+    FILE *f = fopen(path, "wb");
+    bool ok = f && fwrite(data, 1, len, f) == len;
+    if (f)
+        fclose(f);
+    return ok;
+}
+
+static bool listening(void) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(atoi(PORT)),
+                               .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    bool ok = connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+    close(sock);
+    return ok;
+}
+
+// "ota_manifest.py serve", its request log in DIR/server.log
+static pid_t start_server(void) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (!freopen(DIR "/server.log", "w", stderr))
+            _exit(126);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        execl(FIXTURE_PYTHON, FIXTURE_PYTHON, FIXTURE_OTA_MANIFEST_PY, "serve", WWW, "--port", PORT,
+              (char *)NULL);
+        _exit(127);
+    }
+    bool up = pid > 0 && WAIT_FOR(listening(), 10000);
+    CHECK(up);
+    return pid;
+}
+
+static void stop_server(pid_t pid) {
+    if (pid <= 0)
+        return;
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+static void reset_partitions(void) {
+    CHECK(fake_partition_add("ota_0", ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0,
+                             PARTITION_SIZE, NULL));
+    CHECK(fake_partition_add("ota_1", ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1,
+                             PARTITION_SIZE, NULL));
+    CHECK(esp_ota_set_boot_partition(esp_ota_get_running_partition()) == ESP_OK);
+}
+
+static bool installed(void) {
+    const uint8_t *data = fake_partition_data("ota_1");
+    return data && !memcmp(data, image, sizeof(image)) &&
+           esp_ota_get_boot_partition() == esp_ota_get_next_update_partition(NULL);
+}
+
+static bool checking(void) {
+    const char *state = ota_pull_state();
+    return !strcmp(state, "checking") || !strcmp(state, "downloading");
+}
+
+// One check from start to its outcome
+static const char *pull(const char *url, bool force) {
+    esp_err_t err = ESP_OK;
+    WAIT_FOR((err = ota_pull_start(url, force)) != ESP_ERR_INVALID_STATE, 2000);
+    CHECK_INT_EQ(err, ESP_OK);
+    bool done = err == ESP_OK && WAIT_FOR(!checking(), 10000);
+    CHECK(done);
+    return ota_pull_state();
+}
+
+// "ota_manifest.py make" for the image in DIR/image.bin, options as on the command line
+static void make_manifest(const char *manifest, const char *options) {
+    char cmd[1024];
+    snprintf(cmd, sizeof(cmd), "%s '%s' make '%s' '%s' --version 2.0.0 %s > /dev/null",
+             FIXTURE_PYTHON, FIXTURE_OTA_MANIFEST_PY, DIR "/image.bin", manifest, options);
+    CHECK(system(cmd) == 0);
+}
+
+#if CONFIG_OTA_PULL_ALLOW_HTTP
+static int bucket(void) {
+    char cmd[512], line[64] = "";
+    snprintf(cmd, sizeof(cmd), "%s '%s' bucket 2.0.0 " DEVICE_ID, FIXTURE_PYTHON,
+             FIXTURE_OTA_MANIFEST_PY);
+    FILE *p = popen(cmd, "r");
+    CHECK(p && fgets(line, sizeof(line), p));
+    if (p)
+        pclose(p);
+    const char *space = strchr(line, ' ');
+    return space ? atoi(space + 1) : -1;
+}
+
+static void expect_install(const char *url, bool force) {
+    reset_partitions();
+    int restarts = host_test_restarts();
+    CHECK_STR_EQ(pull(url, force), "idle");
+    CHECK(installed());
+    CHECK_INT_EQ(host_test_restarts(), restarts + 1);
+}
+
+static void expect_skip(const char *url, bool force, const char *state) {
+    reset_partitions();
+    int restarts = host_test_restarts();
+    CHECK_STR_EQ(pull(url, force), state);
+    CHECK(!installed());
+    CHECK_INT_EQ(host_test_restarts(), restarts);
+}
+
+static void test_redirect(void) {
+    // The server answers /latest with 301 to /latest/ and serves index.html; image.bin is
+    // resolved against the redirected URL
+    mkdir(WWW "/latest", 0755);
+    make_manifest(WWW "/latest/index.html", "");
+    expect_install(BASE "/latest", false);
+}
+
+static void test_outcomes(void) {
+    make_manifest(WWW "/fleet/manifest.json", "");
+    expect_install(BASE "/fleet/manifest.json", false);
+
+    host_test_set_app_version("2.0.0");
+    expect_skip(BASE "/fleet/manifest.json", false, "up_to_date");
+    host_test_set_app_version("1.0.0");
+
+    make_manifest(WWW "/fleet/manifest.json", "--min-version 1.5.0");
+    expect_skip(BASE "/fleet/manifest.json", false, "too_old");
+    expect_skip(BASE "/fleet/manifest.json", true, "too_old"); // force keeps min_version
+
+    // The device is in the rollout exactly when its bucket (as the tool computes it) is below
+    int b = bucket();
+    CHECK(b >= 0 && b < 100);
+    char options[32];
+    snprintf(options, sizeof(options), "--rollout %d", b);
+    make_manifest(WWW "/fleet/manifest.json", options);
+    expect_skip(BASE "/fleet/manifest.json", false, "not_in_rollout");
+    expect_install(BASE "/fleet/manifest.json", true);
+    snprintf(options, sizeof(options), "--rollout %d", b + 1);
+    make_manifest(WWW "/fleet/manifest.json", options);
+    expect_install(BASE "/fleet/manifest.json", false);
+
+    expect_skip(BASE "/fleet/missing.json", false, "failed");
+}
+
+static void test_bad_image(void) {
+    make_manifest(WWW "/fleet/manifest.json", "");
+
+    // Same size, one byte off: the SHA-256 check refuses it
+    image[IMAGE_SIZE / 2] ^= 0xff;
+    CHECK(write_file(WWW "/fleet/image.bin", image, IMAGE_SIZE));
+    image[IMAGE_SIZE / 2] ^= 0xff;
+    expect_skip(BASE "/fleet/manifest.json", false, "failed");
+
+    // Shorter than the manifest says
+    CHECK(write_file(WWW "/fleet/image.bin", image, IMAGE_SIZE - 1000));
+    expect_skip(BASE "/fleet/manifest.json", false, "failed");
+
+    // Nothing left locked: the intact image installs
+    CHECK(write_file(WWW "/fleet/image.bin", image, IMAGE_SIZE));
+    expect_install(BASE "/fleet/manifest.json", false);
+}
+#else
+static void test_https_required(void) {
+    make_manifest(WWW "/fleet/manifest.json", "");
+    reset_partitions();
+    CHECK_INT_EQ(ota_pull_start(BASE "/fleet/manifest.json", true), ESP_ERR_INVALID_ARG);
+    CHECK_INT_EQ(ota_pull_start("ftp://127.0.0.1/fleet/manifest.json", true), ESP_ERR_INVALID_ARG);
+    CHECK_STR_EQ(ota_pull_state(), "idle");
+
+    // Accepted, but the host client has no TLS (nor does the Python server)
+    CHECK_STR_EQ(pull("https://127.0.0.1:" PORT "/fleet/manifest.json", true), "failed");
+    CHECK(!installed());
+
+    // The server never saw a request
+    FILE *f = fopen(DIR "/server.log", "r");
+    char line[256];
+    bool requested = false;
+    while (f && fgets(line, sizeof(line), f))
+        requested |= strstr(line, "GET ") != NULL;
+    if (f)
+        fclose(f);
+    CHECK(!requested);
+}
+#endif
+
+int main(void) {
+    mkdir(DIR, 0755);
+    mkdir(WWW, 0755);
+    mkdir(WWW "/fleet", 0755);
+    uint32_t x = 2463534242u;
+    for (size_t i = 0; i < IMAGE_SIZE; i++) {
+        x ^= x << 13, x ^= x >> 17, x ^= x << 5;
+        image[i] = (x & 3) ? (uint8_t)(i / 16 + (i & 7)) : (uint8_t)x;
+    }
+    image[0] = 0xE9; // esp_image_header_t.magic
+    CHECK(write_file(DIR "/image.bin", image, IMAGE_SIZE));
+
+    pid_t server = start_server();
+#if CONFIG_OTA_PULL_ALLOW_HTTP
+    test_redirect();
+    test_outcomes();
+    test_bad_image();
+    const char *name = "test_ota_pull";
+#else
+    test_https_required();
+    const char *name = "test_ota_pull_https_only";
+#endif
+    stop_server(server);
+    return host_test_done(name);
+}
@@ -0,0 +1,146 @@
+/* TCP OTA v2 resume (user-048): ota_upload.py, run as shipped against the TCP OTA server on a
+ * loopback port, with --drop-at and --corrupt-at injecting a disconnect and a corrupted block.
+ * Each upload must resume from the offset the device reports (not from 0), land in ota_1 byte
+ * for byte and activate it, plain, zlib and delta alike, also with the fault in the last block.
+ * A delta made against other firmware fails once, without retries. The resume state is the
+ * RAM session of tcp_ota_v2.c, so the server keeps running throughout. */
+#include "esp_ota_ops.h"
+#include "fake_partition.h"
+#include "host_test.h"
+#include "tcp_ota.h"
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#define PARTITION_SIZE (1024 * 1024)
+#define IMAGE_SIZE (300 * 1024)
+#define TCP_PORT 35556
+#define BLOCK 4096 // DATA payload the device asks for in READY
+#define DIR CONFIG_VFS_LITTLEFS_MOUNT_POINT
+
+static uint8_t running[IMAGE_SIZE], image[IMAGE_SIZE];
+
+static bool write_file(const char *path, const void *data, size_t len) {
+    FILE *f = fopen(path, "wb");
+    bool ok = f && fwrite(data, 1, len, f) == len;
+    if (f)
+        fclose(f);
+    return ok;
+}
+
+static char *read_log(void) {
+    FILE *f = fopen(DIR "/upload.log", "rb");
+    if (!f)
+        return NULL;
+    char *log = calloc(1, 64 * 1024);
+    fread(log, 1, 64 * 1024 - 1, f);
+    fclose(f);
+    return log;
+}
+
+static void reset_partitions(void) {
+    CHECK(fake_partition_add("ota_0", ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0,
+                             PARTITION_SIZE, DIR "/running.bin"));
+    CHECK(fake_partition_add("ota_1", ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1,
+                             PARTITION_SIZE, NULL));
+    CHECK(esp_ota_set_boot_partition(esp_ota_get_running_partition()) == ESP_OK);
+}
+
+// Runs ota_upload.py with the given options; returns its exit status, the output in *log
+static int upload(const char *options, char **log) {
+    char cmd[1024];
+    snprintf(cmd, sizeof(cmd), "%s '%s' 127.0.0.1 '%s' --port %d --retries 3 %s > '%s' 2>&1",
+             FIXTURE_PYTHON, FIXTURE_OTA_UPLOAD_PY, DIR "/image.bin", TCP_PORT, options,
+             DIR "/upload.log");
+    int status = system(cmd);
+    *log = read_log();
+    return status;
+}
+
+/* Every reconnect must continue past the start, at a block the device accepted. How far depends
+ * on what it read before the reset: a reset discards what is still in its receive buffer. */
+static void check_resumed(const char *log, int resumes) {
+    int seen = 0;
+    for (const char *p = log; (p = strstr(p, "resuming at ")); p++, seen++) {
+        size_t offset = strtoul(p + strlen("resuming at "), NULL, 10);
+        CHECK(offset > 0 && offset % BLOCK == 0);
+    }
+    CHECK_INT_EQ(seen, resumes);
+}
+
+static void run(const char *name, const char *options, int resumes) {
+    reset_partitions();
+    int restarts = host_test_restarts();
+    char *log = NULL;
+    int status = upload(options, &log);
+    CHECK_INT_EQ(status, 0);
+    bool restarted = WAIT_FOR(host_test_restarts() == restarts + 1, 5000);
+    CHECK(restarted);
+    const uint8_t *data = fake_partition_data("ota_1");
+    bool landed = data && !memcmp(data, image, sizeof(image)) &&
+                  esp_ota_get_boot_partition() == esp_ota_get_next_update_partition(NULL);
+    CHECK(landed);
+    if (log)
+        check_resumed(log, resumes);
+    if (status != 0 || !landed || host_test_failures)
+        fprintf(stderr, "%s (%s):\n%s\n", name, options, log ? log : "(no output)");
+    free(log);
+}
+
+static void test_wrong_base(void) {
+    // A delta against other firmware than the device runs: refused, not retried
+    uint8_t *other = malloc(IMAGE_SIZE);
+    memcpy(other, image, IMAGE_SIZE);
+    other[IMAGE_SIZE / 2] ^= 0xff;
+    CHECK(write_file(DIR "/other.bin", other, IMAGE_SIZE));
+    free(other);
+
+    reset_partitions();
+    int restarts = host_test_restarts();
+    char *log = NULL;
+    int status = upload("--delta '" DIR "/other.bin'", &log);
+    CHECK(status != 0);
+    CHECK(log && strstr(log, "ota_upload: failed") && strstr(log, "attempt") == NULL);
+    host_test_sleep_ms(100);
+    CHECK_INT_EQ(host_test_restarts(), restarts);
+    CHECK(esp_ota_get_boot_partition() != esp_ota_get_next_update_partition(NULL));
+    free(log);
+}
+
+int main(void) {
+    mkdir(DIR, 0755);
+
+    // Firmware-like: the new image is the running one with a few new stretches of code, 17 KB of
+    // delta patch in all
+    uint32_t x = 2463534242u;
+    for (size_t i = 0; i < IMAGE_SIZE; i++) {
+        x ^= x << 13, x ^= x >> 17, x ^= x << 5;
+        running[i] = (x & 3) ? (uint8_t)(i / 16 + (i & 7)) : (uint8_t)x;
+    }
+    memcpy(image, running, IMAGE_SIZE);
+    for (size_t pos = 4096; pos + 2048 < IMAGE_SIZE; pos += 40 * 1024) {
+        for (size_t i = pos; i < pos + 2048; i++) {
+            x ^= x << 13, x ^= x >> 17, x ^= x << 5;
+            image[i] = (uint8_t)x;
+        }
+    }
+    running[0] = image[0] = 0xE9; // esp_image_header_t.magic
+    CHECK(write_file(DIR "/running.bin", running, IMAGE_SIZE));
+    CHECK(write_file(DIR "/image.bin", image, IMAGE_SIZE));
+
+    tcp_ota_configure(TCP_PORT);
+    tcp_ota_init();
+    host_test_sleep_ms(50); // Listening
+
+    run("plain", "", 0);
+    run("plain, dropped", "--drop-at 100000", 1);
+    run("plain, corrupted", "--corrupt-at 200000", 1);
+    run("plain, both", "--drop-at 50000 --corrupt-at 250000", 2);
+    run("zlib, dropped and corrupted", "--zlib --drop-at 30000 --corrupt-at 60000", 2);
+    run("delta, dropped and corrupted",
+        "--delta '" DIR "/running.bin' --drop-at 9000 --corrupt-at 13000", 2);
+    run("fault in the last block", "--drop-at 307000", 1);
+    test_wrong_base();
+
+    tcp_ota_shutdown();
+    return host_test_done("test_ota_upload");
+}
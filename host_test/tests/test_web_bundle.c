@@ -0,0 +1,225 @@
+/* Web bundle (user-035): the image web_bundle.py packs from pages/ unpacks to the same files and
+ * maps to the same bytes on the device side, corrupt images are refused, gzipped entries get 406
+ * for clients refusing gzip, and the pages load from the mapped bundle vs. from LittleFS (time to
+ * first byte and total, per page load). On the host the LittleFS side reads from the page cache,
+ * so flash read latency is not part of it. */
+#include "fake_partition.h"
+#include "http_fixture.h"
+#include "web_bundle.h"
+#include <zlib.h>
+
+#define PAGES_COUNT 3
+#define PARTITION_SIZE (128 * 1024)
+#define LOADS 200
+#define ACCEPT "Accept-Encoding: gzip, deflate\n"
+
+static const char *pages[PAGES_COUNT] = {"/app.js", "/index.html", "/style.css"};
+
+static char *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc(size + 1);
+    *len = fread(data, 1, size, f);
+    data[*len] = '\0';
+    fclose(f);
+    return data;
+}
+
+// Source file under pages/ matches len bytes at data
+static bool same_as_page(const char *uri, const void *data, size_t len) {
+    char path[512];
+    size_t page_len;
+    snprintf(path, sizeof(path), FIXTURE_PAGES "%s", uri);
+    char *page = read_file(path, &page_len);
+    bool same = page && page_len == len && !memcmp(page, data, len);
+    free(page);
+    return same;
+}
+
+static bool gunzip(const void *in, size_t in_len, char *out, size_t *out_len) {
+    z_stream z = {.next_in = (Bytef *)in, .avail_in = in_len, .next_out = (Bytef *)out,
+                  .avail_out = *out_len};
+    if (inflateInit2(&z, 16 + MAX_WBITS) != Z_OK)
+        return false;
+    int rc = inflate(&z, Z_FINISH);
+    *out_len = z.total_out;
+    inflateEnd(&z);
+    return rc == Z_STREAM_END;
+}
+
+static bool load_bundle(void) {
+    return fake_partition_add(CONFIG_HTTP_WEB_BUNDLE_PARTITION, ESP_PARTITION_TYPE_DATA,
+                              (esp_partition_subtype_t)0x40, PARTITION_SIZE, FIXTURE_BUNDLE_IMAGE);
+}
+
+static void test_unpack(void) {
+    const char *dest = FIXTURE_FS "/unpacked";
+    CHECK(system(FIXTURE_PYTHON " '" FIXTURE_WEB_BUNDLE_PY "' unpack '" FIXTURE_BUNDLE_IMAGE
+                                "' '" FIXTURE_FS "/unpacked' > /dev/null") == 0);
+    for (size_t i = 0; i < PAGES_COUNT; i++) {
+        char path[512];
+        size_t len;
+        snprintf(path, sizeof(path), "%s%s", dest, pages[i]);
+        char *data = read_file(path, &len);
+        CHECK(data && same_as_page(pages[i], data, len));
+        free(data);
+    }
+}
+
+static void test_mapped_entries(void) {
+    CHECK_INT_EQ(web_bundle_init(), ESP_OK);
+    static char plain[64 * 1024];
+    for (size_t i = 0; i < PAGES_COUNT; i++) {
+        web_bundle_file_t file;
+        CHECK(web_bundle_find(pages[i], &file));
+        if (!web_bundle_find(pages[i], &file))
+            continue;
+
+        // The crc (the ETag) covers the stored bytes
+        CHECK_INT_EQ(crc32(0, file.data, file.len), file.crc);
+        size_t len = sizeof(plain);
+        if (file.gzipped)
+            CHECK(gunzip(file.data, file.len, plain, &len));
+        else
+            memcpy(plain, file.data, len = file.len);
+        CHECK(same_as_page(pages[i], plain, len));
+    }
+
+    web_bundle_file_t file;
+    CHECK(!web_bundle_find("/missing.html", &file));
+    CHECK(!web_bundle_find("/", &file));
+    web_bundle_deinit();
+    CHECK_INT_EQ(fake_partition_mapped(), 0);
+}
+
+static void test_corrupt_image(void) {
+    uint8_t *image = fake_partition_data(CONFIG_HTTP_WEB_BUNDLE_PARTITION);
+    uint32_t *count = (uint32_t *)(image + 4);
+    uint32_t *first_length = (uint32_t *)(image + 16 + 52);
+
+    // Erased partition (never flashed)
+    image[0] = 0xff;
+    CHECK_INT_EQ(web_bundle_init(), ESP_ERR_INVALID_STATE);
+    image[0] = 'C';
+
+    // Index larger than the image
+    uint32_t saved = *count;
+    *count = PARTITION_SIZE / 64;
+    CHECK_INT_EQ(web_bundle_init(), ESP_ERR_INVALID_STATE);
+    *count = saved;
+
+    // Entry pointing past the end of the image
+    saved = *first_length;
+    *first_length = PARTITION_SIZE;
+    CHECK_INT_EQ(web_bundle_init(), ESP_ERR_INVALID_SIZE);
+    *first_length = saved;
+
+    CHECK_INT_EQ(fake_partition_mapped(), 0);
+    CHECK_INT_EQ(web_bundle_init(), ESP_OK);
+    web_bundle_deinit();
+
+    fake_partition_remove(CONFIG_HTTP_WEB_BUNDLE_PARTITION);
+    CHECK_INT_EQ(web_bundle_init(), ESP_ERR_NOT_FOUND);
+}
+
+/* One page load: the document, then its assets. Returns the mean time to first byte of the
+ * responses and adds the wall time from the first request to the last byte to *total_us. */
+static double page_load(const char **uris, size_t count, uint64_t *total_us) {
+    uint64_t ttfb = 0, start = 0, end = 0;
+    for (size_t i = 0; i < count; i++) {
+        fake_httpd_resp_t *resp = fake_httpd_get(uris[i], ACCEPT);
+        CHECK(resp && resp->status == 200 && resp->body_len > 0);
+        if (!resp)
+            continue;
+        ttfb += resp->first_byte_us - resp->start_us;
+        start = start ? start : resp->start_us;
+        end = resp->done_us;
+        fake_httpd_free(resp);
+    }
+    *total_us += end - start;
+    return (double)ttfb / count;
+}
+
+static void bench_page_loads(const char *source, const char **uris, size_t count) {
+    double ttfb = 0;
+    uint64_t total = 0;
+    for (int i = 0; i < LOADS; i++) {
+        ttfb += page_load(uris, count, &total);
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "%s_ttfb_us", source);
+    host_test_bench(name, ttfb / LOADS, "us");
+    snprintf(name, sizeof(name), "%s_page_load_us", source);
+    host_test_bench(name, (double)total / LOADS, "us");
+}
+
+static void test_served_from_bundle(void) {
+    CHECK(load_bundle());
+    CHECK(fixture_http_start());
+
+    // Gzipped bundle entry, sent as stored
+    char buf[64];
+    web_bundle_file_t file;
+    CHECK(web_bundle_find("/index.html", &file));
+    fake_httpd_resp_t *resp = fake_httpd_get("/", ACCEPT);
+    CHECK(resp && resp->status == 200);
+    CHECK(resp && !strcmp(fake_httpd_header(resp, "Content-Encoding", buf, sizeof(buf)), "gzip"));
+    CHECK(resp && resp->body_len == file.len && !memcmp(resp->body, file.data, file.len));
+    CHECK(resp && resp->writes == 1);
+    fake_httpd_free(resp);
+
+    // Bundled names win: a client refusing gzip gets 406, not a LittleFS copy
+    CHECK(fixture_fs_write("/www/index.html", "plain", 5));
+    resp = fake_httpd_get("/index.html", NULL);
+    CHECK(resp && resp->status == 406);
+    fake_httpd_free(resp);
+    resp = fake_httpd_get("/index.html", "Accept-Encoding: br, gzip;q=0\n");
+    CHECK(resp && resp->status == 406);
+    fake_httpd_free(resp);
+    fixture_fs_reset();
+
+    const char *uris[] = {"/", "/app.js", "/style.css"};
+    bench_page_loads("bundle", uris, 3);
+    http_shutdown();
+    fake_partition_remove(CONFIG_HTTP_WEB_BUNDLE_PARTITION);
+}
+
+static void test_served_from_littlefs(void) {
+    // The same pages as web_assets.py stages them into LittleFS (names hashed)
+    CHECK(fixture_fs_stage_pages());
+    CHECK(fixture_http_start());
+
+    static char uris[PAGES_COUNT][128];
+    const char *list[PAGES_COUNT] = {"/"};
+    size_t count = 1;
+    char *manifest = fixture_fs_read("/www/.manifest", NULL);
+    CHECK(manifest != NULL);
+    for (char *line = manifest ? strtok(manifest, "\n") : NULL; line && count < PAGES_COUNT;
+         line = strtok(NULL, "\n")) {
+        if (sscanf(line, "%127s", uris[count]) == 1 && strcmp(uris[count], "/index.html"))
+            list[count] = uris[count], count++;
+    }
+    free(manifest);
+    CHECK_INT_EQ(count, PAGES_COUNT);
+
+    bench_page_loads("littlefs", list, count);
+    http_shutdown();
+}
+
+int main(void) {
+    fixture_fs_reset();
+    CHECK(load_bundle());
+
+    test_unpack();
+    test_mapped_entries();
+    test_corrupt_image();
+    test_served_from_bundle();
+    test_served_from_littlefs();
+
+    return host_test_done("test_web_bundle");
+}
@@ -0,0 +1,126 @@
+/* Atomic WebDAV PUT (user-042): an upload whose client dies, or whose server process is killed
+ * mid-body, leaves the previous file intact; only a complete body replaces it. The kill runs the
+ * server in a forked child and SIGKILLs it while the body is still arriving. */
+#include "http_fixture.h"
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define OLD "old version, must survive"
+#define UPLOAD_SIZE (512 * 1024)
+#define KILL_AFTER (64 * 1024)
+
+static char upload[UPLOAD_SIZE];
+
+static fake_httpd_resp_t *put(const char *uri, const void *body, size_t len, size_t announced) {
+    return fake_httpd_do(&(fake_httpd_request_t){
+        .method = HTTP_PUT, .uri = uri, .body = body, .body_len = len, .content_len = announced});
+}
+
+static bool file_is(const char *rel, const void *data, size_t len) {
+    size_t got;
+    char *content = fixture_fs_read(rel, &got);
+    bool same = content && got == len && !memcmp(content, data, len);
+    free(content);
+    return same;
+}
+
+static size_t file_size(const char *rel) {
+    char path[512];
+    struct stat st;
+    snprintf(path, sizeof(path), FIXTURE_FS "%s", rel);
+    return stat(path, &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+static void test_client_dies(void) {
+    CHECK(fixture_fs_write("/docs/a.txt", OLD, strlen(OLD)));
+
+    // 3 KB of an announced 10 KB, then the connection drops
+    fake_httpd_resp_t *resp = put("/dav/docs/a.txt", upload, 3000, 10000);
+    CHECK(resp && resp->closed);
+    fake_httpd_free(resp);
+    CHECK(file_is("/docs/a.txt", OLD, strlen(OLD)));
+    CHECK(!fixture_fs_exists("/docs/a.txt.~upload"));
+}
+
+static void test_complete_upload(void) {
+    fake_httpd_resp_t *resp = put("/dav/docs/a.txt", "new", 3, 0);
+    CHECK(resp && resp->status == 204);
+    fake_httpd_free(resp);
+    CHECK(file_is("/docs/a.txt", "new", 3));
+
+    resp = put("/dav/docs/b.txt", upload, sizeof(upload), 0);
+    CHECK(resp && resp->status == 201);
+    fake_httpd_free(resp);
+    CHECK(file_is("/docs/b.txt", upload, sizeof(upload)));
+    CHECK(!fixture_fs_exists("/docs/b.txt.~upload"));
+}
+
+// Every other receive times out: each one that delivers data restarts the retry count
+static void test_lossy_link(void) {
+    fake_httpd_resp_t *resp = fake_httpd_do(&(fake_httpd_request_t){.method = HTTP_PUT,
+                                                                    .uri = "/dav/docs/c.txt",
+                                                                    .body = upload,
+                                                                    .body_len = sizeof(upload),
+                                                                    .timeout_every = 2});
+    CHECK(resp && resp->status == 201);
+    fake_httpd_free(resp);
+    CHECK(file_is("/docs/c.txt", upload, sizeof(upload)));
+}
+
+// Runs the server in a child process and kills it after KILL_AFTER bytes reached the temp file
+static void killed_upload(void) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (!fixture_http_start())
+            _exit(2);
+        // 128 reads of 4 KB, 5 ms apart: the body takes over half a second to arrive
+        fake_httpd_do(&(fake_httpd_request_t){.method = HTTP_PUT,
+                                              .uri = "/dav/docs/a.txt",
+                                              .body = upload,
+                                              .body_len = sizeof(upload),
+                                              .recv_delay_ms = 5});
+        _exit(1);
+    }
+
+    CHECK(pid > 0);
+    bool reached = WAIT_FOR(file_size("/docs/a.txt.~upload") >= KILL_AFTER, 5000);
+    CHECK(reached);
+    kill(pid, SIGKILL);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL);
+    host_test_bench("bytes_received_before_kill", file_size("/docs/a.txt.~upload"), "B");
+}
+
+static void test_server_killed(void) {
+    CHECK(fixture_fs_write("/docs/a.txt", OLD, strlen(OLD)));
+    killed_upload();
+    CHECK(file_is("/docs/a.txt", OLD, strlen(OLD)));
+
+    // The next upload of the same file starts over and completes
+    CHECK(fixture_http_start());
+    fake_httpd_resp_t *resp = put("/dav/docs/a.txt", upload, sizeof(upload), 0);
+    CHECK(resp && resp->status == 204);
+    fake_httpd_free(resp);
+    CHECK(file_is("/docs/a.txt", upload, sizeof(upload)));
+    CHECK(!fixture_fs_exists("/docs/a.txt.~upload"));
+    http_shutdown();
+}
+
+int main(void) {
+    for (size_t i = 0; i < sizeof(upload); i++) {
+        upload[i] = (char)(i * 31 + i / 4096);
+    }
+    fixture_fs_reset();
+
+    // Before any server thread exists, so the child starts from a clean process
+    test_server_killed();
+
+    CHECK(fixture_http_start());
+    test_client_dies();
+    test_complete_upload();
+    test_lossy_link();
+    http_shutdown();
+    return host_test_done("test_webdav_put");
+}
@@ -0,0 +1,298 @@
+/* Resumable WebDAV PUT (user-043): chunks carrying Content-Range build up <path>.~upload, a chunk
+ * whose client dies keeps what arrived, a Content-Range query without a body reports the offset
+ * and the upload resumes from there. The temp file never shows up in PROPFIND or GET, cannot be
+ * uploaded to, and once older than HTTP_WEBDAV_RESUME_TTL it is deleted by the resume (which
+ * restarts at 0), by listing its directory or by a plain PUT next to it. A chunk that does not
+ * fit (fwrite() wrapped to run out of space) leaves the chunks before it. User files named *.tmp
+ * are ordinary files. Range GET of static files and WebDAV, with a download resumed after the
+ * client went away. */
+#include "http_fixture.h"
+#include <stdatomic.h>
+#include <time.h>
+#include <utime.h>
+
+#define TOTAL (48 * 1024)
+#define CHUNK (16 * 1024)
+
+static char upload[TOTAL];
+
+// Bytes fwrite() stores before the filesystem is full, -1: no limit
+static atomic_long space = -1;
+size_t __real_fwrite(const void *data, size_t size, size_t n, FILE *f);
+size_t __wrap_fwrite(const void *data, size_t size, size_t n, FILE *f) {
+    long left = atomic_load(&space);
+    if (left < 0 || size == 0)
+        return __real_fwrite(data, size, n, f);
+    size_t fit = (size_t)left / size < n ? (size_t)left / size : n;
+    size_t done = fit ? __real_fwrite(data, size, fit, f) : 0;
+    atomic_fetch_sub(&space, (long)(done * size));
+    return done;
+}
+
+static fake_httpd_resp_t *put_range(const char *uri, size_t start, size_t len, size_t sent) {
+    char headers[96];
+    if (len)
+        snprintf(headers, sizeof(headers), "Content-Range: bytes %zu-%zu/%d\n", start,
+                 start + len - 1, TOTAL);
+    else
+        snprintf(headers, sizeof(headers), "Content-Range: bytes */%d\n", TOTAL);
+    return fake_httpd_do(&(fake_httpd_request_t){.method = HTTP_PUT,
+                                                 .uri = uri,
+                                                 .headers = headers,
+                                                 .body = upload + start,
+                                                 .body_len = sent,
+                                                 .content_len = len});
+}
+
+static size_t upload_offset(const fake_httpd_resp_t *resp) {
+    char buf[16];
+    const char *hdr = fake_httpd_header(resp, "X-Upload-Offset", buf, sizeof(buf));
+    CHECK(hdr != NULL);
+    return hdr ? strtoul(hdr, NULL, 10) : (size_t)-1;
+}
+
+static size_t file_size(const char *rel) {
+    char path[512];
+    struct stat st;
+    snprintf(path, sizeof(path), FIXTURE_FS "%s", rel);
+    return stat(path, &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+static void age(const char *rel, time_t seconds) {
+    char path[512];
+    snprintf(path, sizeof(path), FIXTURE_FS "%s", rel);
+    time_t then = time(NULL) - seconds;
+    CHECK(utime(path, &(struct utimbuf){then, then}) == 0);
+}
+
+static fake_httpd_resp_t *propfind(const char *uri, const char *depth) {
+    char headers[16];
+    snprintf(headers, sizeof(headers), "Depth: %s\n", depth);
+    return fake_httpd_do(
+        &(fake_httpd_request_t){.method = HTTP_PROPFIND, .uri = uri, .headers = headers});
+}
+
+static void test_interrupted_resume(void) {
+    fake_httpd_resp_t *resp = put_range("/dav/up/big.bin", 0, CHUNK, CHUNK);
+    CHECK(resp && resp->status == 202 && upload_offset(resp) == CHUNK);
+    fake_httpd_free(resp);
+
+    // The second chunk dies after 5000 bytes; they stay in the temp file
+    resp = put_range("/dav/up/big.bin", CHUNK, CHUNK, 5000);
+    CHECK(resp && resp->closed);
+    fake_httpd_free(resp);
+    CHECK_INT_EQ(file_size("/up/big.bin.~upload"), CHUNK + 5000);
+    CHECK(!fixture_fs_exists("/up/big.bin"));
+
+    // Hidden while in progress
+    resp = propfind("/dav/up/", "1");
+    CHECK(resp && resp->status == 207 && strstr(resp->body, "big.bin") == NULL);
+    fake_httpd_free(resp);
+    resp = propfind("/dav/up/big.bin.~upload", "0");
+    CHECK(resp && resp->status == 404);
+    fake_httpd_free(resp);
+    resp = fake_httpd_get("/dav/up/big.bin.~upload", NULL);
+    CHECK(resp && resp->status == 404);
+    fake_httpd_free(resp);
+
+    // The client asks where to continue, a chunk from the old position is refused
+    resp = put_range("/dav/up/big.bin", 0, 0, 0);
+    size_t offset = resp ? upload_offset(resp) : 0;
+    CHECK(resp && resp->status == 202 && offset == CHUNK + 5000);
+    fake_httpd_free(resp);
+    resp = put_range("/dav/up/big.bin", CHUNK, CHUNK, CHUNK);
+    CHECK(resp && resp->status == 409 && upload_offset(resp) == offset);
+    fake_httpd_free(resp);
+
+    resp = put_range("/dav/up/big.bin", offset, TOTAL - offset, TOTAL - offset);
+    CHECK(resp && resp->status == 201);
+    fake_httpd_free(resp);
+    size_t len;
+    char *data = fixture_fs_read("/up/big.bin", &len);
+    CHECK(data && len == TOTAL && !memcmp(data, upload, TOTAL));
+    free(data);
+    CHECK(!fixture_fs_exists("/up/big.bin.~upload"));
+}
+
+static void test_reserved_name(void) {
+    fake_httpd_resp_t *resp = fake_httpd_do(&(fake_httpd_request_t){
+        .method = HTTP_PUT, .uri = "/dav/up/x.~upload", .body = "x", .body_len = 1});
+    CHECK(resp && resp->status == 403);
+    fake_httpd_free(resp);
+    CHECK(!fixture_fs_exists("/up/x.~upload"));
+
+    resp = fake_httpd_do(&(fake_httpd_request_t){.method = HTTP_MOVE,
+                                                 .uri = "/dav/up/big.bin",
+                                                 .headers = "Destination: /dav/up/y.~upload\n"});
+    CHECK(resp && resp->status == 403);
+    fake_httpd_free(resp);
+    CHECK(fixture_fs_exists("/up/big.bin"));
+}
+
+// A *.tmp name belongs to the user: stored, listed, served and never swept
+static void test_user_tmp_file(void) {
+    fake_httpd_resp_t *resp = fake_httpd_do(&(fake_httpd_request_t){
+        .method = HTTP_PUT, .uri = "/dav/up/notes.tmp", .body = "mine", .body_len = 4});
+    CHECK(resp && resp->status == 201);
+    fake_httpd_free(resp);
+    age("/up/notes.tmp", CONFIG_HTTP_WEBDAV_RESUME_TTL + 60);
+
+    resp = propfind("/dav/up", "1");
+    CHECK(resp && resp->status == 207 && strstr(resp->body, "notes.tmp") != NULL);
+    fake_httpd_free(resp);
+    resp = fake_httpd_do(&(fake_httpd_request_t){
+        .method = HTTP_PUT, .uri = "/dav/up/other.txt", .body = "x", .body_len = 1});
+    CHECK(resp && resp->status == 201);
+    fake_httpd_free(resp);
+
+    resp = fake_httpd_get("/dav/up/notes.tmp", NULL);
+    CHECK(resp && resp->status == 200 && resp->body_len == 4 && !memcmp(resp->body, "mine", 4));
+    fake_httpd_free(resp);
+}
+
+static void test_full_storage_keeps_chunks(void) {
+    fake_httpd_resp_t *resp = put_range("/dav/up/full.bin", 0, CHUNK, CHUNK);
+    CHECK(resp && resp->status == 202 && upload_offset(resp) == CHUNK);
+    fake_httpd_free(resp);
+
+    // Room for 5000 bytes of the second chunk: they are dropped again, the first chunk stays
+    atomic_store(&space, 5000);
+    resp = put_range("/dav/up/full.bin", CHUNK, CHUNK, CHUNK);
+    atomic_store(&space, -1);
+    CHECK(resp && resp->status == 507 && upload_offset(resp) == CHUNK);
+    fake_httpd_free(resp);
+    CHECK_INT_EQ(file_size("/up/full.bin.~upload"), CHUNK);
+
+    // Once there is room again the upload continues where the client was told
+    resp = put_range("/dav/up/full.bin", CHUNK, TOTAL - CHUNK, TOTAL - CHUNK);
+    CHECK(resp && resp->status == 201);
+    fake_httpd_free(resp);
+    size_t len;
+    char *data = fixture_fs_read("/up/full.bin", &len);
+    CHECK(data && len == TOTAL && !memcmp(data, upload, TOTAL));
+    free(data);
+
+    // A plain upload that does not fit leaves nothing behind
+    atomic_store(&space, 5000);
+    resp = fake_httpd_do(&(fake_httpd_request_t){
+        .method = HTTP_PUT, .uri = "/dav/up/plain.bin", .body = upload, .body_len = CHUNK});
+    atomic_store(&space, -1);
+    CHECK(resp && resp->status == 507);
+    fake_httpd_free(resp);
+    CHECK(!fixture_fs_exists("/up/plain.bin.~upload"));
+    CHECK(!fixture_fs_exists("/up/plain.bin"));
+}
+
+static fake_httpd_resp_t *get_range(const char *uri, const char *range, size_t read_limit) {
+    char headers[64];
+    snprintf(headers, sizeof(headers), "Range: %s\n", range);
+    return fake_httpd_do(&(fake_httpd_request_t){
+        .method = HTTP_GET, .uri = uri, .headers = headers, .read_limit = read_limit});
+}
+
+static bool header_is(const fake_httpd_resp_t *resp, const char *name, const char *value) {
+    char buf[64];
+    const char *hdr = resp ? fake_httpd_header(resp, name, buf, sizeof(buf)) : NULL;
+    return hdr && !strcmp(hdr, value);
+}
+
+// uri serves upload[] from the filesystem
+static void check_range_get(const char *uri) {
+    fake_httpd_resp_t *resp = get_range(uri, "bytes=100-199", 0);
+    CHECK(resp && resp->status == 206 && resp->body_len == 100);
+    CHECK(resp && !memcmp(resp->body, upload + 100, 100));
+    CHECK(header_is(resp, "Content-Range", "bytes 100-199/49152"));
+    CHECK(header_is(resp, "Accept-Ranges", "bytes"));
+    fake_httpd_free(resp);
+
+    resp = get_range(uri, "bytes=49152-", 0);
+    CHECK(resp && resp->status == 416 && resp->body_len == 0);
+    CHECK(header_is(resp, "Content-Range", "bytes */49152"));
+    fake_httpd_free(resp);
+
+    // The client goes away after 10000 bytes and asks for the rest
+    resp = fake_httpd_do(&(fake_httpd_request_t){.method = HTTP_GET, .uri = uri,
+                                                 .read_limit = 10000});
+    CHECK(resp && resp->status == 200 && resp->body_len == 10000);
+    fake_httpd_free(resp);
+    resp = get_range(uri, "bytes=10000-", 0);
+    CHECK(resp && resp->status == 206 && resp->body_len == TOTAL - 10000);
+    CHECK(resp && !memcmp(resp->body, upload + 10000, TOTAL - 10000));
+    CHECK(header_is(resp, "Content-Range", "bytes 10000-49151/49152"));
+    fake_httpd_free(resp);
+}
+
+static void test_range_get(void) {
+    CHECK(fixture_fs_write("/www/range.bin", upload, TOTAL));
+    check_range_get("/range.bin");
+    CHECK(fixture_fs_write("/up/range.bin", upload, TOTAL));
+    check_range_get("/dav/up/range.bin");
+}
+
+static void test_expired_resume_restarts(void) {
+    fake_httpd_resp_t *resp = put_range("/dav/up/c.bin", 0, CHUNK, CHUNK);
+    CHECK(resp && resp->status == 202);
+    fake_httpd_free(resp);
+
+    // Still fresh just inside the limit
+    age("/up/c.bin.~upload", CONFIG_HTTP_WEBDAV_RESUME_TTL - 60);
+    resp = put_range("/dav/up/c.bin", 0, 0, 0);
+    CHECK(resp && upload_offset(resp) == CHUNK);
+    fake_httpd_free(resp);
+
+    age("/up/c.bin.~upload", CONFIG_HTTP_WEBDAV_RESUME_TTL + 60);
+    resp = put_range("/dav/up/c.bin", CHUNK, CHUNK, CHUNK);
+    CHECK(resp && resp->status == 409 && upload_offset(resp) == 0);
+    fake_httpd_free(resp);
+    CHECK(!fixture_fs_exists("/up/c.bin.~upload"));
+}
+
+static void test_stale_swept(void) {
+    CHECK(fixture_fs_write("/up/old1.bin.~upload", upload, 100));
+    CHECK(fixture_fs_write("/up/old2.bin.~upload", upload, 100));
+    CHECK(fixture_fs_write("/up/fresh.bin.~upload", upload, 100));
+    age("/up/old1.bin.~upload", CONFIG_HTTP_WEBDAV_RESUME_TTL + 60);
+
+    // Listing the directory drops the stale one and keeps the fresh one
+    fake_httpd_resp_t *resp = propfind("/dav/up", "1");
+    CHECK(resp && resp->status == 207 && strstr(resp->body, ".~upload") == NULL);
+    fake_httpd_free(resp);
+    CHECK(!fixture_fs_exists("/up/old1.bin.~upload"));
+    CHECK(fixture_fs_exists("/up/fresh.bin.~upload"));
+
+    // So does a plain PUT next to it
+    age("/up/old2.bin.~upload", CONFIG_HTTP_WEBDAV_RESUME_TTL + 60);
+    resp = fake_httpd_do(&(fake_httpd_request_t){
+        .method = HTTP_PUT, .uri = "/dav/up/small.txt", .body = "hi", .body_len = 2});
+    CHECK(resp && resp->status == 201);
+    fake_httpd_free(resp);
+    CHECK(!fixture_fs_exists("/up/old2.bin.~upload"));
+    CHECK(fixture_fs_exists("/up/fresh.bin.~upload"));
+
+    // A plain PUT of the same path replaces a fresh partial upload
+    resp = fake_httpd_do(&(fake_httpd_request_t){
+        .method = HTTP_PUT, .uri = "/dav/up/fresh.bin", .body = "ok", .body_len = 2});
+    CHECK(resp && resp->status == 201);
+    fake_httpd_free(resp);
+    CHECK(!fixture_fs_exists("/up/fresh.bin.~upload"));
+}
+
+int main(void) {
+    for (size_t i = 0; i < sizeof(upload); i++) {
+        upload[i] = (char)(i * 7 + i / 1024);
+    }
+    fixture_fs_reset();
+    CHECK(fixture_fs_write("/up/.keep", "", 0));
+    CHECK(fixture_http_start());
+
+    test_interrupted_resume();
+    test_reserved_name();
+    test_user_tmp_file();
+    test_full_storage_keeps_chunks();
+    test_range_get();
+    test_expired_resume_restarts();
+    test_stale_swept();
+
+    http_shutdown();
+    return host_test_done("test_webdav_resume");
+}